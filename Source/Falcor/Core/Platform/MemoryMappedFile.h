@@ -0,0 +1,72 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include <filesystem>
+
+namespace Falcor
+{
+    /** Read-only memory mapping of a whole file.
+        The pages are loaded by the OS on first access, so large files can be
+        read without copying them into a separate buffer first.
+    */
+    class dlldecl MemoryMappedFile
+    {
+    public:
+        MemoryMappedFile() = default;
+        ~MemoryMappedFile() { close(); }
+
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+        /** Maps a file. A previously mapped file is closed first.
+            \param[in] path File to map.
+            \return Returns true if successful. Empty files cannot be mapped.
+        */
+        bool open(const std::filesystem::path& path);
+
+        /** Unmaps the file. The pointer returned by getData() becomes invalid.
+        */
+        void close();
+
+        bool isOpen() const { return mpData != nullptr; }
+
+        /** Returns the mapped contents of the file, nullptr if no file is mapped.
+        */
+        const uint8_t* getData() const { return mpData; }
+
+        /** Returns the size of the mapped file in bytes.
+        */
+        size_t getSize() const { return mSize; }
+
+    private:
+        const uint8_t* mpData = nullptr;
+        size_t mSize = 0;
+        void* mpFileHandle = nullptr;    ///< Platform specific handle of the open file.
+        void* mpMappingHandle = nullptr; ///< Platform specific handle of the mapping.
+    };
+}
@@ -395,6 +395,14 @@ namespace Falcor
     */
     dlldecl uint64_t  getProcessUsedVirtualMemory();
 
+    /** Get the physical memory currently used by this process (working set / resident set size) in bytes.
+    */
+    dlldecl uint64_t getProcessWorkingSet();
+
+    /** Get the peak physical memory used by this process since it started in bytes.
+    */
+    dlldecl uint64_t getProcessPeakWorkingSet();
+
     /** Returns index of most significant set bit, or 0 if no bits were set.
     */
     dlldecl uint32_t bitScanReverse(uint32_t a);
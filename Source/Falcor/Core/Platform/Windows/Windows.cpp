@@ -804,6 +804,20 @@ namespace Falcor
         return virtualMemUsedByMe;
     }
 
+    uint64_t getProcessWorkingSet()
+    {
+        PROCESS_MEMORY_COUNTERS pmc;
+        GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+        return pmc.WorkingSetSize;
+    }
+
+    uint64_t getProcessPeakWorkingSet()
+    {
+        PROCESS_MEMORY_COUNTERS pmc;
+        GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+        return pmc.PeakWorkingSetSize;
+    }
+
     uint32_t bitScanReverse(uint32_t a)
     {
         unsigned long index;
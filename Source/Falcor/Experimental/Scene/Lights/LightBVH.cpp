@@ -173,6 +173,29 @@ namespace Falcor
         updateNodeIndices();
     }
 
+    float LightBVH::evalSAHCost() const
+    {
+        if (!isValid()) return 0.f;
+        syncDataToCPU();
+
+        auto getArea = [](const PackedNode& node)
+        {
+            float3 aabbMin, aabbMax;
+            node.getNodeAttributes().getAABB(aabbMin, aabbMax);
+            return AABB(aabbMin, aabbMax).area();
+        };
+
+        double cost = 0.0;
+        for (const PackedNode& node : mNodes)
+        {
+            const float area = getArea(node);
+            cost += node.isLeaf() ? area * node.getLeafNode().triangleCount : area;
+        }
+
+        const float rootArea = getArea(mNodes[0]);
+        return rootArea > 0.f ? (float)(cost / rootArea) : 0.f;
+    }
+
     void LightBVH::computeStats()
     {
         assert(isValid());
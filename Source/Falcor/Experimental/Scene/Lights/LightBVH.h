@@ -107,6 +107,13 @@ namespace Falcor
         */
         const BVHStats& getStats() const { return mBVHStats; }
 
+        /** Evaluates the quality of the hierarchy with the surface area heuristic.
+            The cost is the surface area of the internal nodes plus the surface area of the leaves times their triangle count,
+            relative to the surface area of the root. Lower is better. Reads the nodes back from the GPU if they have been refit.
+            \return The SAH cost, or 0 if the BVH is not valid.
+        */
+        float evalSAHCost() const;
+
         /** Is the BVH valid.
             \return true if the BVH is ready for use.
         */
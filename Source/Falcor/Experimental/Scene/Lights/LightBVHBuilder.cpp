@@ -27,6 +27,7 @@
  **************************************************************************/
 #include "stdafx.h"
 #include "LightBVHBuilder.h"
+#include "Utils/Threading.h"
 #include <algorithm>
 
 namespace
@@ -41,6 +42,21 @@ namespace
     const uint32_t kMaxLeafTriangleCount = 1 << PackedNode::kTriangleCountBits;
     const uint32_t kMaxLeafTriangleOffset = 1 << PackedNode::kTriangleOffsetBits;
 
+    // Subtrees with more triangles are built as parallel tasks by the top-down builder.
+    const uint32_t kParallelBuildThreshold = 4096;
+
+    // Morton codes of the LBVH builder, 10 bits per axis.
+    const uint32_t kMortonBitsPerAxis = 10;
+    const uint32_t kMortonBits = 3 * kMortonBitsPerAxis;
+
+    // Number of bits sorted per pass of the CPU radix sort.
+    const uint32_t kRadixBits = 10;
+
+    // Maximum number of triangles sorted on the GPU, the largest count PrefixSum supports.
+    const uint32_t kMaxGPUSortCount = 1023 * 2048;
+
+    const char kMortonSortShaderFile[] = "Experimental/Scene/Lights/LightBVHMortonSort.cs.slang";
+
     inline float safeACos(float v)
     {
         return std::acos(glm::clamp(v, -1.0f, 1.0f));
@@ -215,6 +231,120 @@ namespace
         return dims.x * dims.y * dims.z;
     }
 
+    /** Spreads the 10 LSBs of v to every third bit.
+    */
+    inline uint32_t expandBits3(uint32_t v)
+    {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    /** Returns the scale that maps the given bounds to the Morton grid.
+        Dimensions that are zero are mapped to the first grid cell.
+    */
+    float3 getMortonScale(const AABB& bounds)
+    {
+        const float3 extent = bounds.extent();
+        const float gridSize = (float)(1 << kMortonBitsPerAxis);
+        return float3(extent.x > 0.f ? gridSize / extent.x : 0.f, extent.y > 0.f ? gridSize / extent.y : 0.f, extent.z > 0.f ? gridSize / extent.z : 0.f);
+    }
+
+    /** Computes the 30-bit Morton code of a point. See computeMortonCode() in LightBVHMortonSort.cs.slang.
+    */
+    uint32_t computeMortonCode(const float3& p, const float3& boundsMin, const float3& scale)
+    {
+        const float3 cell = glm::clamp((p - boundsMin) * scale, float3(0.f), float3((float)((1 << kMortonBitsPerAxis) - 1)));
+        return expandBits3((uint32_t)cell.x) | (expandBits3((uint32_t)cell.y) << 1) | (expandBits3((uint32_t)cell.z) << 2);
+    }
+
+    /** Reorders a list.
+        \param[in] order Index of the item to store at each position.
+    */
+    template<typename T>
+    void permute(std::vector<T>& items, const std::vector<uint32_t>& order)
+    {
+        assert(items.size() == order.size());
+        std::vector<T> sorted(items.size());
+        Threading::parallelFor(0, items.size(), [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i) sorted[i] = items[order[i]];
+        });
+        items.swap(sorted);
+    }
+
+    /** Appends a subtree that was built into a separate node list.
+        \return Index of the subtree root in the destination list.
+    */
+    uint32_t appendNodes(const std::vector<PackedNode>& src, std::vector<PackedNode>& dst)
+    {
+        assert(dst.size() + src.size() < std::numeric_limits<uint32_t>::max());
+        const uint32_t offset = (uint32_t)dst.size();
+        dst.insert(dst.end(), src.begin(), src.end());
+        for (size_t i = offset; i < dst.size(); ++i)
+        {
+            // The first dword of an internal node is its right child index, see PackedNode.
+            // It is offset in place, repacking the node would quantize the attributes again.
+            if (!dst[i].isLeaf()) dst[i].data[0].x += offset;
+        }
+        return offset;
+    }
+
+    /** Per-thread scratch memory for binning the triangles of a node.
+        The centers are gathered into one array per axis, so that the bin indices are computed
+        by loops over contiguous floats which the compiler vectorizes.
+    */
+    struct BinningScratch
+    {
+        std::vector<float> centers[3];
+        std::vector<uint32_t> binIds;
+    };
+
+    thread_local BinningScratch tBinningScratch;
+
+    template<typename TriangleData>
+    void gatherCenters(const std::vector<TriangleData>& triangles, uint32_t begin, uint32_t end, BinningScratch& scratch)
+    {
+        const size_t count = end - begin;
+        for (auto& centers : scratch.centers) centers.resize(count);
+        scratch.binIds.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float3 center = triangles[begin + i].bounds.center();
+            scratch.centers[0][i] = center.x;
+            scratch.centers[1][i] = center.y;
+            scratch.centers[2][i] = center.z;
+        }
+    }
+
+    /** Computes the bin index of every gathered center along one axis.
+        The node bounds can be zero along the axis if all primitives are axis-aligned and coplanar, then all centers go to the first bin.
+    */
+    void computeBinIds(BinningScratch& scratch, uint32_t dimension, float bmin, float bmax, uint32_t binCount)
+    {
+        const float w = bmax - bmin;
+        assert(w >= 0.f);
+        const float scale = w > FLT_MIN ? (float)binCount / w : 0.f;
+        const float maxBin = (float)(binCount - 1);
+        const float* pCenters = scratch.centers[dimension].data();
+        uint32_t* pBinIds = scratch.binIds.data();
+        const size_t count = scratch.binIds.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            // The centers are inside the node bounds, so the value is not negative and the conversion to int is exact.
+            pBinIds[i] = (uint32_t)(int32_t)std::min((pCenters[i] - bmin) * scale, maxBin);
+        }
+    }
+
+    const Gui::DropdownList kBuildMethodList =
+    {
+        { (uint32_t)LightBVHBuilder::BuildMethod::TopDown, "Top-down" },
+        { (uint32_t)LightBVHBuilder::BuildMethod::LBVH, "LBVH" }
+    };
+
     const Gui::DropdownList kSplitHeuristicList =
     {
         { (uint32_t)LightBVHBuilder::SplitHeuristic::Equal, "Equal" },
@@ -248,6 +378,7 @@ namespace Falcor
         // For each triangle, precompute data we need for the build.
         BuildingData data(bvh.mNodes);
         data.trianglesData.reserve(triangles.size());
+        AABB centerBounds;
 
         for (size_t i = 0; i < triangles.size(); i++)
         {
@@ -263,6 +394,7 @@ namespace Falcor
                 tri.cosConeAngle = 1.f; // Single flat emitter => normal bounding cone angle is zero.
                 tri.flux = triangles[i].flux;
                 tri.triangleIndex = static_cast<uint32_t>(i);
+                centerBounds |= tri.bounds.center();
 
                 data.trianglesData.push_back(tri);
             }
@@ -287,14 +419,31 @@ namespace Falcor
         // TODO: Better estimate of how many nodes we will need.
         data.nodes.clear();
         data.nodes.reserve(2 * data.trianglesData.size());
-        data.triangleIndices.reserve(data.trianglesData.size());
+        data.triangleIndices.resize(data.trianglesData.size());
 
         const uint64_t invalidBitmask = std::numeric_limits<uint64_t>::max();
         data.triangleBitmasks.resize(triangles.size(), invalidBitmask); // This is sized based on input triangle count, as it's indexed by global triangle index.
 
         // Build the tree.
-        SplitHeuristicFunction splitFunc = getSplitFunction(mOptions.splitHeuristicSelection);
-        buildInternal(mOptions, splitFunc, 0ull, 0, Range(0, static_cast<uint32_t>(data.trianglesData.size())), data);
+        const Range triangleRange(0, static_cast<uint32_t>(data.trianglesData.size()));
+        if (mOptions.buildMethod == BuildMethod::LBVH)
+        {
+            if (mOptions.sortOnGPU && triangleRange.length() <= kMaxGPUSortCount)
+            {
+                sortByMortonCodeGPU(gpDevice->getRenderContext(), *bvh.mpLightCollection, data, centerBounds);
+            }
+            else
+            {
+                if (mOptions.sortOnGPU) logWarning("LightBVHBuilder::build() can sort at most " + std::to_string(kMaxGPUSortCount) + " triangles on the GPU: sorting on the CPU instead");
+                sortByMortonCodeCPU(data, centerBounds);
+            }
+            buildLBVHInternal(mOptions, 0ull, 0, triangleRange, data);
+        }
+        else
+        {
+            SplitHeuristicFunction splitFunc = getSplitFunction(mOptions.splitHeuristicSelection);
+            buildInternal(mOptions, splitFunc, 0ull, 0, triangleRange, data, data.nodes);
+        }
         assert(!data.nodes.empty());
 
         size_t numValid = 0;
@@ -302,9 +451,12 @@ namespace Falcor
             if (mask != invalidBitmask) numValid++;
         assert(numValid == data.trianglesData.size());
 
-        // Compute per-node light bounding cones.
-        float cosConeAngle;
-        computeLightingConesInternal(0, data, cosConeAngle);
+        // Compute per-node light bounding cones. The LBVH is refit on the GPU instead.
+        if (mOptions.buildMethod == BuildMethod::TopDown)
+        {
+            float cosConeAngle;
+            computeLightingConesInternal(0, data, cosConeAngle);
+        }
 
         // The BVH is ready, mark it as valid and upload the data.
         bvh.mIsValid = true;
@@ -313,6 +465,9 @@ namespace Falcor
 
         // Computate metadata.
         bvh.finalize();
+
+        // The LBVH nodes only hold the hierarchy and the flux, compute the bounds and lighting cones.
+        if (mOptions.buildMethod == BuildMethod::LBVH) bvh.refit(gpDevice->getRenderContext());
     }
 
     bool LightBVHBuilder::renderUI(Gui::Widgets& widget)
@@ -327,6 +482,16 @@ namespace Falcor
 
         optionsChanged |= widget.checkbox("Allow refitting", options.allowRefitting);
         optionsChanged |= widget.var("Max triangle count per leaf", options.maxTriangleCountPerLeaf, 1u, kMaxLeafTriangleCount);
+        optionsChanged |= widget.dropdown("Build method", kBuildMethodList, (uint32_t&)options.buildMethod);
+
+        if (options.buildMethod == BuildMethod::LBVH)
+        {
+            optionsChanged |= widget.checkbox("Sort on GPU", options.sortOnGPU);
+            optionsChanged |= widget.checkbox("Use pre-integration", options.usePreintegration);
+            return optionsChanged;
+        }
+
+        optionsChanged |= widget.checkbox("Parallel build", options.useParallelBuild);
         optionsChanged |= widget.dropdown("Split heuristic", kSplitHeuristicList, (uint32_t&)options.splitHeuristicSelection);
 
         if (auto splitGroup = widget.group("Split Options", true))
@@ -360,7 +525,7 @@ namespace Falcor
     {
     }
 
-    uint32_t LightBVHBuilder::buildInternal(const Options& options, const SplitHeuristicFunction& splitHeuristic, uint64_t bitmask, uint32_t depth, const Range& triangleRange, BuildingData& data)
+    uint32_t LightBVHBuilder::buildInternal(const Options& options, const SplitHeuristicFunction& splitHeuristic, uint64_t bitmask, uint32_t depth, const Range& triangleRange, BuildingData& data, std::vector<PackedNode>& nodes)
     {
         assert(triangleRange.begin < triangleRange.end);
 
@@ -374,8 +539,6 @@ namespace Falcor
         }
         assert(nodeBounds.valid());
 
-        data.currentNodeFlux = nodeFlux;
-
         bool trySplitting = triangleRange.length() > (options.createLeavesASAP ? options.maxTriangleCountPerLeaf : 1);
         const SplitResult splitResult = trySplitting ? splitHeuristic(data, triangleRange, nodeBounds, options) : SplitResult();
 
@@ -389,9 +552,9 @@ namespace Falcor
             std::nth_element(std::begin(data.trianglesData) + triangleRange.begin, std::begin(data.trianglesData) + splitResult.triangleIndex, std::begin(data.trianglesData) + triangleRange.end, comp);
 
             // Allocate internal node.
-            assert(data.nodes.size() < std::numeric_limits<uint32_t>::max());
-            const uint32_t nodeIndex = (uint32_t)data.nodes.size();
-            data.nodes.push_back({});
+            assert(nodes.size() < std::numeric_limits<uint32_t>::max());
+            const uint32_t nodeIndex = (uint32_t)nodes.size();
+            nodes.push_back({});
 
             InternalNode node = {};
             node.attribs.setAABB(nodeBounds.minPoint, nodeBounds.maxPoint);
@@ -405,13 +568,39 @@ namespace Falcor
                 throw std::exception(("BVH depth of " + std::to_string(depth + 1) + " reached; maximum of " + std::to_string(kMaxBVHDepth) + " allowed.").c_str());
             }
 
-            uint32_t leftIndex = buildInternal(options, splitHeuristic, bitmask | (0ull << depth), depth + 1, Range(triangleRange.begin, splitResult.triangleIndex), data);
-            uint32_t rightIndex = buildInternal(options, splitHeuristic, bitmask | (1ull << depth), depth + 1, Range(splitResult.triangleIndex, triangleRange.end), data);
+            const Range leftRange(triangleRange.begin, splitResult.triangleIndex);
+            const Range rightRange(splitResult.triangleIndex, triangleRange.end);
+            const uint64_t leftBitmask = bitmask | (0ull << depth);
+            const uint64_t rightBitmask = bitmask | (1ull << depth);
 
-            assert(leftIndex == nodeIndex + 1); // The left node should always be placed immediately after the current node.
-            node.rightChildIdx = rightIndex;
+            if (options.useParallelBuild && triangleRange.length() > kParallelBuildThreshold && Threading::getThreadCount() > 0)
+            {
+                // Build the children in parallel into separate node lists. They work on disjoint triangle ranges,
+                // and write disjoint triangle indices and bitmasks, so only their nodes need to be merged.
+                std::vector<PackedNode> leftNodes, rightNodes;
+                leftNodes.reserve(2 * leftRange.length());
+                rightNodes.reserve(2 * rightRange.length());
+                {
+                    Threading::TaskGroup group;
+                    group.run([&]() { buildInternal(options, splitHeuristic, leftBitmask, depth + 1, leftRange, data, leftNodes); });
+                    buildInternal(options, splitHeuristic, rightBitmask, depth + 1, rightRange, data, rightNodes);
+                    group.wait();
+                }
 
-            data.nodes[nodeIndex].setInternalNode(node);
+                uint32_t leftIndex = appendNodes(leftNodes, nodes);
+                assert(leftIndex == nodeIndex + 1);
+                node.rightChildIdx = appendNodes(rightNodes, nodes);
+            }
+            else
+            {
+                uint32_t leftIndex = buildInternal(options, splitHeuristic, leftBitmask, depth + 1, leftRange, data, nodes);
+                uint32_t rightIndex = buildInternal(options, splitHeuristic, rightBitmask, depth + 1, rightRange, data, nodes);
+
+                assert(leftIndex == nodeIndex + 1); // The left node should always be placed immediately after the current node.
+                node.rightChildIdx = rightIndex;
+            }
+
+            nodes[nodeIndex].setInternalNode(node);
             return nodeIndex;
         }
         else // No split => create leaf node
@@ -419,9 +608,9 @@ namespace Falcor
             assert(triangleRange.length() <= options.maxTriangleCountPerLeaf);
 
             // Allocate leaf node.
-            assert(data.nodes.size() < std::numeric_limits<uint32_t>::max());
-            const uint32_t nodeIndex = (uint32_t)data.nodes.size();
-            data.nodes.push_back({});
+            assert(nodes.size() < std::numeric_limits<uint32_t>::max());
+            const uint32_t nodeIndex = (uint32_t)nodes.size();
+            nodes.push_back({});
 
             LeafNode node = {};
             node.attribs.setAABB(nodeBounds.minPoint, nodeBounds.maxPoint);
@@ -430,24 +619,221 @@ namespace Falcor
             node.attribs.coneDirection = computeLightingCone(triangleRange, data, cosTheta);
             node.attribs.cosConeAngle = cosTheta;
 
+            // The leaves cover the triangle list in depth-first order, so the triangle indices of a leaf are stored at the offset of its range.
             node.triangleCount = triangleRange.length();
-            node.triangleOffset = (uint32_t)data.triangleIndices.size();
+            node.triangleOffset = triangleRange.begin;
             assert(node.triangleCount < kMaxLeafTriangleCount);
             assert(node.triangleOffset < kMaxLeafTriangleOffset);
 
-            for (uint32_t triangleIdx = triangleRange.begin, index = 0; triangleIdx < triangleRange.end; ++triangleIdx, ++index)
+            for (uint32_t triangleIdx = triangleRange.begin; triangleIdx < triangleRange.end; ++triangleIdx)
             {
                 uint32_t globalTriangleIndex = data.trianglesData[triangleIdx].triangleIndex;
-                data.triangleIndices.push_back(globalTriangleIndex);
+                data.triangleIndices[triangleIdx] = globalTriangleIndex;
                 data.triangleBitmasks[globalTriangleIndex] = bitmask;
             }
-            assert(data.triangleIndices.size() == node.triangleOffset + node.triangleCount);
 
-            data.nodes[nodeIndex].setLeafNode(node);
+            nodes[nodeIndex].setLeafNode(node);
             return nodeIndex;
         }
     }
 
+    uint32_t LightBVHBuilder::buildLBVHInternal(const Options& options, uint64_t bitmask, uint32_t depth, const Range& triangleRange, BuildingData& data)
+    {
+        assert(triangleRange.begin < triangleRange.end);
+
+        assert(data.nodes.size() < std::numeric_limits<uint32_t>::max());
+        const uint32_t nodeIndex = (uint32_t)data.nodes.size();
+        data.nodes.push_back({});
+
+        if (triangleRange.length() > options.maxTriangleCountPerLeaf)
+        {
+            if (depth >= kMaxBVHDepth)
+            {
+                throw std::exception(("BVH depth of " + std::to_string(depth + 1) + " reached; maximum of " + std::to_string(kMaxBVHDepth) + " allowed.").c_str());
+            }
+
+            // Split at the highest bit in which the codes of the range differ. The codes are sorted and agree on the higher bits,
+            // so the triangles with the bit set form the upper part of the range. Triangles with equal codes are split in half.
+            uint32_t splitIndex = triangleRange.middle();
+            const uint32_t codeDiff = data.mortonCodes[triangleRange.begin] ^ data.mortonCodes[triangleRange.end - 1];
+            if (codeDiff != 0)
+            {
+                uint32_t splitBit = 1u << (kMortonBits - 1);
+                while ((codeDiff & splitBit) == 0) splitBit >>= 1;
+                auto it = std::partition_point(data.mortonCodes.begin() + triangleRange.begin, data.mortonCodes.begin() + triangleRange.end, [splitBit](uint32_t code) { return (code & splitBit) == 0; });
+                splitIndex = (uint32_t)(it - data.mortonCodes.begin());
+            }
+            assert(triangleRange.begin < splitIndex && splitIndex < triangleRange.end);
+
+            uint32_t leftIndex = buildLBVHInternal(options, bitmask | (0ull << depth), depth + 1, Range(triangleRange.begin, splitIndex), data);
+            uint32_t rightIndex = buildLBVHInternal(options, bitmask | (1ull << depth), depth + 1, Range(splitIndex, triangleRange.end), data);
+            assert(leftIndex == nodeIndex + 1);
+
+            InternalNode node = {};
+            node.attribs.flux = data.nodes[leftIndex].getNodeAttributes().flux + data.nodes[rightIndex].getNodeAttributes().flux;
+            node.rightChildIdx = rightIndex;
+
+            data.nodes[nodeIndex].setInternalNode(node);
+        }
+        else
+        {
+            LeafNode node = {};
+            node.triangleCount = triangleRange.length();
+            node.triangleOffset = triangleRange.begin;
+            assert(node.triangleCount < kMaxLeafTriangleCount);
+            assert(node.triangleOffset < kMaxLeafTriangleOffset);
+
+            for (uint32_t triangleIdx = triangleRange.begin; triangleIdx < triangleRange.end; ++triangleIdx)
+            {
+                uint32_t globalTriangleIndex = data.trianglesData[triangleIdx].triangleIndex;
+                data.triangleIndices[triangleIdx] = globalTriangleIndex;
+                data.triangleBitmasks[globalTriangleIndex] = bitmask;
+                node.attribs.flux += data.trianglesData[triangleIdx].flux;
+            }
+
+            data.nodes[nodeIndex].setLeafNode(node);
+        }
+        return nodeIndex;
+    }
+
+    void LightBVHBuilder::sortByMortonCodeCPU(BuildingData& data, const AABB& centerBounds)
+    {
+        const size_t count = data.trianglesData.size();
+        const float3 scale = getMortonScale(centerBounds);
+
+        std::vector<uint32_t> keys(count), values(count);
+        Threading::parallelFor(0, count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                keys[i] = computeMortonCode(data.trianglesData[i].bounds.center(), centerBounds.minPoint, scale);
+                values[i] = (uint32_t)i;
+            }
+        });
+
+        // LSD radix sort of the (code, triangle) pairs, kRadixBits per pass.
+        std::vector<uint32_t> sortedKeys(count), sortedValues(count);
+        std::vector<uint32_t> offsets(1 << kRadixBits);
+        const uint32_t digitMask = (1u << kRadixBits) - 1;
+        for (uint32_t shift = 0; shift < kMortonBits; shift += kRadixBits)
+        {
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (uint32_t key : keys) ++offsets[(key >> shift) & digitMask];
+
+            uint32_t offset = 0;
+            for (uint32_t& digitOffset : offsets)
+            {
+                const uint32_t digitCount = digitOffset;
+                digitOffset = offset;
+                offset += digitCount;
+            }
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const uint32_t dst = offsets[(keys[i] >> shift) & digitMask]++;
+                sortedKeys[dst] = keys[i];
+                sortedValues[dst] = values[i];
+            }
+            keys.swap(sortedKeys);
+            values.swap(sortedValues);
+        }
+
+        permute(data.trianglesData, values);
+        data.mortonCodes = std::move(keys);
+    }
+
+    void LightBVHBuilder::sortByMortonCodeGPU(RenderContext* pRenderContext, const LightCollection& lights, BuildingData& data, const AABB& centerBounds)
+    {
+        PROFILE("LightBVHBuilder::sortByMortonCodeGPU()");
+
+        const uint32_t count = (uint32_t)data.trianglesData.size();
+        assert(count > 0 && count <= kMaxGPUSortCount);
+
+        if (!mGPUSort.pComputeMortonCodes)
+        {
+            mGPUSort.pComputeMortonCodes = ComputePass::create(kMortonSortShaderFile, "computeMortonCodes");
+            mGPUSort.pRadixSplitFlags = ComputePass::create(kMortonSortShaderFile, "radixSplitFlags");
+            mGPUSort.pRadixSplitScatter = ComputePass::create(kMortonSortShaderFile, "radixSplitScatter");
+            mGPUSort.pPrefixSum = PrefixSum::create();
+            mGPUSort.pZeroCount = Buffer::create(sizeof(uint32_t), Resource::BindFlags::ShaderResource, Buffer::CpuAccess::None, nullptr);
+        }
+
+        // Reallocate buffers if size requirements have changed.
+        if (!mGPUSort.pFlags || mGPUSort.pFlags->getSize() < count * sizeof(uint32_t))
+        {
+            const auto bindFlags = Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess;
+            mGPUSort.pTriangleIndices = Buffer::createStructured(sizeof(uint32_t), count, Resource::BindFlags::ShaderResource, Buffer::CpuAccess::None, nullptr, false);
+            for (uint32_t i = 0; i < 2; ++i)
+            {
+                mGPUSort.pKeys[i] = Buffer::createStructured(sizeof(uint32_t), count, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+                mGPUSort.pValues[i] = Buffer::createStructured(sizeof(uint32_t), count, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+            }
+            mGPUSort.pFlags = Buffer::create(count * sizeof(uint32_t), bindFlags, Buffer::CpuAccess::None, nullptr);
+        }
+
+        std::vector<uint32_t> triangleIndices(count);
+        for (uint32_t i = 0; i < count; ++i) triangleIndices[i] = data.trianglesData[i].triangleIndex;
+        mGPUSort.pTriangleIndices->setBlob(triangleIndices.data(), 0, count * sizeof(uint32_t));
+
+        // Compute the Morton codes from the triangles of the light collection.
+        {
+            auto var = mGPUSort.pComputeMortonCodes->getRootVar()["CB"];
+            lights.setShaderData(var["gLights"]);
+            var["gTriangleIndices"] = mGPUSort.pTriangleIndices;
+            var["gCount"] = count;
+            var["gCenterMin"] = centerBounds.minPoint;
+            var["gCenterScale"] = getMortonScale(centerBounds);
+            var["gKeysOut"] = mGPUSort.pKeys[0];
+            var["gValuesOut"] = mGPUSort.pValues[0];
+            mGPUSort.pComputeMortonCodes->execute(pRenderContext, count, 1, 1);
+        }
+
+        // Split radix sort, one bit per pass. The prefix sum of the zero bit flags gives
+        // the position of the keys with a zero bit, the keys with a one bit go after them.
+        static_assert(kMortonBits % 2 == 0, "The sorted keys are expected in the first buffers");
+        for (uint32_t bit = 0; bit < kMortonBits; ++bit)
+        {
+            const uint32_t src = bit & 1;
+            const uint32_t dst = src ^ 1;
+            {
+                auto var = mGPUSort.pRadixSplitFlags->getRootVar()["CB"];
+                var["gCount"] = count;
+                var["gBit"] = bit;
+                var["gKeysIn"] = mGPUSort.pKeys[src];
+                var["gFlags"] = mGPUSort.pFlags;
+                mGPUSort.pRadixSplitFlags->execute(pRenderContext, count, 1, 1);
+            }
+
+            pRenderContext->uavBarrier(mGPUSort.pFlags.get());
+            mGPUSort.pPrefixSum->execute(pRenderContext, mGPUSort.pFlags, count, nullptr, mGPUSort.pZeroCount);
+
+            {
+                auto var = mGPUSort.pRadixSplitScatter->getRootVar()["CB"];
+                var["gCount"] = count;
+                var["gBit"] = bit;
+                var["gKeysIn"] = mGPUSort.pKeys[src];
+                var["gValuesIn"] = mGPUSort.pValues[src];
+                var["gZerosBefore"] = mGPUSort.pFlags;
+                var["gZeroCount"] = mGPUSort.pZeroCount;
+                var["gKeysOut"] = mGPUSort.pKeys[dst];
+                var["gValuesOut"] = mGPUSort.pValues[dst];
+                mGPUSort.pRadixSplitScatter->execute(pRenderContext, count, 1, 1);
+            }
+        }
+
+        // The hierarchy is built on the CPU, read back the sorted codes and triangles.
+        std::vector<uint32_t> order(count);
+        data.mortonCodes.resize(count);
+        const uint32_t* pKeys = (const uint32_t*)mGPUSort.pKeys[0]->map(Buffer::MapType::Read);
+        std::memcpy(data.mortonCodes.data(), pKeys, count * sizeof(uint32_t));
+        mGPUSort.pKeys[0]->unmap();
+        const uint32_t* pValues = (const uint32_t*)mGPUSort.pValues[0]->map(Buffer::MapType::Read);
+        std::memcpy(order.data(), pValues, count * sizeof(uint32_t));
+        mGPUSort.pValues[0]->unmap();
+
+        permute(data.trianglesData, order);
+    }
+
     float3 LightBVHBuilder::computeLightingConesInternal(const uint32_t nodeIndex, BuildingData& data, float& cosConeAngle)
     {
         if (!data.nodes[nodeIndex].isLeaf())
@@ -559,22 +945,16 @@ namespace Falcor
         std::vector<Bin> bins(parameters.binCount);
         std::vector<float> costs(parameters.binCount - 1);
 
+        BinningScratch& scratch = tBinningScratch;
+        gatherCenters(data.trianglesData, triangleRange.begin, triangleRange.end, scratch);
+
         /** Helper function that computes the best split along the given dimension using the SAH metric.
             The triangles are binned to n bins, storing only the aggregate parameters (triangle count and bounds).
             Then the cost metric is evaluated for each of the n-1 potential splits.
         */
-        const auto binAlongDimension = [&bins, &costs, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds](uint32_t dimension)
+        const auto binAlongDimension = [&bins, &costs, &scratch, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds](uint32_t dimension)
         {
-            // Helper to compute the bin id for a given triangle.
-            auto getBinId = [&](const TriangleSortData& td)
-            {
-                float bmin = nodeBounds.minPoint[dimension], bmax = nodeBounds.maxPoint[dimension];
-                assert(bmin < bmax);
-                float scale = (float)parameters.binCount / (bmax - bmin);
-                float p = td.bounds.center()[dimension];
-                assert(bmin <= p && p <= bmax);
-                return std::min((uint32_t)((p - bmin) * scale), parameters.binCount - 1);
-            };
+            computeBinIds(scratch, dimension, nodeBounds.minPoint[dimension], nodeBounds.maxPoint[dimension], parameters.binCount);
 
             // Reset the bins.
             for (Bin& bin : bins) bin = Bin();
@@ -582,8 +962,7 @@ namespace Falcor
             // Fill the bins with all triangles.
             for (uint32_t i = triangleRange.begin; i < triangleRange.end; ++i)
             {
-                const auto& td = data.trianglesData[i];
-                bins[getBinId(td)] |= td;
+                bins[scratch.binIds[i - triangleRange.begin]] |= data.trianglesData[i];
             }
 
             // First, compute A_j(L) * N_j(L) by sweeping over the bins from left to right.
@@ -725,6 +1104,9 @@ namespace Falcor
         std::vector<Bin> bins(parameters.binCount);
         std::vector<float> costs(parameters.binCount - 1);
 
+        BinningScratch& scratch = tBinningScratch;
+        gatherCenters(data.trianglesData, triangleRange.begin, triangleRange.end, scratch);
+
         /** Helper function that computes the best split along the given dimension using the SAOH metric.
             The triangles are binned to n bins, storing only the aggregate parameters (triangle count, bounds, flux, and cone direction).
             Then the cost metric is evaluated for each of the n-1 potential splits.
@@ -732,19 +1114,9 @@ namespace Falcor
             the bounding cones are approximates based on the bins' bounding cones. This is less expensive,
             but also less precise than computing them directly from the triangles.
         */
-        const auto binAlongDimension = [&bins, &costs, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds, largestDimension, dimensions](uint32_t dimension)
+        const auto binAlongDimension = [&bins, &costs, &scratch, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds, largestDimension, dimensions](uint32_t dimension)
         {
-            // Helper to compute the bin id for a given triangle.
-            auto getBinId = [&](const TriangleSortData& td)
-            {
-                float bmin = nodeBounds.minPoint[dimension], bmax = nodeBounds.maxPoint[dimension];
-                float w = bmax - bmin;
-                assert(w >= 0.f); // The node bounds can be zero if all primitives are axis-aligned and coplanar
-                float scale = w > FLT_MIN ? (float)parameters.binCount / w : 0.f;
-                float p = td.bounds.center()[dimension];
-                assert(bmin <= p && p <= bmax);
-                return std::min((uint32_t)((p - bmin) * scale), parameters.binCount - 1);
-            };
+            computeBinIds(scratch, dimension, nodeBounds.minPoint[dimension], nodeBounds.maxPoint[dimension], parameters.binCount);
 
             // Reset the bins.
             for (Bin& bin : bins) bin = Bin();
@@ -752,8 +1124,7 @@ namespace Falcor
             // Fill the bins with all triangles.
             for (uint32_t i = triangleRange.begin; i < triangleRange.end; ++i)
             {
-                const auto& td = data.trianglesData[i];
-                bins[getBinId(td)] |= td;
+                bins[scratch.binIds[i - triangleRange.begin]] |= data.trianglesData[i];
             }
 
             // Compute the lighting cones for each bin.
@@ -768,7 +1139,7 @@ namespace Falcor
             for (uint32_t i = triangleRange.begin; i < triangleRange.end; ++i)
             {
                 const auto& td = data.trianglesData[i];
-                Bin& bin = bins[getBinId(td)];
+                Bin& bin = bins[scratch.binIds[i - triangleRange.begin]];
                 bin.cosConeAngle = computeCosConeAngle(bin.coneDirection, bin.cosConeAngle, td.coneDirection, td.cosConeAngle);
             }
 
@@ -869,7 +1240,9 @@ namespace Falcor
             // Evaluate the cost metric for the node. This requires us to first compute the cone angle.
             float cosTheta = kInvalidCosConeAngle;
             computeLightingCone(triangleRange, data, cosTheta);
-            float leafCost = evalSAOH(nodeBounds, data.currentNodeFlux, cosTheta, parameters);
+            float nodeFlux = 0.f;
+            for (uint32_t i = triangleRange.begin; i < triangleRange.end; ++i) nodeFlux += data.trianglesData[i].flux;
+            float leafCost = evalSAOH(nodeBounds, nodeFlux, cosTheta, parameters);
             if (leafCost <= overallBestSplit.first) return SplitResult();
         }
 
@@ -894,6 +1267,10 @@ namespace Falcor
 
     SCRIPT_BINDING(LightBVHBuilder)
     {
+        pybind11::enum_<LightBVHBuilder::BuildMethod> buildMethod(m, "LightBVHBuildMethod");
+        buildMethod.value("TopDown", LightBVHBuilder::BuildMethod::TopDown);
+        buildMethod.value("LBVH", LightBVHBuilder::BuildMethod::LBVH);
+
         pybind11::enum_<LightBVHBuilder::SplitHeuristic> splitHeuristic(m, "SplitHeuristic");
         splitHeuristic.value("Equal", LightBVHBuilder::SplitHeuristic::Equal);
         splitHeuristic.value("BinnedSAH", LightBVHBuilder::SplitHeuristic::BinnedSAH);
@@ -902,6 +1279,7 @@ namespace Falcor
         // TODO use a nested class in the bindings when supported.
         ScriptBindings::SerializableStruct<LightBVHBuilder::Options> options(m, "LightBVHBuilderOptions");
 #define field(f_) field(#f_, &LightBVHBuilder::Options::f_)
+        options.field(buildMethod);
         options.field(splitHeuristicSelection);
         options.field(maxTriangleCountPerLeaf);
         options.field(binCount);
@@ -913,6 +1291,8 @@ namespace Falcor
         options.field(allowRefitting);
         options.field(usePreintegration);
         options.field(useLightingCones);
+        options.field(useParallelBuild);
+        options.field(sortOnGPU);
 #undef field
     }
 }
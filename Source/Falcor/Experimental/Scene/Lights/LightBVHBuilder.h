@@ -27,6 +27,7 @@
  **************************************************************************/
 #pragma once
 #include "LightBVH.h"
+#include "Utils/Algorithm/PrefixSum.h"
 #include "Utils/Math/AABB.h"
 #include "Utils/Math/Vector.h"
 #include "Utils/UI/Gui.h"
@@ -40,6 +41,10 @@ namespace Falcor
         The building process can be customized via the |Options|,
         which are also available in the GUI via the |renderUI()| function.
 
+        The top-down builder builds large subtrees as parallel tasks on the global thread pool.
+        The LBVH builder sorts the lights along a Morton curve (on the CPU or the GPU), derives the
+        hierarchy from the sorted codes and computes the bounds and cones with LightBVH::refit().
+
         TODO: Rename all things triangle* to light* as the BVH class can be used for other types.
     */
     class dlldecl LightBVHBuilder
@@ -55,11 +60,18 @@ namespace Falcor
             BinnedSAOH = 2u,    ///< Split the input according to SAOH (Estévez Conty et al, 2018); the input is binned for speeding up the SAOH computation.
         };
 
+        enum class BuildMethod : uint32_t
+        {
+            TopDown = 0u,       ///< Recursive top-down build, each node is split according to the split heuristic.
+            LBVH = 1u,          ///< Linear BVH (Lauterbach et al, 2009): the lights are sorted by the Morton codes of their centers and the nodes are split at the highest differing bit. Much faster to build, but the tree quality is lower.
+        };
+
         /** Light BVH builder configuration options.
             Note if you change options, please update SCRIPT_BINDING in LightBVHBuilder.cpp
         */
         struct Options
         {
+            BuildMethod    buildMethod = BuildMethod::TopDown;                   ///< Which build method to use.
             SplitHeuristic splitHeuristicSelection = SplitHeuristic::BinnedSAOH; ///< Which splitting heuristic to use when building.
             uint32_t       maxTriangleCountPerLeaf = 10;                         ///< How many triangles to store at most per leaf node.
             uint32_t       binCount = 16;                                        ///< How many bins to use when building the BVH.
@@ -71,6 +83,8 @@ namespace Falcor
             bool           allowRefitting = true;                                ///< Rather than always rebuilding the BVH from scratch, keep the hierarchy but update the bounds and lighting cones.
             bool           usePreintegration = true;                             ///< Use pre-integration for culling out emissive triangles and use their flux when computing the splits. Only valid when using the BinnedSAOH split heuristic.
             bool           useLightingCones = true;                              ///< Use lighting cones when computing the splits. Only valid when using the BinnedSAOH split heuristic.
+            bool           useParallelBuild = true;                              ///< Build large subtrees as parallel tasks. Only used by the TopDown build method.
+            bool           sortOnGPU = false;                                    ///< Compute and sort the Morton codes on the GPU instead of the CPU. Only used by the LBVH build method.
         };
 
         /** Creates a new object.
@@ -126,7 +140,7 @@ namespace Falcor
             std::vector<TriangleSortData> trianglesData;    ///< Compact list of triangles to include in build.
             std::vector<uint32_t> triangleIndices;          ///< Triangle indices sorted by leaf node. Each leaf node refers to a contiguous array of triangle indices.
             std::vector<uint64_t> triangleBitmasks;         ///< Array containing the per triangle bit pattern retracing the tree traversal to reach the triangle: 0=left child, 1=right child; this array gets filled in during the build process. Indexed by global triangle index.
-            float currentNodeFlux = 0.f;                    ///< Used by computeSAOHSplit() as the leaf creation cost.
+            std::vector<uint32_t> mortonCodes;              ///< Morton codes of the triangle centers, in the order of trianglesData. Only used by the LBVH build method.
 
             BuildingData(std::vector<PackedNode>& bvhNodes) : nodes(bvhNodes) {}
         };
@@ -146,14 +160,42 @@ namespace Falcor
         bool renderOptions(Gui::Widgets& widget, Options& options) const;
 
         /** Recursive BVH build.
+            Subtrees of more than kParallelBuildThreshold triangles build their children as parallel tasks into separate node lists,
+            which are appended to the node list afterwards. The leaves refer to the triangle indices at the offset of their range.
             \param[in] splitHeuristic The splitting heuristic to be used.
             \param[in] bitmask Bit pattern retracing the tree traversal to reach the node to be built: 0=left child, 1=right child.
             \param[in] depth Depth of the node to be built
             \param[in] triangleRange Range of triangles to process.
             \param[in,out] data Prepared light data.
+            \param[in,out] nodes Node list the subtree is appended to. The child indices are relative to the start of the list.
             \return Index of the allocated node.
         */
-        uint32_t buildInternal(const Options& options, const SplitHeuristicFunction& splitHeuristic, uint64_t bitmask, uint32_t depth, const Range& triangleRange, BuildingData& data);
+        uint32_t buildInternal(const Options& options, const SplitHeuristicFunction& splitHeuristic, uint64_t bitmask, uint32_t depth, const Range& triangleRange, BuildingData& data, std::vector<PackedNode>& nodes);
+
+        /** Recursive LBVH build over triangles sorted by Morton code.
+            Only the hierarchy and the flux are computed, the bounds and lighting cones are left to LightBVH::refit().
+            \param[in] bitmask Bit pattern retracing the tree traversal to reach the node to be built: 0=left child, 1=right child.
+            \param[in] depth Depth of the node to be built
+            \param[in] triangleRange Range of triangles to process.
+            \param[in,out] data Prepared light data, sorted by data.mortonCodes.
+            \return Index of the allocated node.
+        */
+        uint32_t buildLBVHInternal(const Options& options, uint64_t bitmask, uint32_t depth, const Range& triangleRange, BuildingData& data);
+
+        /** Sorts the triangles by the Morton codes of their centers on the CPU with a radix sort.
+            \param[in,out] data Prepared light data. The triangles are reordered and data.mortonCodes is filled in.
+            \param[in] centerBounds Bounds of the triangle centers.
+        */
+        static void sortByMortonCodeCPU(BuildingData& data, const AABB& centerBounds);
+
+        /** Sorts the triangles by the Morton codes of their centers on the GPU with a split radix sort using PrefixSum.
+            The codes are computed from the triangles of the light collection.
+            \param[in] pRenderContext The render context.
+            \param[in] lights The light collection.
+            \param[in,out] data Prepared light data. The triangles are reordered and data.mortonCodes is filled in.
+            \param[in] centerBounds Bounds of the triangle centers.
+        */
+        void sortByMortonCodeGPU(RenderContext* pRenderContext, const LightCollection& lights, BuildingData& data, const AABB& centerBounds);
 
         /** Recursive computation of lighting cones for all internal nodes.
             \param[in] nodeIndex Index of the current node.
@@ -180,5 +222,19 @@ namespace Falcor
 
         // Configuration
         Options mOptions;
+
+        // GPU resources for sortByMortonCodeGPU(), created on first use.
+        struct
+        {
+            ComputePass::SharedPtr pComputeMortonCodes;
+            ComputePass::SharedPtr pRadixSplitFlags;
+            ComputePass::SharedPtr pRadixSplitScatter;
+            PrefixSum::SharedPtr pPrefixSum;
+            Buffer::SharedPtr pTriangleIndices;     ///< Global triangle index of each triangle to sort.
+            Buffer::SharedPtr pKeys[2];             ///< Morton codes, ping-ponged between the radix passes.
+            Buffer::SharedPtr pValues[2];           ///< Indices into trianglesData, ping-ponged between the radix passes.
+            Buffer::SharedPtr pFlags;               ///< Per key flag of a zero bit, scanned in place into the number of zeros before each key.
+            Buffer::SharedPtr pZeroCount;           ///< Total number of zero bits of the current pass.
+        } mGPUSort;
     };
 }
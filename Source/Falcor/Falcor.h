@@ -74,6 +74,7 @@
 #include "Core/BufferTypes/VariablesBufferUI.h"
 
 // Core/Platform
+#include "Core/Platform/MemoryMappedFile.h"
 #include "Core/Platform/OS.h"
 #include "Core/Platform/ProgressBar.h"
 
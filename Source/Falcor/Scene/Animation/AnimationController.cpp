@@ -39,7 +39,7 @@ namespace Falcor
         const std::string kPrevInverseTransposeWorldMatrices = "prevInverseTransposeWorldMatrices";
     }
 
-    AnimationController::AnimationController(Scene* pScene, const StaticVertexVector& staticVertexData, const DynamicVertexVector& dynamicVertexData, const std::vector<Animation::SharedPtr>& animations)
+    AnimationController::AnimationController(Scene* pScene, StaticVertexView staticVertexData, DynamicVertexView dynamicVertexData, const std::vector<Animation::SharedPtr>& animations)
         : mpScene(pScene)
         , mLocalMatrices(pScene->mSceneGraph.size())
         , mGlobalMatrices(pScene->mSceneGraph.size())
@@ -72,7 +72,7 @@ namespace Falcor
         }
     }
 
-    AnimationController::UniquePtr AnimationController::create(Scene* pScene, const StaticVertexVector& staticVertexData, const DynamicVertexVector& dynamicVertexData, const std::vector<Animation::SharedPtr>& animations)
+    AnimationController::UniquePtr AnimationController::create(Scene* pScene, StaticVertexView staticVertexData, DynamicVertexView dynamicVertexData, const std::vector<Animation::SharedPtr>& animations)
     {
         return UniquePtr(new AnimationController(pScene, staticVertexData, dynamicVertexData, animations));
     }
@@ -271,7 +271,7 @@ namespace Falcor
         return m;
     }
 
-    void AnimationController::createSkinningPass(const std::vector<PackedStaticVertexData>& staticVertexData, const std::vector<DynamicVertexData>& dynamicVertexData)
+    void AnimationController::createSkinningPass(StaticVertexView staticVertexData, DynamicVertexView dynamicVertexData)
     {
         // We always copy the static data, to initialize the non-skinned vertices.
         const Buffer::SharedPtr& pVB = mpScene->mpVao->getVertexBuffer(Scene::kStaticDataBufferIndex);
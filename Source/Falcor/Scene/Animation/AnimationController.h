@@ -30,6 +30,7 @@
 #include "AnimatedVertexCache.h"
 #include "RenderGraph/BasePasses/ComputePass.h"
 #include "Scene/SceneTypes.slang"
+#include "Utils/ArrayView.h"
 
 namespace Falcor
 {
@@ -45,13 +46,13 @@ namespace Falcor
         static const uint32_t kInvalidBoneID = -1;
         ~AnimationController() = default;
 
-        using StaticVertexVector = std::vector<PackedStaticVertexData>;
-        using DynamicVertexVector = std::vector<DynamicVertexData>;
+        using StaticVertexView = ArrayView<PackedStaticVertexData>;
+        using DynamicVertexView = ArrayView<DynamicVertexData>;
 
         /** Create a new object.
             \return A new object, or throws an exception if creation failed.
         */
-        static UniquePtr create(Scene* pScene, const StaticVertexVector& staticVertexData, const DynamicVertexVector& dynamicVertexData, const std::vector<Animation::SharedPtr>& animations);
+        static UniquePtr create(Scene* pScene, StaticVertexView staticVertexData, DynamicVertexView dynamicVertexData, const std::vector<Animation::SharedPtr>& animations);
 
         /** Add animated vertex caches (curves and meshes) to the controller.
         */
@@ -128,7 +129,7 @@ namespace Falcor
 
     private:
         friend class SceneBuilder;
-        AnimationController(Scene* pScene, const StaticVertexVector& staticVertexData, const DynamicVertexVector& dynamicVertexData, const std::vector<Animation::SharedPtr>& animations);
+        AnimationController(Scene* pScene, StaticVertexView staticVertexData, DynamicVertexView dynamicVertexData, const std::vector<Animation::SharedPtr>& animations);
 
         void initFlags();
         void initLocalMatrices();
@@ -138,7 +139,7 @@ namespace Falcor
 
         void bindBuffers();
 
-        void createSkinningPass(const std::vector<PackedStaticVertexData>& staticVertexData, const std::vector<DynamicVertexData>& dynamicVertexData);
+        void createSkinningPass(StaticVertexView staticVertexData, DynamicVertexView dynamicVertexData);
         void executeSkinningPass(RenderContext* pContext, bool initPrev = false);
 
         // Animation
@@ -33,11 +33,10 @@
 #include "AssimpImporter.h"
 #include "Utils/StringUtils.h"
 #include "Utils/Timing/TimeReport.h"
+#include "Utils/Threading.h"
 #include "Core/API/Device.h"
 #include "Scene/SceneBuilder.h"
 
-#include <execution>
-
 namespace Falcor
 {
     namespace
@@ -516,8 +515,7 @@ namespace Falcor
 
             // Pre-process meshes.
             std::vector<SceneBuilder::ProcessedMesh> processedMeshes(meshCount);
-            auto range = NumericRange<uint32_t>(0, meshCount);
-            std::for_each(std::execution::par, range.begin(), range.end(), [&] (uint32_t i) {
+            auto processAiMesh = [&] (uint32_t i) {
                 const aiMesh* pAiMesh = pScene->mMeshes[i];
                 const uint32_t perFaceIndexCount = pAiMesh->mFaces[0].mNumIndices;
 
@@ -586,15 +584,21 @@ namespace Falcor
                 mesh.pMaterial = data.materialMap.at(pAiMesh->mMaterialIndex);
 
                 processedMeshes[i] = data.builder.processMesh(mesh);
-            });
+            };
+
+            // The meshes run on the Falcor thread pool, whose workers keep their mesh processing scratch memory between meshes.
+            Threading::parallelFor(0, meshCount, [&](size_t rangeBegin, size_t rangeEnd)
+            {
+                for (size_t i = rangeBegin; i < rangeEnd; i++) processAiMesh((uint32_t)i);
+            }, 1);
 
             // Add meshes to the scene.
             // We retain a deterministic order of the meshes in the global scene buffer by adding
             // them sequentially after being processed in parallel.
             uint32_t i = 0;
-            for (const auto& mesh : processedMeshes)
+            for (auto& mesh : processedMeshes)
             {
-                uint32_t meshID = data.builder.addProcessedMesh(mesh);
+                uint32_t meshID = data.builder.addProcessedMesh(std::move(mesh));
                 data.meshMap[i++] = meshID;
             }
         }
@@ -0,0 +1,104 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "ConeMapGenerator.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        const char kShaderFilename[] = "Scene/Material/ConeMapGenerator.cs.slang";
+        const ResourceFormat kConeMapFormat = ResourceFormat::RG16Unorm;
+    }
+
+    ConeMapGenerator::SharedPtr ConeMapGenerator::create()
+    {
+        return SharedPtr(new ConeMapGenerator());
+    }
+
+    ConeMapGenerator::ConeMapGenerator()
+    {
+        mpCopyPass = ComputePass::create(kShaderFilename, "copyHeights");
+        mpMipmapPass = ComputePass::create(kShaderFilename, "mipmapMinmax");
+        mpConePass = ComputePass::create(kShaderFilename, "generateConeMap");
+    }
+
+    Texture::SharedPtr ConeMapGenerator::generate(RenderContext* pRenderContext, const Texture::SharedPtr& pHeightMap)
+    {
+        assert(pRenderContext && pHeightMap);
+
+        if (pHeightMap->getType() != Resource::Type::Texture2D)
+        {
+            throw std::runtime_error("ConeMapGenerator::generate() - Height map '" + pHeightMap->getSourceFilename() + "' is not a 2D texture");
+        }
+
+        const uint2 size = { pHeightMap->getWidth(), pHeightMap->getHeight() };
+
+        // [min, max] heights with a full mip chain. Float keeps the heights of any height map format exact.
+        Texture::SharedPtr pMinmax = Texture::create2D(size.x, size.y, ResourceFormat::RG32Float, 1, Resource::kMaxPossible, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+        const uint32_t topLevel = pMinmax->getMipCount() - 1;
+
+        Texture::SharedPtr pConeMap = Texture::create2D(size.x, size.y, kConeMapFormat, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+        pConeMap->setName(pHeightMap->getName() + " (cone map)");
+        pConeMap->setSourceFilename(pHeightMap->getSourceFilename());
+
+        // Copy the heights to the first minmax level.
+        {
+            auto var = mpCopyPass->getRootVar()["gConeMapGenerator"];
+            var["heightMap"].setSrv(pHeightMap->getSRV(0, 1, 0, 1));
+            var["dstMinmaxMap"].setUav(pMinmax->getUAV(0));
+            var["size"] = size;
+            mpCopyPass->execute(pRenderContext, uint3(size, 1));
+        }
+
+        // Pool the minmax mips.
+        auto mipmapVar = mpMipmapPass->getRootVar()["gConeMapGenerator"];
+        mipmapVar["srcMinmaxMap"].setSrv(pMinmax->getSRV());
+        mipmapVar["size"] = size;
+        for (uint32_t level = 0; level < topLevel; level++)
+        {
+            mipmapVar["dstMinmaxMap"].setUav(pMinmax->getUAV(level + 1));
+            mipmapVar["srcLevel"] = level;
+            mpMipmapPass->execute(pRenderContext, uint3(pMinmax->getWidth(level + 1), pMinmax->getHeight(level + 1), 1));
+        }
+
+        // Search the cones.
+        {
+            const uint32_t coneBits = getNumChannelBits(kConeMapFormat, 1);
+            auto var = mpConePass->getRootVar()["gConeMapGenerator"];
+            var["srcMinmaxMap"].setSrv(pMinmax->getSRV());
+            var["coneMap"].setUav(pConeMap->getUAV(0));
+            var["size"] = size;
+            var["topLevel"] = topLevel;
+            var["coneQuantum"] = 1.f / float((1u << coneBits) - 1);
+            mpConePass->execute(pRenderContext, uint3(size, 1));
+        }
+
+        return pConeMap;
+    }
+}
@@ -0,0 +1,63 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+
+namespace Falcor
+{
+    /** Bakes cone maps for cone step mapping.
+
+        A cone map stores [height, cone ratio] per texel. The cone ratio is the
+        horizontal distance (uv units) per unit height of the widest upward cone
+        that is not pierced by the height field. The cones are conservative, a
+        ray that steps along them never skips over the height field.
+    */
+    class dlldecl ConeMapGenerator
+    {
+    public:
+        using SharedPtr = std::shared_ptr<ConeMapGenerator>;
+
+        /** Create a new cone map generator.
+            \return A new object, or throws an exception if creation failed.
+        */
+        static SharedPtr create();
+
+        /** Bake the cone map of a height map.
+            \param[in] pRenderContext The context.
+            \param[in] pHeightMap Height map. The heights in [0,1] are read from the red channel of the first mip level and array slice, 1 is the top of the surface.
+            \return A new RG16Unorm texture storing [height, cone ratio].
+        */
+        Texture::SharedPtr generate(RenderContext* pRenderContext, const Texture::SharedPtr& pHeightMap);
+
+    private:
+        ConeMapGenerator();
+
+        ComputePass::SharedPtr mpCopyPass;
+        ComputePass::SharedPtr mpMipmapPass;
+        ComputePass::SharedPtr mpConePass;
+    };
+}
@@ -63,6 +63,7 @@ namespace Falcor
         updateAlphaMode();
         updateNormalMapMode();
         updateDisplacementFlag();
+        updateConeMapFlag();
     }
 
     Material::SharedPtr Material::create(const std::string& name)
@@ -169,6 +170,20 @@ namespace Falcor
             if (widget.var("Displacement offset", offset)) setDisplacementOffset(offset);
         }
 
+        if (const auto& tex = getConeMap(); tex != nullptr)
+        {
+            widget.text("Cone map: " + tex->getSourceFilename());
+            widget.text("Texture info: " + std::to_string(tex->getWidth()) + "x" + std::to_string(tex->getHeight()) + " (" + to_string(tex->getFormat()) + ")");
+            widget.image("Cone map", tex, float2(100.f));
+            if (widget.button("Remove texture##ConeMap")) setConeMap(nullptr);
+
+            float depth = getConeMapDepth();
+            if (widget.var("Cone map depth", depth, 0.f, std::numeric_limits<float>::max(), 0.001f)) setConeMapDepth(depth);
+
+            uint32_t steps = getConeMapSteps();
+            if (widget.var("Cone map steps", steps, 1u, 1024u)) setConeMapSteps(steps);
+        }
+
         if (const auto& tex = getEmissiveTexture(); tex != nullptr)
         {
             widget.text("Emissive color: " + tex->getSourceFilename());
@@ -356,6 +371,10 @@ namespace Falcor
             updateDisplacementFlag();
             updateDoubleSidedFlag();
             break;
+        case TextureSlot::ConeMap:
+            mResources.coneMap = pTexture;
+            updateConeMapFlag();
+            break;
         case TextureSlot::Transmission:
             mResources.transmission = pTexture;
             updateTransmissionType();
@@ -382,6 +401,8 @@ namespace Falcor
             return mResources.normalMap;
         case TextureSlot::Displacement:
             return mResources.displacementMap;
+        case TextureSlot::ConeMap:
+            return mResources.coneMap;
         case TextureSlot::Transmission:
             return mResources.transmission;
         default:
@@ -511,6 +532,11 @@ namespace Falcor
             // Nothing to do here, displacement texture is prepared when calling prepareDisplacementMap().
             break;
         }
+        case TextureSlot::ConeMap:
+        {
+            // Nothing to do here, the cone map is baked when the scene is created.
+            break;
+        }
         default:
             throw std::logic_error("Material::optimizeTexture() - Unexpected texture slot: " + std::to_string((uint32_t)slot));
         }
@@ -550,6 +576,12 @@ namespace Falcor
         }
     }
 
+    bool Material::isConeMapBakeRequired() const
+    {
+        const auto& pConeMap = mResources.coneMap;
+        return pConeMap != nullptr && !mIsConeMapBaked;
+    }
+
     uint2 Material::getMaxTextureDimensions() const
     {
         uint2 dim = uint2(0);
@@ -602,6 +634,7 @@ namespace Falcor
             return true;
         case TextureSlot::Normal:
         case TextureSlot::Displacement:
+        case TextureSlot::ConeMap:
             return false;
         default:
             should_not_get_here();
@@ -627,6 +660,24 @@ namespace Falcor
         }
     }
 
+    void Material::setConeMapDepth(float depth)
+    {
+        if (mData.coneMapDepth != depth)
+        {
+            mData.coneMapDepth = depth;
+            markUpdates(UpdateFlags::DataChanged);
+        }
+    }
+
+    void Material::setConeMapSteps(uint32_t steps)
+    {
+        if (mData.coneMapSteps != steps)
+        {
+            mData.coneMapSteps = steps;
+            markUpdates(UpdateFlags::DataChanged);
+        }
+    }
+
     void Material::setBaseColor(const float4& color)
     {
         if (mData.baseColor != color)
@@ -777,6 +828,8 @@ namespace Falcor
         compare_field(type);
         compare_field(displacementScale);
         compare_field(displacementOffset);
+        compare_field(coneMapDepth);
+        compare_field(coneMapSteps);
 #undef compare_field
 
 #define compare_texture(_a) if (mResources._a != other.mResources._a) return false
@@ -786,10 +839,12 @@ namespace Falcor
         compare_texture(normalMap);
         compare_texture(transmission);
         compare_texture(displacementMap);
+        compare_texture(coneMap);
 #undef compare_texture
 
         if (mResources.samplerState != other.mResources.samplerState) return false;
         if (mTextureTransform.getMatrix() != other.mTextureTransform.getMatrix()) return false;
+        if (mIsConeMapBaked != other.mIsConeMapBaked) return false;
 
         return true;
     }
@@ -894,6 +949,12 @@ namespace Falcor
         setFlags(PACK_DISPLACEMENT_MAP(mData.flags, hasMap ? 1 : 0));
     }
 
+    void Material::updateConeMapFlag()
+    {
+        bool hasMap = (mResources.coneMap != nullptr);
+        setFlags(PACK_CONE_MAP(mData.flags, hasMap ? 1 : 0));
+    }
+
     SCRIPT_BINDING(Material)
     {
         SCRIPT_BINDING_DEPENDENCY(Transform)
@@ -910,6 +971,7 @@ namespace Falcor
         textureSlot.value("Normal", Material::TextureSlot::Normal);
         textureSlot.value("Transmission", Material::TextureSlot::Transmission);
         textureSlot.value("Displacement", Material::TextureSlot::Displacement);
+        textureSlot.value("ConeMap", Material::TextureSlot::ConeMap);
 
         pybind11::class_<Material, Material::SharedPtr> material(m, "Material");
         material.def_property("name", &Material::getName, &Material::setName);
@@ -935,6 +997,9 @@ namespace Falcor
         material.def_property("textureTransform", pybind11::overload_cast<void>(&Material::getTextureTransform, pybind11::const_), &Material::setTextureTransform);
         material.def_property("displacementScale", &Material::getDisplacementScale, &Material::setDisplacementScale);
         material.def_property("displacementOffset", &Material::getDisplacementOffset, &Material::setDisplacementOffset);
+        material.def_property("coneMapDepth", &Material::getConeMapDepth, &Material::setConeMapDepth);
+        material.def_property("coneMapSteps", &Material::getConeMapSteps, &Material::setConeMapSteps);
+        material.def_property("coneMapBaked", &Material::isConeMapBaked, &Material::setConeMapBaked);
 
         material.def(pybind11::init(&Material::create), "name"_a);
         material.def("loadTexture", &Material::loadTexture, "slot"_a, "filename"_a, "useSrgb"_a = true);
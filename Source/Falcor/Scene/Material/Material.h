@@ -97,6 +97,7 @@ namespace Falcor
             Normal,
             Transmission,
             Displacement,
+            ConeMap,
 
             Count // Must be last
         };
@@ -180,6 +181,11 @@ namespace Falcor
         */
         void prepareDisplacementMapForRendering();
 
+        /** Returns true if the cone map slot holds a height map that has to be baked into a cone map before rendering.
+            Cone maps marked with setConeMapBaked() are used as they are.
+        */
+        bool isConeMapBakeRequired() const;
+
         /** Return the maximum dimensions of the bound textures.
         */
         uint2 getMaxTextureDimensions() const;
@@ -261,6 +267,40 @@ namespace Falcor
         */
         float getDisplacementOffset() const { return mData.displacementOffset; }
 
+        /** Set the cone map used for cone step mapping
+        */
+        void setConeMap(Texture::SharedPtr pConeMap) { setTexture(TextureSlot::ConeMap, pConeMap); }
+
+        /** Get the cone map
+        */
+        Texture::SharedPtr getConeMap() const { return getTexture(TextureSlot::ConeMap); }
+
+        /** Mark the cone map as an already baked [height, cone ratio] map. Unmarked cone maps are height maps, which are baked when the scene is created.
+            The mark is not changed when the cone map texture is set.
+        */
+        void setConeMapBaked(bool baked) { mIsConeMapBaked = baked; }
+
+        /** Returns true if the cone map is marked as baked
+        */
+        bool isConeMapBaked() const { return mIsConeMapBaked; }
+
+        /** Set the depth of the cone map height field in texture space units.
+            The displacement scale and offset do not apply to cone maps.
+        */
+        void setConeMapDepth(float depth);
+
+        /** Get the depth of the cone map height field
+        */
+        float getConeMapDepth() const { return mData.coneMapDepth; }
+
+        /** Set the step limit of cone step mapping
+        */
+        void setConeMapSteps(uint32_t steps);
+
+        /** Get the step limit of cone step mapping
+        */
+        uint32_t getConeMapSteps() const { return mData.coneMapSteps; }
+
         /** Set the base color
         */
         void setBaseColor(const float4& color);
@@ -472,12 +512,14 @@ namespace Falcor
         void updateNormalMapMode();
         void updateDoubleSidedFlag();
         void updateDisplacementFlag();
+        void updateConeMapFlag();
 
         std::string mName;                          ///< Name of the material.
         MaterialData mData;                         ///< Material parameters.
         MaterialResources mResources;               ///< Material textures and samplers.
         Transform mTextureTransform;                ///< Texture transform. This is currently applied at load time.
         bool mDoubleSided = false;
+        bool mIsConeMapBaked = false;               ///< True if the cone map slot holds a baked cone map rather than a height map.
 
         // Additional data to optimize texture access.
         float2 mAlphaRange = float2(0.f, 1.f);      ///< Conservative range of opacity (alpha) values for the material.
@@ -501,6 +543,7 @@ namespace Falcor
             type_2_string(Normal);
             type_2_string(Transmission);
             type_2_string(Displacement);
+            type_2_string(ConeMap);
         default:
             should_not_get_here();
             return "";
@@ -28,6 +28,7 @@
 #include "stdafx.h"
 #include "Scene.h"
 #include "ScenePrimitiveDefines.slangh"
+#include "Material/ConeMapGenerator.h"
 #include <sstream>
 #include <numeric>
 
@@ -145,6 +146,24 @@ namespace Falcor
         // Prepare displacement maps for rendering.
         for (const auto& pMaterial : mMaterials) pMaterial->prepareDisplacementMapForRendering();
 
+        // Bake the cone maps of materials using cone step mapping.
+        // This is done here rather than in the scene builder as the scene cache stores the source height maps.
+        // Materials sharing a height map share its cone map.
+        ConeMapGenerator::SharedPtr pConeMapGenerator;
+        std::map<Texture::SharedPtr, Texture::SharedPtr> bakedConeMaps;
+        for (const auto& pMaterial : mMaterials)
+        {
+            if (!pMaterial->isConeMapBakeRequired()) continue;
+            auto& pConeMap = bakedConeMaps[pMaterial->getConeMap()];
+            if (!pConeMap)
+            {
+                if (!pConeMapGenerator) pConeMapGenerator = ConeMapGenerator::create();
+                pConeMap = pConeMapGenerator->generate(gpDevice->getRenderContext(), pMaterial->getConeMap());
+            }
+            pMaterial->setConeMap(pConeMap);
+            pMaterial->setConeMapBaked(true);
+        }
+
         // Setup additional resources.
         mFrontClockwiseRS[RasterizerState::CullMode::None] = RasterizerState::create(RasterizerState::Desc().setFrontCounterCW(false).setCullMode(RasterizerState::CullMode::None));
         mFrontClockwiseRS[RasterizerState::CullMode::Back] = RasterizerState::create(RasterizerState::Desc().setFrontCounterCW(false).setCullMode(RasterizerState::CullMode::Back));
@@ -156,12 +175,19 @@ namespace Falcor
         // Setup volume grid -> id map.
         for (size_t i = 0; i < mGrids.size(); ++i) mGridIDs.emplace(mGrids[i], (uint32_t)i);
 
+        // The mesh data is either in the scene data vectors or in external storage (memory mapped scene cache).
+        const auto& externalMeshData = sceneData.externalMeshData;
+        const bool useExternalMeshData = externalMeshData.pStorage != nullptr;
+        ArrayView<uint32_t> meshIndexData = useExternalMeshData ? externalMeshData.indexData : sceneData.meshIndexData;
+        ArrayView<PackedStaticVertexData> meshStaticData = useExternalMeshData ? externalMeshData.staticData : sceneData.meshStaticData;
+        ArrayView<DynamicVertexData> meshDynamicData = useExternalMeshData ? externalMeshData.dynamicData : sceneData.meshDynamicData;
+
         // Create vertex array objects for meshes and curves.
-        createMeshVao(sceneData.meshDrawCount, sceneData.meshIndexData, sceneData.meshStaticData, sceneData.meshDynamicData);
+        createMeshVao(sceneData.meshDrawCount, meshIndexData, meshStaticData, meshDynamicData);
         createCurveVao(mCurveIndexData, mCurveStaticData);
 
         // Create animation controller.
-        mpAnimationController = AnimationController::create(this, sceneData.meshStaticData, sceneData.meshDynamicData, sceneData.animations);
+        mpAnimationController = AnimationController::create(this, meshStaticData, meshDynamicData, sceneData.animations);
 
         // Must be placed after curve data/AABB creation.
         mpAnimationController->addAnimatedVertexCaches(sceneData.cachedCurves, sceneData.cachedMeshes);
@@ -270,7 +296,7 @@ namespace Falcor
         pContext->raytrace(pProgram, pVars.get(), dispatchDims.x, dispatchDims.y, dispatchDims.z);
     }
 
-    void Scene::createMeshVao(uint32_t drawCount, const std::vector<uint32_t>& indexData, const std::vector<PackedStaticVertexData>& staticData, const std::vector<DynamicVertexData>& dynamicData)
+    void Scene::createMeshVao(uint32_t drawCount, ArrayView<uint32_t> indexData, ArrayView<PackedStaticVertexData> staticData, ArrayView<DynamicVertexData> dynamicData)
     {
         // Create the index buffer.
         size_t ibSize = sizeof(uint32_t) * indexData.size();
@@ -480,6 +506,7 @@ namespace Falcor
         set_texture(normalMap);
         set_texture(transmission);
         set_texture(displacementMap);
+        set_texture(coneMap);
 #undef set_texture
 
         var["samplerState"] = resources.samplerState;
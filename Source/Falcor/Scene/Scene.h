@@ -36,6 +36,7 @@
 #include "Volume/Volume.h"
 #include "Volume/Grid.h"
 #include "Utils/Math/AABB.h"
+#include "Utils/ArrayView.h"
 #include "Animation/AnimationController.h"
 #include "Animation/AnimatedVertexCache.h"
 #include "Camera/CameraController.h"
@@ -811,6 +812,19 @@ namespace Falcor
             std::vector<PackedStaticVertexData> meshStaticData;     ///< Vertex attributes for all meshes in packed format.
             std::vector<DynamicVertexData> meshDynamicData;         ///< Additional vertex attributes for dynamic (skinned) meshes.
 
+            /** Mesh vertex and index data that is stored outside of the vectors above, e.g. in a memory mapped scene cache.
+                If pStorage is set, the scene is created from these views instead of meshIndexData/meshStaticData/meshDynamicData,
+                so the data is copied straight from the storage into the upload buffers.
+            */
+            struct ExternalMeshData
+            {
+                std::shared_ptr<const void> pStorage;               ///< Owner of the memory the views point to. Released after the scene is created.
+                ArrayView<uint32_t> indexData;
+                ArrayView<PackedStaticVertexData> staticData;
+                ArrayView<DynamicVertexData> dynamicData;
+            };
+            ExternalMeshData externalMeshData;
+
             // Curve data
             std::vector<CurveDesc> curveDesc;                       ///< List of curve descriptors.
             std::vector<AABB> curveBBs;                             ///< List of curve bounding boxes in object space. Each curve consists of many segments, each with its own AABB. The bounding boxes here are the unions of those.
@@ -836,7 +850,7 @@ namespace Falcor
 
         static SharedPtr create(SceneData&& sceneData);
 
-        void createMeshVao(uint32_t drawCount, const std::vector<uint32_t>& indexData, const std::vector<PackedStaticVertexData>& staticData, const std::vector<DynamicVertexData>& dynamicData);
+        void createMeshVao(uint32_t drawCount, ArrayView<uint32_t> indexData, ArrayView<PackedStaticVertexData> staticData, ArrayView<DynamicVertexData> dynamicData);
         void createCurveVao(const std::vector<uint32_t>& indexData, const std::vector<StaticCurveVertexData>& staticData);
 
         /** Create scene parameter block and retrieve pointers to buffers.
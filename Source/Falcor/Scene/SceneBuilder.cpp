@@ -32,6 +32,7 @@
 #include "Utils/Math/MathConstants.slangh"
 #include "Utils/Image/TextureAnalyzer.h"
 #include "Utils/Timing/TimeReport.h"
+#include "Utils/Threading.h"
 #include <mikktspace.h>
 #include <filesystem>
 #include <numeric>
@@ -58,12 +59,15 @@ namespace Falcor
         class MikkTSpaceWrapper
         {
         public:
-            static std::vector<float4> generateTangents(const SceneBuilder::Mesh& mesh)
+            /** Generates the tangents into 'tangents', its previous allocation is reused.
+                \return False if the tangents could not be generated.
+            */
+            static bool generateTangents(const SceneBuilder::Mesh& mesh, std::vector<float4>& tangents)
             {
                 if (!mesh.normals.pData || !mesh.positions.pData || !mesh.texCrds.pData || !mesh.pIndices)
                 {
                     logWarning("Can't generate tangent space. The mesh '" + mesh.name + "' doesn't have positions/normals/texCrd/indices.");
-                    return {};
+                    return false;
                 }
 
                 // Generate new tangent space.
@@ -75,7 +79,7 @@ namespace Falcor
                 mikktspace.m_getTexCoord = [](const SMikkTSpaceContext* pContext, float texCrd[], int32_t face, int32_t vert) { ((MikkTSpaceWrapper*)(pContext->m_pUserData))->getTexCrd(texCrd, face, vert); };
                 mikktspace.m_setTSpaceBasic = [](const SMikkTSpaceContext* pContext, const float tangent[], float sign, int32_t face, int32_t vert) { ((MikkTSpaceWrapper*)(pContext->m_pUserData))->setTangent(tangent, sign, face, vert); };
 
-                MikkTSpaceWrapper wrapper(mesh);
+                MikkTSpaceWrapper wrapper(mesh, tangents);
                 SMikkTSpaceContext context = {};
                 context.m_pInterface = &mikktspace;
                 context.m_pUserData = &wrapper;
@@ -83,21 +87,22 @@ namespace Falcor
                 if (genTangSpaceDefault(&context) == false)
                 {
                     logError("Failed to generate MikkTSpace tangents for the mesh '" + mesh.name + "'.");
-                    return {};
+                    return false;
                 }
 
-                return wrapper.mTangents;
+                return true;
             }
 
         private:
-            MikkTSpaceWrapper(const SceneBuilder::Mesh& mesh)
+            MikkTSpaceWrapper(const SceneBuilder::Mesh& mesh, std::vector<float4>& tangents)
                 : mMesh(mesh)
+                , mTangents(tangents)
             {
                 assert(mesh.indexCount > 0);
-                mTangents.resize(mesh.indexCount, float4(0));
+                mTangents.assign(mesh.indexCount, float4(0));
             }
             const SceneBuilder::Mesh& mMesh;
-            std::vector<float4> mTangents;
+            std::vector<float4>& mTangents;
             int32_t getFaceCount() const { return (int32_t)mMesh.faceCount; }
             void getPosition(float position[], int32_t face, int32_t vert) { *reinterpret_cast<float3*>(position) = mMesh.getPosition(face, vert); }
             void getNormal(float normal[], int32_t face, int32_t vert) { *reinterpret_cast<float3*>(normal) = mMesh.getNormal(face, vert); }
@@ -125,6 +130,35 @@ namespace Falcor
             if (isZero(v.normal) || isZero(v.tangent.xyz())) zeroCount++;
         }
 
+        // Temporary buffers of SceneBuilder::processMesh(). They are kept per thread, so the meshes processed
+        // by a thread reuse the allocations instead of growing new vectors for every mesh.
+        // Buffers grown beyond kMaxRetainedScratchBytes by a large mesh are released after use.
+        const size_t kMaxRetainedScratchBytes = 64ull << 20;
+
+        struct MeshScratch
+        {
+            std::vector<float4> tangents;
+            std::vector<float2> texCrds;
+            std::vector<std::pair<SceneBuilder::Mesh::Vertex, uint32_t>> vertices;
+            std::vector<uint32_t> indices;
+            std::vector<uint32_t> heads;
+
+            void trim()
+            {
+                auto trimVector = [](auto& v)
+                {
+                    if (v.capacity() * sizeof(v[0]) > kMaxRetainedScratchBytes) std::remove_reference_t<decltype(v)>().swap(v);
+                };
+                trimVector(tangents);
+                trimVector(texCrds);
+                trimVector(vertices);
+                trimVector(indices);
+                trimVector(heads);
+            }
+        };
+
+        thread_local MeshScratch tMeshScratch;
+
         bool compareVertices(const SceneBuilder::Mesh::Vertex& lhs, const SceneBuilder::Mesh::Vertex& rhs, float threshold = 1e-6f)
         {
             using namespace glm;
@@ -154,7 +188,7 @@ namespace Falcor
 
         SceneCache::Key computeSceneCacheKey(const std::string& scenePath, SceneBuilder::Flags buildFlags)
         {
-            SceneBuilder::Flags cacheFlags = buildFlags & (~(SceneBuilder::Flags::UseCache | SceneBuilder::Flags::RebuildCache));
+            SceneBuilder::Flags cacheFlags = buildFlags & (~(SceneBuilder::Flags::UseCache | SceneBuilder::Flags::RebuildCache | SceneBuilder::Flags::UseMappedCache));
             SHA1 sha1;
             sha1.update(scenePath.data(), scenePath.size());
             sha1.update(&cacheFlags, sizeof(cacheFlags));
@@ -197,11 +231,14 @@ namespace Falcor
         pBuilder->mWriteSceneCache = sceneCacheSupported && (useCache || rebuildCache);
 
         // Try to load scene cache if supported, available and requested.
-        if (sceneCacheSupported && useCache && !rebuildCache && SceneCache::hasValidCache(pBuilder->mSceneCacheKey))
+        bool useMappedCache = is_set(buildFlags, Flags::UseMappedCache);
+        auto hasValidCache = [&]() { return useMappedCache ? SceneCache::hasValidMappedCache(pBuilder->mSceneCacheKey) : SceneCache::hasValidCache(pBuilder->mSceneCacheKey); };
+        if (sceneCacheSupported && useCache && !rebuildCache && hasValidCache())
         {
             try
             {
-                pBuilder->mpScene = Scene::create(SceneCache::readCache(pBuilder->mSceneCacheKey));
+                auto sceneData = useMappedCache ? SceneCache::readMappedCache(pBuilder->mSceneCacheKey) : SceneCache::readCache(pBuilder->mSceneCacheKey);
+                pBuilder->mpScene = Scene::create(std::move(sceneData));
                 return pBuilder;
             }
             catch (const std::exception& e)
@@ -213,6 +250,15 @@ namespace Falcor
         return pBuilder->import(filename, instances) ? pBuilder : nullptr;
     }
 
+    bool SceneBuilder::hasValidSceneCache(const std::string& filename, Flags buildFlags)
+    {
+        std::string fullPath;
+        if (!findFileInDataDirectories(filename, fullPath)) return false;
+
+        SceneCache::Key key = computeSceneCacheKey(fullPath, buildFlags);
+        return is_set(buildFlags, Flags::UseMappedCache) ? SceneCache::hasValidMappedCache(key) : SceneCache::hasValidCache(key);
+    }
+
     bool SceneBuilder::import(const std::string& filename, const InstanceMatrices& instances, const Dictionary& dict)
     {
         bool success = Importer::import(filename, *this, instances, dict);
@@ -245,31 +291,65 @@ namespace Falcor
         // Post-process the scene data.
         TimeReport timeReport;
 
-        // Prepare displacement maps. This either removes them (if requested in build flags)
+        // Prepare displacement maps. This either removes them (if requested in build flags),
+        // moves them to the cone map slot for cone step mapping (if requested in build flags)
         // or makes sure that normal maps are removed if displacement is in use.
         prepareDisplacementMaps();
 
         prepareSceneGraph();
         removeUnusedMeshes();
         flattenStaticMeshInstances();
+        timeReport.measure("Preparing scene graph");
+
         pretransformStaticMeshes();
-        unifyTriangleWinding();
+        timeReport.measure("Pre-transforming meshes");
+
+        // Unifying the triangle winding only touches the index data and the winding flag of the meshes,
+        // it runs concurrently with the stages up to the mesh groups. Splitting the meshes copies both.
+        // Without a thread pool (scenes built outside of a sample) it runs inline.
+        double windingTime = 0.0;
+        auto windingFunc = [this, &windingTime]()
+        {
+            auto startTime = CpuTimer::getCurrentTimePoint();
+            unifyTriangleWinding();
+            windingTime = CpuTimer::calcDuration(startTime, CpuTimer::getCurrentTimePoint()) * 1.0e-3;
+        };
+        Threading::Task windingTask;
+        if (Threading::getThreadCount() > 0) windingTask = Threading::dispatchTask(windingFunc);
+        else windingFunc();
+
         optimizeSceneGraph();
+        timeReport.measure("Optimizing scene graph");
+
         calculateMeshBoundingBoxes();
+        timeReport.measure("Mesh bounding boxes");
+
         createMeshGroups();
+        timeReport.measure("Creating mesh groups");
+
+        windingTask.finish();
+        timeReport.measure("Unifying winding (wait)");
+        timeReport.addMeasurement("Unifying winding (task)", windingTime);
+
         optimizeGeometry();
+        timeReport.measure("Optimizing geometry");
+
         sortMeshes();
         createGlobalBuffers();
+        timeReport.measure("Creating global buffers");
+
         createCurveGlobalBuffers();
         collectVolumeGrids();
-
-        timeReport.measure("Post processing geometry");
+        timeReport.measure("Curves and volumes");
 
         optimizeMaterials();
+        timeReport.measure("Optimizing materials");
+
         removeDuplicateMaterials();
-        quantizeTexCoords();
+        timeReport.measure("Removing dup. materials");
 
-        timeReport.measure("Optimizing materials");
+        quantizeTexCoords();
+        timeReport.measure("Quantizing texcoords");
 
         // Prepare scene resources.
         createSceneGraph();
@@ -286,7 +366,8 @@ namespace Falcor
         // Write scene cache if requested.
         if (mWriteSceneCache)
         {
-            SceneCache::writeCache(mSceneData, mSceneCacheKey);
+            if (is_set(mFlags, Flags::UseMappedCache)) SceneCache::writeMappedCache(mSceneData, mSceneCacheKey);
+            else SceneCache::writeCache(mSceneData, mSceneCacheKey);
             timeReport.measure("Writing cache");
         }
 
@@ -386,15 +467,16 @@ namespace Falcor
             if (mesh.boneWeights.pData == nullptr) throw_on_missing_element("bone weights");
         }
 
+        MeshScratch& scratch = tMeshScratch;
+
         // Generate tangent space if that's required.
-        std::vector<float4> tangents;
         if (!(is_set(mFlags, Flags::UseOriginalTangentSpace) || mesh.useOriginalTangentSpace) || !mesh.tangents.pData)
         {
-            generateTangents(mesh, tangents);
+            generateTangents(mesh, scratch.tangents);
         }
 
         // Pretransform the texture coordinates, rather than transforming them at runtime.
-        std::vector<float2> transformedTexCoords;
+        std::vector<float2>& transformedTexCoords = scratch.texCrds;
         if (mesh.texCrds.pData != nullptr)
         {
             const glm::mat4 xform = mesh.pMaterial->getTextureTransform().getMatrix();
@@ -429,10 +511,13 @@ namespace Falcor
         // This ensures that adding to the linked lists do not require any dynamic memory allocation.
         //
         const uint32_t invalidIndex = 0xffffffff;
-        std::vector<std::pair<Mesh::Vertex, uint32_t>> vertices;
+        auto& vertices = scratch.vertices;
+        vertices.clear();
         vertices.reserve(mesh.vertexCount);
-        std::vector<uint32_t> indices(mesh.indexCount);
-        std::vector<uint32_t> heads(mesh.vertexCount, invalidIndex);
+        auto& indices = scratch.indices;
+        indices.resize(mesh.indexCount);
+        auto& heads = scratch.heads;
+        heads.assign(mesh.vertexCount, invalidIndex);
 
         if (pAttributeIndices)
         {
@@ -509,7 +594,7 @@ namespace Falcor
             processedMesh.indexCount = indices.size();
             processedMesh.use16BitIndices = (vertices.size() <= (1u << 16)) && !(is_set(mFlags, Flags::Force32BitIndices));
 
-            if (!processedMesh.use16BitIndices) processedMesh.indexData = std::move(indices);
+            if (!processedMesh.use16BitIndices) processedMesh.indexData.assign(indices.begin(), indices.end());
             else processedMesh.indexData = compact16BitIndices(indices);
         }
 
@@ -542,13 +627,13 @@ namespace Falcor
             }
         }
 
+        scratch.trim();
         return processedMesh;
     }
 
     void SceneBuilder::generateTangents(Mesh& mesh, std::vector<float4>& tangents) const
     {
-        tangents = MikkTSpaceWrapper::generateTangents(mesh);
-        if (!tangents.empty())
+        if (MikkTSpaceWrapper::generateTangents(mesh, tangents))
         {
             assert(tangents.size() == mesh.indexCount);
             mesh.tangents.pData = tangents.data();
@@ -562,6 +647,11 @@ namespace Falcor
     }
 
     uint32_t SceneBuilder::addProcessedMesh(const ProcessedMesh& mesh)
+    {
+        return addProcessedMesh(ProcessedMesh(mesh));
+    }
+
+    uint32_t SceneBuilder::addProcessedMesh(ProcessedMesh&& mesh)
     {
         const bool isIndexed = !is_set(mFlags, Flags::NonIndexedVertices);
 
@@ -593,7 +683,7 @@ namespace Falcor
             spec.hasDynamicData = true;
         }
 
-        mMeshes.push_back(spec);
+        mMeshes.push_back(std::move(spec));
 
         if (mMeshes.size() > std::numeric_limits<uint32_t>::max())
         {
@@ -1082,14 +1172,31 @@ namespace Falcor
 
     void SceneBuilder::prepareDisplacementMaps()
     {
+        size_t ignoredScaleCount = 0;
         for (const auto& pMaterial : mSceneData.materials)
         {
             // Remove displacement maps if requested by scene flags.
             if (is_set(mFlags, Flags::DontUseDisplacement)) pMaterial->clearTexture(Material::TextureSlot::Displacement);
 
+            // Use the displacement maps as height maps for cone step mapping if requested by scene flags.
+            // The shading normal is kept as it is, the cone map is baked when the scene is created.
+            // The displacement scale and offset are object space distances, the cone map depth is in texture space
+            // and the height field always starts at the surface, so they are ignored and coneMapDepth is used instead.
+            if (is_set(mFlags, Flags::UseConeStepMapping) && pMaterial->getDisplacementMap() != nullptr)
+            {
+                if (pMaterial->getDisplacementScale() != 0.f || pMaterial->getDisplacementOffset() != 0.f) ignoredScaleCount++;
+                pMaterial->setConeMap(pMaterial->getDisplacementMap());
+                pMaterial->clearTexture(Material::TextureSlot::Displacement);
+            }
+
             // Remove normal maps for materials using displacement.
             if (pMaterial->getDisplacementMap() != nullptr) pMaterial->clearTexture(Material::TextureSlot::Normal);
         }
+
+        if (ignoredScaleCount > 0)
+        {
+            logWarning("The displacement scale and offset of " + std::to_string(ignoredScaleCount) + " materials are ignored by cone step mapping. Use 'coneMapDepth' to set the depth of the height field.");
+        }
     }
 
     void SceneBuilder::prepareSceneGraph()
@@ -1371,7 +1478,8 @@ namespace Falcor
         uint32_t identityNodeID = addNode(Node{ "Identity", glm::identity<glm::mat4>(), glm::identity<glm::mat4>() });
         auto& identityNode = mSceneGraph[identityNodeID];
 
-        size_t transformedMeshCount = 0;
+        // The scene graph is relinked serially, the vertices are transformed in parallel afterwards.
+        std::vector<std::pair<uint32_t, glm::mat4>> transformedMeshes;
         for (uint32_t meshID = 0; meshID < (uint32_t)mMeshes.size(); meshID++)
         {
             auto& mesh = mMeshes[meshID];
@@ -1405,21 +1513,7 @@ namespace Falcor
             {
                 assert(!mesh.staticData.empty());
                 assert((size_t)mesh.vertexCount == mesh.staticData.size());
-
-                glm::mat3 invTranspose3x3 = (glm::mat3)glm::transpose(glm::inverse(transform));
-                glm::mat3 transform3x3 = (glm::mat3)transform;
-
-                for (auto& v : mesh.staticData)
-                {
-                    float4 p = transform * float4(v.position, 1.f);
-                    v.position = p.xyz;
-                    v.normal = glm::normalize(invTranspose3x3 * v.normal);
-                    v.tangent.xyz = glm::normalize(transform3x3 * v.tangent.xyz);
-                    // TODO: We should flip the sign of v.tangent.w if flippedWinding is true.
-                    // Leaving that out for now for consistency with the shader code that needs the same fix.
-                }
-
-                transformedMeshCount++;
+                transformedMeshes.push_back({ meshID, transform });
             }
 
             // Unlink mesh from its previous transform node.
@@ -1435,7 +1529,27 @@ namespace Falcor
             mesh.instances[0] = identityNodeID;
         }
 
-        if (transformedMeshCount > 0) logInfo("Pre-transformed " + std::to_string(transformedMeshCount) + " static meshes to world space");
+        Threading::parallelFor(0, transformedMeshes.size(), [&](size_t rangeBegin, size_t rangeEnd)
+        {
+            for (size_t i = rangeBegin; i < rangeEnd; i++)
+            {
+                const auto& [meshID, transform] = transformedMeshes[i];
+                glm::mat3 invTranspose3x3 = (glm::mat3)glm::transpose(glm::inverse(transform));
+                glm::mat3 transform3x3 = (glm::mat3)transform;
+
+                for (auto& v : mMeshes[meshID].staticData)
+                {
+                    float4 p = transform * float4(v.position, 1.f);
+                    v.position = p.xyz;
+                    v.normal = glm::normalize(invTranspose3x3 * v.normal);
+                    v.tangent.xyz = glm::normalize(transform3x3 * v.tangent.xyz);
+                    // TODO: We should flip the sign of v.tangent.w if flippedWinding is true.
+                    // Leaving that out for now for consistency with the shader code that needs the same fix.
+                }
+            }
+        }, 1);
+
+        if (!transformedMeshes.empty()) logInfo("Pre-transformed " + std::to_string(transformedMeshes.size()) + " static meshes to world space");
     }
 
     void SceneBuilder::flipTriangleWinding(MeshSpec& mesh)
@@ -1482,38 +1596,45 @@ namespace Falcor
         // Note that this pass needs to run *after* pre-transformation of static meshes to world space,
         // as those transforms may flip the winding.
 
-        size_t flippedMeshCount = 0;
-        for (uint32_t meshID = 0; meshID < (uint32_t)mMeshes.size(); meshID++)
+        std::atomic<size_t> flippedMeshCount = 0;
+        Threading::parallelFor(0, mMeshes.size(), [&](size_t rangeBegin, size_t rangeEnd)
         {
-            auto& mesh = mMeshes[meshID];
+            for (size_t meshID = rangeBegin; meshID < rangeEnd; meshID++)
+            {
+                auto& mesh = mMeshes[meshID];
 
-            // Skip meshes that are already front face counter-clockwise.
-            if (mesh.isFrontFaceCW == false) continue;
+                // Skip meshes that are already front face counter-clockwise.
+                if (mesh.isFrontFaceCW == false) continue;
 
-            flipTriangleWinding(mesh);
-            assert(!mesh.isFrontFaceCW);
+                flipTriangleWinding(mesh);
+                assert(!mesh.isFrontFaceCW);
 
-            flippedMeshCount++;
-        }
+                flippedMeshCount++;
+            }
+        });
 
-        if (flippedMeshCount > 0) logInfo("Flipped triangle winding for " + std::to_string(flippedMeshCount) + " out of " + std::to_string(mMeshes.size()) + " meshes");
+        if (flippedMeshCount > 0) logInfo("Flipped triangle winding for " + std::to_string(flippedMeshCount.load()) + " out of " + std::to_string(mMeshes.size()) + " meshes");
     }
 
     void SceneBuilder::calculateMeshBoundingBoxes()
     {
-        for (auto& mesh : mMeshes)
+        Threading::parallelFor(0, mMeshes.size(), [&](size_t rangeBegin, size_t rangeEnd)
         {
-            assert(!mesh.staticData.empty());
-            assert((size_t)mesh.vertexCount == mesh.staticData.size());
-
-            AABB meshBB;
-            for (auto& v : mesh.staticData)
+            for (size_t meshID = rangeBegin; meshID < rangeEnd; meshID++)
             {
-                meshBB.include(v.position);
-            }
+                auto& mesh = mMeshes[meshID];
+                assert(!mesh.staticData.empty());
+                assert((size_t)mesh.vertexCount == mesh.staticData.size());
 
-            mesh.boundingBox = meshBB;
-        }
+                AABB meshBB;
+                for (auto& v : mesh.staticData)
+                {
+                    meshBB.include(v.position);
+                }
+
+                mesh.boundingBox = meshBB;
+            }
+        });
     }
 
     void SceneBuilder::createMeshGroups()
@@ -2065,14 +2186,18 @@ namespace Falcor
 
         const bool isIndexed = !is_set(mFlags, Flags::NonIndexedVertices);
 
-        // Count total number of vertex and index data elements.
+        // Count total number of vertex and index data elements and assign the offsets of the meshes.
         size_t totalIndexDataCount = 0;
         size_t totalStaticVertexCount = 0;
         size_t totalDynamicVertexCount = 0;
 
-        for (const auto& mesh : mMeshes)
+        for (auto& mesh : mMeshes)
         {
-            totalIndexDataCount += mesh.indexData.size();
+            mesh.staticVertexOffset = (uint32_t)totalStaticVertexCount;
+            mesh.dynamicVertexOffset = (uint32_t)totalDynamicVertexCount;
+            if (isIndexed) mesh.indexOffset = (uint32_t)totalIndexDataCount;
+
+            if (isIndexed) totalIndexDataCount += mesh.indexData.size();
             totalStaticVertexCount += mesh.staticData.size();
             totalDynamicVertexCount += mesh.dynamicData.size();
         }
@@ -2085,43 +2210,44 @@ namespace Falcor
             throw std::exception("Trying to build a scene that exceeds supported mesh data size.");
         }
 
-        mSceneData.meshIndexData.reserve(totalIndexDataCount);
-        mSceneData.meshStaticData.reserve(totalStaticVertexCount);
-        mSceneData.meshDynamicData.reserve(totalDynamicVertexCount);
+        mSceneData.meshIndexData.resize(totalIndexDataCount);
+        mSceneData.meshStaticData.resize(totalStaticVertexCount);
+        mSceneData.meshDynamicData.resize(totalDynamicVertexCount);
 
-        // Copy all vertex and index data into the global buffers.
-        for (auto& mesh : mMeshes)
+        // Copy all vertex and index data into the global buffers, the meshes write disjoint ranges.
+        Threading::parallelFor(0, mMeshes.size(), [&](size_t rangeBegin, size_t rangeEnd)
         {
-            mesh.staticVertexOffset = (uint32_t)mSceneData.meshStaticData.size();
-            mesh.dynamicVertexOffset = (uint32_t)mSceneData.meshDynamicData.size();
-
-            // Insert the static vertex data in the global array.
-            // The vertices are automatically converted to their packed format in this step.
-            mSceneData.meshStaticData.insert(mSceneData.meshStaticData.end(), mesh.staticData.begin(), mesh.staticData.end());
-
-            if (isIndexed)
+            for (size_t meshID = rangeBegin; meshID < rangeEnd; meshID++)
             {
-                mesh.indexOffset = (uint32_t)mSceneData.meshIndexData.size();
-                mSceneData.meshIndexData.insert(mSceneData.meshIndexData.end(), mesh.indexData.begin(), mesh.indexData.end());
-            }
+                auto& mesh = mMeshes[meshID];
 
-            if (mesh.isDynamic())
-            {
-                assert(!mesh.dynamicData.empty());
-                mSceneData.meshDynamicData.insert(mSceneData.meshDynamicData.end(), mesh.dynamicData.begin(), mesh.dynamicData.end());
+                // Copy the static vertex data to the global array.
+                // The vertices are automatically converted to their packed format in this step.
+                std::copy(mesh.staticData.begin(), mesh.staticData.end(), mSceneData.meshStaticData.begin() + mesh.staticVertexOffset);
 
-                // Patch vertex index references.
-                for (uint32_t i = 0; i < mesh.dynamicData.size(); ++i)
+                if (isIndexed)
                 {
-                    mSceneData.meshDynamicData[mesh.dynamicVertexOffset + i].staticIndex += mesh.staticVertexOffset;
+                    std::copy(mesh.indexData.begin(), mesh.indexData.end(), mSceneData.meshIndexData.begin() + mesh.indexOffset);
                 }
-            }
 
-            // Free the mesh local data.
-            mesh.indexData.clear();
-            mesh.staticData.clear();
-            mesh.dynamicData.clear();
-        }
+                if (mesh.isDynamic())
+                {
+                    assert(!mesh.dynamicData.empty());
+                    std::copy(mesh.dynamicData.begin(), mesh.dynamicData.end(), mSceneData.meshDynamicData.begin() + mesh.dynamicVertexOffset);
+
+                    // Patch vertex index references.
+                    for (uint32_t i = 0; i < mesh.dynamicData.size(); ++i)
+                    {
+                        mSceneData.meshDynamicData[mesh.dynamicVertexOffset + i].staticIndex += mesh.staticVertexOffset;
+                    }
+                }
+
+                // Free the mesh local data.
+                mesh.indexData.clear();
+                mesh.staticData.clear();
+                mesh.dynamicData.clear();
+            }
+        });
     }
 
     void SceneBuilder::createCurveGlobalBuffers()
@@ -2244,23 +2370,35 @@ namespace Falcor
 
         if (is_set(mFlags, Flags::DontMergeMaterials)) return;
 
+        const auto& materials = mSceneData.materials;
         std::vector<Material::SharedPtr> uniqueMaterials;
-        std::vector<uint32_t> idMap(mSceneData.materials.size());
+        std::vector<uint32_t> idMap(materials.size());
+
+        // Find the first identical material of every material in parallel.
+        // That material is unique itself, as nothing before it is identical to it.
+        std::vector<uint32_t> firstEqual(materials.size());
+        Threading::parallelFor(0, materials.size(), [&](size_t rangeBegin, size_t rangeEnd)
+        {
+            for (size_t id = rangeBegin; id < rangeEnd; ++id)
+            {
+                auto it = std::find_if(materials.begin(), materials.begin() + id, [&](const auto& m) { return *m == *materials[id]; });
+                firstEqual[id] = (uint32_t)std::distance(materials.begin(), it);
+            }
+        });
 
-        // Find unique set of materials.
-        for (uint32_t id = 0; id < mSceneData.materials.size(); ++id)
+        // Build the unique set of materials.
+        for (uint32_t id = 0; id < materials.size(); ++id)
         {
-            const auto& pMaterial = mSceneData.materials[id];
-            auto it = std::find_if(uniqueMaterials.begin(), uniqueMaterials.end(), [&pMaterial](const auto& m) { return *m == *pMaterial; });
-            if (it == uniqueMaterials.end())
+            const auto& pMaterial = materials[id];
+            if (firstEqual[id] == id)
             {
                 idMap[id] = (uint32_t)uniqueMaterials.size();
                 uniqueMaterials.push_back(pMaterial);
             }
             else
             {
-                logInfo("Removing duplicate material '" + pMaterial->getName() + "' (duplicate of '" + (*it)->getName() + "')");
-                idMap[id] = (uint32_t)std::distance(uniqueMaterials.begin(), it);
+                logInfo("Removing duplicate material '" + pMaterial->getName() + "' (duplicate of '" + materials[firstEqual[id]]->getName() + "')");
+                idMap[id] = idMap[firstEqual[id]];
             }
         }
 
@@ -2290,11 +2428,16 @@ namespace Falcor
         // Match texture coordinate quantization for textured emissives to format of PackedEmissiveTriangle.
         // This is to avoid mismatch when sampling and evaluating emissive triangles.
         // Note that non-emissive meshes are unmodified and use full precision texcoords.
-        for (auto& mesh : mMeshes)
+        // The meshes are quantized in parallel, the warnings are logged in mesh order afterwards.
+        std::vector<std::string> warnings(mMeshes.size());
+        Threading::parallelFor(0, mMeshes.size(), [&](size_t rangeBegin, size_t rangeEnd)
         {
-            const auto& pMaterial = mSceneData.materials[mesh.materialId];
-            if (pMaterial->getEmissiveTexture() != nullptr)
+            for (size_t meshID = rangeBegin; meshID < rangeEnd; meshID++)
             {
+                const auto& mesh = mMeshes[meshID];
+                const auto& pMaterial = mSceneData.materials[mesh.materialId];
+                if (pMaterial->getEmissiveTexture() == nullptr) continue;
+
                 // Quantize texture coordinates to fp16. Also track the bounds and max error.
                 float2 minTexCrd = float2(std::numeric_limits<float>::infinity());
                 float2 maxTexCrd = float2(-std::numeric_limits<float>::infinity());
@@ -2314,7 +2457,7 @@ namespace Falcor
                 float2 maxAbsCrd = max(abs(minTexCrd), abs(maxTexCrd));
                 if (maxAbsCrd.x > HLF_MAX || maxAbsCrd.y > HLF_MAX)
                 {
-                    logWarning("Texture coordinates for emissive textured mesh '" + mesh.name + "' are outside the representable range, expect rendering errors.");
+                    warnings[meshID] = "Texture coordinates for emissive textured mesh '" + mesh.name + "' are outside the representable range, expect rendering errors.";
                 }
                 else
                 {
@@ -2330,10 +2473,15 @@ namespace Falcor
                         oss << "Texture coordinates for emissive textured mesh '" << mesh.name << "' have a large quantization error of " << maxTexelError << " texels. "
                             << "The coordinate range is [" << minTexCrd.x << ", " << maxTexCrd.x << "] x [" << minTexCrd.y << ", " << maxTexCrd.y << "] for maximum texture dimensions ("
                             << maxTexDim.x << ", " << maxTexDim.y << ").";
-                        logWarning(oss.str());
+                        warnings[meshID] = oss.str();
                     }
                 }
             }
+        });
+
+        for (const auto& warning : warnings)
+        {
+            if (!warning.empty()) logWarning(warning);
         }
     }
 
@@ -2608,8 +2756,10 @@ namespace Falcor
         flags.value("DontOptimizeGraph", SceneBuilder::Flags::DontOptimizeGraph);
         flags.value("DontOptimizeMaterials", SceneBuilder::Flags::DontOptimizeMaterials);
         flags.value("DontUseDisplacement", SceneBuilder::Flags::DontUseDisplacement);
+        flags.value("UseConeStepMapping", SceneBuilder::Flags::UseConeStepMapping);
         flags.value("UseCache", SceneBuilder::Flags::UseCache);
         flags.value("RebuildCache", SceneBuilder::Flags::RebuildCache);
+        flags.value("UseMappedCache", SceneBuilder::Flags::UseMappedCache);
         ScriptBindings::addEnumBinaryOperators(flags);
 
         pybind11::class_<SceneBuilder, SceneBuilder::SharedPtr> sceneBuilder(m, "SceneBuilder");
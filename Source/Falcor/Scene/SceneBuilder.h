@@ -62,9 +62,11 @@ namespace Falcor
             DontOptimizeGraph           = 0x1000, ///< Don't optimize the scene graph to remove unnecessary nodes.
             DontOptimizeMaterials       = 0x2000, ///< Don't optimize materials by removing constant textures. The optimizations are lossless so should generally be enabled.
             DontUseDisplacement         = 0x4000, ///< Don't use displacement mapping.
+            UseConeStepMapping          = 0x8000, ///< Use cone step mapping instead of displacement mapping. Displacement maps are moved to the cone map slot and baked into cone maps when the scene is created. Their displacement scale and offset are ignored, the depth is set by the material's cone map depth.
 
             UseCache                    = 0x10000000, ///< Enable scene caching. This caches the runtime scene representation on disk to reduce load time.
             RebuildCache                = 0x20000000, ///< Rebuild scene cache.
+            UseMappedCache              = 0x40000000, ///< Use the memory mapped scene cache format, which references the mesh data in place instead of deserializing it. Only has an effect together with UseCache or RebuildCache.
 
             Default = None
         };
@@ -316,6 +318,13 @@ namespace Falcor
         */
         static SharedPtr create(const std::string& filename, Flags buildFlags = Flags::Default, const InstanceMatrices& instances = InstanceMatrices());
 
+        /** Check if a scene file has a valid scene cache
+            \param filename The scene filename
+            \param buildFlags The build flags. UseMappedCache selects the memory mapped cache format, the other scene cache flags are ignored.
+            \return True if create() would load the scene from the cache with UseCache set
+        */
+        static bool hasValidSceneCache(const std::string& filename, Flags buildFlags = Flags::Default);
+
         /** Import a scene/model file
             \param filename The filename to load
             \param instances A list of instance matrices to load. This is optional, by default a single instance will be load
@@ -392,6 +401,12 @@ namespace Falcor
         */
         uint32_t addProcessedMesh(const ProcessedMesh& mesh);
 
+        /** Add a pre-processed mesh, its vertex and index data are moved into the scene builder.
+            \param mesh The pre-processed mesh.
+            \return The ID of the mesh in the scene. Note that all of the instances share the same mesh ID.
+        */
+        uint32_t addProcessedMesh(ProcessedMesh&& mesh);
+
         /** Set mesh vertex cache for animation.
             \param[in] cachedCurves The mesh vertex cache data.
         */
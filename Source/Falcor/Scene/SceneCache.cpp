@@ -28,8 +28,12 @@
 #include "stdafx.h"
 #include "SceneCache.h"
 #include "Material/MaterialTextureLoader.h"
+#include "Core/Platform/MemoryMappedFile.h"
+#include "Utils/Threading.h"
+#include "Utils/Timing/TimeReport.h"
 
 #include <lz4_stream/lz4_stream.h>
+#include <lz4.h>
 
 namespace Falcor
 {
@@ -38,7 +42,7 @@ namespace Falcor
         /** Specfies the current cache file version.
             This needs to be incremented every time the file format changes!
         */
-        const uint32_t kVersion = 14;
+        const uint32_t kVersion = 16;
 
         /** Scene cache directory (subdirectory in the application data directory).
         */
@@ -57,6 +61,139 @@ namespace Falcor
                 return std::memcmp(magic, kMagic, sizeof(Header::magic)) == 0 && version == kVersion;
             }
         };
+
+        // Memory mapped cache format.
+        // The header is followed by the table of contents, the chunks start at page aligned offsets so that the raw
+        // chunks can be used in place. Compressed chunks begin with the compressed sizes of their blocks (uint32_t),
+        // followed by the blocks. Every block but the last one decompresses to kCompressionBlockSize bytes.
+
+        const char* kMappedMagic = "FalcorM$";
+        const std::string kMappedExtension = ".mapped";
+
+        const size_t kPageSize = 4096;
+        const size_t kCompressionBlockSize = 4 * 1024 * 1024;
+
+        /** The mesh data chunks are only compressed if that at least halves them, otherwise they are used in place.
+            The other chunks are deserialized anyway, they are compressed whenever that saves space.
+        */
+        const double kMaxMeshDataCompressionRatio = 0.5;
+
+        enum class ChunkID : uint32_t
+        {
+            SceneData,
+            Materials,
+            Animations,
+            MeshIndexData,
+            MeshStaticData,
+            MeshDynamicData,
+
+            Count
+        };
+
+        struct MappedHeader
+        {
+            uint8_t magic[8]{};
+            uint32_t version{};
+            uint32_t chunkCount{};
+
+            bool isValid() const
+            {
+                return std::memcmp(magic, kMappedMagic, sizeof(MappedHeader::magic)) == 0 && version == kVersion;
+            }
+        };
+
+        struct ChunkEntry
+        {
+            uint32_t id = 0;
+            uint32_t blockCount = 0;    ///< Number of compressed blocks, 0 if the chunk is stored raw.
+            uint64_t offset = 0;        ///< Offset from the start of the file, a multiple of kPageSize (0 for empty chunks).
+            uint64_t size = 0;          ///< Size of the chunk in the file.
+            uint64_t dataSize = 0;      ///< Size of the uncompressed data.
+        };
+
+        /** Chunk to write.
+        */
+        struct WriteChunk
+        {
+            ChunkID id;
+            const uint8_t* pData = nullptr;
+            size_t size = 0;
+            double maxCompressionRatio = 1.0;
+            std::vector<uint8_t> compressed;    ///< Block sizes and blocks, empty if the chunk is stored raw.
+            uint32_t blockCount = 0;
+        };
+
+        /** Memory of a loaded memory mapped cache, referenced by the views of the scene data.
+        */
+        struct MappedCacheStorage
+        {
+            MemoryMappedFile file;
+            std::vector<std::unique_ptr<uint8_t[]>> decompressedChunks;
+        };
+
+        /** Stream buffer reading from memory in place.
+        */
+        class MemoryStreamBuf : public std::streambuf
+        {
+        public:
+            MemoryStreamBuf(const uint8_t* pData, size_t size)
+            {
+                char* p = const_cast<char*>(reinterpret_cast<const char*>(pData));
+                setg(p, p, p + size);
+            }
+        };
+
+        size_t alignToPage(size_t offset)
+        {
+            return (offset + kPageSize - 1) / kPageSize * kPageSize;
+        }
+
+        /** Compresses the blocks of a chunk in parallel.
+            The chunk is left raw if the compressed size exceeds the maximum compression ratio.
+        */
+        void compressChunk(WriteChunk& chunk)
+        {
+            const size_t blockCount = (chunk.size + kCompressionBlockSize - 1) / kCompressionBlockSize;
+            if (blockCount == 0) return;
+
+            std::vector<std::vector<uint8_t>> blocks(blockCount);
+            Threading::parallelFor(0, blockCount, [&](size_t rangeBegin, size_t rangeEnd)
+            {
+                for (size_t b = rangeBegin; b < rangeEnd; b++)
+                {
+                    const size_t srcOffset = b * kCompressionBlockSize;
+                    const int srcSize = (int)std::min(kCompressionBlockSize, chunk.size - srcOffset);
+                    auto& block = blocks[b];
+                    block.resize(LZ4_compressBound(srcSize));
+                    const int size = LZ4_compress_default(reinterpret_cast<const char*>(chunk.pData + srcOffset), reinterpret_cast<char*>(block.data()), srcSize, (int)block.size());
+                    block.resize(std::max(size, 0));
+                }
+            }, 1);
+
+            size_t compressedSize = blockCount * sizeof(uint32_t);
+            for (const auto& block : blocks)
+            {
+                // An empty block means the compression failed, store the chunk raw.
+                if (block.empty()) return;
+                compressedSize += block.size();
+            }
+            if ((double)compressedSize > chunk.maxCompressionRatio * (double)chunk.size) return;
+
+            chunk.compressed.resize(compressedSize);
+            uint8_t* pDst = chunk.compressed.data();
+            for (const auto& block : blocks)
+            {
+                const uint32_t blockSize = (uint32_t)block.size();
+                std::memcpy(pDst, &blockSize, sizeof(blockSize));
+                pDst += sizeof(blockSize);
+            }
+            for (const auto& block : blocks)
+            {
+                std::memcpy(pDst, block.data(), block.size());
+                pDst += block.size();
+            }
+            chunk.blockCount = (uint32_t)blockCount;
+        }
     }
 
     /** Wrapper around std::ostream to ease serialization of basic types.
@@ -189,6 +326,8 @@ namespace Falcor
 
     void SceneCache::writeCache(const Scene::SceneData& sceneData, const Key& key)
     {
+        assert(sceneData.externalMeshData.pStorage == nullptr);
+
         auto cachePath = getCachePath(key);
 
         logInfo("Writing scene cache to " + cachePath.string());
@@ -236,6 +375,253 @@ namespace Falcor
         return sceneData;
     }
 
+    bool SceneCache::hasValidMappedCache(const Key& key)
+    {
+        auto cachePath = getMappedCachePath(key);
+        if (!std::filesystem::exists(cachePath)) return false;
+
+        // Open file.
+        std::ifstream fs(cachePath.c_str(), std::ios_base::binary);
+        if (fs.bad()) return false;
+
+        // Verify header.
+        MappedHeader header;
+        fs.read(reinterpret_cast<char*>(&header), sizeof(header));
+        return !fs.eof() && header.isValid();
+    }
+
+    void SceneCache::writeMappedCache(const Scene::SceneData& sceneData, const Key& key)
+    {
+        assert(sceneData.externalMeshData.pStorage == nullptr);
+
+        auto cachePath = getMappedCachePath(key);
+
+        logInfo("Writing memory mapped scene cache to " + cachePath.string());
+
+        // Create directories if not existing.
+        std::filesystem::create_directories(cachePath.parent_path());
+
+        // Serialize the scene data, the materials and the animations.
+        std::ostringstream sceneDataStream, materialStream, animationStream;
+        {
+            OutputStream stream(sceneDataStream);
+            writeSceneData(stream, sceneData, true);
+        }
+        {
+            OutputStream stream(materialStream);
+            stream.write((uint32_t)sceneData.materials.size());
+            for (const auto& pMaterial : sceneData.materials) writeMaterial(stream, pMaterial);
+        }
+        {
+            OutputStream stream(animationStream);
+            stream.write((uint32_t)sceneData.animations.size());
+            for (const auto& pAnimation : sceneData.animations) writeAnimation(stream, pAnimation);
+        }
+        const std::string serialized[] = { sceneDataStream.str(), materialStream.str(), animationStream.str() };
+
+        auto serializedChunk = [](ChunkID id, const std::string& data)
+        {
+            WriteChunk chunk = { id, reinterpret_cast<const uint8_t*>(data.data()), data.size() };
+            return chunk;
+        };
+        auto meshDataChunk = [](ChunkID id, const auto& vec)
+        {
+            WriteChunk chunk = { id, reinterpret_cast<const uint8_t*>(vec.data()), vec.size() * sizeof(vec[0]), kMaxMeshDataCompressionRatio };
+            return chunk;
+        };
+
+        std::vector<WriteChunk> chunks =
+        {
+            serializedChunk(ChunkID::SceneData, serialized[0]),
+            serializedChunk(ChunkID::Materials, serialized[1]),
+            serializedChunk(ChunkID::Animations, serialized[2]),
+            meshDataChunk(ChunkID::MeshIndexData, sceneData.meshIndexData),
+            meshDataChunk(ChunkID::MeshStaticData, sceneData.meshStaticData),
+            meshDataChunk(ChunkID::MeshDynamicData, sceneData.meshDynamicData),
+        };
+        for (auto& chunk : chunks) compressChunk(chunk);
+
+        // Lay out the chunks.
+        MappedHeader header;
+        std::memcpy(header.magic, kMappedMagic, sizeof(MappedHeader::magic));
+        header.version = kVersion;
+        header.chunkCount = (uint32_t)chunks.size();
+
+        std::vector<ChunkEntry> toc(chunks.size());
+        size_t offset = sizeof(MappedHeader) + toc.size() * sizeof(ChunkEntry);
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            const auto& chunk = chunks[i];
+            auto& entry = toc[i];
+            entry.id = (uint32_t)chunk.id;
+            entry.blockCount = chunk.blockCount;
+            entry.size = chunk.blockCount > 0 ? chunk.compressed.size() : chunk.size;
+            entry.dataSize = chunk.size;
+            if (entry.size == 0) continue;
+            entry.offset = alignToPage(offset);
+            offset = entry.offset + entry.size;
+        }
+
+        // Open file.
+        std::ofstream fs(cachePath.c_str(), std::ios_base::binary);
+        if (fs.bad()) throw std::runtime_error("Failed to create scene cache file '" + cachePath.string() + "'!");
+
+        // Write header, table of contents and the chunks.
+        fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fs.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(ChunkEntry));
+        size_t position = sizeof(MappedHeader) + toc.size() * sizeof(ChunkEntry);
+        const std::vector<char> padding(kPageSize, 0);
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            const auto& chunk = chunks[i];
+            const auto& entry = toc[i];
+            if (entry.size == 0) continue;
+            fs.write(padding.data(), entry.offset - position);
+            const uint8_t* pData = chunk.blockCount > 0 ? chunk.compressed.data() : chunk.pData;
+            fs.write(reinterpret_cast<const char*>(pData), entry.size);
+            position = entry.offset + entry.size;
+        }
+        if (fs.bad()) throw std::runtime_error("Failed to write scene cache file to '" + cachePath.string() + "'!");
+    }
+
+    Scene::SceneData SceneCache::readMappedCache(const Key& key)
+    {
+        auto cachePath = getMappedCachePath(key);
+
+        logInfo("Loading memory mapped scene cache from " + cachePath.string());
+
+        TimeReport timeReport;
+
+        // Map file.
+        auto pStorage = std::make_shared<MappedCacheStorage>();
+        if (!pStorage->file.open(cachePath)) throw std::runtime_error("Failed to open scene cache file '" + cachePath.string() + "'!");
+        const uint8_t* pFile = pStorage->file.getData();
+        const size_t fileSize = pStorage->file.getSize();
+
+        // Read header and table of contents.
+        auto invalid = [&cachePath]() { return std::runtime_error("Invalid scene cache file '" + cachePath.string() + "'!"); };
+        MappedHeader header;
+        if (fileSize < sizeof(header)) throw invalid();
+        std::memcpy(&header, pFile, sizeof(header));
+        if (!header.isValid()) throw std::runtime_error("Invalid header in scene cache file '" + cachePath.string() + "'!");
+        if ((fileSize - sizeof(header)) / sizeof(ChunkEntry) < header.chunkCount) throw invalid();
+        std::vector<ChunkEntry> toc(header.chunkCount);
+        std::memcpy(toc.data(), pFile + sizeof(header), toc.size() * sizeof(ChunkEntry));
+
+        // Locate the chunks and collect the blocks to decompress.
+        struct Block
+        {
+            const uint8_t* pSrc;
+            size_t srcSize;
+            uint8_t* pDst;
+            size_t dstSize;
+        };
+        std::vector<Block> blocks;
+        std::array<const uint8_t*, (size_t)ChunkID::Count> chunkData = {};
+        std::array<size_t, (size_t)ChunkID::Count> chunkSizes = {};
+        for (const auto& entry : toc)
+        {
+            if (entry.id >= (uint32_t)ChunkID::Count || entry.offset % kPageSize != 0) throw invalid();
+            if (entry.offset > fileSize || entry.size > fileSize - entry.offset) throw invalid();
+            const uint8_t* pChunk = pFile + entry.offset;
+            chunkSizes[entry.id] = (size_t)entry.dataSize;
+
+            if (entry.blockCount == 0)
+            {
+                if (entry.size != entry.dataSize) throw invalid();
+                chunkData[entry.id] = pChunk;
+                continue;
+            }
+
+            const size_t tableSize = entry.blockCount * sizeof(uint32_t);
+            if (entry.blockCount != (entry.dataSize + kCompressionBlockSize - 1) / kCompressionBlockSize || tableSize > entry.size) throw invalid();
+            pStorage->decompressedChunks.emplace_back(new uint8_t[entry.dataSize]);
+            uint8_t* pDst = pStorage->decompressedChunks.back().get();
+            chunkData[entry.id] = pDst;
+
+            size_t srcOffset = tableSize;
+            for (uint32_t b = 0; b < entry.blockCount; b++)
+            {
+                uint32_t blockSize;
+                std::memcpy(&blockSize, pChunk + b * sizeof(uint32_t), sizeof(blockSize));
+                if (blockSize > entry.size - srcOffset) throw invalid();
+                const size_t dstOffset = b * kCompressionBlockSize;
+                blocks.push_back({ pChunk + srcOffset, blockSize, pDst + dstOffset, std::min(kCompressionBlockSize, (size_t)entry.dataSize - dstOffset) });
+                srcOffset += blockSize;
+            }
+        }
+        for (size_t id = 0; id < (size_t)ChunkID::Count; id++)
+        {
+            if (!chunkData[id] && chunkSizes[id] > 0) throw invalid();
+        }
+
+        timeReport.measure("Mapping file");
+
+        // Decompress the blocks of all compressed chunks in parallel.
+        std::atomic<bool> failed = false;
+        Threading::parallelFor(0, blocks.size(), [&](size_t rangeBegin, size_t rangeEnd)
+        {
+            for (size_t b = rangeBegin; b < rangeEnd; b++)
+            {
+                const auto& block = blocks[b];
+                const int size = LZ4_decompress_safe(reinterpret_cast<const char*>(block.pSrc), reinterpret_cast<char*>(block.pDst), (int)block.srcSize, (int)block.dstSize);
+                if (size != (int)block.dstSize) failed = true;
+            }
+        }, 1);
+        if (failed) throw std::runtime_error("Failed to decompress scene cache file '" + cachePath.string() + "'!");
+
+        timeReport.measure("Decompressing chunks");
+
+        // Deserialize the scene data, the materials and the animations.
+        auto readChunk = [&](ChunkID id, const std::function<void(InputStream&)>& func)
+        {
+            MemoryStreamBuf buffer(chunkData[(size_t)id], chunkSizes[(size_t)id]);
+            std::istream is(&buffer);
+            InputStream stream(is);
+            func(stream);
+            if (!is) throw std::runtime_error("Failed to read scene cache file from '" + cachePath.string() + "'!");
+        };
+
+        Scene::SceneData sceneData;
+        readChunk(ChunkID::SceneData, [&](InputStream& stream) { sceneData = readSceneData(stream, true); });
+        timeReport.measure("Reading scene data");
+
+        // See readSceneData() for the restrictions on GPU operations while material textures are loading.
+        readChunk(ChunkID::Materials, [&](InputStream& stream)
+        {
+            auto pMaterialTextureLoader = std::make_unique<MaterialTextureLoader>(true);
+            sceneData.materials.resize(stream.read<uint32_t>());
+            for (auto& pMaterial : sceneData.materials) pMaterial = readMaterial(stream, *pMaterialTextureLoader);
+        });
+        timeReport.measure("Reading materials");
+
+        readChunk(ChunkID::Animations, [&](InputStream& stream)
+        {
+            sceneData.animations.resize(stream.read<uint32_t>());
+            for (auto& pAnimation : sceneData.animations) pAnimation = readAnimation(stream);
+        });
+        timeReport.measure("Reading animations");
+
+        // Reference the mesh data in place.
+        auto setMeshDataView = [&](ChunkID id, auto& view)
+        {
+            using View = std::remove_reference_t<decltype(view)>;
+            using T = typename View::value_type;
+            const size_t size = chunkSizes[(size_t)id];
+            if (size % sizeof(T) != 0) throw invalid();
+            view = View(reinterpret_cast<const T*>(chunkData[(size_t)id]), size / sizeof(T));
+        };
+        auto& externalMeshData = sceneData.externalMeshData;
+        setMeshDataView(ChunkID::MeshIndexData, externalMeshData.indexData);
+        setMeshDataView(ChunkID::MeshStaticData, externalMeshData.staticData);
+        setMeshDataView(ChunkID::MeshDynamicData, externalMeshData.dynamicData);
+        externalMeshData.pStorage = pStorage;
+
+        timeReport.printToLog();
+
+        return sceneData;
+    }
+
     std::filesystem::path SceneCache::getCachePath(const Key& key)
     {
         std::stringstream ss;
@@ -244,9 +630,16 @@ namespace Falcor
         return std::filesystem::path(getAppDataDirectory()) / kDirectory / ss.str();
     }
 
+    std::filesystem::path SceneCache::getMappedCachePath(const Key& key)
+    {
+        auto path = getCachePath(key);
+        path += kMappedExtension;
+        return path;
+    }
+
     // SceneData
 
-    void SceneCache::writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData)
+    void SceneCache::writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData, bool separateChunks)
     {
         writeMarker(stream, "Filename");
         stream.write(sceneData.filename);
@@ -277,9 +670,12 @@ namespace Falcor
         stream.write(hasEnvMap);
         if (hasEnvMap) writeEnvMap(stream, sceneData.pEnvMap);
 
-        writeMarker(stream, "Materials");
-        stream.write((uint32_t)sceneData.materials.size());
-        for (const auto& pMaterial : sceneData.materials) writeMaterial(stream, pMaterial);
+        if (!separateChunks)
+        {
+            writeMarker(stream, "Materials");
+            stream.write((uint32_t)sceneData.materials.size());
+            for (const auto& pMaterial : sceneData.materials) writeMaterial(stream, pMaterial);
+        }
 
         writeMarker(stream, "SceneGraph");
         stream.write((uint32_t)sceneData.sceneGraph.size());
@@ -292,11 +688,14 @@ namespace Falcor
             stream.write(node.localToBindSpace);
         }
 
-        writeMarker(stream, "Animations");
-        stream.write((uint32_t)sceneData.animations.size());
-        for (const auto& pAnimation : sceneData.animations)
+        if (!separateChunks)
         {
-            writeAnimation(stream, pAnimation);
+            writeMarker(stream, "Animations");
+            stream.write((uint32_t)sceneData.animations.size());
+            for (const auto& pAnimation : sceneData.animations)
+            {
+                writeAnimation(stream, pAnimation);
+            }
         }
 
         writeMarker(stream, "Metadata");
@@ -331,9 +730,12 @@ namespace Falcor
         stream.write(sceneData.has16BitIndices);
         stream.write(sceneData.has32BitIndices);
         stream.write(sceneData.meshDrawCount);
-        stream.write(sceneData.meshIndexData);
-        stream.write(sceneData.meshStaticData);
-        stream.write(sceneData.meshDynamicData);
+        if (!separateChunks)
+        {
+            stream.write(sceneData.meshIndexData);
+            stream.write(sceneData.meshStaticData);
+            stream.write(sceneData.meshDynamicData);
+        }
 
         writeMarker(stream, "Curves");
         stream.write(sceneData.curveDesc);
@@ -358,7 +760,7 @@ namespace Falcor
         writeMarker(stream, "End");
     }
 
-    Scene::SceneData SceneCache::readSceneData(InputStream& stream)
+    Scene::SceneData SceneCache::readSceneData(InputStream& stream, bool separateChunks)
     {
         Scene::SceneData sceneData;
 
@@ -399,9 +801,12 @@ namespace Falcor
         // further down which blocks until all textures are loaded.
         auto pMaterialTextureLoader = std::make_unique<MaterialTextureLoader>(true);
 
-        readMarker(stream, "Materials");
-        sceneData.materials.resize(stream.read<uint32_t>());
-        for (auto& pMaterial : sceneData.materials) pMaterial = readMaterial(stream, *pMaterialTextureLoader);
+        if (!separateChunks)
+        {
+            readMarker(stream, "Materials");
+            sceneData.materials.resize(stream.read<uint32_t>());
+            for (auto& pMaterial : sceneData.materials) pMaterial = readMaterial(stream, *pMaterialTextureLoader);
+        }
 
         readMarker(stream, "SceneGraph");
         sceneData.sceneGraph.resize(stream.read<uint32_t>());
@@ -414,9 +819,12 @@ namespace Falcor
             stream.read(node.localToBindSpace);
         }
 
-        readMarker(stream, "Animations");
-        sceneData.animations.resize(stream.read<uint32_t>());
-        for (auto& pAnimation : sceneData.animations) pAnimation = readAnimation(stream);
+        if (!separateChunks)
+        {
+            readMarker(stream, "Animations");
+            sceneData.animations.resize(stream.read<uint32_t>());
+            for (auto& pAnimation : sceneData.animations) pAnimation = readAnimation(stream);
+        }
 
         readMarker(stream, "Metadata");
         sceneData.metadata = readMetadata(stream);
@@ -450,9 +858,12 @@ namespace Falcor
         stream.read(sceneData.has16BitIndices);
         stream.read(sceneData.has32BitIndices);
         stream.read(sceneData.meshDrawCount);
-        stream.read(sceneData.meshIndexData);
-        stream.read(sceneData.meshStaticData);
-        stream.read(sceneData.meshDynamicData);
+        if (!separateChunks)
+        {
+            stream.read(sceneData.meshIndexData);
+            stream.read(sceneData.meshStaticData);
+            stream.read(sceneData.meshDynamicData);
+        }
 
         readMarker(stream, "Curves");
         stream.read(sceneData.curveDesc);
@@ -650,6 +1061,7 @@ namespace Falcor
         }
         writeTransform(stream, pMaterial->mTextureTransform);
         stream.write(pMaterial->mDoubleSided);
+        stream.write(pMaterial->mIsConeMapBaked);
         stream.write(pMaterial->mAlphaRange);
         stream.write(pMaterial->mIsTexturedBaseColorConstant);
         stream.write(pMaterial->mIsTexturedAlphaConstant);
@@ -677,6 +1089,7 @@ namespace Falcor
         }
         pMaterial->mTextureTransform = readTransform(stream);
         stream.read(pMaterial->mDoubleSided);
+        stream.read(pMaterial->mIsConeMapBaked);
         stream.read(pMaterial->mAlphaRange);
         stream.read(pMaterial->mIsTexturedBaseColorConstant);
         stream.read(pMaterial->mIsTexturedAlphaConstant);
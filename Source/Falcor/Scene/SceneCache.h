@@ -61,14 +61,42 @@ namespace Falcor
         */
         static Scene::SceneData readCache(const Key& key);
 
+        /** Check if there is a valid memory mapped scene cache for a given cache key.
+            \param[in] key Cache key.
+            \return Returns true if a valid cache exists.
+        */
+        static bool hasValidMappedCache(const Key& key);
+
+        /** Write a memory mapped scene cache.
+            This is a second cache format next to the stream compressed one. The mesh vertex/index data, the materials and
+            the animations are stored in chunks of their own at page aligned offsets, listed in a table of contents after the header.
+            A chunk is LZ4 compressed in independent blocks if that saves enough space, otherwise it is stored raw.
+            \param[in] sceneData Scene data.
+            \param[in] key Cache key.
+        */
+        static void writeMappedCache(const Scene::SceneData& sceneData, const Key& key);
+
+        /** Read a memory mapped scene cache.
+            The blocks of the compressed chunks are decompressed in parallel. The mesh vertex/index data is not copied into
+            the vectors of the scene data, Scene::SceneData::externalMeshData references the mapping (or the decompressed chunk)
+            and keeps it alive until the scene is created.
+            \param[in] key Cache key.
+            \return Returns the loaded scene data.
+        */
+        static Scene::SceneData readMappedCache(const Key& key);
+
     private:
         class OutputStream;
         class InputStream;
 
         static std::filesystem::path getCachePath(const Key& key);
+        static std::filesystem::path getMappedCachePath(const Key& key);
 
-        static void writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData);
-        static Scene::SceneData readSceneData(InputStream& stream);
+        /** Write/read the scene data.
+            \param[in] separateChunks Skip the materials, the animations and the mesh vertex/index data, the memory mapped cache stores them in chunks of their own.
+        */
+        static void writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData, bool separateChunks = false);
+        static Scene::SceneData readSceneData(InputStream& stream, bool separateChunks = false);
 
         static void writeMetadata(OutputStream& stream, const Scene::Metadata& metadata);
         static Scene::Metadata readMetadata(InputStream& stream);
@@ -0,0 +1,59 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include <vector>
+
+namespace Falcor
+{
+    /** Read-only view of a contiguous array that is owned elsewhere, e.g. by a std::vector or a memory mapped file.
+        The view does not keep the memory alive.
+    */
+    template<typename T>
+    class ArrayView
+    {
+    public:
+        using value_type = T;
+
+        ArrayView() = default;
+        ArrayView(const T* pData, size_t size) : mpData(pData), mSize(size) {}
+        ArrayView(const std::vector<T>& vec) : mpData(vec.data()), mSize(vec.size()) {}
+
+        const T* data() const { return mpData; }
+        size_t size() const { return mSize; }
+        bool empty() const { return mSize == 0; }
+
+        const T& operator[](size_t i) const { assert(i < mSize); return mpData[i]; }
+
+        const T* begin() const { return mpData; }
+        const T* end() const { return mpData + mSize; }
+
+    private:
+        const T* mpData = nullptr;
+        size_t mSize = 0;
+    };
+}
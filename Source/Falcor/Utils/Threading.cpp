@@ -27,69 +27,337 @@
  **************************************************************************/
 #include "stdafx.h"
 #include "Threading.h"
+#include <deque>
 
 namespace Falcor
 {
+    struct Threading::TaskData
+    {
+        std::function<void(void)> func;
+        std::atomic<uint32_t> pendingCount = 1; // unfinished dependencies + 1 until the task is dispatched
+        std::atomic<bool> done = false;
+        std::exception_ptr pException;
+        std::mutex mutex; // guards done (when set) and continuations
+        std::vector<std::shared_ptr<TaskData>> continuations;
+    };
+
+    struct Threading::TaskGroup::GroupData
+    {
+        std::atomic<uint32_t> pendingCount = 0;
+        std::mutex mutex;
+        std::exception_ptr pException; // the first one
+    };
+
     namespace
     {
+        using TaskPtr = std::shared_ptr<Threading::TaskData>;
+        const uint32_t kNoWorker = uint32_t(-1);
+
+        struct TaskQueue
+        {
+            std::mutex mutex;
+            std::deque<TaskPtr> tasks;
+        };
+
         struct ThreadingData
         {
             bool initialized = false;
             std::vector<std::thread> threads;
-            uint32_t current;
+            std::vector<std::unique_ptr<TaskQueue>> queues; // one per worker, the last one takes the tasks of other threads
+            std::atomic<size_t> queuedCount = 0;  // tasks in the queues
+            std::atomic<size_t> activeCount = 0;  // dispatched tasks that have not finished
+            std::atomic<bool> stop = false;
+            std::mutex sleepMutex;
+            std::condition_variable workerCondition; // idle workers
+            std::condition_variable waiterCondition; // threads waiting for tasks
+            std::atomic<uint32_t> sleepingWorkerCount = 0;
+            std::atomic<uint32_t> sleepingWaiterCount = 0;
         } gData;
+
+        thread_local uint32_t tWorkerIndex = kNoWorker;
+
+        void notifyWaiters()
+        {
+            if (gData.sleepingWaiterCount > 0)
+            {
+                std::lock_guard<std::mutex> lock(gData.sleepMutex);
+                gData.waiterCondition.notify_all();
+            }
+        }
+
+        void push(const TaskPtr& pTask)
+        {
+            TaskQueue& queue = tWorkerIndex != kNoWorker ? *gData.queues[tWorkerIndex] : *gData.queues.back();
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.tasks.push_back(pTask);
+            }
+            ++gData.queuedCount;
+            if (gData.sleepingWorkerCount > 0)
+            {
+                std::lock_guard<std::mutex> lock(gData.sleepMutex);
+                gData.workerCondition.notify_one();
+            }
+            notifyWaiters();
+        }
+
+        // Own tasks newest first, then the shared queue and the other workers' tasks oldest first
+        TaskPtr pop()
+        {
+            if (gData.queuedCount == 0) return nullptr;
+            const uint32_t queueCount = (uint32_t)gData.queues.size();
+            const uint32_t first = tWorkerIndex != kNoWorker ? tWorkerIndex : queueCount - 1;
+            for (uint32_t i = 0; i < queueCount; ++i)
+            {
+                TaskQueue& queue = *gData.queues[(first + i) % queueCount];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tasks.empty()) continue;
+                TaskPtr pTask;
+                if (i == 0 && tWorkerIndex != kNoWorker)
+                {
+                    pTask = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+                else
+                {
+                    pTask = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                --gData.queuedCount;
+                return pTask;
+            }
+            return nullptr;
+        }
+
+        void execute(const TaskPtr& pTask)
+        {
+            try
+            {
+                pTask->func();
+            }
+            catch (...)
+            {
+                pTask->pException = std::current_exception();
+            }
+            pTask->func = nullptr;
+
+            std::vector<TaskPtr> continuations;
+            {
+                std::lock_guard<std::mutex> lock(pTask->mutex);
+                pTask->done = true;
+                continuations.swap(pTask->continuations);
+            }
+            for (const auto& pNext : continuations)
+            {
+                if (--pNext->pendingCount == 0) push(pNext);
+            }
+            --gData.activeCount;
+            notifyWaiters();
+        }
+
+        // Executes queued tasks until isDone() returns true
+        void helpUntil(const std::function<bool()>& isDone)
+        {
+            while (!isDone())
+            {
+                if (TaskPtr pTask = pop())
+                {
+                    execute(pTask);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(gData.sleepMutex);
+                ++gData.sleepingWaiterCount;
+                gData.waiterCondition.wait(lock, [&]() { return gData.queuedCount > 0 || isDone(); });
+                --gData.sleepingWaiterCount;
+            }
+        }
+
+        void workerLoop(uint32_t index)
+        {
+            tWorkerIndex = index;
+            while (true)
+            {
+                if (TaskPtr pTask = pop())
+                {
+                    execute(pTask);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(gData.sleepMutex);
+                ++gData.sleepingWorkerCount;
+                gData.workerCondition.wait(lock, []() { return gData.queuedCount > 0 || gData.stop; });
+                --gData.sleepingWorkerCount;
+                if (gData.stop && gData.queuedCount == 0) break;
+            }
+        }
     }
 
     void Threading::start(uint32_t threadCount)
     {
         if (gData.initialized) return;
 
-        gData.threads.resize(threadCount);
+        if (threadCount == 0) threadCount = getLogicalThreadCount();
+        if (threadCount == 0) threadCount = kDefaultThreadCount;
+        gData.stop = false;
+        gData.queues.clear();
+        for (uint32_t i = 0; i <= threadCount; ++i) gData.queues.push_back(std::make_unique<TaskQueue>());
+        gData.threads.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; ++i) gData.threads.emplace_back(workerLoop, i);
         gData.initialized = true;
     }
 
     void Threading::shutdown()
     {
+        if (!gData.initialized) return;
+
+        finish();
+        {
+            std::lock_guard<std::mutex> lock(gData.sleepMutex);
+            gData.stop = true;
+            gData.workerCondition.notify_all();
+        }
         for (auto& t : gData.threads)
         {
             if (t.joinable()) t.join();
         }
-
+        gData.threads.clear();
+        gData.queues.clear();
         gData.initialized = false;
     }
 
+    uint32_t Threading::getThreadCount()
+    {
+        return (uint32_t)gData.threads.size();
+    }
+
     Threading::Task Threading::dispatchTask(const std::function<void(void)>& func)
+    {
+        return dispatchTask(func, {});
+    }
+
+    Threading::Task Threading::dispatchTask(const std::function<void(void)>& func, const std::vector<Task>& dependencies)
     {
         assert(gData.initialized);
 
-        std::thread& t = gData.threads[gData.current];
-        if (t.joinable()) t.join();
-        t = std::thread(func);
-        gData.current = (gData.current + 1) % gData.threads.size();
+        auto pTask = std::make_shared<TaskData>();
+        pTask->func = func;
+        ++gData.activeCount;
+        for (const auto& dependency : dependencies)
+        {
+            if (!dependency.mpData) continue;
+            std::lock_guard<std::mutex> lock(dependency.mpData->mutex);
+            if (dependency.mpData->done) continue;
+            ++pTask->pendingCount;
+            dependency.mpData->continuations.push_back(pTask);
+        }
+        if (--pTask->pendingCount == 0) push(pTask);
 
-        return Task();
+        return Task(pTask);
     }
 
     void Threading::finish()
     {
-        for (auto& t : gData.threads)
+        helpUntil([]() { return gData.activeCount == 0; });
+    }
+
+    size_t Threading::getGrainSize(size_t count, size_t grainSize)
+    {
+        if (grainSize > 0) return grainSize;
+        const size_t chunkCount = 4 * std::max<size_t>(getThreadCount(), 1);
+        return std::max<size_t>((count + chunkCount - 1) / chunkCount, 1);
+    }
+
+    void Threading::parallelFor(size_t begin, size_t end, const std::function<void(size_t rangeBegin, size_t rangeEnd)>& func, size_t grainSize)
+    {
+        if (end <= begin) return;
+        grainSize = getGrainSize(end - begin, grainSize);
+        if (!gData.initialized || end - begin <= grainSize)
         {
-            if (t.joinable()) t.join();
+            for (size_t rangeBegin = begin; rangeBegin < end; rangeBegin += grainSize) func(rangeBegin, std::min(end, rangeBegin + grainSize));
+            return;
         }
+
+        // the calling thread takes the first range and helps with the rest in wait()
+        TaskGroup group;
+        for (size_t rangeBegin = begin + grainSize; rangeBegin < end; rangeBegin += grainSize)
+        {
+            const size_t rangeEnd = std::min(end, rangeBegin + grainSize);
+            group.run([&func, rangeBegin, rangeEnd]() { func(rangeBegin, rangeEnd); });
+        }
+        std::exception_ptr pException;
+        try
+        {
+            func(begin, begin + grainSize);
+        }
+        catch (...)
+        {
+            pException = std::current_exception();
+        }
+        group.wait();
+        if (pException) std::rethrow_exception(pException);
     }
 
-    Threading::Task::Task()
+    bool Threading::Task::isRunning() const
     {
+        return mpData && !mpData->done;
     }
 
-    bool Threading::Task::isRunning()
+    void Threading::Task::finish()
     {
-        logError("Threading::Task::isRunning() not implemented");
-        return true;
+        if (!mpData) return;
+        auto pData = mpData;
+        helpUntil([pData]() { return pData->done.load(); });
+        if (pData->pException) std::rethrow_exception(pData->pException);
     }
 
-    void Threading::Task::finish()
+    Threading::Task Threading::Task::then(const std::function<void(void)>& func) const
+    {
+        return Threading::dispatchTask(func, { *this });
+    }
+
+    Threading::TaskGroup::TaskGroup()
+        : mpData(std::make_shared<GroupData>())
+    {
+    }
+
+    Threading::TaskGroup::~TaskGroup()
+    {
+        auto pData = mpData;
+        helpUntil([pData]() { return pData->pendingCount == 0; });
+    }
+
+    void Threading::TaskGroup::run(const std::function<void(void)>& func)
+    {
+        auto pData = mpData;
+        ++pData->pendingCount;
+        Threading::dispatchTask([pData, func]()
+        {
+            try
+            {
+                func();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(pData->mutex);
+                if (!pData->pException) pData->pException = std::current_exception();
+            }
+            --pData->pendingCount;
+        });
+    }
+
+    void Threading::TaskGroup::wait()
+    {
+        auto pData = mpData;
+        helpUntil([pData]() { return pData->pendingCount == 0; });
+        std::exception_ptr pException;
+        {
+            std::lock_guard<std::mutex> lock(pData->mutex);
+            std::swap(pException, pData->pException);
+        }
+        if (pException) std::rethrow_exception(pException);
+    }
+
+    bool Threading::TaskGroup::isRunning() const
     {
-        logError("Threading::Task::finish() not implemented");
+        return mpData->pendingCount > 0;
     }
 }
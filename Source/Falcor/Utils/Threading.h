@@ -29,44 +29,98 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <functional>
 
 namespace Falcor
 {
+    /** Global thread pool.
+        Every worker thread has its own task queue. A task dispatched from a worker goes to the worker's queue,
+        the worker executes its newest task first, and idle workers steal the oldest tasks of the others.
+        Threads waiting for a task (Task::finish(), TaskGroup::wait(), Threading::finish()) execute queued
+        tasks until it has finished instead of blocking, so tasks can wait for other tasks.
+    */
     class dlldecl Threading
     {
     public:
-        const static uint32_t kDefaultThreadCount = 16;
+        const static uint32_t kDefaultThreadCount = 16; ///< Used when the hardware thread count is not available.
 
-        /** Handle to a dispatched task
+        /** State of a dispatched task, internal to the thread pool.
+        */
+        struct TaskData;
 
-            TODO: Implementation
+        /** Handle to a dispatched task
         */
-        class Task
+        class dlldecl Task
         {
         public:
-            /** Check if task is still executing
+            /** Creates an empty handle, it is never running.
             */
-            bool isRunning();
+            Task() = default;
 
-            /** Wait for task to finish executing
+            /** Check if task is still executing (or waiting for its dependencies)
+            */
+            bool isRunning() const;
+
+            /** Wait for task to finish executing, executes queued tasks meanwhile.
+                Rethrows the exception the task has thrown, if any.
             */
             void finish();
 
+            /** Dispatches a task that starts after this one has finished.
+                \return Handle to the continuation
+            */
+            Task then(const std::function<void(void)>& func) const;
+
         private:
-            Task();
+            Task(const std::shared_ptr<TaskData>& pData) : mpData(pData) {}
+            std::shared_ptr<TaskData> mpData;
             friend class Threading;
         };
 
+        /** Set of tasks that are waited for together.
+            The destructor waits for the tasks as well, but only wait() rethrows their exceptions.
+        */
+        class dlldecl TaskGroup
+        {
+        public:
+            /** State of a task group, internal to the thread pool.
+            */
+            struct GroupData;
+
+            TaskGroup();
+            ~TaskGroup();
+            TaskGroup(const TaskGroup&) = delete;
+            TaskGroup& operator=(const TaskGroup&) = delete;
+
+            /** Dispatches a task into the group.
+            */
+            void run(const std::function<void(void)>& func);
+
+            /** Waits for every task of the group, executes queued tasks meanwhile.
+                Rethrows the first exception a task of the group has thrown, if any.
+            */
+            void wait();
+
+            /** Check if a task of the group is still executing
+            */
+            bool isRunning() const;
+
+        private:
+            std::shared_ptr<GroupData> mpData;
+        };
+
         /** Initializes the global thread pool
-            \param[in] threadCount Number of threads in the pool
+            \param[in] threadCount Number of worker threads in the pool, 0 means getLogicalThreadCount()
         */
-        static void start(uint32_t threadCount = kDefaultThreadCount);
+        static void start(uint32_t threadCount = 0);
 
-        /** Waits for all currently executing threads to finish
+        /** Waits for all dispatched tasks to finish, executes queued tasks meanwhile.
+            Must not be called from a task.
         */
         static void finish();
 
-        /** Waits for all currently executing threads to finish and shuts down the thread pool
+        /** Waits for all dispatched tasks to finish and shuts down the thread pool
         */
         static void shutdown();
 
@@ -74,10 +128,56 @@ namespace Falcor
         */
         static uint32_t getLogicalThreadCount() { return std::thread::hardware_concurrency(); }
 
+        /** Returns the number of worker threads in the pool, 0 if it is not started
+        */
+        static uint32_t getThreadCount();
+
         /** Starts a task on an available thread.
             \return Handle to the task
         */
         static Task dispatchTask(const std::function<void(void)>& func);
+
+        /** Starts a task when all of its dependencies have finished (also if they have thrown).
+            \param[in] dependencies Tasks to wait for, empty handles are ignored.
+            \return Handle to the task
+        */
+        static Task dispatchTask(const std::function<void(void)>& func, const std::vector<Task>& dependencies);
+
+        /** Calls func for consecutive subranges of [begin, end) in parallel and waits for them.
+            The calling thread executes subranges too. Runs on the calling thread only if the pool is not started.
+            \param[in] func Called with [rangeBegin, rangeEnd) of at most grainSize elements.
+            \param[in] grainSize Number of elements per call, 0 picks about four calls per worker thread.
+        */
+        static void parallelFor(size_t begin, size_t end, const std::function<void(size_t rangeBegin, size_t rangeEnd)>& func, size_t grainSize = 0);
+
+        /** Reduces [begin, end) in parallel.
+            The partial results of the subranges are combined in order on the calling thread, so the result
+            does not depend on the scheduling for a given grain size.
+            \param[in] map Returns the result of a subrange, T map(size_t rangeBegin, size_t rangeEnd).
+            \param[in] combine Combines two results, T combine(const T& a, const T& b).
+            \param[in] grainSize Number of elements per subrange, 0 picks about four subranges per worker thread.
+        */
+        template<typename T, typename MapFunc, typename CombineFunc>
+        static T parallelReduce(size_t begin, size_t end, const T& identity, MapFunc map, CombineFunc combine, size_t grainSize = 0)
+        {
+            if (end <= begin) return identity;
+            grainSize = getGrainSize(end - begin, grainSize);
+            std::vector<T> partials((end - begin + grainSize - 1) / grainSize, identity);
+            parallelFor(0, partials.size(), [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    const size_t rangeBegin = begin + i * grainSize;
+                    partials[i] = map(rangeBegin, std::min(end, rangeBegin + grainSize));
+                }
+            }, 1);
+            T result = identity;
+            for (const T& partial : partials) result = combine(result, partial);
+            return result;
+        }
+
+    private:
+        static size_t getGrainSize(size_t count, size_t grainSize);
     };
 
     /** Simple thread barrier class.
@@ -246,10 +246,32 @@ namespace Falcor
         ++mFrameCount;
     }
 
+    void Profiler::Capture::captureCounters(const std::map<std::string, float>& counters)
+    {
+        // Called on every captured frame, mFrameCount only counts the frames that had events.
+        for (const auto& [name, value] : counters)
+        {
+            auto it = mCounterLaneIndices.find(name);
+            if (it == mCounterLaneIndices.end())
+            {
+                it = mCounterLaneIndices.emplace(name, mCounterLanes.size()).first;
+                auto& lane = mCounterLanes.emplace_back();
+                lane.name = name + "/value";
+                lane.records.reserve(std::max(mReservedFrames, mCounterFrameCount + 1));
+                lane.records.resize(mCounterFrameCount, 0.f);
+            }
+            mCounterLanes[it->second].records.push_back(value);
+        }
+        ++mCounterFrameCount;
+    }
+
     void Profiler::Capture::finalize()
     {
         assert(!mFinalized);
 
+        mLanes.insert(mLanes.end(), std::make_move_iterator(mCounterLanes.begin()), std::make_move_iterator(mCounterLanes.end()));
+        mCounterLanes.clear();
+
         for (auto& lane : mLanes)
         {
             lane.stats = Stats::compute(lane.records.data(), lane.records.size());
@@ -324,9 +346,14 @@ namespace Falcor
             pEvent->endFrame(mFrameIndex);
         }
 
-        if (mpCapture) mpCapture->captureEvents(mCurrentFrameEvents);
+        if (mpCapture)
+        {
+            mpCapture->captureCounters(mCurrentFrameCounters);
+            mpCapture->captureEvents(mCurrentFrameEvents);
+        }
 
         mLastFrameEvents = std::move(mCurrentFrameEvents);
+        mLastFrameCounters = mCurrentFrameCounters;
         ++mFrameIndex;
     }
 
@@ -372,6 +399,19 @@ namespace Falcor
         return result;
     }
 
+    void Profiler::setCounter(const std::string& name, float value)
+    {
+        if (!mEnabled || mPaused) return;
+        mCurrentFrameCounters[name] = value;
+    }
+
+    pybind11::dict Profiler::getPythonCounters() const
+    {
+        pybind11::dict result;
+        for (const auto& [name, value] : getCounters()) result[name.c_str()] = value;
+        return result;
+    }
+
     const Profiler::SharedPtr& Profiler::instancePtr()
     {
         static Profiler::SharedPtr pInstance;
@@ -406,6 +446,7 @@ namespace Falcor
         profiler.def_property("paused", &Profiler::isPaused, &Profiler::setPaused);
         profiler.def_property_readonly("isCapturing", &Profiler::isCapturing);
         profiler.def_property_readonly("events", &Profiler::getPythonEvents);
+        profiler.def_property_readonly("counters", &Profiler::getPythonCounters);
         profiler.def("startCapture", &Profiler::startCapture, "reservedFrames"_a = 1000);
         profiler.def("endCapture", endCapture);
     }
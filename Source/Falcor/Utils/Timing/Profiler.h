@@ -27,6 +27,7 @@
  **************************************************************************/
 #pragma once
 #include <stack>
+#include <map>
 #include <unordered_map>
 #include <memory>
 #include "CpuTimer.h"
@@ -144,12 +145,16 @@ namespace Falcor
 
             static SharedPtr create(size_t reservedEvents, size_t reservedFrames);
             void captureEvents(const std::vector<Event*>& events);
+            void captureCounters(const std::map<std::string, float>& counters);
             void finalize();
 
             size_t mReservedFrames;
             size_t mFrameCount = 0;
             std::vector<Event*> mEvents;
             std::vector<Lane> mLanes;
+            std::vector<Lane> mCounterLanes;                    ///< Appended to mLanes when the capture is finalized.
+            size_t mCounterFrameCount = 0;                      ///< Number of captured frames, including the ones without events.
+            std::unordered_map<std::string, size_t> mCounterLaneIndices;
             bool mFinalized = false;
 
             friend class Profiler;
@@ -222,6 +227,23 @@ namespace Falcor
         */
         pybind11::dict getPythonEvents() const;
 
+        /** Set the value of a counter for the current frame.
+            Counters are named values that are not measured by the profiler, e.g. statistics computed on the GPU.
+            A counter keeps its value until it is set again, and is recorded in every frame of a capture
+            as a lane named "<name>/value". Frames of a capture before the counter was first set record 0.
+            \param[in] name The counter name.
+            \param[in] value The counter value.
+        */
+        void setCounter(const std::string& name, float value);
+
+        /** Get the profiler counters (previous frame).
+        */
+        const std::map<std::string, float>& getCounters() const { return mLastFrameCounters; }
+
+        /** Get the profiler counters (previous frame) as a python dictionary.
+        */
+        pybind11::dict getPythonCounters() const;
+
         /** Global profiler instance pointer.
         */
         static const Profiler::SharedPtr& instancePtr();
@@ -249,6 +271,8 @@ namespace Falcor
         std::unordered_map<std::string, std::shared_ptr<Event>> mEvents; ///< Events by name.
         std::vector<Event*> mCurrentFrameEvents;            ///< Events registered for current frame.
         std::vector<Event*> mLastFrameEvents;               ///< Events from last frame.
+        std::map<std::string, float> mCurrentFrameCounters; ///< Counters of the current frame.
+        std::map<std::string, float> mLastFrameCounters;    ///< Counters of the last frame.
         std::string mCurrentEventName;                      ///< Current nested event name.
         uint32_t mCurrentLevel = 0;                         ///< Current nesting level.
         uint32_t mFrameIndex = 0;                           ///< Current frame index.
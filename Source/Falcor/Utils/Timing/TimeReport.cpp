@@ -60,6 +60,11 @@ namespace Falcor
         mMeasurements.push_back({name, duration.count()});
     }
 
+    void TimeReport::addMeasurement(const std::string& name, double seconds)
+    {
+        mMeasurements.push_back({name, seconds});
+    }
+
     void TimeReport::addTotal(const std::string name)
     {
         double total = std::accumulate(mMeasurements.begin(), mMeasurements.end(), 0.0, [] (double t, auto &&m) { return t + m.second; });
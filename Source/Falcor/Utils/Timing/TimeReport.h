@@ -55,6 +55,13 @@ namespace Falcor
         */
         void measure(const std::string& name);
 
+        /** Records a time measurement taken elsewhere, e.g. of a task that ran concurrently with the measured ones.
+            Does not reset the internal timer.
+            \param[in] name Name of the record.
+            \param[in] seconds Duration in seconds.
+        */
+        void addMeasurement(const std::string& name, double seconds);
+
         /** Add a record containing the total of all measurements.
             \param[in] name Name of the record.
         */
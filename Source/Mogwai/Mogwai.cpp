@@ -473,6 +473,7 @@ namespace Mogwai
 
         if (mOptions.useSceneCache) buildFlags |= SceneBuilder::Flags::UseCache;
         if (mOptions.rebuildSceneCache) buildFlags |= SceneBuilder::Flags::RebuildCache;
+        if (mOptions.useMappedSceneCache) buildFlags |= SceneBuilder::Flags::UseMappedCache;
 
         SceneBuilder::SharedPtr pBuilder = SceneBuilder::create(filename, buildFlags);
         if (!pBuilder) return;
@@ -689,6 +690,7 @@ int main(int argc, char** argv)
     args::ValueFlag<uint32_t> heightFlag(parser, "pixels", "Initial window height.", {"height"});
     args::Flag useSceneCacheFlag(parser, "", "Use scene cache to improve scene load times.", {'c', "use-cache"});
     args::Flag rebuildSceneCacheFlag(parser, "", "Rebuild the scene cache.", {"rebuild-cache"});
+    args::Flag mappedSceneCacheFlag(parser, "", "Use the memory mapped scene cache format.", {"mapped-cache"});
     args::Flag generateShaderDebugInfo(parser, "", "Generate shader debug info.", {'d', "debug-shaders"});
 
     args::CompletionFlag completionFlag(parser, {"complete"});
@@ -744,6 +746,7 @@ int main(int argc, char** argv)
     if (silentFlag) options.silentMode = true;
     if (useSceneCacheFlag) options.useSceneCache = true;
     if (rebuildSceneCacheFlag) options.rebuildSceneCache = true;
+    if (mappedSceneCacheFlag) options.useMappedSceneCache = true;
     if (generateShaderDebugInfo) options.generateShaderDebugInfo = true;
 
     try
@@ -67,6 +67,16 @@ void ComputeProgramWrapper::runProgram(RenderContext* pContext, const uint3& dim
     pContext->dispatch(mpParallaxRenderState.get(), mpParallaxVars.get(), groups);
 }
 
+void ComputeProgramWrapper::runProgramIndirect(RenderContext* pContext, const Buffer* pArgBuffer, uint64_t argBufferOffset)
+{
+    assert(mpParallaxVars);
+    for (const auto& buffer : mStructuredBuffers)
+    {
+        mpParallaxVars->setBuffer(buffer.first, buffer.second.pBuffer);
+    }
+    pContext->dispatchIndirect(mpParallaxRenderState.get(), mpParallaxVars.get(), pArgBuffer, argBufferOffset);
+}
+
 void ComputeProgramWrapper::unmapBuffer(const char* bufferName)
 {
     assert(mStructuredBuffers.find(bufferName) != mStructuredBuffers.end());
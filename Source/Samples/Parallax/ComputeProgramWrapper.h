@@ -72,6 +72,13 @@ public:
     */
     void runProgram(RenderContext* pContext, uint32_t width = 1, uint32_t height = 1, uint32_t depth = 1) { runProgram(pContext, uint3(width, height, depth)); }
 
+    /** runProgramIndirect runs the compute program with the thread group
+        counts read from a buffer, e.g. written by a previous dispatch.
+        \param[in] pArgBuffer Buffer with IndirectArg bind flag holding three uints.
+        \param[in] argBufferOffset Offset of the arguments in bytes.
+    */
+    void runProgramIndirect(RenderContext* pContext, const Buffer* pArgBuffer, uint64_t argBufferOffset = 0);
+
     /** mapBuffer returns a pointer to the named structured buffer.
         Returns nullptr if no such buffer exists.  SFINAE is used to
         require that a the requested pointer is const.
@@ -0,0 +1,228 @@
+#include "ConemapCache.h"
+#include <lz4.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // Increment every time the file format changes.
+    const uint32_t kVersion = 1;
+
+    // Subdirectory of the application data directory, next to the scene cache.
+    const std::string kDirectory = "NVIDIA/Falcor/ConemapCache";
+
+    const size_t kChunkSize = 1 * 1024 * 1024; // uncompressed size of an lz4 chunk
+
+    const char* kMagic = "FalcorC$";
+    struct Header
+    {
+        uint8_t magic[8]{};
+        uint32_t version{};
+        uint32_t textureCount{}; // 1: conemap, 2: conemap and minmax mipmap
+    };
+
+    struct TextureHeader
+    {
+        uint32_t format{};
+        uint32_t width{};
+        uint32_t height{};
+        uint32_t mipCount{};
+        uint32_t bindFlags{};
+        uint32_t nameLength{};
+    };
+
+    /** Bounds checked reads from the mapped file.
+    */
+    class Reader
+    {
+    public:
+        Reader(const MemoryMappedFile& file) : mpData(file.getData()), mSize(file.getSize()) {}
+
+        const uint8_t* take(size_t len)
+        {
+            if (len > mSize - mOffset) throw std::runtime_error("Unexpected end of conemap cache file");
+            const uint8_t* p = mpData + mOffset;
+            mOffset += len;
+            return p;
+        }
+
+        template<typename T>
+        T read()
+        {
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+    private:
+        const uint8_t* mpData;
+        size_t mSize;
+        size_t mOffset = 0;
+    };
+
+    void writeTexture(std::ostream& stream, const Texture::SharedPtr& pTex, RenderContext* pRenderContext)
+    {
+        TextureHeader header;
+        header.format = (uint32_t)pTex->getFormat();
+        header.width = pTex->getWidth();
+        header.height = pTex->getHeight();
+        header.mipCount = pTex->getMipCount();
+        header.bindFlags = (uint32_t)pTex->getBindFlags();
+        const std::string& name = pTex->getName();
+        header.nameLength = (uint32_t)name.size();
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(name.data(), name.size());
+
+        std::vector<char> compressed(LZ4_compressBound((int)kChunkSize));
+        for (uint32_t mip = 0; mip < header.mipCount; ++mip)
+        {
+            std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pTex.get(), pTex->getSubresourceIndex(0, mip));
+            uint64_t rawSize = data.size();
+            stream.write(reinterpret_cast<const char*>(&rawSize), sizeof(rawSize));
+            for (size_t offset = 0; offset < data.size(); offset += kChunkSize)
+            {
+                int chunkSize = (int)std::min(kChunkSize, data.size() - offset);
+                int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(data.data() + offset), compressed.data(), chunkSize, (int)compressed.size());
+                if (compressedSize <= 0) throw std::runtime_error("Failed to compress conemap cache data");
+                uint32_t size = (uint32_t)compressedSize;
+                stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+                stream.write(compressed.data(), compressedSize);
+            }
+        }
+    }
+
+    /** Size of a mip level as returned by readTextureSubresource: tightly packed rows of blocks.
+    */
+    uint64_t getMipDataSize(ResourceFormat format, uint32_t width, uint32_t height, uint32_t mip)
+    {
+        uint32_t blockWidth = getFormatWidthCompressionRatio(format);
+        uint32_t blockHeight = getFormatHeightCompressionRatio(format);
+        uint32_t mipWidth = std::max(1u, width >> mip);
+        uint32_t mipHeight = std::max(1u, height >> mip);
+        uint64_t rowPitch = getFormatRowPitch(format, (mipWidth + blockWidth - 1) / blockWidth * blockWidth);
+        return rowPitch * ((mipHeight + blockHeight - 1) / blockHeight);
+    }
+
+    /** Returns nullptr if the stored data does not match the texture description.
+    */
+    Texture::SharedPtr readTexture(Reader& reader, RenderContext* pRenderContext)
+    {
+        auto header = reader.read<TextureHeader>();
+        if (header.width == 0 || header.height == 0 || header.mipCount == 0 || header.format >= (uint32_t)ResourceFormat::Count)
+            throw std::runtime_error("Invalid texture in conemap cache file");
+        std::string name(reinterpret_cast<const char*>(reader.take(header.nameLength)), header.nameLength);
+
+        auto pTex = Texture::create2D(header.width, header.height, (ResourceFormat)header.format, 1, header.mipCount, nullptr, (ResourceBindFlags)header.bindFlags);
+        pTex->setName(name);
+        std::vector<uint8_t> data;
+        for (uint32_t mip = 0; mip < header.mipCount; ++mip)
+        {
+            // a size mismatch would make updateSubresourceData read out of bounds
+            uint64_t rawSize = reader.read<uint64_t>();
+            if (rawSize != getMipDataSize((ResourceFormat)header.format, header.width, header.height, mip)) return nullptr;
+
+            // decompress straight from the mapped file
+            data.resize(rawSize);
+            for (size_t offset = 0; offset < data.size(); offset += kChunkSize)
+            {
+                int chunkSize = (int)std::min(kChunkSize, data.size() - offset);
+                uint32_t compressedSize = reader.read<uint32_t>();
+                const char* pSrc = reinterpret_cast<const char*>(reader.take(compressedSize));
+                if (LZ4_decompress_safe(pSrc, reinterpret_cast<char*>(data.data() + offset), (int)compressedSize, chunkSize) != chunkSize)
+                    throw std::runtime_error("Corrupted chunk in conemap cache file");
+            }
+            pRenderContext->updateSubresourceData(pTex.get(), pTex->getSubresourceIndex(0, mip), data.data());
+        }
+        return pTex;
+    }
+}
+
+SHA1::MD ConemapCache::hashHeightmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext)
+{
+    SHA1 sha1;
+    uint32_t desc[3] = { (uint32_t)pHeightmap->getFormat(), pHeightmap->getWidth(), pHeightmap->getHeight() };
+    sha1.update(desc, sizeof(desc));
+    std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pHeightmap.get(), 0);
+    sha1.update(data.data(), data.size());
+    return sha1.final();
+}
+
+ConemapCache::Key ConemapCache::computeKey(const SHA1::MD& heightmapDigest, const std::string& generatorSettings)
+{
+    SHA1 sha1;
+    sha1.update(heightmapDigest.data(), heightmapDigest.size());
+    sha1.update(generatorSettings.data(), generatorSettings.size());
+    return sha1.final();
+}
+
+bool ConemapCache::hasEntry(const Key& key)
+{
+    return std::filesystem::exists(getCachePath(key));
+}
+
+bool ConemapCache::read(const Key& key, Texture::SharedPtr& pConemap, Texture::SharedPtr& pMinmax, RenderContext* pRenderContext)
+{
+    auto cachePath = getCachePath(key);
+    MemoryMappedFile file;
+    if (!file.open(cachePath)) return false;
+
+    Reader reader(file);
+    auto header = reader.read<Header>();
+    if (std::memcmp(header.magic, kMagic, sizeof(Header::magic)) != 0 || header.version != kVersion || header.textureCount < 1 || header.textureCount > 2)
+        throw std::runtime_error("Invalid header in conemap cache file '" + cachePath.string() + "'!");
+
+    auto pCone = readTexture(reader, pRenderContext);
+    if (!pCone) return false;
+    Texture::SharedPtr pMinmaxTex;
+    if (header.textureCount > 1)
+    {
+        pMinmaxTex = readTexture(reader, pRenderContext);
+        if (!pMinmaxTex) return false;
+    }
+    pConemap = pCone;
+    pMinmax = pMinmaxTex;
+    return true;
+}
+
+void ConemapCache::write(const Key& key, const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pMinmax, RenderContext* pRenderContext)
+{
+    auto cachePath = getCachePath(key);
+    std::filesystem::create_directories(cachePath.parent_path());
+
+    // Write to a temporary file first, an interrupted write must not leave a broken entry.
+    auto tempPath = cachePath;
+    tempPath += ".tmp";
+    {
+        std::ofstream fs(tempPath, std::ios_base::binary);
+        if (!fs) throw std::runtime_error("Failed to create conemap cache file '" + tempPath.string() + "'!");
+
+        Header header;
+        std::memcpy(header.magic, kMagic, sizeof(Header::magic));
+        header.version = kVersion;
+        header.textureCount = pMinmax ? 2 : 1;
+        fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeTexture(fs, pConemap, pRenderContext);
+        if (pMinmax) writeTexture(fs, pMinmax, pRenderContext);
+        if (!fs) throw std::runtime_error("Failed to write conemap cache file '" + tempPath.string() + "'!");
+    }
+    std::filesystem::rename(tempPath, cachePath);
+}
+
+void ConemapCache::clear()
+{
+    std::filesystem::remove_all(getCacheDirectory());
+}
+
+std::filesystem::path ConemapCache::getCacheDirectory()
+{
+    return std::filesystem::path(getAppDataDirectory()) / kDirectory;
+}
+
+std::filesystem::path ConemapCache::getCachePath(const Key& key)
+{
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (auto c : key) ss << std::setw(2) << (int)c;
+    return getCacheDirectory() / ss.str();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "Falcor.h"
+#include <filesystem>
+
+using namespace Falcor;
+
+/** On-disk cache of baked conemaps and their minmax mipmaps.
+    Entries are keyed by the SHA1 of the heightmap contents and the generator
+    settings, so a heightmap that was baked before (e.g. the default one on
+    startup) is loaded instead of regenerated. The files live next to the scene
+    cache, every mip level is stored as lz4 compressed chunks, and the file is
+    memory mapped when it is read.
+*/
+class ConemapCache
+{
+public:
+    using Key = SHA1::MD;
+
+    /** Digest of the format, size and level 0 texels of a heightmap. Reads back the texture.
+    */
+    static SHA1::MD hashHeightmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext);
+
+    /** Key of the conemap baked from a heightmap with the given generator settings.
+        \param[in] heightmapDigest Result of hashHeightmap.
+        \param[in] generatorSettings Every setting that changes the result (algorithm, search steps, bit depth...).
+    */
+    static Key computeKey(const SHA1::MD& heightmapDigest, const std::string& generatorSettings);
+
+    /** Checks if the cache has an entry for the key.
+    */
+    static bool hasEntry(const Key& key);
+
+    /** Reads an entry.
+        Throws an exception if the file is corrupted or written by another version.
+        \param[out] pConemap The conemap.
+        \param[out] pMinmax The minmax mipmap, nullptr if the entry has none.
+        \return false if there is no entry for the key, or its data does not match the stored texture description.
+    */
+    static bool read(const Key& key, Texture::SharedPtr& pConemap, Texture::SharedPtr& pMinmax, RenderContext* pRenderContext);
+
+    /** Writes an entry, replacing the previous one.
+        Throws an exception if the file cannot be written.
+        \param[in] pMinmax The minmax mipmap of the heightmap, can be nullptr.
+    */
+    static void write(const Key& key, const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pMinmax, RenderContext* pRenderContext);
+
+    /** Deletes every entry.
+    */
+    static void clear();
+
+    static std::filesystem::path getCacheDirectory();
+    static std::filesystem::path getCachePath(const Key& key);
+};
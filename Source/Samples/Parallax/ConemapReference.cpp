@@ -0,0 +1,121 @@
+#include "ConemapReference.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace ConemapReference
+{
+    namespace
+    {
+        /** Conservative cone of the texel (x, y), the exact search of CpuConemap::bake with Algorithm::Conservative.
+        */
+        float conservativeCone(const Heightmap& hmap, uint32_t x, uint32_t y)
+        {
+            float cone = 1.0f;
+            CpuConemap::bakeWindowCones(hmap, 1.0f / hmap.width, 1.0f / hmap.height, x, y, 1, 1, &cone);
+            return cone;
+        }
+    }
+
+    CompareResult compareConservativeConemap(const Heightmap& hmap, const std::vector<uint8_t>& coneData, uint32_t bytesPerChannel, uint32_t sampleCount, uint32_t tolerance)
+    {
+        assert(bytesPerChannel == 1 || bytesPerChannel == 2);
+        const size_t texelCount = size_t(hmap.width) * hmap.height;
+        assert(coneData.size() >= texelCount * 2 * bytesPerChannel);
+
+        const uint32_t maxValue = bytesPerChannel == 1 ? 0xffu : 0xffffu;
+        auto loadChannel = [&](size_t ind, uint32_t ch) -> uint32_t
+        {
+            size_t offset = (2 * ind + ch) * bytesPerChannel;
+            if (bytesPerChannel == 1) return coneData[offset];
+            uint16_t v;
+            std::memcpy(&v, coneData.data() + offset, sizeof(v));
+            return v;
+        };
+        auto toUnorm = [&](float f) -> uint32_t
+        {
+            return uint32_t(std::lround(std::clamp(f, 0.0f, 1.0f) * maxValue));
+        };
+        auto absDiff = [](uint32_t a, uint32_t b) { return a > b ? a - b : b - a; };
+
+        CompareResult res;
+        if (texelCount == 0) return res;
+        const size_t stride = std::max<size_t>(1, texelCount / std::max(1u, sampleCount));
+        for (size_t ind = 0; ind < texelCount; ind += stride)
+        {
+            uint32_t x = uint32_t(ind % hmap.width);
+            uint32_t y = uint32_t(ind / hmap.width);
+            uint32_t diffH = absDiff(loadChannel(ind, 0), toUnorm(hmap.texels[ind]));
+            uint32_t diffC = absDiff(loadChannel(ind, 1), toUnorm(conservativeCone(hmap, x, y)));
+            uint32_t diff = std::max(diffH, diffC);
+            res.maxDiff = std::max(res.maxDiff, diff);
+            if (diff > tolerance) ++res.mismatchedTexels;
+            ++res.checkedTexels;
+        }
+        return res;
+    }
+
+    TightnessResult measureConeTightness(const Heightmap& hmap, const std::vector<uint8_t>& coneData, uint32_t bytesPerChannel, uint32_t sampleCount, uint32_t tolerance)
+    {
+        assert(bytesPerChannel == 1 || bytesPerChannel == 2);
+        const size_t texelCount = size_t(hmap.width) * hmap.height;
+        assert(coneData.size() >= texelCount * 2 * bytesPerChannel);
+
+        const float maxValue = bytesPerChannel == 1 ? 255.0f : 65535.0f;
+        auto loadCone = [&](size_t ind) -> float
+        {
+            size_t offset = (2 * ind + 1) * bytesPerChannel;
+            if (bytesPerChannel == 1) return coneData[offset] / maxValue;
+            uint16_t v;
+            std::memcpy(&v, coneData.data() + offset, sizeof(v));
+            return v / maxValue;
+        };
+
+        TightnessResult res;
+        if (texelCount == 0) return res;
+        double ratioSum = 0.0;
+        uint32_t ratioCount = 0;
+        const size_t stride = std::max<size_t>(1, texelCount / std::max(1u, sampleCount));
+        for (size_t ind = 0; ind < texelCount; ind += stride)
+        {
+            const float cone = loadCone(ind);
+            const float exact = conservativeCone(hmap, uint32_t(ind % hmap.width), uint32_t(ind / hmap.width));
+            if (cone > exact + tolerance / maxValue) ++res.widerTexels;
+            if (exact > 0)
+            {
+                ratioSum += cone / exact;
+                ++ratioCount;
+            }
+            ++res.checkedTexels;
+        }
+        res.meanTightness = ratioCount ? ratioSum / ratioCount : 1.0;
+        return res;
+    }
+
+    TraversalCompareResult compareMaxMipmapTraversal(const CpuConemap::MinmaxPyramid& mipmap, const std::vector<CpuConemap::TraceRay>& rays, const std::vector<float>& gpuResults, uint32_t maxSteps, float tolerance)
+    {
+        assert(gpuResults.size() >= rays.size() * 4);
+        TraversalCompareResult res;
+        uint32_t walkedRays = 0;
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            const CpuConemap::TraceResult cpu = CpuConemap::traceMaxMipmap(mipmap, rays[i], maxSteps);
+            const float* gpu = &gpuResults[4 * i];
+            if ((gpu[2] != 0) != cpu.wasHit || std::abs(gpu[0] - cpu.t) > tolerance) ++res.mismatchedRays;
+            // the texel walk has no step limit
+            if (cpu.stepCount < maxSteps)
+            {
+                const CpuConemap::TraceResult texels = CpuConemap::traceTexels(mipmap.levels[0], rays[i]);
+                if (texels.wasHit != cpu.wasHit || texels.t != cpu.t) ++res.referenceErrors;
+                res.meanTexels += texels.stepCount;
+                ++walkedRays;
+            }
+            res.meanSteps += cpu.stepCount;
+            ++res.checkedRays;
+        }
+        if (res.checkedRays > 0) res.meanSteps /= res.checkedRays;
+        if (walkedRays > 0) res.meanTexels /= walkedRays;
+        return res;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "CpuConemap.h"
+#include "HeightfieldTrace.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Checks of the textures generated on the GPU against the CPU generators of the CpuConemap library,
+// without any dependency on a GPU device, so the generated textures can be validated headless.
+namespace ConemapReference
+{
+    using Heightmap = CpuConemap::Heightmap;
+
+    struct CompareResult
+    {
+        uint32_t checkedTexels = 0;
+        uint32_t mismatchedTexels = 0; // texels that differ by more than `tolerance` in any channel
+        uint32_t maxDiff = 0;          // largest difference in unorm steps
+    };
+
+    /** Compares a conemap read back from the GPU with the CPU reference.
+        \param[in] hmap The heightmap the conemap was generated from.
+        \param[in] coneData Raw texel data of an RG8Unorm or RG16Unorm conemap, tightly packed.
+        \param[in] bytesPerChannel 1 for RG8Unorm, 2 for RG16Unorm.
+        \param[in] sampleCount Number of texels to check, spread evenly over the texture. The
+                   exact cone of a texel can search the whole map, so checking every texel of a large map is slow.
+        \param[in] tolerance Allowed difference in unorm steps, covers the rounding of the
+                   float to unorm conversion and the GPU's approximate sqrt/division.
+    */
+    CompareResult compareConservativeConemap(const Heightmap& hmap, const std::vector<uint8_t>& coneData, uint32_t bytesPerChannel, uint32_t sampleCount, uint32_t tolerance = 1);
+
+    struct TightnessResult
+    {
+        uint32_t checkedTexels = 0;
+        uint32_t widerTexels = 0;   // texels whose cone is wider than the conservative cone by more than `tolerance`
+        double meanTightness = 0.0; // mean ratio of the cones and the conservative cones, over the texels with a nonzero conservative cone
+    };
+
+    /** Compares the cones of a conemap read back from the GPU, e.g. a quick one, with the conservative cones.
+        The parameters are the same as for compareConservativeConemap. A tightness of 1 means that the
+        cones are as wide as possible, wider texels are not safe for cone step mapping.
+    */
+    TightnessResult measureConeTightness(const Heightmap& hmap, const std::vector<uint8_t>& coneData, uint32_t bytesPerChannel, uint32_t sampleCount, uint32_t tolerance = 1);
+
+    struct TraversalCompareResult
+    {
+        uint32_t checkedRays = 0;
+        uint32_t mismatchedRays = 0;  // GPU result differs from CpuConemap::traceMaxMipmap
+        uint32_t referenceErrors = 0; // CpuConemap::traceMaxMipmap differs from CpuConemap::traceTexels
+        double meanSteps = 0.0;       // of CpuConemap::traceMaxMipmap
+        double meanTexels = 0.0;      // texels visited by CpuConemap::traceTexels
+    };
+
+    /** Compares the results of findIntersection_maxMipmap read back from the GPU with the CPU traversal (CpuConemap::traceMaxMipmap).
+        \param[in] mipmap The minmax mipmap read back from the GPU, see CpuConemap::buildMinmaxMipmap for the layout.
+        \param[in] gpuResults [t, last t, hit, step count] for every ray.
+        \param[in] tolerance Allowed difference of t.
+    */
+    TraversalCompareResult compareMaxMipmapTraversal(const CpuConemap::MinmaxPyramid& mipmap, const std::vector<CpuConemap::TraceRay>& rays, const std::vector<float>& gpuResults, uint32_t maxSteps, float tolerance = 1e-5f);
+}
@@ -26,6 +26,9 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #include "Parallax.h"
+#include "ConemapEncode.h"
+#include "ConemapMips.h"
+#include <random>
 
 struct Vertex
 {
@@ -48,6 +51,9 @@ namespace
         {1, "1: Parallax mapping"},
         {2, "2: Linear search"},
         {3, "3: Cone step mapping"},
+        {4, "4: Directional cone step mapping"},
+        {5, "5: Maximum mipmap traversal"},
+        {6, "6: Cone steps + max mipmap traversal"},
     };
     const char kRefinementFunDefine[] = "REFINE_FUN";
     const Gui::DropdownList kRefinementFunList = {
@@ -55,12 +61,35 @@ namespace
         {1, "1: Linear approx"},
         {2, "2: Binary search"},
     };
+    const char kSelfShadowDefine[] = "SELF_SHADOW";
+    const Gui::DropdownList kSelfShadowList = {
+        {0, "0: Off"},
+        {1, "1: Linear march"},
+        {2, "2: Cone traced"},
+    };
+    const uint32_t kMaxMinmaxLevels = 16; // size of dstMips in MinmaxSinglePass.cs.slang, up to 32K x 32K textures
     const char kHeightFunDefine[] = "HEIGHT_FUN";
     const Gui::DropdownList kHeightFunList = {
         {0, "Sinc"},
         {1, "Spheres"},
     };
     const char kConeTypeDefine[] = "CONE_TYPE";
+    const char kConeSectorsDefine[] = "CONE_SECTORS";
+    const Gui::DropdownList kConeSectorsList = {
+        {4, "4 sectors"},
+        {8, "8 sectors"},
+    };
+    const char kStepHistogramDefine[] = "STEP_HISTOGRAM";
+    const uint32_t kStepHistogramBins = 256; // kStepHistogramBins in Parallax.ps.slang
+    const std::string kStepStatsCounterPrefix = "parallax."; // Profiler counter names, '/' separates the lane name
+    const char kConemapPackedDefine[] = "CONEMAP_PACKED";
+    const Gui::DropdownList kConemapStorageList = {
+        {0, "RG"},
+        {1, "Packed R16"},
+        {2, "BC5"},
+    };
+    const char kConemapVirtualDefine[] = "CONEMAP_VIRTUAL";
+    const char kConeLodDefine[] = "CONE_LOD";
     const char kQuickGenAlgDefine[] = "QUICK_GEN_ALG";
     const char kDebugModeDefine[] = "DEBUG_MODE";
     const char kMaxAtTexelCenterDefine[] = "MAX_AT_TEXEL_CENTER";
@@ -70,6 +99,12 @@ namespace
         {2, "Min max"},
         {3, "Loaded albedo map"},
     };
+    const Gui::DropdownList kStepHeatmapList = {
+        {0, "Off"},
+        {1, "Primary search steps"},
+        {2, "Primary search + refinement steps"},
+        {3, "Self-shadow steps"},
+    };
     const Gui::DropdownList kDebugChannelList = {
         {0, "X RED"},
         {1, "Y GREEN"},
@@ -118,17 +153,23 @@ void Parallax::onGuiRender(Gui* pGui)
         w.separator();
         guiRenderSettings(mainGroup);
         w.separator();
+        guiStepHistogram(mainGroup);
+        w.separator();
         guiProceduralGeneration(mainGroup);
         w.separator();
         guiConemapGeneration(mainGroup);
         w.separator();
         guiQuickconemapGeneration(mainGroup);
         w.separator();
+        guiHeightmapEditing(mainGroup);
+        w.separator();
         guiLoadImage(mainGroup);
         w.separator();
         guiDebugRender(mainGroup);
         w.separator();
         guiSaveImage(mainGroup);
+        w.separator();
+        guiVirtualConemap(mainGroup);
 
         mainGroup.release();
     }
@@ -218,8 +259,29 @@ void Parallax::guiRenderSettings(Gui::Widgets& parent)
     w.tooltip("Step number for iterative primary searches", true);
     w.slider("Max refine step number", mRenderSettings.refineStepNum, 0U, 20U);
     w.tooltip("Step number for iterative refinement searches", true);
+    w.checkbox("Automatic refine step number", mRenderSettings.autoRefine);
+    w.tooltip("Cone step mapping (PARALLAX_FUN 3) with binary search refinement: measures how far the cone steps of the conemap can end past the surface,\n"
+        "then sets the smallest refine step number that finds the intersection within the tolerance. The measurement is an estimate, rare rays can end farther.\n"
+        "Needs Relax multiplier 1, no LOD and an RG conemap.", true);
+    if (mRenderSettings.autoRefine)
+    {
+        w.slider("Refine tolerance", mRenderSettings.refineTolerance, 1e-5f, 0.05f);
+        w.tooltip("Error of the refined intersection along the ray, in heightmap heights", true);
+        w.var("Overshoot search steps", mOvershootSearchSteps, 2u);
+        if (w.button("Measure overshoot")) mpOvershootConeTex.reset();
+        if (!mOvershootResult.empty()) w.text(mOvershootResult);
+    }
+    w.slider("Max traversal step number", mRenderSettings.traversalStepNum, 1U, 1024U);
+    w.tooltip("Cells visited by the maximum mipmap traversal that follows the cone steps (PARALLAX_FUN 6)", true);
     w.slider("Relax multiplier", mRenderSettings.relax, 1.0f, 8.0f);
     w.tooltip("Primary search step relaxation", true);
+    w.checkbox("LOD-aware cone stepping", mRenderSettings.coneLod);
+    w.tooltip("Cone step mapping (PARALLAX_FUN 3) on the conservative mipmap of the conemap, trilinearly sampled at the LOD of the pixel footprint,\n"
+        "which reads less memory per step. Needs an RG conemap, the mipmap is generated when the conemap changes.", true);
+    if (mRenderSettings.coneLod)
+    {
+        w.slider("LOD bias", mRenderSettings.coneLodBias, -2.0f, 4.0f);
+    }
     w.separator();
 
     if (w.dropdown(kParallaxFunDefine, kParallaxFunList, mRenderSettings.selectedParallaxFun)) {
@@ -228,6 +290,25 @@ void Parallax::guiRenderSettings(Gui::Widgets& parent)
     if (w.dropdown(kRefinementFunDefine, kRefinementFunList, mRenderSettings.selectedRefinementFun)) {
         mRenderSettings.setRefinementFun();
     }
+    if (w.dropdown(kSelfShadowDefine, kSelfShadowList, mRenderSettings.selfShadow)) {
+        mRenderSettings.setSelfShadow();
+    }
+    w.tooltip("Self-shadowing: a second ray from the intersection toward the light.\n"
+        "The cone traced march steps with the cones of the conemap and needs a conservative (not relaxed) conemap.", true);
+    if (mRenderSettings.selfShadow > 0)
+    {
+        w.slider("Max shadow step number", mRenderSettings.shadowStepNum, 1U, 256U);
+        w.tooltip("Step number of the linear march, step limit of the cone traced march", true);
+        w.slider("Shadow penumbra", mRenderSettings.shadowPenumbra, 0.0f, 0.2f);
+        w.tooltip("Tangent of the angular radius of the light, 0 for hard shadows", true);
+    }
+    w.var("Verified rays", mTraversalVerifyRayCount, 1u);
+    if (w.button("Verify max mipmap traversal against CPU reference") && mpHeightmapTex)
+    {
+        mRunTraversalVerify = true;
+    }
+    w.tooltip("Traces random rays with `PARALLAX_FUN 5` on the GPU and on the CPU (ConemapReference.h) and compares the hits.\nThe CPU traversal is also checked against a walk over every texel along the ray.");
+    if (!mTraversalVerifyResult.empty()) w.text(mTraversalVerifyResult);
     w.separator();
 
     w.text("Transformation");
@@ -237,6 +318,41 @@ void Parallax::guiRenderSettings(Gui::Widgets& parent)
     w.slider("Translate", mRenderSettings.translate, -1.f, 1.f);
     w.release();
 }
+void Parallax::guiStepHistogram(Gui::Widgets& parent)
+{
+    auto w = Gui::Group(parent, "Step Count Histogram");
+    if (!w.open())
+        return;
+    w.checkbox("Collect step statistics", mCollectStepStats);
+    w.tooltip("Counts the iterations of the primary search and the refinement for every pixel of every frame.\n"
+        "The results are also available as Profiler counters and as parallax.stepStats in Python.");
+    if (mStepStats.valid)
+    {
+        w.text("  pixels: " + std::to_string(mStepStats.pixelCount)
+            + "\n  steps mean: " + std::to_string(mStepStats.meanSteps) + ", max: " + std::to_string(mStepStats.maxSteps)
+            + "\n  refinement mean: " + std::to_string(mStepStats.meanRefineSteps) + ", max: " + std::to_string(mStepStats.maxRefineSteps)
+            + "\n  non-converged: " + std::to_string(mStepStats.nonConvergedRate * 100.f) + "%");
+    }
+    if (w.button("Capture step counts"))
+    {
+        mCaptureStepHistogram = true;
+    }
+    w.tooltip("Keeps the histogram of the primary search iterations of the next frame.\nThe previous capture is kept for comparison.");
+    auto showHistogram = [&w](const char label[], const StepHistogram& hist)
+    {
+        if (hist.pixelCount == 0)
+            return;
+        w.text(label + ": "_s + hist.name);
+        w.text("  pixels: " + std::to_string(hist.pixelCount) + ", mean: " + std::to_string(hist.mean)
+            + ", p50: " + std::to_string(hist.p50) + ", p99: " + std::to_string(hist.p99)
+            + "\n  non-converged: " + std::to_string(hist.nonConverged));
+        w.graph(label, [](void* pData, int32_t i) { return static_cast<const float*>(pData)[i]; },
+            const_cast<float*>(hist.bins.data()), (uint32_t)hist.bins.size(), 0, 0.f);
+    };
+    showHistogram("Last capture", mStepHistogram);
+    showHistogram("Previous capture", mPrevStepHistogram);
+    w.release();
+}
 void Parallax::guiProceduralGeneration(Gui::Widgets& parent)
 {
     auto w = Gui::Group(parent, "Procedural Heightmap Generation");
@@ -257,7 +373,9 @@ void Parallax::guiProceduralGeneration(Gui::Widgets& parent)
         mRunHeightmapCompute = true;
         mpParallaxProgram->addDefine("USE_ALBEDO_TEXTURE", "0");
         mpConeTex.reset();
+        mpDirConeTex.reset();
         mpMinmaxTex.reset();
+        mTiledCMState = {};
     }
     w.tooltip("Generates a Heightmap; deletes the Conemap");
     w.release();
@@ -267,6 +385,22 @@ void Parallax::guiConemapGeneration(Gui::Widgets& parent)
     auto w = Gui::Group(parent, "Conemap Generation from Heightmap");
     if (!w.open())
         return;
+    w.dropdown("Conemap storage", kConemapStorageList, mConemapStorage);
+    w.tooltip("Format of every generated Conemap, quick ones included\n"
+        "RG: R16Unorm or R8Unorm channels, see `16 bit texture`\n"
+        "Packed R16: 10 bit height and 6 bit square root of the cone ratio in one R16Uint channel, filtered in the shader\n"
+        "BC5: encoded on the CPU, the size has to be a multiple of 4\n"
+        "The cone ratios are rounded down, so the cones stay conservative.");
+    w.checkbox("Use conemap cache", mUseConemapCache);
+    w.tooltip("Generated Conemaps and minmax mipmaps are stored in\n" + ConemapCache::getCacheDirectory().string() +
+        "\nkeyed by the hash of the Heightmap and the generator settings, and loaded instead of generated the next time.");
+    if (w.button("Clear conemap cache", true))
+    {
+        ConemapCache::clear();
+        mConemapCacheResult = "";
+    }
+    if (!mConemapCacheResult.empty()) w.text(mConemapCacheResult);
+    w.separator();
     w.checkbox("16 bit texture##conemap", mCMCompSettings.newHmap16bit);
     w.tooltip("Checked: R16Unorm, unchecked: R8Unorm");
     if (w.button("Generate Conemap from Heightmap") && mpHeightmapTex && mpConemapCompute)
@@ -284,6 +418,82 @@ void Parallax::guiConemapGeneration(Gui::Widgets& parent)
         mCMCompSettings.name = "Relaxed Conemap";
     }
     w.tooltip("Single dispatch; might crash for larger textures.");
+    w.separator();
+
+    w.var("Tiled: destination tile size", mTiledCMSettings.dstTileSize, 16u, 16384u, 16u);
+    w.tooltip("Number of texels whose cone is updated by one dispatch");
+    w.var("Tiled: source tile size", mTiledCMSettings.srcTileSize, 1u, 16384u);
+    w.tooltip("Number of texels each thread compares against in one dispatch.\nThe cost of a dispatch is proportional to dst size * src size, keep it small enough to avoid a TDR.");
+    w.var("Tiled: dispatches per frame", mTiledCMSettings.passesPerFrame, 1u, 1024u);
+    if (w.button("Generate Conemap - tiled") && mpHeightmapTex && mpConemapTiledCompute)
+    {
+        mRunTiledConemapCompute = true;
+        mCMCompSettings.algorithm = "1";
+        mCMCompSettings.name = "Standard Conemap";
+    }
+    w.tooltip("Multiple dispatches over several frames; same result as the single dispatch version.");
+    if (w.button("Generate Relaxed Conemap - tiled", true) && mpHeightmapTex && mpConemapTiledCompute)
+    {
+        mRunTiledConemapCompute = true;
+        mCMCompSettings.algorithm = "2";
+        mCMCompSettings.name = "Relaxed Conemap";
+    }
+    w.tooltip("Multiple dispatches over several frames; same result as the single dispatch version.");
+    if (mTiledCMState.running)
+    {
+        const auto& st = mTiledCMState;
+        w.text("Tiled generation: " + std::to_string(st.nextPass) + " / " + std::to_string(st.passCount) + " dispatches");
+        if (w.button("Cancel tiled generation"))
+        {
+            mTiledCMState = {};
+        }
+    }
+    w.separator();
+
+    if (w.button("Generate Conemap - hierarchical") && mpHeightmapTex && mpConemapHierarchicalCompute)
+    {
+        mRunMinmaxCompute = true;
+        mRunHierarchicalConemapCompute = true;
+        mCMCompSettings.algorithm = "1";
+        mCMCompSettings.name = "Standard Conemap";
+    }
+    w.tooltip("Walks the minmax mipmap top-down and skips the blocks that cannot narrow the cone.\nSame result as the single dispatch version.");
+    if (w.button("Generate Relaxed Conemap - hierarchical", true) && mpHeightmapTex && mpConemapHierarchicalCompute)
+    {
+        mRunMinmaxCompute = true;
+        mRunHierarchicalConemapCompute = true;
+        mCMCompSettings.algorithm = "2";
+        mCMCompSettings.name = "Relaxed Conemap";
+    }
+    w.tooltip("Walks the minmax mipmap top-down and skips the blocks that cannot narrow the cone.\nSame result as the single dispatch version.");
+    if (!mHierarchicalResult.empty()) w.text(mHierarchicalResult);
+    w.separator();
+
+    w.dropdown("Cone sectors", kConeSectorsList, mConeSectors);
+    w.tooltip("Number of direction sectors with a separate cone");
+    if (w.button("Generate Directional Conemap") && mpHeightmapTex && mpConemapDirectionalCompute)
+    {
+        mRunMinmaxCompute = true;
+        mRunDirectionalConemapCompute = true;
+    }
+    w.tooltip("Standard cones for every sector of directions, stored in an RGBA16Unorm texture array.\nRendered by `PARALLAX_FUN 4`, the heights are still read from the texture in use.");
+    if (!mDirectionalResult.empty()) w.text(mDirectionalResult);
+    w.separator();
+
+    w.var("Verified texels", mVerifySampleCount, 1u);
+    w.tooltip("Number of texels checked, spread evenly over the texture.\nThe CPU reference is O(N) for each texel, so keep this low for large textures.");
+    if (w.button("Verify Conemap against CPU reference") && mpConeTex && mpHeightmapTex)
+    {
+        mRunConemapVerify = true;
+    }
+    w.tooltip("Reads back the Conemap and compares it with a CPU implementation of the standard (conservative) cone search.\nOnly meaningful for standard Conemaps.");
+    if (!mVerifyResult.empty()) w.text(mVerifyResult);
+    if (w.button("Verify conservative mipmap against CPU reference") && mpConeTex && canGenerateConemapMips(mpConeTex->getFormat()))
+    {
+        mRunConemapMipsVerify = true;
+    }
+    w.tooltip("Compares the conservative mipmap of the Conemap (see LOD-aware cone stepping) with its CPU port, checks the coarse texels against every texel of level 0 and the bilinear samples of every level against the finer level.\nThe tightness is the mean ratio of the coarse cones and their brute force cones.");
+    if (!mMipsVerifyResult.empty()) w.text(mMipsVerifyResult);
     w.release();
 }
 void Parallax::guiQuickconemapGeneration(Gui::Widgets& parent)
@@ -295,6 +505,14 @@ void Parallax::guiQuickconemapGeneration(Gui::Widgets& parent)
     w.tooltip("Checked: R16Unorm, unchecked: R8Unorm");
     w.checkbox("Max at texel centers", mQCMCompSettings.maxAtTexelCenter);
     w.tooltip("Texel center heuristic", true);
+    w.checkbox("Single pass minmax mipmap", mSinglePassMinmax);
+    w.tooltip("Checked: every level of the minmax mipmap is built by one dispatch\nUnchecked: one dispatch per level");
+    if (w.button("Verify single pass minmax mipmap") && mpMinmaxSinglePassCompute)
+    {
+        mRunMinmaxVerify = true;
+    }
+    w.tooltip("Builds the minmax mipmaps of random height maps of several sizes, non-power-of-two ones included, with both methods and compares every level.");
+    if (!mMinmaxVerifyResult.empty()) w.text(mMinmaxVerifyResult);
     if (w.button("Generate Quick Conemap - naive") && mpQuickConemapCompute)
     {
         mRunMinmaxCompute = true;
@@ -309,6 +527,50 @@ void Parallax::guiQuickconemapGeneration(Gui::Widgets& parent)
         mQCMCompSettings.algorithm = "2";
         mQCMCompSettings.name = "Quick Conemap"_s + (mQCMCompSettings.maxAtTexelCenter ? " + Center Heuristic" : "");
     }
+    const std::pair<const char*, const char*> ringAlgorithms[] = { { "3", "5x5" }, { "4", "7x7" }, { "5", "adaptive" } };
+    for (const auto& [algorithm, ring] : ringAlgorithms)
+    {
+        const std::string label = "Generate Quick Conemap - region growing "_s + ring;
+        if (w.button(label.c_str()) && mpQuickConemapCompute)
+        {
+            mRunMinmaxCompute = true;
+            mRunQuickConemapCompute = true;
+            mQCMCompSettings.algorithm = algorithm;
+            mQCMCompSettings.name = "Quick Conemap "_s + ring + (mQCMCompSettings.maxAtTexelCenter ? " + Center Heuristic" : "");
+        }
+    }
+    w.tooltip("Every level of the minmax mipmap is searched in a 5x5 or 7x7 ring of blocks instead of 3x3, giving tighter cones for a longer bake.\n"
+        "The adaptive ring starts at 3x3 and only grows (up to 7x7) while the next ring could still lower the cone.");
+    if (w.button("Measure tightness against brute force") && mpConeTex && mpHeightmapTex)
+    {
+        mRunTightnessMeasure = true;
+    }
+    w.tooltip("Reads back the Conemap and compares its cones with the standard (conservative) cones of a CPU brute force search on `Verified texels` texels.\n"
+        "The tightness is the mean ratio of the cones, wider cones are not safe.");
+    if (!mTightnessResult.empty()) w.text(mTightnessResult);
+    w.release();
+}
+void Parallax::guiHeightmapEditing(Gui::Widgets& parent)
+{
+    auto w = Gui::Group(parent, "Heightmap Editing");
+    if (!w.open())
+        return;
+    w.var("Brush center", mBrushSettings.center, 0.f, 65536.f, 1.f);
+    w.tooltip("In texels");
+    w.var("Brush radius", mBrushSettings.radius, 1.f, 4096.f, 1.f);
+    w.tooltip("In texels");
+    w.var("Brush height", mBrushSettings.height, -1.f, 1.f, 0.01f);
+    w.tooltip("Height added at the center of the brush");
+    w.checkbox("Incremental conemap update", mBrushSettings.incremental);
+    w.tooltip("Checked: only the cones that can be affected by the edit are recomputed\nUnchecked: the whole conemap is regenerated (hierarchical, standard cones)");
+    w.checkbox("Read back update statistics", mBrushSettings.readbackStats);
+    w.tooltip("Stalls the GPU to read back the number of recomputed cones");
+    if (w.button("Apply brush") && mpHeightmapTex)
+    {
+        mRunHeightmapBrush = true;
+    }
+    w.tooltip("Edits the Heightmap and updates the Minmax mipmap and the Conemap");
+    if (!mConemapUpdateResult.empty()) w.text(mConemapUpdateResult);
     w.release();
 }
 void Parallax::guiLoadImage(Gui::Widgets& parent)
@@ -317,6 +579,7 @@ void Parallax::guiLoadImage(Gui::Widgets& parent)
     if (!w.open())
         return;
     w.checkbox("Generate Mipmaps on Image Load", mGenerateMips);
+    w.tooltip("Box filtered mipmap for the heightmap and the albedo, conservative mipmap (ConemapMip.cs.slang) for RG conemaps");
     bool reloadHeightmap = false;
     if (w.button("Choose Height File"))
     {
@@ -324,6 +587,13 @@ void Parallax::guiLoadImage(Gui::Widgets& parent)
     }
     w.tooltip("Loads texture to Heightmap; deletes the Conemap");
 
+    bool reloadConemap = false;
+    if (w.button("Choose Conemap File"))
+    {
+        reloadConemap |= openFileDialog({}, mConemapName);
+    }
+    w.tooltip("Loads a baked cone map (e.g. written by ConemapBaker), [height, cone ratio] in the red and green channels");
+
     bool reloadAlbedo = false;
     if (w.button("Choose Albedo File"))
     {
@@ -343,6 +613,13 @@ void Parallax::guiLoadImage(Gui::Widgets& parent)
     {
         mHeightmapName = stripDataDirectories(mHeightmapName);
         LoadHeightmapTexture();
+        mLookupConemapCache = true;
+    }
+
+    if (reloadConemap && !mConemapName.empty())
+    {
+        mConemapName = stripDataDirectories(mConemapName);
+        LoadConemapTexture();
     }
 
     if (reloadAlbedo && !mAlbedoName.empty())
@@ -357,6 +634,13 @@ void Parallax::guiDebugRender(Gui::Widgets& parent)
     auto w = Gui::Group(parent, "Debug Texture View");
     if (!w.open())
         return;
+    w.dropdown("Step count heatmap", kStepHeatmapList, mDebugSettings.stepHeatmap);
+    w.tooltip("Overlays the iteration count of every pixel on the parallax rendering.");
+    if (mDebugSettings.stepHeatmap)
+    {
+        w.var("Heatmap max steps", mDebugSettings.stepHeatmapMax, 1u, 1024u);
+        w.slider("Heatmap opacity", mDebugSettings.stepHeatmapOpacity, 0.f, 1.f);
+    }
     bool changed = w.checkbox("Debug: draw texture", mDebugSettings.drawDebug);
     if (mDebugSettings.drawDebug)
     {
@@ -409,6 +693,39 @@ void Parallax::guiSaveImage(Gui::Widgets& parent)
     w.release();
 }
 
+void Parallax::guiVirtualConemap(Gui::Widgets& parent)
+{
+    auto w = Gui::Group(parent, "Virtual Conemap");
+    if (!w.open())
+        return;
+    w.var("Tile size", mVirtualSettings.tileSize, 16u, 1024u);
+    w.tooltip("Tile size of the written files");
+    w.checkbox("Write albedo tiles", mVirtualSettings.writeAlbedo);
+    w.tooltip("Writes the loaded albedo texture next to the conemap tiles");
+    if (w.button("Write conemap as tiled file") && mpConeTex) {
+        if (saveFileDialog({ {"ctile", "Tiled conemap"} }, mVirtualConemapName)) {
+            mWriteVirtualConemap = true;
+        }
+    }
+    w.tooltip("Writes the conemap as a tiled conemap file, like ConemapBaker --raw does");
+
+    w.var("Cache slots", mVirtualSettings.cacheSlots, 1u, 4096u);
+    w.tooltip("Tiles in the physical cache, applied when a file is loaded");
+    w.var("Max tile loads per frame", mVirtualSettings.maxLoadsPerFrame, 0u, 1024u);
+    w.tooltip("0: no limit. Applied when a file is loaded");
+    if (w.button("Load tiled conemap file")) {
+        mLoadVirtualConemap |= openFileDialog({ {"ctile", "Tiled conemap"} }, mVirtualConemapName);
+    }
+    if (mpVirtualConemap)
+    {
+        w.checkbox("Use virtual conemap", mUseVirtualConemap);
+        w.tooltip("Renders the tiled file instead of the conemap. Only the parallax functions that sample the conemap through getH/getHC support it (not the minmax or directional ones)");
+        w.text(mpVirtualConemap->getStatsString());
+    }
+    if (!mVirtualConemapResult.empty()) w.text(mVirtualConemapResult);
+    w.release();
+}
+
 void initSquare(Buffer::SharedPtr& pVB, Vao::SharedPtr& pVao)
 {
     sizeof(Vertex);
@@ -438,6 +755,10 @@ void Parallax::RenderSettings::setRefinementFun() {
     app.mpParallaxProgram->addDefine(kRefinementFunDefine, std::to_string(selectedRefinementFun));
 }
 
+void Parallax::RenderSettings::setSelfShadow() {
+    app.mpParallaxProgram->addDefine(kSelfShadowDefine, std::to_string(selfShadow));
+}
+
 void Parallax::onLoad(RenderContext* pRenderContext)
 {
     // parallax program
@@ -449,6 +770,12 @@ void Parallax::onLoad(RenderContext* pRenderContext)
         mpParallaxProgram = GraphicsProgram::create( d, {
             {kParallaxFunDefine, std::to_string(mRenderSettings.selectedParallaxFun )},
             {kRefinementFunDefine, std::to_string(mRenderSettings.selectedRefinementFun )},
+            {kSelfShadowDefine, std::to_string(mRenderSettings.selfShadow )},
+            {kConeSectorsDefine, std::to_string(mConeSectors)},
+            {kStepHistogramDefine, "0"},
+            {kConemapPackedDefine, "0"},
+            {kConemapVirtualDefine, "0"},
+            {kConeLodDefine, "0"},
             } );
     }
 
@@ -478,6 +805,36 @@ void Parallax::onLoad(RenderContext* pRenderContext)
     mpConemapCompute = ComputeProgramWrapper::create();
     mpConemapCompute->createProgram("Samples/Parallax/Conemap.cs.slang", "main", { {kConeTypeDefine, mCMCompSettings.algorithm} });
 
+    mpConemapTiledCompute = ComputeProgramWrapper::create();
+    mpConemapTiledCompute->createProgram("Samples/Parallax/Conemap.cs.slang", "mainTiled", { {kConeTypeDefine, mCMCompSettings.algorithm} });
+
+    mpConemapHierarchicalCompute = ComputeProgramWrapper::create();
+    mpConemapHierarchicalCompute->createProgram("Samples/Parallax/Conemap.cs.slang", "mainHierarchical", { {kConeTypeDefine, mCMCompSettings.algorithm} });
+
+    mpConeOvershootCompute = ComputeProgramWrapper::create();
+    mpConeOvershootCompute->createProgram("Samples/Parallax/Conemap.cs.slang", "mainOvershoot", { {kConeTypeDefine, "2"} });
+    mpOvershootReduction = ComputeParallelReduction::create();
+
+    mpTraversalVerifyCompute = ComputeProgramWrapper::create();
+    mpTraversalVerifyCompute->createProgram("Samples/Parallax/TraversalVerify.cs.slang", "mainVerify", { {kParallaxFunDefine, "5"}, {kRefinementFunDefine, "0"} });
+
+    mpConemapDirectionalCompute = ComputeProgramWrapper::create();
+    mpConemapDirectionalCompute->createProgram("Samples/Parallax/Conemap.cs.slang", "mainDirectional", { {kConeTypeDefine, "1"}, {kConeSectorsDefine, std::to_string(mConeSectors)} });
+
+    mpConemapUpdateBoundCompute = ComputeProgramWrapper::create();
+    mpConemapUpdateBoundCompute->createProgram("Samples/Parallax/Conemap.cs.slang", "updateBound", { {kConeTypeDefine, "1"} });
+
+    mpConemapUpdateCompute = ComputeProgramWrapper::create();
+    mpConemapUpdateCompute->createProgram("Samples/Parallax/Conemap.cs.slang", "mainUpdate", { {kConeTypeDefine, "1"} });
+    mpConemapUpdateArgs = Buffer::createStructured(mpConemapUpdateCompute->getProgram(), "updateArgs", 9,
+        ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess | ResourceBindFlags::IndirectArg, Buffer::CpuAccess::None, nullptr, false);
+
+    mpHeightmapBrushCompute = ComputeProgramWrapper::create();
+    mpHeightmapBrushCompute->createProgram("Samples/Parallax/HeightmapBrush.cs.slang");
+
+    mpConemapPackCompute = ComputeProgramWrapper::create();
+    mpConemapPackCompute->createProgram("Samples/Parallax/ConemapPack.cs.slang");
+
     mpTextureCopyCompute = ComputeProgramWrapper::create();
     mpTextureCopyCompute->createProgram( "Samples/Parallax/TextureCopy.cs.slang");
 
@@ -487,6 +844,20 @@ void Parallax::onLoad(RenderContext* pRenderContext)
     mpMinmaxMipmapCompute = ComputeProgramWrapper::create();
     mpMinmaxMipmapCompute->createProgram( "Samples/Parallax/Minmax.cs.slang", "mipmapMinmax" );
 
+    mpMinmaxRefitCopyCompute = ComputeProgramWrapper::create();
+    mpMinmaxRefitCopyCompute->createProgram("Samples/Parallax/Minmax.cs.slang", "copyFromScalarToVector");
+
+    mpMinmaxRefitMipmapCompute = ComputeProgramWrapper::create();
+    mpMinmaxRefitMipmapCompute->createProgram("Samples/Parallax/Minmax.cs.slang", "mipmapMinmax");
+
+    mpMinmaxSinglePassCompute = ComputeProgramWrapper::create();
+    mpMinmaxSinglePassCompute->createProgram("Samples/Parallax/MinmaxSinglePass.cs.slang");
+    const uint32_t zero = 0;
+    mpMinmaxSinglePassCompute->allocateStructuredBuffer("groupCounter", 1, &zero, sizeof(zero));
+
+    mpConemapMipCompute = ComputeProgramWrapper::create();
+    mpConemapMipCompute->createProgram("Samples/Parallax/ConemapMip.cs.slang", "mipmapConemap");
+
     mpQuickConemapCompute = ComputeProgramWrapper::create();
     mpQuickConemapCompute->createProgram("Samples/Parallax/QuickConemap.cs.slang", "main", {
         {kQuickGenAlgDefine, mQCMCompSettings.algorithm},
@@ -527,10 +898,18 @@ void Parallax::onLoad(RenderContext* pRenderContext)
     }
 
     mpParallaxVars[ "gSampler" ] = mpSampler;
+    mpStepHistogram = Buffer::createStructured(sizeof(uint32_t), kStepHistogramBins, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
+    mpParallaxVars["gStepHistogram"] = mpStepHistogram;
+    mpStepHistogramReadback = Buffer::create(kStepHistogramBins * sizeof(uint32_t), ResourceBindFlags::None, Buffer::CpuAccess::Read);
+    mpStepReduction = ComputeParallelReduction::create();
+    mpStepReductionResult = Buffer::create(3 * sizeof(uint4), ResourceBindFlags::None, Buffer::CpuAccess::Read);
+    mpStepStatsFence = GpuFence::create();
     mpDebugVars["gSampler"] = mpSamplerNearest;
 
     // other
     gpDevice->toggleVSync(true);
+    ScriptBindings::registerBinding([this](pybind11::module& m) { registerScriptBindings(m); });
+    Scripting::getDefaultContext().setObject("parallax", pybind11::cast(this, pybind11::return_value_policy::reference));
 
     // generate a conemap in the first frame
     mRunMinmaxCompute = true;
@@ -552,6 +931,30 @@ void Parallax::onFrameRender(RenderContext* pRenderContext, const Fbo::SharedPtr
             pCopiedTexture->captureToFile(0, 0, saveFilePath, Bitmap::FileFormat::ExrFile);
         }
     }
+    // virtual conemap files
+    if (mWriteVirtualConemap) {
+        mWriteVirtualConemap = false;
+        try {
+            VirtualConemap::write(mVirtualConemapName, mpConeTex, mVirtualSettings.writeAlbedo ? mpAlbedoTex : nullptr, mVirtualSettings.tileSize, pRenderContext);
+            mVirtualConemapResult = "Written: " + filenameFromPath(mVirtualConemapName);
+        }
+        catch (const std::exception& e) {
+            mVirtualConemapResult = std::string("Cannot write tiled conemap: ") + e.what();
+        }
+    }
+    if (mLoadVirtualConemap) {
+        mLoadVirtualConemap = false;
+        try {
+            mpVirtualConemap = VirtualConemap::create(mVirtualConemapName, mVirtualSettings.cacheSlots, mVirtualSettings.maxLoadsPerFrame, pRenderContext);
+            mUseVirtualConemap = true;
+            mVirtualConemapResult = "Loaded: " + filenameFromPath(mVirtualConemapName);
+        }
+        catch (const std::exception& e) {
+            mpVirtualConemap = nullptr;
+            mUseVirtualConemap = false;
+            mVirtualConemapResult = std::string("Cannot load tiled conemap: ") + e.what();
+        }
+    }
     // procedural heightmap generation
     if (mRunHeightmapCompute) {
         mRunHeightmapCompute = false;
@@ -561,23 +964,179 @@ void Parallax::onFrameRender(RenderContext* pRenderContext, const Fbo::SharedPtr
         mpParallaxVars["FScb"]["HMres"] = res;
         mpParallaxVars["FScb"]["HMres_r"] = 1.f / res;
     }
+    // cached quick conemap of a newly loaded heightmap
+    if (mLookupConemapCache) {
+        mLookupConemapCache = false;
+        if (loadCachedConemap(getCacheSettings(mQCMCompSettings), pRenderContext)) setConemapGenerator(mQCMCompSettings);
+    }
     // conemap or relaxed conemap generation
     if (mRunConemapCompute) {
         mRunConemapCompute = false;
-        mpConeTex = generateConemap(mCMCompSettings, mpHeightmapTex, pRenderContext);
+        const std::string cacheSettings = getCacheSettings(mCMCompSettings);
+        if (!loadCachedConemap(cacheSettings, pRenderContext)) {
+            mpConeTex = encodeConemap(generateConemap(mCMCompSettings, mpHeightmapTex, pRenderContext), pRenderContext);
+            mpParallaxVars["gTexture"] = mpConeTex;
+            storeCachedConemap(cacheSettings, false, pRenderContext);
+        }
+        setConemapGenerator(mCMCompSettings);
+    }
+    // tiled conemap or relaxed conemap generation
+    if (mRunTiledConemapCompute) {
+        mRunTiledConemapCompute = false;
+        if (loadCachedConemap(getCacheSettings(mCMCompSettings), pRenderContext))
+            setConemapGenerator(mCMCompSettings);
+        else
+            beginTiledConemap(mCMCompSettings, mpHeightmapTex, pRenderContext);
+    }
+    if (mTiledCMState.running && stepTiledConemap(pRenderContext, mTiledCMSettings.passesPerFrame)) {
+        mpConeTex = encodeConemap(mTiledCMState.pConemap, pRenderContext);
         mpParallaxVars["gTexture"] = mpConeTex;
+        storeCachedConemap(getCacheSettings(mTiledCMState.settings), false, pRenderContext);
+        setConemapGenerator(mTiledCMState.settings);
+        mTiledCMState = {};
+    }
+    // cached conemaps of the generators below come with the minmax mipmap
+    if (mRunHierarchicalConemapCompute && loadCachedConemap(getCacheSettings(mCMCompSettings), pRenderContext)) {
+        mRunHierarchicalConemapCompute = false;
+        setConemapGenerator(mCMCompSettings);
+        mRunMinmaxCompute = !mpMinmaxTex;
+    }
+    if (mRunQuickConemapCompute && loadCachedConemap(getCacheSettings(mQCMCompSettings), pRenderContext)) {
+        mRunQuickConemapCompute = false;
+        setConemapGenerator(mQCMCompSettings);
+        mRunMinmaxCompute = !mpMinmaxTex;
+    }
+    // the maximum mipmap traversals render from the minmax mipmap
+    const bool usesMinmax = mRenderSettings.selectedParallaxFun == 5 || mRenderSettings.selectedParallaxFun == 6;
+    if ((usesMinmax || mRunTraversalVerify) && !mpMinmaxTex && mpHeightmapTex) {
+        mRunMinmaxCompute = true;
     }
     // minmax mipmap for quick conemap generation
     if ( mRunMinmaxCompute )
     {
         mRunMinmaxCompute = false;
-        mpMinmaxTex = generateMinmaxMipmap(mpHeightmapTex, pRenderContext);
+        mpMinmaxTex = generateMinmaxMipmap(mpHeightmapTex, pRenderContext, mSinglePassMinmax);
+    }
+    // conemap or relaxed conemap generation with minmax mipmap culling
+    if (mRunHierarchicalConemapCompute) {
+        mRunHierarchicalConemapCompute = false;
+        HierarchicalConemapStats stats;
+        mpConeTex = encodeConemap(generateHierarchicalConemap(mCMCompSettings, mpHeightmapTex, mpMinmaxTex, pRenderContext, &stats), pRenderContext);
+        mpParallaxVars["gTexture"] = mpConeTex;
+        storeCachedConemap(getCacheSettings(mCMCompSettings), true, pRenderContext);
+        setConemapGenerator(mCMCompSettings);
+        // the brute force search tests every other texel
+        uint64_t texelCount = uint64_t(mpHeightmapTex->getWidth()) * mpHeightmapTex->getHeight();
+        double bruteForce = double(texelCount) * double(texelCount - 1);
+        mHierarchicalResult = mCMCompSettings.name + ": tested texels: " + std::to_string(stats.testedTexels)
+            + " (" + std::to_string(bruteForce > 0 ? 100.0 * double(stats.testedTexels) / bruteForce : 0.0) + "% of brute force)"
+            + ", visited minmax texels: " + std::to_string(stats.visitedNodes);
+        logInfo(mHierarchicalResult);
+    }
+    // directional conemap generation
+    if (mRunDirectionalConemapCompute) {
+        mRunDirectionalConemapCompute = false;
+        HierarchicalConemapStats stats;
+        mpDirConeTex = generateDirectionalConemap(mConeSectors, mpHeightmapTex, mpMinmaxTex, pRenderContext, &stats);
+        mpParallaxVars["gDirConeTexture"] = mpDirConeTex;
+        mpParallaxProgram->addDefine(kConeSectorsDefine, std::to_string(mConeSectors));
+        mDirectionalResult = "Directional Conemap, " + std::to_string(mConeSectors) + " sectors: tested texels: " + std::to_string(stats.testedTexels)
+            + ", visited minmax texels: " + std::to_string(stats.visitedNodes);
+        logInfo(mDirectionalResult);
     }
     // quick conemap generation
     if (mRunQuickConemapCompute) {
         mRunQuickConemapCompute = false;
-        mpConeTex = generateQuickConemap(mQCMCompSettings, mpMinmaxTex, pRenderContext);
+        mpConeTex = encodeConemap(generateQuickConemap(mQCMCompSettings, mpMinmaxTex, pRenderContext), pRenderContext);
         mpParallaxVars["gTexture"] = mpConeTex;
+        storeCachedConemap(getCacheSettings(mQCMCompSettings), true, pRenderContext);
+        setConemapGenerator(mQCMCompSettings);
+    }
+    // heightmap edit followed by an incremental conemap update
+    if (mRunHeightmapBrush) {
+        mRunHeightmapBrush = false;
+        PROFILE("heightmapEdit");
+        makeHeightmapEditable(pRenderContext);
+        mpHashedHeightmap.reset(); // edited in place
+        // the update needs the minmax mipmap of the heights before the edit
+        if (!mpMinmaxTex) mpMinmaxTex = generateMinmaxMipmap(mpHeightmapTex, pRenderContext, mSinglePassMinmax);
+        uint2 dirtyBegin, dirtyEnd;
+        applyHeightmapBrush(mBrushSettings, pRenderContext, dirtyBegin, dirtyEnd);
+        if (glm::any(glm::greaterThanEqual(dirtyBegin, dirtyEnd))) {
+            mConemapUpdateResult = "The brush is outside of the heightmap";
+        }
+        else {
+            ConemapUpdateStats stats;
+            // the update recomputes conservative cones and keeps the cones that are farther than they allow, relaxed conemaps are rebuilt
+            const bool relaxed = mConeTexGenerator.type == ConemapGenerator::Type::Conemap && mConeTexGenerator.conemap.algorithm != "1";
+            bool updated = mBrushSettings.incremental && mpConeTex && !relaxed
+                && updateConemap(mpConeTex, mpHeightmapTex, mpMinmaxTex, dirtyBegin, dirtyEnd, pRenderContext, mBrushSettings.readbackStats ? &stats : nullptr);
+            if (updated) {
+                mpConemapMipsTex.reset(); // only the first level is updated
+                mpOvershootConeTex.reset();
+                mConemapUpdateResult = "Incremental update";
+                if (mBrushSettings.readbackStats) {
+                    uint2 area = stats.updateEnd - stats.updateBegin;
+                    mConemapUpdateResult += ": tested " + std::to_string(area.x * area.y) + " texels, recomputed " + std::to_string(stats.updatedTexels) + " cones";
+                }
+            }
+            else {
+                mpMinmaxTex = generateMinmaxMipmap(mpHeightmapTex, pRenderContext, mSinglePassMinmax);
+                if (mpConeTex) {
+                    // rebuild with the generator of the conemap, the ones loaded from file as standard conemaps
+                    if (mConeTexGenerator.type == ConemapGenerator::Type::Quick) {
+                        mpConeTex = encodeConemap(generateQuickConemap(mConeTexGenerator.quick, mpMinmaxTex, pRenderContext), pRenderContext);
+                        mConemapUpdateResult = "Full rebuild: " + mConeTexGenerator.quick.name;
+                    }
+                    else {
+                        if (mConeTexGenerator.type == ConemapGenerator::Type::Unknown) {
+                            ConemapComputeSettings settings = mCMCompSettings;
+                            settings.algorithm = "1";
+                            settings.name = "Standard Conemap";
+                            setConemapGenerator(settings);
+                        }
+                        mpConeTex = encodeConemap(generateHierarchicalConemap(mConeTexGenerator.conemap, mpHeightmapTex, mpMinmaxTex, pRenderContext), pRenderContext);
+                        mConemapUpdateResult = "Full rebuild: " + mConeTexGenerator.conemap.name;
+                    }
+                    mpParallaxVars["gTexture"] = mpConeTex;
+                }
+                else {
+                    mpParallaxVars["gTexture"] = mpHeightmapTex;
+                    mConemapUpdateResult = "No conemap to update";
+                }
+            }
+            // the minmax mipmap holds the new heights in both cases
+            if (mpDirConeTex) {
+                mpDirConeTex = generateDirectionalConemap(mpDirConeTex->getArraySize() * 4, mpHeightmapTex, mpMinmaxTex, pRenderContext);
+                mpParallaxVars["gDirConeTexture"] = mpDirConeTex;
+            }
+        }
+    }
+    // compare the conemap with the CPU reference
+    if (mRunConemapVerify) {
+        mRunConemapVerify = false;
+        mVerifyResult = verifyConemap(mpConeTex, mpHeightmapTex, pRenderContext);
+        logInfo(mVerifyResult);
+    }
+    if (mRunTightnessMeasure) {
+        mRunTightnessMeasure = false;
+        mTightnessResult = measureConemapTightness(mpConeTex, mpHeightmapTex, pRenderContext);
+        logInfo(mTightnessResult);
+    }
+    if (mRunConemapMipsVerify) {
+        mRunConemapMipsVerify = false;
+        mMipsVerifyResult = verifyConemapMips(mpConeTex, pRenderContext);
+        logInfo(mMipsVerifyResult);
+    }
+    if (mRunMinmaxVerify) {
+        mRunMinmaxVerify = false;
+        mMinmaxVerifyResult = verifySinglePassMinmax(pRenderContext);
+        logInfo(mMinmaxVerifyResult);
+    }
+    if (mRunTraversalVerify) {
+        mRunTraversalVerify = false;
+        mTraversalVerifyResult = verifyMaxMipmapTraversal(mpMinmaxTex, pRenderContext);
+        logInfo(mTraversalVerifyResult);
     }
 
     // camera
@@ -601,10 +1160,47 @@ void Parallax::onFrameRender(RenderContext* pRenderContext, const Fbo::SharedPtr
         mpParallaxVars[ "FScb" ][ "displayNonConverged" ] = mRenderSettings.displayNonConverged;
         mpParallaxVars[ "FScb" ][ "lightIntensity" ] = mRenderSettings.lightIntensity;
         mpParallaxVars[ "FScb" ][ "steps" ] = mRenderSettings.stepNum;
+        {
+            // the binary search only has to cover the overshoot of the cone steps, known for the conemap in use
+            const bool autoRefine = mRenderSettings.autoRefine && mRenderSettings.selectedParallaxFun == 3 && mRenderSettings.selectedRefinementFun == 2
+                && mRenderSettings.relax == 1.0f && !mRenderSettings.coneLod && mpConeTex && mpParallaxVars["gTexture"].getTexture() == mpConeTex;
+            if (autoRefine && mpOvershootConeTex.lock() != mpConeTex)
+            {
+                mConeOvershoot = measureConeOvershoot(mpConeTex, mpHeightmapTex, pRenderContext);
+                mpOvershootConeTex = mpConeTex;
+                mOvershootResult = mConeOvershoot < 0 ? "Overshoot: needs an RG conemap and its heightmap" : "Overshoot: " + std::to_string(mConeOvershoot);
+                logInfo(mOvershootResult);
+            }
+            float refineOvershoot = 1.0f;
+            if (autoRefine && mConeOvershoot >= 0)
+            {
+                // the steps also go up to a texel (w in findIntersection_coneStepMapping) past the cones
+                refineOvershoot = std::min(mConeOvershoot + 1.0f / mpConeTex->getWidth(), 1.0f);
+                mRenderSettings.refineStepNum = getAutoRefineStepNum(refineOvershoot, mRenderSettings.refineTolerance);
+            }
+            mpParallaxVars["FScb"]["refineOvershoot"] = refineOvershoot;
+        }
         mpParallaxVars[ "FScb" ][ "refine_steps" ] = mRenderSettings.refineStepNum;
         mpParallaxVars[ "FScb" ][ "relax" ] = mRenderSettings.relax;
         mpParallaxVars[ "FScb" ][ "oneOverSteps" ] = 1.0f / mRenderSettings.stepNum;
+        mpParallaxVars[ "FScb" ][ "traversalSteps" ] = mRenderSettings.traversalStepNum;
+        mpParallaxVars[ "FScb" ][ "shadowSteps" ] = mRenderSettings.shadowStepNum;
+        mpParallaxVars[ "FScb" ][ "shadowPenumbra" ] = mRenderSettings.shadowPenumbra;
         mpParallaxVars[ "FScb" ][ "const_isolate" ] = 1;
+        mpParallaxVars[ "FScb" ][ "stepHeatmap" ] = mDebugSettings.stepHeatmap;
+        mpParallaxVars[ "FScb" ][ "stepHeatmapMax" ] = mDebugSettings.stepHeatmapMax;
+        mpParallaxVars[ "FScb" ][ "stepHeatmapOpacity" ] = mDebugSettings.stepHeatmapOpacity;
+        {
+            // packed conemaps are decoded and filtered in the shader
+            const auto& pTex = mpParallaxVars["gTexture"].getTexture();
+            const bool packed = pTex && pTex->getFormat() == ResourceFormat::R16Uint;
+            mpParallaxProgram->addDefine(kConemapPackedDefine, packed ? "1" : "0");
+        }
+        if (mpMinmaxTex)
+        {
+            mpParallaxVars["gMinmaxTexture"] = mpMinmaxTex;
+            mpParallaxVars["FScb"]["minmaxTopLevel"] = mpMinmaxTex->getMipCount() - 1;
+        }
 
         mpParallaxVars[ "VScb" ][ "viewProj" ] = mpCamera->getViewProjMatrix();
         float4x4 m = glm::translate( glm::mat4(), mRenderSettings.translate ); ;
@@ -613,7 +1209,64 @@ void Parallax::onFrameRender(RenderContext* pRenderContext, const Fbo::SharedPtr
         mpParallaxVars[ "VScb" ][ "model" ] = m;
         mpParallaxVars[ "VScb" ][ "modelIT" ] = glm::inverse( glm::transpose( m ) );
 
+        const bool useVirtual = mUseVirtualConemap && mpVirtualConemap;
+        mpParallaxProgram->addDefine(kConemapVirtualDefine, useVirtual ? "1" : "0");
+        if (useVirtual)
+        {
+            float2 res = float2(mpVirtualConemap->getSize());
+            mpParallaxVars["FScb"]["HMres"] = res;
+            mpParallaxVars["FScb"]["HMres_r"] = 1.f / res;
+            mpVirtualConemap->beginFrame(mpParallaxVars, pRenderContext);
+            mVirtualConemapBound = true;
+        }
+        else if (mVirtualConemapBound)
+        {
+            // back to the size of the bound texture
+            mVirtualConemapBound = false;
+            if (const auto& pTex = mpParallaxVars["gTexture"].getTexture())
+            {
+                float2 res = float2(pTex->getWidth(), pTex->getHeight());
+                mpParallaxVars["FScb"]["HMres"] = res;
+                mpParallaxVars["FScb"]["HMres_r"] = 1.f / res;
+            }
+        }
+
+        // LOD-aware cone stepping samples the conservative mipmap of the conemap
+        const auto& pBoundTex = mpParallaxVars["gTexture"].getTexture();
+        const bool coneLod = mRenderSettings.coneLod && mRenderSettings.selectedParallaxFun == 3 && !useVirtual
+            && mpConeTex && pBoundTex == mpConeTex && canGenerateConemapMips(mpConeTex->getFormat());
+        if (coneLod && mpConemapMipsTex.lock() != mpConeTex)
+        {
+            mpConeTex = generateConemapMips(mpConeTex, pRenderContext);
+            mpConemapMipsTex = mpConeTex;
+            mpParallaxVars["gTexture"] = mpConeTex;
+        }
+        mpParallaxProgram->addDefine(kConeLodDefine, coneLod ? "1" : "0");
+        mpParallaxVars["FScb"]["coneLodMaxLevel"] = coneLod ? mpConeTex->getMipCount() - 1 : 0u;
+        mpParallaxVars["FScb"]["coneLodBias"] = mRenderSettings.coneLodBias;
+
+        // the statistics of the previous frame are read before the buffers are reused
+        readStepStats();
+        const bool collectSteps = mCollectStepStats || mCaptureStepHistogram;
+        if (collectSteps)
+        {
+            beginStepStats(pRenderContext, uint2(pTargetFbo->getWidth(), pTargetFbo->getHeight()));
+        }
+        else if (mStepStatsDefineSet)
+        {
+            mStepStatsDefineSet = false;
+            mpParallaxProgram->addDefine(kStepHistogramDefine, "0");
+        }
         pRenderContext->draw( mpParallaxRenderState.get(), mpParallaxVars.get(), arraysize( kVertices ), 0 );
+        if (useVirtual)
+        {
+            mpVirtualConemap->endFrame(pRenderContext);
+        }
+        if (collectSteps)
+        {
+            endStepStats(pRenderContext, mCaptureStepHistogram);
+            mCaptureStepHistogram = false;
+        }
     }
     else
     {
@@ -693,13 +1346,55 @@ void Parallax::LoadHeightmapTexture()
     mpHeightmapTex = Texture::createFromFile(mHeightmapName, mGenerateMips, false);
     mpHeightmapTex->setName(filenameFromPath(mHeightmapName));
     mpConeTex.reset();
+    mpDirConeTex.reset();
     mpMinmaxTex.reset();
+    mTiledCMState = {};
     mpParallaxVars["gTexture"] = mpHeightmapTex;
     float2 res = float2(mpHeightmapTex->getWidth(), mpHeightmapTex->getHeight());
     mpParallaxVars["FScb"]["HMres"] = res;
     mpParallaxVars["FScb"]["HMres_r"] = 1.f / res;
 }
 
+void Parallax::LoadConemapTexture()
+{
+    mpConeTex = Texture::createFromFile(mConemapName, false, false);
+    mpConeTex->setName(filenameFromPath(mConemapName));
+    if (mGenerateMips)
+    {
+        // box filtered mips would break the cone guarantee, build the conservative mipmap instead
+        if (auto pMips = generateConemapMips(mpConeTex, gpDevice->getRenderContext()))
+        {
+            mpConeTex = pMips;
+            mpConemapMipsTex = mpConeTex;
+        }
+        else
+        {
+            mpConeTex = Texture::createFromFile(mConemapName, true, false);
+            mpConeTex->setName(filenameFromPath(mConemapName));
+        }
+    }
+    mTiledCMState = {};
+    mConeTexGenerator = {};
+    mpParallaxVars["gTexture"] = mpConeTex;
+    float2 res = float2(mpConeTex->getWidth(), mpConeTex->getHeight());
+    mpParallaxVars["FScb"]["HMres"] = res;
+    mpParallaxVars["FScb"]["HMres_r"] = 1.f / res;
+}
+
+void Parallax::setConemapGenerator(const ConemapComputeSettings& settings)
+{
+    mConeTexGenerator = {};
+    mConeTexGenerator.type = ConemapGenerator::Type::Conemap;
+    mConeTexGenerator.conemap = settings;
+}
+
+void Parallax::setConemapGenerator(const QuickConemapComputeSettings& settings)
+{
+    mConeTexGenerator = {};
+    mConeTexGenerator.type = ConemapGenerator::Type::Quick;
+    mConeTexGenerator.quick = settings;
+}
+
 void Parallax::LoadAlbedoTexture()
 {
     mpAlbedoTex = Texture::createFromFile( mAlbedoName, mGenerateMips, true );
@@ -758,12 +1453,597 @@ Texture::SharedPtr Parallax::generateConemap(const ConemapComputeSettings& setti
     return pTex;
 }
 
-Texture::SharedPtr Parallax::generateMinmaxMipmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const
+void Parallax::beginTiledConemap(const ConemapComputeSettings& settings, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext)
+{
+    mTiledCMState = {};
+    if (!mpConemapTiledCompute || !pHeightmap)
+        return;
+    auto& st = mTiledCMState;
+    auto w = pHeightmap->getWidth();
+    auto h = pHeightmap->getHeight();
+    ResourceFormat format = settings.newHmap16bit ? ResourceFormat::RG16Unorm : ResourceFormat::RG8Unorm;
+    st.pConemap = Texture::create2D(w, h, format, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+    st.pConemap->setName(settings.name + " (tiled)");
+    st.pMinTan = Texture::create2D(w, h, ResourceFormat::R32Float, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+    pRenderContext->clearUAV(st.pMinTan->getUAV(0).get(), float4(1.0f));
+
+    uint2 maxSize = { w, h };
+    st.settings = settings;
+    st.pHeightmap = pHeightmap;
+    st.dstTileSize = glm::max(mTiledCMSettings.dstTileSize, uint2(1));
+    st.srcTileSize = glm::max(mTiledCMSettings.srcTileSize, uint2(1));
+    st.dstTileCount = div_round_up(maxSize, st.dstTileSize);
+    st.srcTileCount = div_round_up(maxSize, st.srcTileSize);
+    st.passCount = st.dstTileCount.x * st.dstTileCount.y * st.srcTileCount.x * st.srcTileCount.y;
+    st.nextPass = 0;
+    st.running = true;
+
+    auto& comp = *mpConemapTiledCompute;
+    comp.getProgram()->addDefine(kConeTypeDefine, settings.algorithm);
+}
+
+bool Parallax::stepTiledConemap(RenderContext* pRenderContext, uint32_t maxPasses)
+{
+    auto& st = mTiledCMState;
+    if (!st.running)
+        return false;
+    auto& comp = *mpConemapTiledCompute;
+    uint2 maxSize = { st.pHeightmap->getWidth(), st.pHeightmap->getHeight() };
+
+    comp["heightMap"].setSrv(st.pHeightmap->getSRV());
+    comp["CScb"]["srcLevel"] = 0;
+    comp["gSampler"] = mpSampler;
+    comp["coneMap"].setUav(st.pConemap->getUAV(0));
+    comp["minTanMap"].setUav(st.pMinTan->getUAV(0));
+    comp["CScb"]["maxSize"] = maxSize;
+    comp["CScb"]["oneOverMaxSize"] = 1.0f / float2(maxSize);
+    comp["CScb"]["searchSteps"] = st.settings.relaxedConeSearchSteps;
+    comp["CScb"]["oneOverSearchSteps"] = 1.0f / st.settings.relaxedConeSearchSteps;
+
+    // destination tile major order: a destination tile is finished before the next one is started
+    const uint32_t srcTilesPerDst = st.srcTileCount.x * st.srcTileCount.y;
+    for (uint32_t i = 0; i < maxPasses && st.nextPass < st.passCount; ++i, ++st.nextPass)
+    {
+        uint32_t dstTile = st.nextPass / srcTilesPerDst;
+        uint32_t srcTile = st.nextPass % srcTilesPerDst;
+        uint2 dstOffset = uint2(dstTile % st.dstTileCount.x, dstTile / st.dstTileCount.x) * st.dstTileSize;
+        uint2 srcBegin = uint2(srcTile % st.srcTileCount.x, srcTile / st.srcTileCount.x) * st.srcTileSize;
+        uint2 srcEnd = glm::min(srcBegin + st.srcTileSize, maxSize);
+        uint2 dstSize = glm::min(dstOffset + st.dstTileSize, maxSize) - dstOffset;
+
+        comp["CScb"]["dstOffset"] = dstOffset;
+        comp["CScb"]["srcBegin"] = srcBegin;
+        comp["CScb"]["srcEnd"] = srcEnd;
+        comp.runProgram(pRenderContext, dstSize.x, dstSize.y, 1);
+    }
+    return st.nextPass == st.passCount;
+}
+
+std::string Parallax::verifyConemap(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const
+{
+    if (!pConemap || !pHeightmap)
+        return "Verify: missing texture";
+    uint32_t w = pHeightmap->getWidth();
+    uint32_t h = pHeightmap->getHeight();
+    ResourceFormat format = pConemap->getFormat();
+    if (pConemap->getWidth() != w || pConemap->getHeight() != h)
+        return "Verify: the Conemap and the Heightmap sizes differ";
+    if (format != ResourceFormat::RG16Unorm && format != ResourceFormat::RG8Unorm)
+        return "Verify: unsupported Conemap format " + to_string(format);
+
+    ConemapReference::Heightmap hmap = readbackHeightmap(pHeightmap, pRenderContext);
+    std::vector<uint8_t> coneData = pRenderContext->readTextureSubresource(pConemap.get(), 0);
+    uint32_t bytesPerChannel = getFormatBytesPerBlock(format) / 2;
+
+    auto res = ConemapReference::compareConservativeConemap(hmap, coneData, bytesPerChannel, mVerifySampleCount);
+    return "Verify: " + std::to_string(res.mismatchedTexels) + " of " + std::to_string(res.checkedTexels) +
+        " texels differ, max difference: " + std::to_string(res.maxDiff) + " unorm steps";
+}
+
+std::string Parallax::measureConemapTightness(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const
+{
+    if (!pConemap || !pHeightmap)
+        return "Tightness: missing texture";
+    ResourceFormat format = pConemap->getFormat();
+    if (pConemap->getWidth() != pHeightmap->getWidth() || pConemap->getHeight() != pHeightmap->getHeight())
+        return "Tightness: the Conemap and the Heightmap sizes differ";
+    if (format != ResourceFormat::RG16Unorm && format != ResourceFormat::RG8Unorm)
+        return "Tightness: unsupported Conemap format " + to_string(format);
+
+    ConemapReference::Heightmap hmap = readbackHeightmap(pHeightmap, pRenderContext);
+    std::vector<uint8_t> coneData = pRenderContext->readTextureSubresource(pConemap.get(), 0);
+    uint32_t bytesPerChannel = getFormatBytesPerBlock(format) / 2;
+
+    auto res = ConemapReference::measureConeTightness(hmap, coneData, bytesPerChannel, mVerifySampleCount);
+    return "Tightness: " + std::to_string(res.meanTightness) + " of the brute force cones, " + std::to_string(res.widerTexels) + " of " +
+        std::to_string(res.checkedTexels) + " texels are wider";
+}
+
+ConemapReference::Heightmap Parallax::readbackHeightmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const
+{
+    // read back the heights as floats, this is exactly what the compute shaders see
+    const uint32_t w = pHeightmap->getWidth();
+    const uint32_t h = pHeightmap->getHeight();
+    auto pFloatTex = Texture::create2D(w, h, ResourceFormat::R32Float, 1, 1, nullptr, ResourceBindFlags::RenderTarget);
+    pRenderContext->blit(pHeightmap->getSRV(0, 1), pFloatTex->getRTV());
+    std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pFloatTex.get(), 0);
+    ConemapReference::Heightmap hmap;
+    hmap.width = w;
+    hmap.height = h;
+    hmap.texels.resize(size_t(w) * h);
+    std::memcpy(hmap.texels.data(), data.data(), hmap.texels.size() * sizeof(float));
+    return hmap;
+}
+
+std::string Parallax::verifyConemapMips(const Texture::SharedPtr& pConemap, RenderContext* pRenderContext) const
+{
+    if (!pConemap || !canGenerateConemapMips(pConemap->getFormat()))
+        return "Verify mipmap: missing or unsupported Conemap";
+    Texture::SharedPtr pMips = mpConemapMipsTex.lock() == pConemap ? pConemap : generateConemapMips(pConemap, pRenderContext);
+    if (!pMips)
+        return "Verify mipmap: the mipmap could not be generated";
+
+    // read back every level as floats, the same values the shaders sample
+    std::vector<CpuConemap::Conemap> levels;
+    for (uint32_t level = 0; level < pMips->getMipCount(); ++level)
+    {
+        CpuConemap::Conemap lvl;
+        lvl.width = pMips->getWidth(level);
+        lvl.height = pMips->getHeight(level);
+        auto pFloatTex = Texture::create2D(lvl.width, lvl.height, ResourceFormat::RG32Float, 1, 1, nullptr, ResourceBindFlags::RenderTarget);
+        pRenderContext->blit(pMips->getSRV(level, 1), pFloatTex->getRTV());
+        std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pFloatTex.get(), 0);
+        lvl.texels.resize(size_t(lvl.width) * lvl.height * 2);
+        std::memcpy(lvl.texels.data(), data.data(), lvl.texels.size() * sizeof(float));
+        levels.push_back(std::move(lvl));
+    }
+
+    // the CPU port starts from the same level 0, its levels should match up to the GPU's rounding
+    const uint32_t coneBits = getNumChannelBits(pMips->getFormat(), 1);
+    const float coneQuantum = getFormatType(pMips->getFormat()) == FormatType::Unorm ? 1.0f / float((1ull << coneBits) - 1) : 0.0f;
+    const std::vector<CpuConemap::Conemap> reference = CpuConemap::buildConservativeMips(levels[0], coneQuantum);
+    float maxDiff = 0.0f;
+    for (size_t level = 1; level < levels.size(); ++level)
+        for (size_t i = 0; i < levels[level].texels.size(); ++i)
+            maxDiff = std::max(maxDiff, std::abs(levels[level].texels[i] - reference[level].texels[i]));
+
+    auto res = CpuConemap::checkConservativeMips(levels, mVerifySampleCount, std::max(coneQuantum, 1e-5f));
+    std::string result = "Verify mipmap: " + std::to_string(levels.size()) + " levels, max difference from the CPU port: " + std::to_string(maxDiff);
+    if (coneQuantum > 0) result += " (" + std::to_string(maxDiff / coneQuantum) + " unorm steps)";
+    return result + "\n" + std::to_string(res.heightViolations) + " height and " + std::to_string(res.coneViolations) + " cone violations of " +
+        std::to_string(res.checkedTexels) + " texels, mean tightness: " + std::to_string(res.meanTightness) + "\n" +
+        std::to_string(res.filterViolations) + " filtering violations of " + std::to_string(res.checkedSamples) + " samples";
+}
+
+std::string Parallax::verifyMaxMipmapTraversal(const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext) const
+{
+    if (!pMinmaxMipmap)
+        return "Verify traversal: missing minmax mipmap";
+
+    // read back every level, so the GPU and the CPU traverse the same heights
+    CpuConemap::MinmaxPyramid mipmap;
+    for (uint32_t level = 0; level < pMinmaxMipmap->getMipCount(); ++level)
+    {
+        CpuConemap::MinmaxPyramid::Level lvl;
+        lvl.width = pMinmaxMipmap->getWidth(level);
+        lvl.height = pMinmaxMipmap->getHeight(level);
+        std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pMinmaxMipmap.get(), pMinmaxMipmap->getSubresourceIndex(0, level));
+        lvl.texels.resize(size_t(lvl.width) * lvl.height * 2);
+        const uint16_t* pTexels = reinterpret_cast<const uint16_t*>(data.data());
+        for (size_t i = 0; i < lvl.texels.size(); ++i) lvl.texels[i] = pTexels[i] / 65535.f;
+        mipmap.levels.push_back(std::move(lvl));
+    }
+
+    // random rays, from steep ones to grazing ones that cross the whole texture
+    const uint32_t rayCount = std::max(mTraversalVerifyRayCount, 1u);
+    std::vector<CpuConemap::TraceRay> rays(rayCount);
+    std::vector<float4> rayData(rayCount);
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> uni(0.f, 1.f);
+    for (uint32_t i = 0; i < rayCount; ++i)
+    {
+        float2 u = float2(uni(rng), uni(rng));
+        float angle = 2 * glm::pi<float>() * uni(rng);
+        float2 u2 = u + 2.f * uni(rng) * float2(std::cos(angle), std::sin(angle));
+        rays[i] = { { u.x, u.y }, { u2.x, u2.y } };
+        rayData[i] = float4(u, u2);
+    }
+
+    auto& comp = *mpTraversalVerifyCompute;
+    const float2 res = float2(pMinmaxMipmap->getWidth(), pMinmaxMipmap->getHeight());
+    comp.allocateStructuredBuffer("rays", rayCount, rayData.data(), rayData.size() * sizeof(float4));
+    comp.allocateStructuredBuffer("hits", rayCount);
+    comp["gMinmaxTexture"].setSrv(pMinmaxMipmap->getSRV());
+    comp["CScb"]["rayCount"] = rayCount;
+    comp["FScb"]["HMres"] = res;
+    comp["FScb"]["HMres_r"] = 1.f / res;
+    comp["FScb"]["steps"] = mRenderSettings.stepNum;
+    comp["FScb"]["minmaxTopLevel"] = pMinmaxMipmap->getMipCount() - 1;
+    comp.runProgram(pRenderContext, rayCount, 1, 1);
+
+    std::vector<float> gpuResults(size_t(rayCount) * 4);
+    const float4* pHits = comp.mapBuffer<const float4>("hits");
+    std::memcpy(gpuResults.data(), pHits, gpuResults.size() * sizeof(float));
+    comp.unmapBuffer("hits");
+
+    auto cmp = ConemapReference::compareMaxMipmapTraversal(mipmap, rays, gpuResults, mRenderSettings.stepNum);
+    return "Verify traversal: " + std::to_string(cmp.mismatchedRays) + " of " + std::to_string(cmp.checkedRays) + " rays differ, reference errors: "
+        + std::to_string(cmp.referenceErrors) + "\n  mean steps: " + std::to_string(cmp.meanSteps) + " (texel walk: " + std::to_string(cmp.meanTexels) + ")";
+}
+
+Texture::SharedPtr Parallax::generateHierarchicalConemap(const ConemapComputeSettings& settings, const Texture::SharedPtr& pHeightmap, const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext, HierarchicalConemapStats* pStats) const
+{
+    if (!mpConemapHierarchicalCompute || !pHeightmap || !pMinmaxMipmap)
+        return nullptr;
+    auto& comp = *mpConemapHierarchicalCompute;
+    auto w = pHeightmap->getWidth();
+    auto h = pHeightmap->getHeight();
+    ResourceFormat format = settings.newHmap16bit ? ResourceFormat::RG16Unorm : ResourceFormat::RG8Unorm;
+    auto pTex = Texture::create2D(w, h, format, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+    pTex->setName(settings.name + " (hierarchical)");
+    comp.getProgram()->addDefine(kConeTypeDefine, settings.algorithm);
+
+    const uint32_t zeros[4] = { 0, 0, 0, 0 };
+    comp.allocateStructuredBuffer("visitedCounter", 4, zeros, sizeof(zeros));
+    comp["heightMap"].setSrv(pHeightmap->getSRV());
+    comp["minmaxMap"].setSrv(pMinmaxMipmap->getSRV());
+    comp["gSampler"] = mpSampler;
+    comp["coneMap"].setUav(pTex->getUAV(0));
+    uint2 maxSize = { w, h };
+    comp["CScb"]["srcLevel"] = 0;
+    comp["CScb"]["maxSize"] = maxSize;
+    comp["CScb"]["oneOverMaxSize"] = 1.0f / float2(maxSize);
+    comp["CScb"]["searchSteps"] = settings.relaxedConeSearchSteps;
+    comp["CScb"]["oneOverSearchSteps"] = 1.0f / settings.relaxedConeSearchSteps;
+    comp["CScb"]["topLevel"] = pMinmaxMipmap->getMipCount() - 1;
+    comp.runProgram(pRenderContext, w, h, 1);
+
+    if (pStats)
+    {
+        const uint32_t* pCounters = comp.mapBuffer<const uint32_t>("visitedCounter");
+        pStats->testedTexels = uint64_t(pCounters[0]) | (uint64_t(pCounters[1]) << 32);
+        pStats->visitedNodes = uint64_t(pCounters[2]) | (uint64_t(pCounters[3]) << 32);
+        comp.unmapBuffer("visitedCounter");
+    }
+    return pTex;
+}
+
+Texture::SharedPtr Parallax::generateDirectionalConemap(uint32_t sectorCount, const Texture::SharedPtr& pHeightmap, const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext, HierarchicalConemapStats* pStats) const
+{
+    if (!mpConemapDirectionalCompute || !pHeightmap || !pMinmaxMipmap)
+        return nullptr;
+    auto& comp = *mpConemapDirectionalCompute;
+    auto w = pHeightmap->getWidth();
+    auto h = pHeightmap->getHeight();
+    // four sectors in each slice
+    auto pTex = Texture::create2D(w, h, ResourceFormat::RGBA16Unorm, sectorCount / 4, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+    pTex->setName("Directional Conemap (" + std::to_string(sectorCount) + " sectors)");
+    comp.getProgram()->addDefine(kConeSectorsDefine, std::to_string(sectorCount));
+
+    const uint32_t zeros[4] = { 0, 0, 0, 0 };
+    comp.allocateStructuredBuffer("visitedCounter", 4, zeros, sizeof(zeros));
+    comp["heightMap"].setSrv(pHeightmap->getSRV());
+    comp["minmaxMap"].setSrv(pMinmaxMipmap->getSRV());
+    comp["gSampler"] = mpSampler;
+    comp["dirConeMap"].setUav(pTex->getUAV(0));
+    uint2 maxSize = { w, h };
+    comp["CScb"]["srcLevel"] = 0;
+    comp["CScb"]["maxSize"] = maxSize;
+    comp["CScb"]["oneOverMaxSize"] = 1.0f / float2(maxSize);
+    comp["CScb"]["topLevel"] = pMinmaxMipmap->getMipCount() - 1;
+    comp.runProgram(pRenderContext, w, h, 1);
+
+    if (pStats)
+    {
+        const uint32_t* pCounters = comp.mapBuffer<const uint32_t>("visitedCounter");
+        pStats->testedTexels = uint64_t(pCounters[0]) | (uint64_t(pCounters[1]) << 32);
+        pStats->visitedNodes = uint64_t(pCounters[2]) | (uint64_t(pCounters[3]) << 32);
+        comp.unmapBuffer("visitedCounter");
+    }
+    return pTex;
+}
+
+void Parallax::beginStepStats(RenderContext* pRenderContext, const uint2& frameDim)
+{
+    if (!mpStepCounts || mpStepCounts->getWidth() != frameDim.x || mpStepCounts->getHeight() != frameDim.y)
+    {
+        mpStepCounts = Texture::create2D(frameDim.x, frameDim.y, ResourceFormat::RGBA32Uint, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+        mpStepCounts->setName("Parallax step counts");
+        mpParallaxVars["gStepCounts"] = mpStepCounts;
+    }
+    if (!mStepStatsDefineSet)
+    {
+        mStepStatsDefineSet = true;
+        mpParallaxProgram->addDefine(kStepHistogramDefine, "1");
+    }
+    pRenderContext->clearUAV(mpStepHistogram->getUAV().get(), uint4(0));
+    pRenderContext->clearUAV(mpStepCounts->getUAV().get(), uint4(0));
+}
+
+void Parallax::endStepStats(RenderContext* pRenderContext, bool capture)
+{
+    PROFILE("endStepStats");
+    mpStepReduction->execute<uint4>(pRenderContext, mpStepCounts, ComputeParallelReduction::Type::Sum, nullptr, mpStepReductionResult, 0);
+    mpStepReduction->execute<uint4>(pRenderContext, mpStepCounts, ComputeParallelReduction::Type::MinMax, nullptr, mpStepReductionResult, sizeof(uint4));
+    pRenderContext->copyResource(mpStepHistogramReadback.get(), mpStepHistogram.get());
+
+    // submit and read the results in the next frame, to avoid a GPU flush
+    pRenderContext->flush(false);
+    mpStepStatsFence->gpuSignal(pRenderContext->getLowLevelData()->getCommandQueue());
+
+    // the bins above the step limit are empty
+    uint32_t steps = mRenderSettings.stepNum;
+    if (mRenderSettings.selectedParallaxFun == 6) steps += mRenderSettings.traversalStepNum;
+    mPendingStepStats.waiting = true;
+    mPendingStepStats.capture = capture;
+    mPendingStepStats.steps = steps;
+    mPendingStepStats.name = kParallaxFunList[mRenderSettings.selectedParallaxFun].label + ", max steps: " + std::to_string(steps);
+}
+
+void Parallax::readStepStats()
+{
+    if (!mPendingStepStats.waiting)
+        return;
+    mPendingStepStats.waiting = false;
+    mpStepStatsFence->syncCpu();
+
+    // sum: steps, refinement steps, covered pixels, non-converged pixels
+    // the sums are 32 bit, they overflow above 2^32 iterations per frame
+    const uint4* pResult = static_cast<const uint4*>(mpStepReductionResult->map(Buffer::MapType::Read));
+    const uint4 sum = pResult[0];
+    const uint4 max = pResult[2];
+    mpStepReductionResult->unmap();
+
+    StepStats stats;
+    stats.valid = true;
+    stats.pixelCount = sum.z;
+    const float pixelCount = float(std::max(sum.z, 1u));
+    stats.meanSteps = float(sum.x) / pixelCount;
+    stats.maxSteps = max.x;
+    stats.meanRefineSteps = float(sum.y) / pixelCount;
+    stats.maxRefineSteps = max.y;
+    stats.nonConvergedRate = float(sum.w) / pixelCount;
+    const uint32_t* pBins = static_cast<const uint32_t*>(mpStepHistogramReadback->map(Buffer::MapType::Read));
+    stats.histogram = makeStepHistogram(pBins, mPendingStepStats.steps, mPendingStepStats.name);
+    mpStepHistogramReadback->unmap();
+    mStepStats = std::move(stats);
+
+    if (mPendingStepStats.capture)
+    {
+        mPrevStepHistogram = std::move(mStepHistogram);
+        mStepHistogram = mStepStats.histogram;
+    }
+
+    auto& profiler = Profiler::instance();
+    profiler.setCounter(kStepStatsCounterPrefix + "meanSteps", mStepStats.meanSteps);
+    profiler.setCounter(kStepStatsCounterPrefix + "maxSteps", float(mStepStats.maxSteps));
+    profiler.setCounter(kStepStatsCounterPrefix + "meanRefineSteps", mStepStats.meanRefineSteps);
+    profiler.setCounter(kStepStatsCounterPrefix + "maxRefineSteps", float(mStepStats.maxRefineSteps));
+    profiler.setCounter(kStepStatsCounterPrefix + "p99Steps", float(mStepStats.histogram.p99));
+    profiler.setCounter(kStepStatsCounterPrefix + "nonConvergedRate", mStepStats.nonConvergedRate);
+}
+
+Parallax::StepHistogram Parallax::makeStepHistogram(const uint32_t* pBins, uint32_t steps, const std::string& name)
+{
+    // the bins above the step limit are empty
+    const uint32_t binCount = std::min(steps, kStepHistogramBins - 1) + 1;
+    std::vector<uint64_t> counts(binCount, 0);
+    for (uint32_t i = 0; i < kStepHistogramBins; ++i)
+    {
+        counts[std::min(i, binCount - 1)] += pBins[i];
+    }
+
+    StepHistogram hist;
+    hist.name = name;
+    hist.bins.resize(binCount);
+    double stepSum = 0.0;
+    for (uint32_t i = 0; i < binCount; ++i)
+    {
+        hist.bins[i] = float(counts[i]);
+        hist.pixelCount += counts[i];
+        stepSum += double(i) * double(counts[i]);
+        if (i >= steps) hist.nonConverged += counts[i];
+    }
+    if (hist.pixelCount == 0)
+        return hist;
+    hist.mean = float(stepSum / double(hist.pixelCount));
+    // smallest step counts that cover 50% and 99% of the pixels
+    uint64_t cumulative = 0;
+    bool p50Found = false;
+    for (uint32_t i = 0; i < binCount; ++i)
+    {
+        cumulative += counts[i];
+        if (!p50Found && 2 * cumulative >= hist.pixelCount) { hist.p50 = i; p50Found = true; }
+        if (100 * cumulative >= 99 * hist.pixelCount) { hist.p99 = i; break; }
+    }
+    return hist;
+}
+
+pybind11::dict Parallax::StepStats::toPython() const
+{
+    pybind11::dict d;
+    d["valid"] = valid;
+    d["pixelCount"] = pixelCount;
+    d["meanSteps"] = meanSteps;
+    d["maxSteps"] = maxSteps;
+    d["meanRefineSteps"] = meanRefineSteps;
+    d["maxRefineSteps"] = maxRefineSteps;
+    d["nonConvergedRate"] = nonConvergedRate;
+    d["p50Steps"] = histogram.p50;
+    d["p99Steps"] = histogram.p99;
+    d["histogram"] = histogram.bins;
+    d["name"] = histogram.name;
+    return d;
+}
+
+void Parallax::registerScriptBindings(pybind11::module& m)
+{
+    pybind11::class_<Parallax> parallax(m, "Parallax");
+    parallax.def_readwrite("collectStepStats", &Parallax::mCollectStepStats);
+    parallax.def_property_readonly("stepStats", [](Parallax* pParallax) { pParallax->readStepStats(); return pParallax->mStepStats.toPython(); });
+    parallax.def_property_readonly("profiler", [](Parallax* pParallax) { return Profiler::instancePtr(); });
+    parallax.def_property("stepNum", [](Parallax* pParallax) { return pParallax->mRenderSettings.stepNum; }, [](Parallax* pParallax, uint32_t n) { pParallax->mRenderSettings.stepNum = n; });
+    parallax.def_property("refineStepNum", [](Parallax* pParallax) { return pParallax->mRenderSettings.refineStepNum; }, [](Parallax* pParallax, uint32_t n) { pParallax->mRenderSettings.refineStepNum = n; });
+    parallax.def_property("selfShadow", [](Parallax* pParallax) { return pParallax->mRenderSettings.selfShadow; }, [](Parallax* pParallax, uint32_t mode) { pParallax->mRenderSettings.selfShadow = mode; pParallax->mRenderSettings.setSelfShadow(); });
+    parallax.def_property("relax", [](Parallax* pParallax) { return pParallax->mRenderSettings.relax; }, [](Parallax* pParallax, float relax) { pParallax->mRenderSettings.relax = relax; });
+}
+
+void Parallax::makeHeightmapEditable(RenderContext* pRenderContext)
+{
+    if (!mpHeightmapTex)
+        return;
+    if (is_set(mpHeightmapTex->getBindFlags(), ResourceBindFlags::UnorderedAccess) && getFormatChannelCount(mpHeightmapTex->getFormat()) == 1)
+        return;
+    // loaded textures are read only, copy the red channel to an R16Unorm texture
+    uint2 maxSize = { mpHeightmapTex->getWidth(), mpHeightmapTex->getHeight() };
+    auto pTex = Texture::create2D(maxSize.x, maxSize.y, ResourceFormat::R16Unorm, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+    pTex->setName(mpHeightmapTex->getName() + " (edited)");
+    auto& comp = *mpTextureCopyCompute;
+    comp["CScb"]["maxSize"] = maxSize;
+    comp["src"].setSrv(mpHeightmapTex->getSRV(0, 1));
+    comp["dst"].setUav(pTex->getUAV(0));
+    comp.runProgram(pRenderContext, maxSize.x, maxSize.y, 1);
+
+    if (mpParallaxVars["gTexture"].getTexture() == mpHeightmapTex)
+        mpParallaxVars["gTexture"] = pTex;
+    mpHeightmapTex = pTex;
+}
+
+void Parallax::applyHeightmapBrush(const HeightmapBrushSettings& settings, RenderContext* pRenderContext, uint2& dirtyBegin, uint2& dirtyEnd) const
+{
+    uint2 maxSize = { mpHeightmapTex->getWidth(), mpHeightmapTex->getHeight() };
+    float2 lo = glm::floor(settings.center - settings.radius);
+    float2 hi = glm::ceil(settings.center + settings.radius);
+    dirtyBegin = uint2(glm::clamp(lo, float2(0), float2(maxSize)));
+    dirtyEnd = uint2(glm::clamp(hi, float2(0), float2(maxSize)));
+    if (glm::any(glm::greaterThanEqual(dirtyBegin, dirtyEnd)))
+        return;
+
+    auto& comp = *mpHeightmapBrushCompute;
+    comp["CScb"]["maxSize"] = maxSize;
+    comp["CScb"]["dstOffset"] = dirtyBegin;
+    comp["CScb"]["brushCenter"] = settings.center;
+    comp["CScb"]["brushRadius"] = settings.radius;
+    comp["CScb"]["brushHeight"] = settings.height;
+    comp["heightMap"].setUav(mpHeightmapTex->getUAV(0));
+    uint2 size = dirtyEnd - dirtyBegin;
+    comp.runProgram(pRenderContext, size.x, size.y, 1);
+}
+
+void Parallax::refitMinmaxMipmap(const Texture::SharedPtr& pMinmaxMipmap, const Texture::SharedPtr& pHeightmap, const uint2& dirtyBegin, const uint2& dirtyEnd, RenderContext* pRenderContext) const
+{
+    uint2 maxSize = { pHeightmap->getWidth(), pHeightmap->getHeight() };
+    uint2 begin = dirtyBegin;
+    uint2 end = dirtyEnd;
+    auto& copyCS = *mpMinmaxRefitCopyCompute;
+    copyCS["CScb"]["maxSize"] = maxSize;
+    copyCS["CScb"]["dstOffset"] = begin;
+    copyCS["heightMap"].setSrv(pHeightmap->getSRV(0));
+    copyCS["dstMinmaxMap"].setUav(pMinmaxMipmap->getUAV(0));
+    copyCS.runProgram(pRenderContext, end.x - begin.x, end.y - begin.y, 1);
+
+    // the last texel of a level also covers the extra texel of an odd sized finer level
+    auto& minmaxCS = *mpMinmaxRefitMipmapCompute;
+    for (uint currentLevel = 0; currentLevel < pMinmaxMipmap->getMipCount() - 1; ++currentLevel)
+    {
+        uint2 srcSize = maxSize;
+        maxSize = glm::max(maxSize / 2u, uint2(1));
+        begin = glm::min(begin / 2u, maxSize - 1u);
+        end = glm::min((end - 1u) / 2u, maxSize - 1u) + 1u;
+        minmaxCS["CScb"]["maxSize"] = maxSize;
+        minmaxCS["CScb"]["srcSize"] = srcSize;
+        minmaxCS["CScb"]["dstOffset"] = begin;
+        minmaxCS["CScb"]["currentLevel"] = currentLevel;
+        minmaxCS["srcMinmaxMap"].setSrv(pMinmaxMipmap->getSRV());
+        minmaxCS["dstMinmaxMap"].setUav(pMinmaxMipmap->getUAV(currentLevel + 1));
+        minmaxCS.runProgram(pRenderContext, end.x - begin.x, end.y - begin.y, 1);
+    }
+}
+
+bool Parallax::updateConemap(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, const Texture::SharedPtr& pMinmaxMipmap, const uint2& dirtyBegin, const uint2& dirtyEnd, RenderContext* pRenderContext, ConemapUpdateStats* pStats) const
+{
+    if (!pConemap || !pHeightmap || !pMinmaxMipmap)
+        return false;
+    if (!is_set(pConemap->getBindFlags(), ResourceBindFlags::UnorderedAccess))
+        return false;
+    if (pConemap->getFormat() != ResourceFormat::RG16Unorm && pConemap->getFormat() != ResourceFormat::RG8Unorm)
+        return false; // packed and compressed conemaps are rebuilt
+    if (pConemap->getWidth() != pHeightmap->getWidth() || pConemap->getHeight() != pHeightmap->getHeight())
+        return false;
+    PROFILE("updateConemap");
+
+    uint2 maxSize = { pHeightmap->getWidth(), pHeightmap->getHeight() };
+    uint32_t coneBits = getNumChannelBits(pConemap->getFormat(), 1);
+    float coneQuantum = getFormatType(pConemap->getFormat()) == FormatType::Unorm ? 1.0f / float((1ull << coneBits) - 1) : 0.0f;
+    auto setConstants = [&](ComputeProgramWrapper& comp)
+    {
+        comp["heightMap"].setSrv(pHeightmap->getSRV());
+        comp["minmaxMap"].setSrv(pMinmaxMipmap->getSRV());
+        comp["updateArgs"] = mpConemapUpdateArgs;
+        comp["gSampler"] = mpSampler;
+        comp["CScb"]["srcLevel"] = 0;
+        comp["CScb"]["maxSize"] = maxSize;
+        comp["CScb"]["oneOverMaxSize"] = 1.0f / float2(maxSize);
+        comp["CScb"]["topLevel"] = pMinmaxMipmap->getMipCount() - 1;
+        comp["CScb"]["dirtyBegin"] = dirtyBegin;
+        comp["CScb"]["dirtyEnd"] = dirtyEnd;
+        comp["CScb"]["coneQuantum"] = coneQuantum;
+    };
+
+    // bound of the old heights, from the minmax mipmap before the refit
+    auto& boundCS = *mpConemapUpdateBoundCompute;
+    setConstants(boundCS);
+    boundCS["CScb"]["updatePhase"] = 0;
+    boundCS.runProgram(pRenderContext, 1, 1, 1);
+
+    refitMinmaxMipmap(pMinmaxMipmap, pHeightmap, dirtyBegin, dirtyEnd, pRenderContext);
+
+    // bound of the new heights and the rectangle of the texels to test
+    boundCS["CScb"]["updatePhase"] = 1;
+    boundCS.runProgram(pRenderContext, 1, 1, 1);
+
+    auto& updateCS = *mpConemapUpdateCompute;
+    setConstants(updateCS);
+    updateCS["coneMap"].setUav(pConemap->getUAV(0));
+    updateCS.runProgramIndirect(pRenderContext, mpConemapUpdateArgs.get(), 0);
+
+    if (pStats)
+    {
+        const uint32_t* pArgs = static_cast<const uint32_t*>(mpConemapUpdateArgs->map(Buffer::MapType::Read));
+        pStats->dirtyBegin = dirtyBegin;
+        pStats->dirtyEnd = dirtyEnd;
+        pStats->updateBegin = uint2(pArgs[4], pArgs[5]);
+        pStats->updateEnd = uint2(pArgs[6], pArgs[7]);
+        pStats->updatedTexels = pArgs[8];
+        mpConemapUpdateArgs->unmap();
+    }
+    return true;
+}
+
+Texture::SharedPtr Parallax::generateMinmaxMipmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext, bool singlePass) const
 {
-    // Initialize the minmax LOD 0
     uint2 maxSize = { pHeightmap->getWidth(), pHeightmap->getHeight() };
     auto pTex = Texture::create2D(maxSize.x, maxSize.y, ResourceFormat::RG16Unorm, 1, uint32_t(-1), nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
 
+    if (singlePass && pTex->getMipCount() <= kMaxMinmaxLevels)
+    {
+        // One group for every 64x64 tile, the last tile of a row/column extends to the edge
+        auto& comp = *mpMinmaxSinglePassCompute;
+        uint2 tileCount = glm::max(maxSize / 64u, uint2(1));
+        comp["CScb"]["maxSize"] = maxSize;
+        comp["CScb"]["topLevel"] = pTex->getMipCount() - 1;
+        comp["CScb"]["groupCount"] = tileCount.x * tileCount.y;
+        comp["CScb"]["tileCount"] = tileCount;
+        comp["heightMap"].setSrv(pHeightmap->getSRV(0));
+        for (uint32_t level = 0; level < pTex->getMipCount(); ++level)
+        {
+            comp["dstMips"][level].setUav(pTex->getUAV(level));
+        }
+        comp.runProgram(pRenderContext, tileCount.x * 256, tileCount.y, 1);
+        return pTex;
+    }
+
+    // Initialize the minmax LOD 0
     auto& copyCS = *mpMinmaxCopyCompute;
     copyCS["CScb"]["maxSize"] = maxSize;
     copyCS["heightMap"].setSrv(pHeightmap->getSRV(0));
@@ -774,8 +2054,10 @@ Texture::SharedPtr Parallax::generateMinmaxMipmap(const Texture::SharedPtr& pHei
     auto& minmaxCS = *mpMinmaxMipmapCompute;
     for (uint currentLevel = 0; currentLevel < pTex->getMipCount() - 1; ++currentLevel)
     {
-        maxSize /= 2;
+        uint2 srcSize = maxSize;
+        maxSize = glm::max(maxSize / 2u, uint2(1));
         minmaxCS["CScb"]["maxSize"] = maxSize;
+        minmaxCS["CScb"]["srcSize"] = srcSize;
         minmaxCS["CScb"]["currentLevel"] = currentLevel;
         minmaxCS["srcMinmaxMap"].setSrv(pTex->getSRV());
         minmaxCS["dstMinmaxMap"].setUav(pTex->getUAV(currentLevel + 1));
@@ -784,6 +2066,141 @@ Texture::SharedPtr Parallax::generateMinmaxMipmap(const Texture::SharedPtr& pHei
     return pTex;
 }
 
+std::string Parallax::verifySinglePassMinmax(RenderContext* pRenderContext) const
+{
+    // odd sizes, sizes that are not multiples of the 64x64 tiles, a single tile and single rows/columns
+    const uint2 kSizes[] = { {1, 1}, {37, 1}, {1, 300}, {64, 64}, {100, 37}, {129, 257}, {255, 1000}, {1000, 999}, {2048, 1536} };
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<uint32_t> uni(0, 65535);
+    uint32_t mismatchedTexels = 0;
+    uint32_t mismatchedSizes = 0;
+    uint64_t comparedTexels = 0;
+    for (const uint2& size : kSizes)
+    {
+        std::vector<uint16_t> heights(size_t(size.x) * size.y);
+        for (uint16_t& h : heights) h = uint16_t(uni(rng));
+        auto pHeightmap = Texture::create2D(size.x, size.y, ResourceFormat::R16Unorm, 1, 1, heights.data(), ResourceBindFlags::ShaderResource);
+        auto pSinglePass = generateMinmaxMipmap(pHeightmap, pRenderContext, true);
+        auto pPerLevel = generateMinmaxMipmap(pHeightmap, pRenderContext, false);
+
+        // both store RG16Unorm texels, so they are compared bit by bit
+        uint32_t mismatched = 0;
+        for (uint32_t level = 0; level < pSinglePass->getMipCount(); ++level)
+        {
+            std::vector<uint8_t> a = pRenderContext->readTextureSubresource(pSinglePass.get(), pSinglePass->getSubresourceIndex(0, level));
+            std::vector<uint8_t> b = pRenderContext->readTextureSubresource(pPerLevel.get(), pPerLevel->getSubresourceIndex(0, level));
+            const uint32_t* pA = reinterpret_cast<const uint32_t*>(a.data());
+            const uint32_t* pB = reinterpret_cast<const uint32_t*>(b.data());
+            const size_t texelCount = size_t(pSinglePass->getWidth(level)) * pSinglePass->getHeight(level);
+            for (size_t i = 0; i < texelCount; ++i)
+                if (pA[i] != pB[i]) ++mismatched;
+            comparedTexels += texelCount;
+        }
+        mismatchedTexels += mismatched;
+        if (mismatched > 0) ++mismatchedSizes;
+    }
+    return "Verify single pass minmax: " + std::to_string(mismatchedTexels) + " texels of " + std::to_string(comparedTexels) + " differ from the per level mipmap, in " +
+        std::to_string(mismatchedSizes) + " of " + std::to_string(std::size(kSizes)) + " sizes";
+}
+
+bool Parallax::canGenerateConemapMips(ResourceFormat format)
+{
+    return !isCompressedFormat(format) && getFormatType(format) != FormatType::Uint;
+}
+
+Texture::SharedPtr Parallax::generateConemapMips(const Texture::SharedPtr& pConemap, RenderContext* pRenderContext) const
+{
+    if (!mpConemapMipCompute || !pConemap || !canGenerateConemapMips(pConemap->getFormat()))
+        return nullptr;
+    PROFILE("generateConemapMips");
+    const uint2 fineSize = { pConemap->getWidth(), pConemap->getHeight() };
+    auto pTex = Texture::create2D(fineSize.x, fineSize.y, pConemap->getFormat(), 1, uint32_t(-1), nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+    pTex->setName(pConemap->getName() + " (conservative mips)");
+    pRenderContext->copySubresource(pTex.get(), 0, pConemap.get(), 0);
+
+    // the stored cones are rounded down, so they stay conservative
+    const uint32_t coneBits = getNumChannelBits(pConemap->getFormat(), 1);
+    const float coneQuantum = getFormatType(pConemap->getFormat()) == FormatType::Unorm ? 1.0f / float((1ull << coneBits) - 1) : 0.0f;
+    auto& comp = *mpConemapMipCompute;
+    comp["srcConeMap"].setSrv(pTex->getSRV());
+    comp["CScb"]["fineSize"] = fineSize;
+    comp["CScb"]["coneQuantum"] = coneQuantum;
+    uint2 maxSize = fineSize;
+    for (uint32_t level = 1; level < pTex->getMipCount(); ++level)
+    {
+        const uint2 srcSize = maxSize;
+        maxSize = glm::max(maxSize / 2u, uint2(1));
+        comp["CScb"]["maxSize"] = maxSize;
+        comp["CScb"]["srcSize"] = srcSize;
+        comp["CScb"]["srcLevel"] = level - 1;
+        comp["CScb"]["dstLevel"] = level;
+        comp["dstConeMap"].setUav(pTex->getUAV(level));
+        comp.runProgram(pRenderContext, maxSize.x, maxSize.y, 1);
+    }
+    return pTex;
+}
+
+float Parallax::measureConeOvershoot(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const
+{
+    if (!mpConeOvershootCompute || !pConemap || !pHeightmap || !canGenerateConemapMips(pConemap->getFormat()))
+        return -1.f;
+    const uint2 size = { pConemap->getWidth(), pConemap->getHeight() };
+    if (pHeightmap->getWidth() != size.x || pHeightmap->getHeight() != size.y)
+        return -1.f;
+    PROFILE("measureConeOvershoot");
+    auto pOvershoot = Texture::create2D(size.x, size.y, ResourceFormat::R32Float, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+
+    // the stored cones are rounded to the nearest unorm value, the measurement takes the widest cone they can come from
+    const uint32_t coneBits = getNumChannelBits(pConemap->getFormat(), 1);
+    const float coneQuantum = getFormatType(pConemap->getFormat()) == FormatType::Unorm ? 1.0f / float((1ull << coneBits) - 1) : 0.0f;
+    auto& comp = *mpConeOvershootCompute;
+    comp["heightMap"].setSrv(pHeightmap->getSRV());
+    comp["overshootConeMap"].setSrv(pConemap->getSRV(0, 1));
+    comp["overshootMap"].setUav(pOvershoot->getUAV(0));
+    comp["gSampler"] = mpSampler;
+    comp["CScb"]["srcLevel"] = 0;
+    comp["CScb"]["maxSize"] = size;
+    comp["CScb"]["oneOverMaxSize"] = 1.0f / float2(size);
+    comp["CScb"]["searchSteps"] = mOvershootSearchSteps;
+    comp["CScb"]["oneOverSearchSteps"] = 1.0f / mOvershootSearchSteps;
+    comp["CScb"]["coneQuantum"] = coneQuantum;
+
+    // every texel tests every other one, the dispatches are tiled like the tiled generation to avoid a TDR
+    pRenderContext->clearUAV(pOvershoot->getUAV(0).get(), float4(0.0f));
+    const uint2 dstTileSize = glm::max(mTiledCMSettings.dstTileSize, uint2(1));
+    const uint2 srcTileSize = glm::max(mTiledCMSettings.srcTileSize, uint2(1));
+    const uint2 dstTileCount = div_round_up(size, dstTileSize);
+    const uint2 srcTileCount = div_round_up(size, srcTileSize);
+    for (uint32_t dstTile = 0; dstTile < dstTileCount.x * dstTileCount.y; ++dstTile)
+    {
+        const uint2 dstOffset = uint2(dstTile % dstTileCount.x, dstTile / dstTileCount.x) * dstTileSize;
+        const uint2 dstSize = glm::min(dstOffset + dstTileSize, size) - dstOffset;
+        comp["CScb"]["dstOffset"] = dstOffset;
+        for (uint32_t srcTile = 0; srcTile < srcTileCount.x * srcTileCount.y; ++srcTile)
+        {
+            const uint2 srcBegin = uint2(srcTile % srcTileCount.x, srcTile / srcTileCount.x) * srcTileSize;
+            comp["CScb"]["srcBegin"] = srcBegin;
+            comp["CScb"]["srcEnd"] = glm::min(srcBegin + srcTileSize, size);
+            comp.runProgram(pRenderContext, dstSize.x, dstSize.y, 1);
+        }
+        // submit every destination tile, so a command list never holds the whole measurement
+        pRenderContext->flush();
+    }
+
+    float4 minMax[2];
+    if (!mpOvershootReduction->execute<float4>(pRenderContext, pOvershoot, ComputeParallelReduction::Type::MinMax, minMax))
+        return -1.f;
+    return minMax[1].x;
+}
+
+uint32_t Parallax::getAutoRefineStepNum(float overshoot, float tolerance)
+{
+    // every step halves the interval, the result is its midpoint
+    if (overshoot <= 2 * tolerance)
+        return 0;
+    return std::min(uint32_t(std::ceil(std::log2(overshoot / (2 * tolerance)))), 20u);
+}
+
 Texture::SharedPtr Parallax::generateQuickConemap(const QuickConemapComputeSettings& settings, const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext) const
 {
     if (!mpQuickConemapCompute || !pMinmaxMipmap)
@@ -815,3 +2232,111 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
     Sample::run(config, pRenderer);
     return 0;
 }
+
+Texture::SharedPtr Parallax::encodeConemap(const Texture::SharedPtr& pConemap, RenderContext* pRenderContext) const
+{
+    if (!pConemap || mConemapStorage == 0)
+        return pConemap;
+    PROFILE("encodeConemap");
+    const uint32_t w = pConemap->getWidth();
+    const uint32_t h = pConemap->getHeight();
+
+    if (mConemapStorage == 1)
+    {
+        auto pTex = Texture::create2D(w, h, ResourceFormat::R16Uint, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+        pTex->setName(pConemap->getName() + " (packed R16)");
+        auto& comp = *mpConemapPackCompute;
+        comp["CScb"]["maxSize"] = uint2(w, h);
+        comp["coneMap"].setSrv(pConemap->getSRV(0, 1));
+        comp["packedConeMap"].setUav(pTex->getUAV(0));
+        comp.runProgram(pRenderContext, w, h);
+        return pTex;
+    }
+
+    // BC5: encoded on the CPU from the float values the shaders see
+    if (w % 4 != 0 || h % 4 != 0)
+    {
+        logWarning("BC5 conemaps need a size that is a multiple of 4, the conemap is kept as " + to_string(pConemap->getFormat()));
+        return pConemap;
+    }
+    CpuConemap::Conemap conemap;
+    {
+        auto pFloatTex = Texture::create2D(w, h, ResourceFormat::RG32Float, 1, 1, nullptr, ResourceBindFlags::RenderTarget);
+        pRenderContext->blit(pConemap->getSRV(0, 1), pFloatTex->getRTV());
+        std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pFloatTex.get(), 0);
+        conemap.width = w;
+        conemap.height = h;
+        conemap.texels.resize(2 * size_t(w) * h);
+        std::memcpy(conemap.texels.data(), data.data(), conemap.texels.size() * sizeof(float));
+    }
+    std::vector<uint8_t> blocks = CpuConemap::encodeBC5(conemap);
+    auto pTex = Texture::create2D(w, h, ResourceFormat::BC5Unorm, 1, 1, blocks.data(), ResourceBindFlags::ShaderResource);
+    pTex->setName(pConemap->getName() + " (BC5)");
+    return pTex;
+}
+
+std::string Parallax::getCacheSettings(const ConemapComputeSettings& settings) const
+{
+    // the single dispatch, tiled and hierarchical generators give the same result
+    std::string s = "conemap algorithm=" + settings.algorithm;
+    if (settings.algorithm == "2") s += " relaxedConeSearchSteps=" + std::to_string(settings.relaxedConeSearchSteps);
+    return s + " bits=" + (settings.newHmap16bit ? "16" : "8") + " storage=" + std::to_string(mConemapStorage);
+}
+
+std::string Parallax::getCacheSettings(const QuickConemapComputeSettings& settings) const
+{
+    return "quick algorithm=" + settings.algorithm + " maxAtTexelCenter=" + (settings.maxAtTexelCenter ? "1" : "0")
+        + " bits=" + (settings.newHmap16bit ? "16" : "8") + " storage=" + std::to_string(mConemapStorage);
+}
+
+const SHA1::MD& Parallax::getHeightmapDigest(RenderContext* pRenderContext)
+{
+    if (mpHashedHeightmap.lock() != mpHeightmapTex)
+    {
+        mHeightmapDigest = ConemapCache::hashHeightmap(mpHeightmapTex, pRenderContext);
+        mpHashedHeightmap = mpHeightmapTex;
+    }
+    return mHeightmapDigest;
+}
+
+bool Parallax::loadCachedConemap(const std::string& generatorSettings, RenderContext* pRenderContext)
+{
+    if (!mUseConemapCache || !mpHeightmapTex)
+        return false;
+    PROFILE("loadCachedConemap");
+    auto key = ConemapCache::computeKey(getHeightmapDigest(pRenderContext), generatorSettings);
+    Texture::SharedPtr pConemap, pMinmax;
+    try
+    {
+        if (!ConemapCache::read(key, pConemap, pMinmax, pRenderContext))
+            return false;
+    }
+    catch (const std::exception& e)
+    {
+        logWarning("Failed to load conemap cache file '" + ConemapCache::getCachePath(key).string() + "' (" + e.what() + ")");
+        return false;
+    }
+    mpConeTex = pConemap;
+    if (pMinmax) mpMinmaxTex = pMinmax;
+    mpParallaxVars["gTexture"] = mpConeTex;
+    mConemapCacheResult = "Loaded from cache: " + generatorSettings;
+    logInfo(mConemapCacheResult);
+    return true;
+}
+
+void Parallax::storeCachedConemap(const std::string& generatorSettings, bool withMinmax, RenderContext* pRenderContext)
+{
+    if (!mUseConemapCache || !mpConeTex || !mpHeightmapTex)
+        return;
+    PROFILE("storeCachedConemap");
+    auto key = ConemapCache::computeKey(getHeightmapDigest(pRenderContext), generatorSettings);
+    try
+    {
+        ConemapCache::write(key, mpConeTex, withMinmax ? mpMinmaxTex : nullptr, pRenderContext);
+        mConemapCacheResult = "Stored in cache: " + generatorSettings;
+    }
+    catch (const std::exception& e)
+    {
+        logWarning("Failed to write conemap cache file '" + ConemapCache::getCachePath(key).string() + "' (" + e.what() + ")");
+    }
+}
@@ -27,7 +27,11 @@
  **************************************************************************/
 #pragma once
 #include "Falcor.h"
+#include "Utils/Algorithm/ComputeParallelReduction.h"
 #include "ComputeProgramWrapper.h"
+#include "ConemapReference.h"
+#include "ConemapCache.h"
+#include "VirtualConemap.h"
 
 using namespace Falcor;
 
@@ -49,12 +53,15 @@ private:
 
     void guiTexureInfo(Gui::Widgets& w);
     void guiRenderSettings(Gui::Widgets& w);
+    void guiStepHistogram(Gui::Widgets& w);
     void guiProceduralGeneration(Gui::Widgets& w);
     void guiConemapGeneration(Gui::Widgets& w);
     void guiQuickconemapGeneration(Gui::Widgets& w);
+    void guiHeightmapEditing(Gui::Widgets& w);
     void guiLoadImage(Gui::Widgets& w);
     void guiDebugRender(Gui::Widgets& w);
     void guiSaveImage(Gui::Widgets& w);
+    void guiVirtualConemap(Gui::Widgets& w);
 
     // program
     GraphicsProgram::SharedPtr mpDebugProgram = nullptr;
@@ -84,12 +91,172 @@ private:
         std::string name = "";
     } mCMCompSettings;
 
+    // tiled conemap generation: the all-pairs search is split into
+    // (destination tile, source tile) passes, a few of them are run every frame
+    ComputeProgramWrapper::SharedPtr mpConemapTiledCompute = nullptr;
+    bool mRunTiledConemapCompute = false; // starts a new tiled generation
+    struct TiledConemapSettings {
+        uint2 dstTileSize = { 1024, 1024 }; // texels written by a pass
+        uint2 srcTileSize = { 64, 64 };     // texels each thread tests in a pass
+        uint32_t passesPerFrame = 1;
+    } mTiledCMSettings;
+    struct TiledConemapState {
+        bool running = false;
+        ConemapComputeSettings settings;
+        Texture::SharedPtr pHeightmap;
+        Texture::SharedPtr pConemap; // output, valid when the last pass is done
+        Texture::SharedPtr pMinTan;  // running cone ratio, R32Float
+        uint2 dstTileSize = { 0, 0 };
+        uint2 srcTileSize = { 0, 0 };
+        uint2 dstTileCount = { 0, 0 };
+        uint2 srcTileCount = { 0, 0 };
+        uint32_t nextPass = 0;
+        uint32_t passCount = 0;
+    } mTiledCMState;
+
+    // exact conemap generation that culls blocks of the minmax mipmap
+    ComputeProgramWrapper::SharedPtr mpConemapHierarchicalCompute = nullptr;
+    bool mRunHierarchicalConemapCompute = false;
+    struct HierarchicalConemapStats {
+        uint64_t testedTexels = 0; // heightmap texels the cones were computed for
+        uint64_t visitedNodes = 0; // coarse minmax texels visited
+    };
+    std::string mHierarchicalResult = "";
+
+    // directional conemap: a cone ratio for every sector of directions, see mainDirectional in Conemap.cs.slang
+    ComputeProgramWrapper::SharedPtr mpConemapDirectionalCompute = nullptr;
+    bool mRunDirectionalConemapCompute = false;
+    uint32_t mConeSectors = 4; // 4 or 8
+    Texture::SharedPtr mpDirConeTex = nullptr; // RGBA16Unorm array with mConeSectors / 4 slices
+    std::string mDirectionalResult = "";
+
+    // step statistics of the parallax functions, see STEP_HISTOGRAM in Parallax.ps.slang
+    // the results of a frame are read back asynchronously at the beginning of the next one
+    Buffer::SharedPtr mpStepHistogram = nullptr;           // histogram of the primary search step counts
+    Texture::SharedPtr mpStepCounts = nullptr;             // RGBA32Uint per pixel: primary steps, refinement steps, 1 if covered, 1 if not converged
+    ComputeParallelReduction::SharedPtr mpStepReduction = nullptr;
+    Buffer::SharedPtr mpStepReductionResult = nullptr;     // sum and [min, max] of mpStepCounts
+    Buffer::SharedPtr mpStepHistogramReadback = nullptr;   // copy of mpStepHistogram
+    GpuFence::SharedPtr mpStepStatsFence = nullptr;
+    bool mCollectStepStats = false;   // every frame
+    bool mCaptureStepHistogram = false; // next frame only, kept in mStepHistogram
+    bool mStepStatsDefineSet = false;
+    struct PendingStepStats {
+        bool waiting = false;
+        bool capture = false;      // the frame was requested by mCaptureStepHistogram
+        uint32_t steps = 0;        // step limit of the primary search
+        std::string name = "";     // parallax function and settings of the frame
+    } mPendingStepStats;
+    struct StepHistogram {
+        std::string name = "";     // parallax function and settings of the capture
+        std::vector<float> bins;   // number of pixels for each step count
+        uint64_t pixelCount = 0;
+        uint64_t nonConverged = 0; // pixels that used every step
+        float mean = 0.f;
+        uint32_t p50 = 0;
+        uint32_t p99 = 0;
+    };
+    StepHistogram mStepHistogram;     // last capture
+    StepHistogram mPrevStepHistogram; // the one before, for comparison
+    struct StepStats {
+        bool valid = false;
+        uint64_t pixelCount = 0;      // pixels covered by the plate
+        float meanSteps = 0.f;        // primary search iterations per pixel
+        uint32_t maxSteps = 0;
+        float meanRefineSteps = 0.f;  // refinement iterations per pixel
+        uint32_t maxRefineSteps = 0;
+        float nonConvergedRate = 0.f; // fraction of the pixels that used every step
+        StepHistogram histogram;
+        pybind11::dict toPython() const;
+    } mStepStats; // last collected frame
+
+    // CPU reference check of the maximum mipmap traversal (PARALLAX_FUN 5)
+    ComputeProgramWrapper::SharedPtr mpTraversalVerifyCompute = nullptr;
+    bool mRunTraversalVerify = false;
+    uint32_t mTraversalVerifyRayCount = 4096;
+    std::string mTraversalVerifyResult = "";
+
+    // heightmap editing with incremental conemap update
+    ComputeProgramWrapper::SharedPtr mpHeightmapBrushCompute = nullptr;
+    ComputeProgramWrapper::SharedPtr mpConemapUpdateBoundCompute = nullptr;
+    ComputeProgramWrapper::SharedPtr mpConemapUpdateCompute = nullptr;
+    ComputeProgramWrapper::SharedPtr mpMinmaxRefitCopyCompute = nullptr;
+    ComputeProgramWrapper::SharedPtr mpMinmaxRefitMipmapCompute = nullptr;
+    Buffer::SharedPtr mpConemapUpdateArgs = nullptr; // indirect arguments and results of the update, see Conemap.cs.slang
+    bool mRunHeightmapBrush = false;
+    struct HeightmapBrushSettings {
+        float2 center = { 256, 256 }; // in texels
+        float radius = 32;            // in texels
+        float height = 0.1f;          // added at the center, can be negative
+        bool incremental = true;      // false: rebuild the whole conemap for comparison
+        bool readbackStats = false;   // read back the number of updated cones (stalls the GPU)
+    } mBrushSettings;
+    struct ConemapUpdateStats {
+        uint2 dirtyBegin = { 0, 0 };
+        uint2 dirtyEnd = { 0, 0 };
+        uint2 updateBegin = { 0, 0 }; // rectangle of the texels that were tested
+        uint2 updateEnd = { 0, 0 };
+        uint32_t updatedTexels = 0;   // cones that were recomputed
+    };
+    std::string mConemapUpdateResult = "";
+
+    // CPU reference check of the conservative conemap
+    bool mRunConemapVerify = false;
+    uint32_t mVerifySampleCount = 1024;
+    std::string mVerifyResult = "";
+    bool mRunConemapMipsVerify = false;
+    std::string mMipsVerifyResult = "";
+    bool mRunTightnessMeasure = false; // quick cones against the conservative cones
+    std::string mTightnessResult = "";
+
     ComputeProgramWrapper::SharedPtr mpTextureCopyCompute = nullptr;
 
+    // on-disk cache of the generated conemaps and minmax mipmaps, see ConemapCache.h
+    bool mUseConemapCache = true;
+    bool mLookupConemapCache = false; // load the cached quick conemap of a newly loaded heightmap, if there is one
+    std::weak_ptr<Texture> mpHashedHeightmap; // mHeightmapDigest is the hash of this heightmap
+    SHA1::MD mHeightmapDigest = {};
+    std::string mConemapCacheResult = "";
+
+    // storage of the generated conemaps: RG, packed R16 or BC5, see encodeConemap
+    ComputeProgramWrapper::SharedPtr mpConemapPackCompute = nullptr;
+    uint32_t mConemapStorage = 0; // see kConemapStorageList
+
+    // virtual conemap streamed from a tiled conemap file, see VirtualConemap.h
+    VirtualConemap::SharedPtr mpVirtualConemap = nullptr;
+    bool mUseVirtualConemap = false;
+    bool mVirtualConemapBound = false; // HMres is the size of the virtual conemap
+    bool mLoadVirtualConemap = false;
+    bool mWriteVirtualConemap = false;
+    std::string mVirtualConemapName = "";
+    struct VirtualConemapSettings {
+        uint32_t tileSize = 128;        // tile size of the written files
+        bool writeAlbedo = true;
+        uint32_t cacheSlots = 256;      // tiles in the physical cache
+        uint32_t maxLoadsPerFrame = 16;
+    } mVirtualSettings;
+    std::string mVirtualConemapResult = "";
+
     ComputeProgramWrapper::SharedPtr mpMinmaxCopyCompute = nullptr;
     ComputeProgramWrapper::SharedPtr mpMinmaxMipmapCompute = nullptr;
+    ComputeProgramWrapper::SharedPtr mpMinmaxSinglePassCompute = nullptr; // builds every level in one dispatch
+    bool mSinglePassMinmax = true;
+    bool mRunMinmaxVerify = false;
+    std::string mMinmaxVerifyResult = "";
     bool mRunMinmaxCompute = false;
 
+    // overshoot bound of the cone steps for the automatic refinement, see mainOvershoot in Conemap.cs.slang
+    ComputeProgramWrapper::SharedPtr mpConeOvershootCompute = nullptr;
+    ComputeParallelReduction::SharedPtr mpOvershootReduction = nullptr;
+    std::weak_ptr<Texture> mpOvershootConeTex; // the conemap mConeOvershoot was measured on
+    float mConeOvershoot = -1.f;               // negative if it is not known
+    uint32_t mOvershootSearchSteps = 64;
+    std::string mOvershootResult = "";
+
+    // conservative conemap mipmap of the LOD-aware cone stepping, see ConemapMip.cs.slang
+    ComputeProgramWrapper::SharedPtr mpConemapMipCompute = nullptr;
+    std::weak_ptr<Texture> mpConemapMipsTex; // the conemap that has the conservative mipmap
+
     ComputeProgramWrapper::SharedPtr mpQuickConemapCompute = nullptr;
     bool mRunQuickConemapCompute = false;
     struct QuickConemapComputeSettings {
@@ -98,6 +265,14 @@ private:
         std::string algorithm = "2";
         std::string name = "";
     } mQCMCompSettings;
+    // generator and settings of mpConeTex, a heightmap edit rebuilds the conemap with them
+    struct ConemapGenerator {
+        enum class Type { Unknown, Conemap, Quick } type = Type::Unknown; // Unknown: loaded from file
+        ConemapComputeSettings conemap;
+        QuickConemapComputeSettings quick;
+    } mConeTexGenerator;
+    void setConemapGenerator(const ConemapComputeSettings& settings);
+    void setConemapGenerator(const QuickConemapComputeSettings& settings);
     // geometry
     Buffer::SharedPtr mpVertexBuffer = nullptr;
     Vao::SharedPtr mpVao = nullptr;
@@ -108,6 +283,8 @@ private:
     Texture::SharedPtr mpHeightmapTex = nullptr;
     std::string mHeightmapName = "Dirt_Cracked/Dirt_Cracked_height 512.png";
     void LoadHeightmapTexture(); // load texture from file(mHeightmapName) and set variables
+    std::string mConemapName = "";
+    void LoadConemapTexture(); // load baked conemap from file(mConemapName) and set variables
     Texture::SharedPtr mpAlbedoTex = nullptr;
     std::string mAlbedoName = "Dirt_Cracked/Dirt_Cracked_diffuse 4k.png";
     void LoadAlbedoTexture(); // load texture from file(mAlbedoName) and set variables
@@ -126,6 +303,9 @@ private:
         bool drawDebug = false;
         uint32_t mipLevel = 0;
         uint3 debugChannels = { 0, 1, 2 };
+        uint32_t stepHeatmap = 0; // see kStepHeatmapList
+        uint32_t stepHeatmapMax = 64; // step count shown with the hottest color
+        float stepHeatmapOpacity = 0.75f;
     } mDebugSettings;
 
     // render settings
@@ -140,21 +320,67 @@ private:
         float lightIntensity = 1.0f;
         uint stepNum = 32;
         uint refineStepNum = 5;
+        uint traversalStepNum = 64; // maximum mipmap traversal after cone stepping, PARALLAX_FUN 6
         float3 scale{ 1, 1, 1 };
         float angle = 0.0f;
         float3 axis{ 0, 0, 1 };
         float3 translate{ 0, 0, 0 };
         float relax = 1.0f;
+        bool coneLod = false;   // LOD-aware cone stepping, PARALLAX_FUN 3
+        float coneLodBias = 0.0f;
+        bool autoRefine = false; // refine step number from the overshoot of the conemap
+        float refineTolerance = 1.0f / 1024; // error of the refined intersection in t (height) units
         uint32_t selectedParallaxFun = 3; // see kParallaxFunList
         void setParallaxFun();
         uint32_t selectedRefinementFun = 1; // see kRefineFunList
         void setRefinementFun();
+        uint32_t selfShadow = 0; // see kSelfShadowList
+        void setSelfShadow();
+        uint shadowStepNum = 32;
+        float shadowPenumbra = 0.02f; // tangent of the angular radius of the light
     } mRenderSettings;
 
 
     // compute calls
     Texture::SharedPtr generateProceduralHeightmap(const ProceduralHeightmapComputeSettings& settings, RenderContext* pRenderContext) const;
     Texture::SharedPtr generateConemap(const ConemapComputeSettings& settings, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const;
-    Texture::SharedPtr generateMinmaxMipmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const;
+    void beginTiledConemap(const ConemapComputeSettings& settings, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext);
+    bool stepTiledConemap(RenderContext* pRenderContext, uint32_t maxPasses); // returns true when the conemap is finished
+    Texture::SharedPtr generateHierarchicalConemap(const ConemapComputeSettings& settings, const Texture::SharedPtr& pHeightmap, const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext, HierarchicalConemapStats* pStats = nullptr) const;
+    // returns an RGBA16Unorm texture array, sector k is in channel k % 4 of slice k / 4
+    Texture::SharedPtr generateDirectionalConemap(uint32_t sectorCount, const Texture::SharedPtr& pHeightmap, const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext, HierarchicalConemapStats* pStats = nullptr) const;
+    void beginStepStats(RenderContext* pRenderContext, const uint2& frameDim);
+    void endStepStats(RenderContext* pRenderContext, bool capture);
+    void readStepStats(); // waits for the pending frame, if there is one
+    static StepHistogram makeStepHistogram(const uint32_t* pBins, uint32_t steps, const std::string& name);
+    void registerScriptBindings(pybind11::module& m);
+    void makeHeightmapEditable(RenderContext* pRenderContext); // replaces mpHeightmapTex with an R16Unorm UAV copy if needed
+    void applyHeightmapBrush(const HeightmapBrushSettings& settings, RenderContext* pRenderContext, uint2& dirtyBegin, uint2& dirtyEnd) const;
+    void refitMinmaxMipmap(const Texture::SharedPtr& pMinmaxMipmap, const Texture::SharedPtr& pHeightmap, const uint2& dirtyBegin, const uint2& dirtyEnd, RenderContext* pRenderContext) const;
+    // pMinmaxMipmap has to hold the heights before the edit, it is refitted. Returns false if pConemap cannot be updated in place.
+    bool updateConemap(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, const Texture::SharedPtr& pMinmaxMipmap, const uint2& dirtyBegin, const uint2& dirtyEnd, RenderContext* pRenderContext, ConemapUpdateStats* pStats = nullptr) const;
+    std::string verifyConemap(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const;
+    std::string measureConemapTightness(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const;
+    ConemapReference::Heightmap readbackHeightmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const;
+    // checks the conservative mipmap of the conemap with CpuConemap::checkConservativeMips, the mipmap is generated if the conemap has none
+    std::string verifyConemapMips(const Texture::SharedPtr& pConemap, RenderContext* pRenderContext) const;
+    std::string verifyMaxMipmapTraversal(const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext) const;
+    Texture::SharedPtr generateMinmaxMipmap(const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext, bool singlePass) const;
+    std::string verifySinglePassMinmax(RenderContext* pRenderContext) const;
     Texture::SharedPtr generateQuickConemap(const QuickConemapComputeSettings& settings, const Texture::SharedPtr& pMinmaxMipmap, RenderContext* pRenderContext) const;
+    // copy of an RG conemap with a conservative mipmap, see ConemapMip.cs.slang; packed and compressed conemaps are not supported
+    static bool canGenerateConemapMips(ResourceFormat format);
+    Texture::SharedPtr generateConemapMips(const Texture::SharedPtr& pConemap, RenderContext* pRenderContext) const;
+    // largest overshoot of the cone steps on an RG conemap, -1 if it cannot be measured
+    float measureConeOvershoot(const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pHeightmap, RenderContext* pRenderContext) const;
+    // smallest binary search step number that brings an interval of length overshoot below the tolerance
+    static uint32_t getAutoRefineStepNum(float overshoot, float tolerance);
+    // conemap cache, generatorSettings identifies the generator and every setting that changes its result
+    std::string getCacheSettings(const ConemapComputeSettings& settings) const;
+    std::string getCacheSettings(const QuickConemapComputeSettings& settings) const;
+    const SHA1::MD& getHeightmapDigest(RenderContext* pRenderContext);
+    bool loadCachedConemap(const std::string& generatorSettings, RenderContext* pRenderContext); // sets mpConeTex and mpMinmaxTex on a hit
+    void storeCachedConemap(const std::string& generatorSettings, bool withMinmax, RenderContext* pRenderContext);
+    // converts a generated RG conemap to the format selected by mConemapStorage, the cones are rounded down
+    Texture::SharedPtr encodeConemap(const Texture::SharedPtr& pConemap, RenderContext* pRenderContext) const;
 };
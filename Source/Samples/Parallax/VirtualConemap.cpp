@@ -0,0 +1,208 @@
+#include "VirtualConemap.h"
+
+namespace
+{
+    const uint32_t kMaxTextureSize = 16384; // D3D12 limit of a 2D texture side
+    const uint32_t kMaxAlbedoScale = 16;
+    const uint32_t kTailBlockSize = 8;      // conemap texels per texel of the low resolution conemap written by write()
+
+    /** Largest number of cache slots that fit in the tile count and the physical textures.
+    */
+    uint32_t getCacheSlotCount(const CpuConemap::TiledConemapHeader& header, uint32_t requested)
+    {
+        const uint32_t maxTilesPerSide = kMaxTextureSize / std::max(header.tileSize, header.getAlbedoTileSize());
+        uint32_t slots = std::min(requested, header.getTileCount());
+        slots = std::min(slots, maxTilesPerSide * maxTilesPerSide);
+        return std::max(slots, 1u);
+    }
+}
+
+VirtualConemap::SharedPtr VirtualConemap::create(const std::string& filename, uint32_t cacheSlots, uint32_t maxLoadsPerFrame, RenderContext* pRenderContext)
+{
+    SharedPtr pVirtual(new VirtualConemap(filename, cacheSlots, maxLoadsPerFrame));
+    const auto& header = pVirtual->mReader.getHeader();
+
+    const uint32_t slots = pVirtual->mResidency.getSlotCount();
+    pVirtual->mCacheTilesX = (uint32_t)std::ceil(std::sqrt((double)slots));
+    const uint32_t cacheTilesY = (slots + pVirtual->mCacheTilesX - 1) / pVirtual->mCacheTilesX;
+
+    pVirtual->mpPageTable = Texture::create2D(header.tilesX, header.tilesY, ResourceFormat::R32Uint, 1, 1, pVirtual->mResidency.getPageTable().data(), ResourceBindFlags::ShaderResource);
+    pVirtual->mpPageTable->setName("Virtual conemap page table");
+    pVirtual->mpConemapCache = Texture::create2D(pVirtual->mCacheTilesX * header.tileSize, cacheTilesY * header.tileSize, ResourceFormat::RG16Unorm, 1, 1, nullptr, ResourceBindFlags::ShaderResource);
+    pVirtual->mpConemapCache->setName("Virtual conemap cache");
+    const uint32_t albedoTileSize = std::max(1u, header.getAlbedoTileSize());
+    pVirtual->mpAlbedoCache = header.albedoScale
+        ? Texture::create2D(pVirtual->mCacheTilesX * albedoTileSize, cacheTilesY * albedoTileSize, ResourceFormat::RGBA8UnormSrgb, 1, 1, nullptr, ResourceBindFlags::ShaderResource)
+        : Texture::create2D(1, 1, ResourceFormat::RGBA8UnormSrgb, 1, 1, nullptr, ResourceBindFlags::ShaderResource);
+    pVirtual->mpAlbedoCache->setName("Virtual albedo cache");
+
+    // without a low resolution conemap, the missing tiles are flat
+    std::vector<uint16_t> tail = pVirtual->mReader.readTailData();
+    if (tail.empty()) tail = { 0, 0xffff };
+    pVirtual->mpTail = Texture::create2D(std::max(1u, header.tailWidth), std::max(1u, header.tailHeight), ResourceFormat::RG16Unorm, 1, 1, tail.data(), ResourceBindFlags::ShaderResource);
+    pVirtual->mpTail->setName("Virtual conemap tail");
+
+    pVirtual->mpFeedback = Buffer::createStructured(sizeof(uint32_t), pVirtual->mResidency.getFeedbackWordCount(), ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
+    pRenderContext->clearUAV(pVirtual->mpFeedback->getUAV().get(), uint4(0));
+    pVirtual->mpFeedbackReadback = Buffer::create(pVirtual->mResidency.getFeedbackWordCount() * sizeof(uint32_t), ResourceBindFlags::None, Buffer::CpuAccess::Read);
+    pVirtual->mpFeedbackFence = GpuFence::create();
+    return pVirtual;
+}
+
+VirtualConemap::VirtualConemap(const std::string& filename, uint32_t cacheSlots, uint32_t maxLoadsPerFrame)
+    : mFilename(filename)
+    , mReader(filename)
+    , mResidency(mReader.getHeader().tilesX, mReader.getHeader().tilesY, getCacheSlotCount(mReader.getHeader(), cacheSlots), maxLoadsPerFrame)
+{
+}
+
+void VirtualConemap::write(const std::string& filename, const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pAlbedo, uint32_t tileSize, RenderContext* pRenderContext)
+{
+    if (pConemap->getFormat() == ResourceFormat::R16Uint) throw std::runtime_error("Packed conemaps cannot be written as virtual conemaps");
+    const uint32_t w = pConemap->getWidth();
+    const uint32_t h = pConemap->getHeight();
+
+    // the float values the shaders see
+    CpuConemap::Conemap conemap;
+    {
+        auto pFloatTex = Texture::create2D(w, h, ResourceFormat::RG32Float, 1, 1, nullptr, ResourceBindFlags::RenderTarget);
+        pRenderContext->blit(pConemap->getSRV(0, 1), pFloatTex->getRTV());
+        std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pFloatTex.get(), 0);
+        conemap.width = w;
+        conemap.height = h;
+        conemap.texels.resize(2 * size_t(w) * h);
+        std::memcpy(conemap.texels.data(), data.data(), conemap.texels.size() * sizeof(float));
+    }
+
+    // albedo resampled to an integer number of texels per conemap texel
+    uint32_t albedoScale = 0;
+    std::vector<uint8_t> albedo;
+    if (pAlbedo)
+    {
+        albedoScale = std::max(1u, std::min({ pAlbedo->getWidth() / w, pAlbedo->getHeight() / h, kMaxAlbedoScale, kMaxTextureSize / std::max(w, h) }));
+        auto pAlbedoTex = Texture::create2D(w * albedoScale, h * albedoScale, ResourceFormat::RGBA8UnormSrgb, 1, 1, nullptr, ResourceBindFlags::RenderTarget);
+        pRenderContext->blit(pAlbedo->getSRV(0, 1), pAlbedoTex->getRTV());
+        albedo = pRenderContext->readTextureSubresource(pAlbedoTex.get(), 0);
+    }
+
+    CpuConemap::TiledConemapWriter writer(filename, w, h, tileSize, albedoScale);
+    const auto& header = writer.getHeader();
+    std::vector<uint8_t> albedoTile;
+    for (uint32_t ty = 0; ty < header.tilesY; ++ty)
+    {
+        for (uint32_t tx = 0; tx < header.tilesX; ++tx)
+        {
+            CpuConemap::Conemap tile;
+            tile.width = header.getTileWidth(tx);
+            tile.height = header.getTileHeight(ty);
+            tile.texels.resize(2 * size_t(tile.width) * tile.height);
+            for (uint32_t y = 0; y < tile.height; ++y)
+            {
+                const float* src = conemap.texels.data() + 2 * (size_t(ty * tileSize + y) * w + tx * tileSize);
+                std::copy(src, src + 2 * tile.width, tile.texels.data() + 2 * size_t(y) * tile.width);
+            }
+            if (albedoScale)
+            {
+                const size_t rowBytes = size_t(tile.width) * albedoScale * 4;
+                albedoTile.resize(rowBytes * tile.height * albedoScale);
+                for (uint32_t y = 0; y < tile.height * albedoScale; ++y)
+                {
+                    const uint8_t* src = albedo.data() + (size_t(ty * tileSize * albedoScale + y) * w * albedoScale + size_t(tx) * tileSize * albedoScale) * 4;
+                    std::memcpy(albedoTile.data() + y * rowBytes, src, rowBytes);
+                }
+            }
+            writer.writeTile(tx, ty, tile, albedoScale ? albedoTile.data() : nullptr);
+        }
+    }
+
+    // low resolution conemap of the block maxima, shown while the tiles are loaded
+    CpuConemap::Heightmap envelope;
+    envelope.width = (w + kTailBlockSize - 1) / kTailBlockSize;
+    envelope.height = (h + kTailBlockSize - 1) / kTailBlockSize;
+    envelope.texels.assign(size_t(envelope.width) * envelope.height, 0.f);
+    for (uint32_t y = 0; y < h; ++y)
+    {
+        for (uint32_t x = 0; x < w; ++x)
+        {
+            float& e = envelope.texels[size_t(y / kTailBlockSize) * envelope.width + x / kTailBlockSize];
+            e = std::max(e, conemap.getHeight(x, y));
+        }
+    }
+    writer.writeTail(CpuConemap::bake(envelope, CpuConemap::Settings()), kTailBlockSize);
+}
+
+void VirtualConemap::beginFrame(const GraphicsVars::SharedPtr& pVars, RenderContext* pRenderContext)
+{
+    const auto& header = mReader.getHeader();
+    pVars["VTcb"]["vtSize"] = getSize();
+    pVars["VTcb"]["vtTilesX"] = header.tilesX;
+    pVars["VTcb"]["vtTileSize"] = header.tileSize;
+    pVars["VTcb"]["vtCacheTilesX"] = mCacheTilesX;
+    pVars["VTcb"]["vtAlbedoScale"] = header.albedoScale;
+    // without a low resolution conemap, every texel maps to the single flat texel
+    pVars["VTcb"]["vtTailBlockSize"] = header.tailWidth ? header.tailBlockSize : std::max(header.width, header.height);
+    pVars["gPageTable"] = mpPageTable;
+    pVars["gConemapCache"] = mpConemapCache;
+    pVars["gAlbedoCache"] = mpAlbedoCache;
+    pVars["gConemapTail"] = mpTail;
+    pVars["gTileFeedback"] = mpFeedback;
+    pRenderContext->clearUAV(mpFeedback->getUAV().get(), uint4(0));
+}
+
+void VirtualConemap::endFrame(RenderContext* pRenderContext)
+{
+    PROFILE("VirtualConemap::endFrame");
+    if (mFeedbackPending)
+    {
+        // submitted with the previous frame, normally done by now
+        mpFeedbackFence->syncCpu();
+        std::vector<uint32_t> feedback(mResidency.getFeedbackWordCount());
+        const uint32_t* pBits = static_cast<const uint32_t*>(mpFeedbackReadback->map(Buffer::MapType::Read));
+        std::copy(pBits, pBits + feedback.size(), feedback.begin());
+        mpFeedbackReadback->unmap();
+        uploadTiles(mResidency.update(feedback), pRenderContext);
+    }
+
+    // submit and read the feedback in the next frame, to avoid a GPU flush
+    pRenderContext->copyResource(mpFeedbackReadback.get(), mpFeedback.get());
+    pRenderContext->flush(false);
+    mpFeedbackFence->gpuSignal(pRenderContext->getLowLevelData()->getCommandQueue());
+    mFeedbackPending = true;
+}
+
+void VirtualConemap::uploadTiles(const std::vector<CpuConemap::ResidencyManager::TileLoad>& loads, RenderContext* pRenderContext)
+{
+    mLastLoads = (uint32_t)loads.size();
+    if (loads.empty()) return;
+
+    const auto& header = mReader.getHeader();
+    std::vector<uint16_t> conemap;
+    std::vector<uint8_t> albedo;
+    for (const auto& load : loads)
+    {
+        mReader.readTileData(load.tile % header.tilesX, load.tile / header.tilesX, conemap, albedo);
+        const uint2 slot = { load.slot % mCacheTilesX, load.slot / mCacheTilesX };
+        const uint32_t size = header.tileSize;
+        pRenderContext->updateSubresourceData(mpConemapCache.get(), 0, conemap.data(), uint3(slot * size, 0), uint3(size, size, 1));
+        if (header.albedoScale)
+        {
+            const uint32_t albedoSize = header.getAlbedoTileSize();
+            pRenderContext->updateSubresourceData(mpAlbedoCache.get(), 0, albedo.data(), uint3(slot * albedoSize, 0), uint3(albedoSize, albedoSize, 1));
+        }
+    }
+    pRenderContext->updateTextureData(mpPageTable.get(), mResidency.getPageTable().data());
+}
+
+std::string VirtualConemap::getStatsString() const
+{
+    const auto& header = mReader.getHeader();
+    const auto& stats = mResidency.getStats();
+    std::string s = std::to_string(header.width) + " x " + std::to_string(header.height) + ", " + std::to_string(header.tilesX * header.tilesY) + " tiles of " + std::to_string(header.tileSize) + "^2";
+    if (header.albedoScale) s += ", albedo x" + std::to_string(header.albedoScale);
+    s += "\nresident: " + std::to_string(mResidency.getResidentCount()) + " / " + std::to_string(mResidency.getSlotCount())
+        + ", requested: " + std::to_string(stats.requestedTiles)
+        + ", missing: " + std::to_string(stats.missingTiles)
+        + "\nloads: " + std::to_string(stats.loads) + " (last frame " + std::to_string(mLastLoads) + ")"
+        + ", evictions: " + std::to_string(stats.evictions);
+    return s;
+}
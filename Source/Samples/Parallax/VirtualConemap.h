@@ -0,0 +1,69 @@
+#pragma once
+#include "Falcor.h"
+#include "TiledConemapFile.h"
+#include "TileResidency.h"
+
+using namespace Falcor;
+
+/** Virtual (sparse tiled) conemap, renders tiled conemap files that do not fit in a texture.
+    The shader (CONEMAP_VIRTUAL in Parallax.ps.slang) translates every texel fetch through
+    a page table into a physical cache of resident tiles, and sets a feedback bit for every
+    tile it touched. After the frame, the feedback is copied to a readback buffer, which is
+    read a frame later so the GPU is never stalled, and the residency manager
+    (CpuConemap/TileResidency.h) picks the tiles to load, evicting the least recently used
+    ones; they are read from the file and uploaded to the cache. Tiles that are not resident
+    are sampled from the low resolution conemap of the file. The page table covers the
+    albedo too, if the file has albedo tiles.
+*/
+class VirtualConemap
+{
+public:
+    using SharedPtr = std::shared_ptr<VirtualConemap>;
+
+    /** Opens a tiled conemap file. Throws if the file cannot be read.
+        \param[in] cacheSlots Tiles in the physical cache, clamped to the tile count and the texture size limit.
+        \param[in] maxLoadsPerFrame Largest number of tiles uploaded after a frame, 0 means no limit.
+    */
+    static SharedPtr create(const std::string& filename, uint32_t cacheSlots, uint32_t maxLoadsPerFrame, RenderContext* pRenderContext);
+
+    /** Writes a conemap and an optional albedo texture as a tiled conemap file.
+        The albedo is resampled to an integer multiple of the conemap size. Throws if the file cannot be written.
+        \param[in] pConemap RG conemap (8, 16 bit unorm, float or BC5).
+    */
+    static void write(const std::string& filename, const Texture::SharedPtr& pConemap, const Texture::SharedPtr& pAlbedo, uint32_t tileSize, RenderContext* pRenderContext);
+
+    /** Binds the page table, the caches and the constants, and clears the feedback.
+    */
+    void beginFrame(const GraphicsVars::SharedPtr& pVars, RenderContext* pRenderContext);
+
+    /** Uploads the tiles requested by the feedback of the previous frame and the page table,
+        then submits the copy of the feedback of this frame, which is read by the next call.
+    */
+    void endFrame(RenderContext* pRenderContext);
+
+    uint2 getSize() const { return { mReader.getHeader().width, mReader.getHeader().height }; }
+    bool hasAlbedo() const { return mReader.getHeader().albedoScale != 0; }
+    const std::string& getFilename() const { return mFilename; }
+    std::string getStatsString() const;
+
+private:
+    VirtualConemap(const std::string& filename, uint32_t cacheSlots, uint32_t maxLoadsPerFrame);
+
+    /** Reads the tiles from the file and uploads them to their slots, then uploads the page table.
+    */
+    void uploadTiles(const std::vector<CpuConemap::ResidencyManager::TileLoad>& loads, RenderContext* pRenderContext);
+
+    std::string mFilename;
+    CpuConemap::TiledConemapReader mReader;
+    CpuConemap::ResidencyManager mResidency;
+    uint32_t mCacheTilesX = 0;          // tiles per row of the physical caches
+    Texture::SharedPtr mpPageTable;     // R32Uint, one texel per virtual tile: slot + 1, 0 if not resident
+    Texture::SharedPtr mpConemapCache;  // RG16Unorm physical tiles
+    Texture::SharedPtr mpAlbedoCache;   // RGBA8UnormSrgb physical tiles, 1x1 if the file has no albedo
+    Texture::SharedPtr mpTail;          // RG16Unorm low resolution conemap
+    Buffer::SharedPtr mpFeedback;       // one bit per virtual tile
+    Buffer::SharedPtr mpFeedbackReadback; // copy of mpFeedback, read in the next frame
+    GpuFence::SharedPtr mpFeedbackFence;
+    bool mFeedbackPending = false;      // mpFeedbackReadback holds the feedback of the previous frame
+    uint32_t mLastLoads = 0;
+};
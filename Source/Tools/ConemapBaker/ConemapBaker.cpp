@@ -0,0 +1,344 @@
+#include "CpuConemap.h"
+#include "ConemapEncode.h"
+#include "StreamingBake.h"
+#include <FreeImage.h>
+#include <args.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace CpuConemap;
+
+namespace
+{
+    template<typename T>
+    T clamp(T x, T lo, T hi) { return std::max(lo, std::min(hi, x)); }
+
+    /** Loads the red channel of an image as heights. The first row of the result is the top row of the image.
+    */
+    Heightmap loadHeightmap(const std::string& filename)
+    {
+        FREE_IMAGE_FORMAT fifFormat = FreeImage_GetFileType(filename.c_str(), 0);
+        if (fifFormat == FIF_UNKNOWN) fifFormat = FreeImage_GetFIFFromFilename(filename.c_str());
+        if (fifFormat == FIF_UNKNOWN) throw std::runtime_error("Unknown image format");
+        if (!FreeImage_FIFSupportsReading(fifFormat)) throw std::runtime_error("Unsupported image format");
+
+        FIBITMAP* srcBitmap = FreeImage_Load(fifFormat, filename.c_str());
+        if (!srcBitmap) throw std::runtime_error("Cannot read image");
+
+        // Convert to RGBA32F, this handles 8 and 16 bit grayscale and color images as well.
+        FIBITMAP* floatBitmap = FreeImage_ConvertToRGBAF(srcBitmap);
+        FreeImage_Unload(srcBitmap);
+        if (!floatBitmap) throw std::runtime_error("Cannot convert to RGBA float format");
+
+        Heightmap hmap;
+        hmap.width = FreeImage_GetWidth(floatBitmap);
+        hmap.height = FreeImage_GetHeight(floatBitmap);
+        hmap.texels.resize(size_t(hmap.width) * hmap.height);
+        for (uint32_t y = 0; y < hmap.height; ++y)
+        {
+            // FreeImage stores the bottom row first
+            const FIRGBAF* src = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(floatBitmap, hmap.height - y - 1));
+            for (uint32_t x = 0; x < hmap.width; ++x) hmap.texels[size_t(y) * hmap.width + x] = clamp(src[x].red, 0.f, 1.f);
+        }
+        FreeImage_Unload(floatBitmap);
+        return hmap;
+    }
+
+    /** Saves the conemap to the red (height) and green (cone ratio) channels of an image.
+        EXR and PFM files store 32 bit floats, other formats store unorm values with `bits` bits per channel.
+    */
+    void saveConemap(const Conemap& conemap, const std::string& filename, uint32_t bits)
+    {
+        FREE_IMAGE_FORMAT fifFormat = FreeImage_GetFIFFromFilename(filename.c_str());
+        if (fifFormat == FIF_UNKNOWN) throw std::runtime_error("Unknown image format");
+        if (!FreeImage_FIFSupportsWriting(fifFormat)) throw std::runtime_error("Unsupported image format");
+
+        const uint32_t w = conemap.width;
+        const uint32_t h = conemap.height;
+        const bool writeFloat = fifFormat == FIF_EXR || fifFormat == FIF_PFM;
+        const bool write16 = !writeFloat && bits == 16;
+        if (write16 && fifFormat != FIF_PNG && fifFormat != FIF_TIFF) throw std::runtime_error("16 bit output is only supported for PNG and TIFF files");
+
+        FIBITMAP* bitmap = writeFloat ? FreeImage_AllocateT(FIT_RGBF, w, h) : write16 ? FreeImage_AllocateT(FIT_RGB16, w, h) : FreeImage_Allocate(w, h, 24);
+        if (!bitmap) throw std::runtime_error("Cannot allocate image");
+        // the cones of the unorm outputs are narrowed by the rounding of the heights, see encodeUnormRG
+        std::vector<uint16_t> unorm;
+        if (!writeFloat) unorm = encodeUnormRG(conemap, write16 ? 16 : 8);
+        for (uint32_t y = 0; y < h; ++y)
+        {
+            BYTE* dst = FreeImage_GetScanLine(bitmap, h - y - 1);
+            for (uint32_t x = 0; x < w; ++x)
+            {
+                const size_t ind = 2 * (size_t(y) * w + x);
+                if (writeFloat)
+                {
+                    FIRGBF* p = reinterpret_cast<FIRGBF*>(dst) + x;
+                    p->red = conemap.getHeight(x, y);
+                    p->green = conemap.getCone(x, y);
+                    p->blue = 0.f;
+                }
+                else if (write16)
+                {
+                    FIRGB16* p = reinterpret_cast<FIRGB16*>(dst) + x;
+                    p->red = WORD(unorm[ind + 0]);
+                    p->green = WORD(unorm[ind + 1]);
+                    p->blue = 0;
+                }
+                else
+                {
+                    BYTE* p = dst + 3 * x;
+                    p[FI_RGBA_RED] = BYTE(unorm[ind + 0]);
+                    p[FI_RGBA_GREEN] = BYTE(unorm[ind + 1]);
+                    p[FI_RGBA_BLUE] = 0;
+                }
+            }
+        }
+        bool saved = FreeImage_Save(fifFormat, bitmap, filename.c_str());
+        FreeImage_Unload(bitmap);
+        if (!saved) throw std::runtime_error("Cannot write image");
+    }
+
+    enum class OutputFormat
+    {
+        RG,         // height and cone ratio in the red and green channels of a regular image
+        BC5,        // BC5Unorm DDS file
+        PackedR16,  // R16Uint DDS file, see CpuConemap::packHeightCone
+    };
+
+    // DXGI_FORMAT values of the DDS DX10 header
+    const uint32_t kDxgiFormatR16Uint = 57;
+    const uint32_t kDxgiFormatBC5Unorm = 83;
+
+    /** Writes a single 2D texture with the DDS DX10 header, which loads with Falcor's ImageIO (DirectXTex).
+        \param[in] pitch Bytes per row of texels, or per row of 4x4 blocks for block compressed formats.
+    */
+    void writeDDS(const std::string& filename, uint32_t width, uint32_t height, uint32_t dxgiFormat, bool blockCompressed, uint32_t pitch, const void* data, size_t size)
+    {
+        uint32_t header[1 + 31 + 5] = {};
+        header[0] = 0x20534444; // "DDS "
+        uint32_t* dds = header + 1;
+        dds[0] = 124; // header size
+        dds[1] = 0x1 | 0x2 | 0x4 | 0x1000 | (blockCompressed ? 0x80000 : 0x8); // caps, height, width, pixel format, linear size or pitch
+        dds[2] = height;
+        dds[3] = width;
+        dds[4] = blockCompressed ? uint32_t(size) : pitch;
+        dds[6] = 1; // mip count
+        uint32_t* pixelFormat = dds + 18;
+        pixelFormat[0] = 32;          // pixel format size
+        pixelFormat[1] = 0x4;         // DDPF_FOURCC
+        pixelFormat[2] = 0x30315844;  // "DX10"
+        dds[26] = 0x1000;             // DDSCAPS_TEXTURE
+        uint32_t* dx10 = dds + 31;
+        dx10[0] = dxgiFormat;
+        dx10[1] = 3; // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+        dx10[3] = 1; // array size
+
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) throw std::runtime_error("Cannot open output file");
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data), size);
+        if (!file) throw std::runtime_error("Cannot write DDS file");
+    }
+
+    /** Saves the conemap in one of the compact formats and returns the largest errors of the encoding.
+    */
+    EncodeError saveEncodedConemap(const Conemap& conemap, const std::string& filename, OutputFormat format)
+    {
+        const uint32_t w = conemap.width;
+        const uint32_t h = conemap.height;
+        if (format == OutputFormat::BC5)
+        {
+            std::vector<uint8_t> blocks = encodeBC5(conemap);
+            writeDDS(filename, w, h, kDxgiFormatBC5Unorm, true, ((w + 3) / 4) * 16, blocks.data(), blocks.size());
+            return measureEncodeError(conemap, decodeBC5(blocks, w, h));
+        }
+        else
+        {
+            std::vector<uint16_t> packed = encodePackedR16(conemap);
+            writeDDS(filename, w, h, kDxgiFormatR16Uint, false, w * 2, packed.data(), packed.size() * sizeof(uint16_t));
+            return measureEncodeError(conemap, decodePackedR16(packed, w, h));
+        }
+    }
+
+    /** Streaming bake of a raw height map into a tiled cone map file, see StreamingBake.h.
+    */
+    int bakeRaw(const std::string& input, const std::string& output, const std::string& size, const std::string& rawFormat, const Settings& settings, uint32_t tileSize, uint32_t maxHalo, bool verbose)
+    {
+        uint32_t width = 0, height = 0;
+        char separator = 0;
+        std::istringstream sizeStream(size);
+        if (!(sizeStream >> width >> separator >> height) || separator != 'x' || width == 0 || height == 0)
+        {
+            std::cerr << "Invalid raw size '" << size << "', expected WxH." << std::endl;
+            return 1;
+        }
+        RawFormat format;
+        if (!parseRawFormat(rawFormat, format))
+        {
+            std::cerr << "Unknown raw format '" << rawFormat << "'." << std::endl;
+            return 1;
+        }
+        if (settings.algorithm != Algorithm::Conservative)
+        {
+            std::cerr << "Raw height maps are only baked with conservative cones." << std::endl;
+            return 1;
+        }
+
+        StreamingSettings streaming;
+        streaming.tileSize = tileSize;
+        streaming.maxHalo = maxHalo;
+        streaming.threadCount = settings.threadCount;
+        if (tileSize == 0 || tileSize % streaming.blockSize != 0)
+        {
+            std::cerr << "The tile size must be a multiple of " << streaming.blockSize << "." << std::endl;
+            return 1;
+        }
+
+        try
+        {
+            RawHeightmapFile hmap(input, width, height, format);
+            StreamingStats stats;
+            bakeStreaming(hmap, output, streaming, &stats);
+            if (verbose)
+            {
+                std::cout << input << ": " << width << "x" << height
+                    << ", " << stats.seconds << " s (minmax pass " << stats.pyramidSeconds << " s)"
+                    << ", threads: " << stats.threadCount << " (" << getSimdName() << ")"
+                    << ", stolen tiles: " << stats.stolenTiles
+                    << ", tested texels: " << stats.testedTexels << std::endl;
+                std::cout << "tiles: " << stats.tileCount << ", exact: " << stats.exactTiles
+                    << ", largest needed halo: " << stats.largestHalo
+                    << ", peak window: " << stats.peakWindowTexels << " texels" << std::endl;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Cannot bake '" << input << "' (Error: " << e.what() << ")." << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    args::ArgumentParser parser("Bakes a cone map from a height map on the CPU.");
+    parser.helpParams.programName = "ConemapBaker";
+    args::HelpFlag helpFlag(parser, "help", "Display this help menu.", {'h', "help"});
+    args::ValueFlag<std::string> algorithmFlag(parser, "algorithm", "Generator: conservative (default), relaxed, quick-naive, quick (region growing 3x3), quick-5x5, quick-7x7 or quick-adaptive (region growing with larger rings).", {'a', "algorithm"});
+    args::ValueFlag<uint32_t> searchStepsFlag(parser, "steps", "Search steps of the relaxed cones (default: 64).", {'s', "search-steps"});
+    args::Flag centerFlag(parser, "", "Use the texel center heuristic for the quick generators.", {'c', "center"});
+    args::ValueFlag<uint32_t> threadsFlag(parser, "threads", "Number of threads (default: all hardware threads).", {'j', "threads"});
+    args::ValueFlag<uint32_t> tileFlag(parser, "size", "Size of the scheduled tiles in texels (default: 32).", {'t', "tile"});
+    args::ValueFlag<uint32_t> bitsFlag(parser, "bits", "Bits per channel of unorm outputs, 8 or 16 (default: 16).", {'b', "bits"});
+    args::ValueFlag<std::string> formatFlag(parser, "format", "Output format: rg (default), bc5 or packed (R16, 10 bit height and 6 bit sqrt cone). bc5 and packed write DDS files.", {'f', "format"});
+    args::ValueFlag<std::string> rawFlag(parser, "WxH", "The input is a headerless raw height map of this size. It is baked out of core, tile by tile, into a tiled cone map file (conservative cones only).", {"raw"});
+    args::ValueFlag<std::string> rawFormatFlag(parser, "format", "Texel format of the raw height map: u16 (default) or f32.", {"raw-format"});
+    args::ValueFlag<uint32_t> streamTileFlag(parser, "size", "Size of the tiles of the raw bake and the tiled output in texels, a multiple of 64 (default: 1024).", {"stream-tile"});
+    args::ValueFlag<uint32_t> haloFlag(parser, "texels", "Largest halo loaded around a tile of the raw bake. Texels farther away are bounded by a coarse minmax pyramid (default: 1024).", {"halo"});
+    args::Flag verboseFlag(parser, "", "Print statistics of the bake.", {'v', "verbose"});
+    args::Positional<std::string> inputFlag(parser, "heightmap", "The input height map, heights are read from the red channel.", args::Options::Required);
+    args::Positional<std::string> outputFlag(parser, "conemap", "The output cone map, [height, cone ratio] in the red and green channels.", args::Options::Required);
+    args::CompletionFlag completionFlag(parser, {"complete"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (const args::Completion& e)
+    {
+        std::cout << e.what();
+        return 0;
+    }
+    catch (const args::Help&)
+    {
+        std::cout << parser;
+        return 0;
+    }
+    catch (const args::ParseError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const args::RequiredError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    Settings settings;
+    if (algorithmFlag && !parseAlgorithm(args::get(algorithmFlag), settings.algorithm))
+    {
+        std::cerr << "Unknown algorithm '" << args::get(algorithmFlag) << "'." << std::endl;
+        return 1;
+    }
+    if (searchStepsFlag) settings.relaxedConeSearchSteps = std::max(1u, args::get(searchStepsFlag));
+    if (threadsFlag) settings.threadCount = args::get(threadsFlag);
+    if (tileFlag) settings.tileSize = std::max(1u, args::get(tileFlag));
+    settings.maxAtTexelCenter = centerFlag;
+    uint32_t bits = bitsFlag ? args::get(bitsFlag) : 16;
+    if (bits != 8 && bits != 16)
+    {
+        std::cerr << "Bits per channel must be 8 or 16." << std::endl;
+        return 1;
+    }
+
+    OutputFormat format = OutputFormat::RG;
+    if (formatFlag)
+    {
+        const std::string& name = args::get(formatFlag);
+        if (name == "bc5") format = OutputFormat::BC5;
+        else if (name == "packed") format = OutputFormat::PackedR16;
+        else if (name != "rg")
+        {
+            std::cerr << "Unknown output format '" << name << "'." << std::endl;
+            return 1;
+        }
+    }
+
+    if (rawFlag) return bakeRaw(args::get(inputFlag), args::get(outputFlag), args::get(rawFlag), rawFormatFlag ? args::get(rawFormatFlag) : "u16",
+        settings, streamTileFlag ? args::get(streamTileFlag) : StreamingSettings().tileSize, haloFlag ? args::get(haloFlag) : StreamingSettings().maxHalo, verboseFlag);
+
+    FreeImage_Initialise();
+    int result = 0;
+    try
+    {
+        Heightmap hmap = loadHeightmap(args::get(inputFlag));
+        BakeStats stats;
+        Conemap conemap = bake(hmap, settings, &stats);
+        EncodeError encodeError;
+        if (format == OutputFormat::RG) saveConemap(conemap, args::get(outputFlag), bits);
+        else encodeError = saveEncodedConemap(conemap, args::get(outputFlag), format);
+
+        if (verboseFlag)
+        {
+            std::cout << args::get(inputFlag) << ": " << hmap.width << "x" << hmap.height
+                << ", algorithm: " << to_string(settings.algorithm)
+                << ", " << stats.seconds << " s"
+                << ", threads: " << stats.threadCount << " (" << getSimdName() << ")"
+                << ", stolen tiles: " << stats.stolenTiles
+                << ", tested texels: " << stats.testedTexels << std::endl;
+            if (format != OutputFormat::RG)
+            {
+                std::cout << "encoding error: height " << encodeError.maxHeightError
+                    << ", cone " << encodeError.maxConeError
+                    << ", wider cones: " << encodeError.wideCones << std::endl;
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Cannot bake '" << args::get(inputFlag) << "' (Error: " << e.what() << ")." << std::endl;
+        result = 1;
+    }
+    FreeImage_DeInitialise();
+    return result;
+}
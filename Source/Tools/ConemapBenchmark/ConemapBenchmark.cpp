@@ -0,0 +1,501 @@
+#include "CpuConemap.h"
+#include "HeightfieldTrace.h"
+#include "TileScheduler.h"
+#include <FreeImage.h>
+#include <args.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace CpuConemap;
+
+namespace
+{
+    const uint32_t kRaySeed = 0x5eed;
+    const uint32_t kShadowRaySeed = 0x54ad;
+    const uint32_t kRaysPerTask = 256;
+
+    /** Loads the red channel of an image as heights, see ConemapBaker.
+    */
+    Heightmap loadHeightmap(const std::string& filename)
+    {
+        FREE_IMAGE_FORMAT fifFormat = FreeImage_GetFileType(filename.c_str(), 0);
+        if (fifFormat == FIF_UNKNOWN) fifFormat = FreeImage_GetFIFFromFilename(filename.c_str());
+        if (fifFormat == FIF_UNKNOWN) throw std::runtime_error("Unknown image format");
+        if (!FreeImage_FIFSupportsReading(fifFormat)) throw std::runtime_error("Unsupported image format");
+
+        FIBITMAP* srcBitmap = FreeImage_Load(fifFormat, filename.c_str());
+        if (!srcBitmap) throw std::runtime_error("Cannot read image");
+        FIBITMAP* floatBitmap = FreeImage_ConvertToRGBAF(srcBitmap);
+        FreeImage_Unload(srcBitmap);
+        if (!floatBitmap) throw std::runtime_error("Cannot convert to RGBA float format");
+
+        Heightmap hmap;
+        hmap.width = FreeImage_GetWidth(floatBitmap);
+        hmap.height = FreeImage_GetHeight(floatBitmap);
+        hmap.texels.resize(size_t(hmap.width) * hmap.height);
+        for (uint32_t y = 0; y < hmap.height; ++y)
+        {
+            // FreeImage stores the bottom row first
+            const FIRGBAF* src = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(floatBitmap, hmap.height - y - 1));
+            for (uint32_t x = 0; x < hmap.width; ++x) hmap.texels[size_t(y) * hmap.width + x] = std::max(0.f, std::min(1.f, src[x].red));
+        }
+        FreeImage_Unload(floatBitmap);
+        return hmap;
+    }
+
+    /** Expands the inputs: images are used as they are, .txt files list one image per line
+        (relative to the list, empty lines and lines starting with '#' are skipped).
+    */
+    std::vector<std::string> expandInputs(const std::vector<std::string>& inputs)
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::string> files;
+        for (const auto& input : inputs)
+        {
+            fs::path path(input);
+            if (path.extension() != ".txt")
+            {
+                files.push_back(input);
+                continue;
+            }
+            std::ifstream list(input);
+            if (!list) throw std::runtime_error("Cannot open list '" + input + "'");
+            std::string line;
+            while (std::getline(list, line))
+            {
+                line.erase(0, line.find_first_not_of(" \t"));
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (line.empty() || line[0] == '#') continue;
+                fs::path file(line);
+                files.push_back((file.is_relative() ? path.parent_path() / file : file).string());
+            }
+        }
+        return files;
+    }
+
+    struct Variant
+    {
+        Algorithm algorithm;
+        bool maxAtTexelCenter;
+
+        std::string getName() const { return std::string(to_string(algorithm)) + (maxAtTexelCenter ? "+center" : ""); }
+    };
+
+    std::vector<Variant> getVariants(Algorithm algorithm)
+    {
+        if (algorithm == Algorithm::Conservative || algorithm == Algorithm::Relaxed) return { { algorithm, false } };
+        return { { algorithm, false }, { algorithm, true } };
+    }
+
+    /** Deterministic rays from height 1 to height 0, uniform origins and directions,
+        the texture space length of u2 - u is uniform in [0, maxOffset].
+    */
+    std::vector<TraceRay> generateRays(uint32_t count, float maxOffset)
+    {
+        std::mt19937 rng(kRaySeed);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::vector<TraceRay> rays(count);
+        for (auto& ray : rays)
+        {
+            const float angle = 2.f * 3.14159265f * uniform(rng);
+            const float offset = maxOffset * uniform(rng);
+            ray.u[0] = uniform(rng);
+            ray.u[1] = uniform(rng);
+            ray.u2[0] = ray.u[0] + offset * std::cos(angle);
+            ray.u2[1] = ray.u[1] + offset * std::sin(angle);
+        }
+        return rays;
+    }
+
+    /** Deterministic self-shadow rays from uniform points of the height field, uniform light azimuths,
+        the texture space length of the light direction per unit height is uniform in [0, maxOffset].
+    */
+    std::vector<ShadowRay> generateShadowRays(uint32_t count, float maxOffset)
+    {
+        std::mt19937 rng(kShadowRaySeed);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::vector<ShadowRay> rays(count);
+        for (auto& ray : rays)
+        {
+            const float angle = 2.f * 3.14159265f * uniform(rng);
+            const float offset = maxOffset * uniform(rng);
+            ray.u[0] = uniform(rng);
+            ray.u[1] = uniform(rng);
+            ray.light[0] = offset * std::cos(angle);
+            ray.light[1] = offset * std::sin(angle);
+            ray.light[2] = 1.f;
+        }
+        return rays;
+    }
+
+    struct ShadowStats
+    {
+        double meanSteps = 0.0;
+        double meanError = 0.0; // mean |visibility - reference visibility|
+        double leakRate = 0.0;  // rays lit more than half where the reference is shadowed more than half
+    };
+
+    struct Result
+    {
+        std::string texture;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::string variant;
+        double bakeSeconds = 0.0;
+        uint64_t testedTexels = 0;
+        double meanCone = 0.0;
+        double coneVolumeRatio = 0.0;   // sum of cone volumes relative to the exact conservative cones
+        double meanTightness = 0.0;     // mean of the cone ratios relative to the exact conservative cones, over the texels with a nonzero exact cone
+        double meanSteps = 0.0;
+        uint32_t p99Steps = 0;
+        uint32_t maxSteps = 0;
+        double missRate = 0.0;          // rays that ran out of steps
+        double overshootRate = 0.0;     // rays that stopped more than a texel past the first intersection
+        double meanError = 0.0;         // mean |t - reference t| of the rays that did not run out of steps
+        ShadowStats shadow;             // cone traced self-shadowing (SELF_SHADOW 2)
+        ShadowStats linearShadow;       // linear march self-shadowing (SELF_SHADOW 1), the same for every variant
+    };
+
+    /** Volume of the cones above the texels, the cone of a texel with ratio c and height h has a volume proportional to c^2 (1 - h)^3.
+    */
+    double getConeVolume(const Conemap& conemap)
+    {
+        double volume = 0.0;
+        for (size_t i = 0; i < conemap.texels.size(); i += 2)
+        {
+            const double depth = 1.0 - conemap.texels[i];
+            const double cone = conemap.texels[i + 1];
+            volume += cone * cone * depth * depth * depth;
+        }
+        return volume;
+    }
+
+    double getMeanTightness(const Conemap& conemap, const Conemap& exact)
+    {
+        double sum = 0.0;
+        size_t count = 0;
+        for (size_t i = 1; i < conemap.texels.size(); i += 2)
+        {
+            if (exact.texels[i] <= 0) continue;
+            sum += double(conemap.texels[i]) / exact.texels[i];
+            ++count;
+        }
+        return count ? sum / count : 1.0;
+    }
+
+    void measureRays(const Conemap& conemap, const std::vector<TraceRay>& rays, const std::vector<float>& referenceT, const TraceSettings& traceSettings, TileScheduler& scheduler, Result& result)
+    {
+        std::vector<TraceResult> traced(rays.size());
+        const uint32_t taskCount = uint32_t((rays.size() + kRaysPerTask - 1) / kRaysPerTask);
+        scheduler.run(taskCount, [&](uint32_t task, uint32_t)
+        {
+            const size_t first = size_t(task) * kRaysPerTask;
+            const size_t count = std::min(rays.size() - first, size_t(kRaysPerTask));
+            traceRays(conemap, IntersectionFunction::ConeStepMapping, RefinementFunction::None, rays.data() + first, count, traceSettings, traced.data() + first);
+        });
+
+        std::vector<uint32_t> steps(rays.size());
+        uint64_t stepSum = 0, misses = 0, overshoots = 0;
+        double errorSum = 0.0;
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            const auto& ray = rays[i];
+            const auto& res = traced[i];
+            steps[i] = res.stepCount;
+            stepSum += res.stepCount;
+            if (!res.wasHit)
+            {
+                ++misses;
+                continue;
+            }
+            // one texel along the ray, the cone step result is already moved back by that much
+            const float du = ray.u2[0] - ray.u[0];
+            const float dv = ray.u2[1] - ray.u[1];
+            const float texelT = 1.f / (float(conemap.width) * std::sqrt(du * du + dv * dv + 1.f));
+            if (res.t > referenceT[i] + texelT) ++overshoots;
+            errorSum += std::abs(res.t - referenceT[i]);
+        }
+        std::sort(steps.begin(), steps.end());
+        const size_t n = rays.size();
+        result.meanSteps = double(stepSum) / n;
+        result.p99Steps = steps[std::min(n - 1, size_t(std::ceil(0.99 * n)) - 1)];
+        result.maxSteps = steps.back();
+        result.missRate = double(misses) / n;
+        result.overshootRate = double(overshoots) / n;
+        result.meanError = n > misses ? errorSum / (n - misses) : 0.0;
+    }
+
+    ShadowStats measureShadowRays(const Conemap& conemap, ShadowFunction function, const std::vector<ShadowRay>& rays, const std::vector<float>& referenceVisibility, const ShadowSettings& shadowSettings, TileScheduler& scheduler)
+    {
+        std::vector<ShadowResult> traced(rays.size());
+        const uint32_t taskCount = uint32_t((rays.size() + kRaysPerTask - 1) / kRaysPerTask);
+        scheduler.run(taskCount, [&](uint32_t task, uint32_t)
+        {
+            const size_t end = std::min(rays.size(), size_t(task + 1) * kRaysPerTask);
+            for (size_t i = size_t(task) * kRaysPerTask; i < end; ++i) traced[i] = traceShadow(conemap, function, rays[i], shadowSettings);
+        });
+
+        ShadowStats stats;
+        uint64_t stepSum = 0, leaks = 0;
+        double errorSum = 0.0;
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            stepSum += traced[i].stepCount;
+            errorSum += std::abs(traced[i].visibility - referenceVisibility[i]);
+            if (traced[i].visibility > 0.5f && referenceVisibility[i] < 0.5f) ++leaks;
+        }
+        const size_t n = std::max<size_t>(rays.size(), 1);
+        stats.meanSteps = double(stepSum) / n;
+        stats.meanError = errorSum / n;
+        stats.leakRate = double(leaks) / n;
+        return stats;
+    }
+
+    std::vector<Result> benchmarkTexture(const std::string& filename, const std::vector<Variant>& variants, const Settings& bakeSettings, const std::vector<TraceRay>& rays, const TraceSettings& traceSettings,
+        const std::vector<ShadowRay>& shadowRays, const ShadowSettings& shadowSettings)
+    {
+        const Heightmap hmap = loadHeightmap(filename);
+        TileScheduler scheduler(bakeSettings.threadCount);
+
+        // the exact cones and the reference intersections are shared by every variant, the heights of the conemaps are the same
+        Settings exactSettings = bakeSettings;
+        exactSettings.algorithm = Algorithm::Conservative;
+        BakeStats exactStats;
+        const Conemap exact = bake(hmap, exactSettings, &exactStats);
+        const double exactVolume = getConeVolume(exact);
+        std::vector<float> referenceT(rays.size());
+        const uint32_t taskCount = uint32_t((rays.size() + kRaysPerTask - 1) / kRaysPerTask);
+        scheduler.run(taskCount, [&](uint32_t task, uint32_t)
+        {
+            const size_t end = std::min(rays.size(), size_t(task + 1) * kRaysPerTask);
+            for (size_t i = size_t(task) * kRaysPerTask; i < end; ++i) referenceT[i] = traceReference(exact, rays[i]);
+        });
+        std::vector<float> referenceVisibility(shadowRays.size());
+        const uint32_t shadowTaskCount = uint32_t((shadowRays.size() + kRaysPerTask - 1) / kRaysPerTask);
+        scheduler.run(shadowTaskCount, [&](uint32_t task, uint32_t)
+        {
+            const size_t end = std::min(shadowRays.size(), size_t(task + 1) * kRaysPerTask);
+            for (size_t i = size_t(task) * kRaysPerTask; i < end; ++i) referenceVisibility[i] = traceShadowReference(exact, shadowRays[i], shadowSettings);
+        });
+        // the linear march only samples the heights
+        const ShadowStats linearShadow = measureShadowRays(exact, ShadowFunction::LinearMarch, shadowRays, referenceVisibility, shadowSettings, scheduler);
+
+        std::vector<Result> results;
+        for (const auto& variant : variants)
+        {
+            Settings settings = bakeSettings;
+            settings.algorithm = variant.algorithm;
+            settings.maxAtTexelCenter = variant.maxAtTexelCenter;
+            BakeStats stats = exactStats;
+            const bool isExact = variant.algorithm == Algorithm::Conservative;
+            const Conemap conemap = isExact ? Conemap() : bake(hmap, settings, &stats);
+            const Conemap& cones = isExact ? exact : conemap;
+
+            Result result;
+            result.texture = filename;
+            result.width = hmap.width;
+            result.height = hmap.height;
+            result.variant = variant.getName();
+            result.bakeSeconds = stats.seconds;
+            result.testedTexels = stats.testedTexels;
+            double coneSum = 0.0;
+            for (size_t i = 1; i < cones.texels.size(); i += 2) coneSum += cones.texels[i];
+            result.meanCone = coneSum / (size_t(hmap.width) * hmap.height);
+            result.coneVolumeRatio = exactVolume > 0.0 ? getConeVolume(cones) / exactVolume : 1.0;
+            result.meanTightness = getMeanTightness(cones, exact);
+            measureRays(cones, rays, referenceT, traceSettings, scheduler, result);
+            result.shadow = measureShadowRays(cones, ShadowFunction::ConeTracing, shadowRays, referenceVisibility, shadowSettings, scheduler);
+            result.linearShadow = linearShadow;
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    std::string escapeJson(const std::string& s)
+    {
+        std::string r;
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\') r += '\\';
+            r += c;
+        }
+        return r;
+    }
+
+    std::string escapeCsv(const std::string& s)
+    {
+        if (s.find_first_of(",\"") == std::string::npos) return s;
+        std::string r = "\"";
+        for (char c : s)
+        {
+            if (c == '"') r += '"';
+            r += c;
+        }
+        return r + "\"";
+    }
+
+    void writeCsv(const std::string& filename, const std::vector<Result>& results)
+    {
+        std::ofstream file(filename);
+        if (!file) throw std::runtime_error("Cannot open '" + filename + "'");
+        file << std::setprecision(9);
+        file << "texture,width,height,variant,bake_seconds,tested_texels,mean_cone,cone_volume_ratio,mean_tightness,mean_steps,p99_steps,max_steps,miss_rate,overshoot_rate,mean_error,"
+            "shadow_steps,shadow_error,shadow_leak_rate,linear_shadow_steps,linear_shadow_error,linear_shadow_leak_rate\n";
+        for (const auto& r : results)
+        {
+            file << escapeCsv(r.texture) << ',' << r.width << ',' << r.height << ',' << r.variant << ',' << r.bakeSeconds << ',' << r.testedTexels
+                << ',' << r.meanCone << ',' << r.coneVolumeRatio << ',' << r.meanTightness << ',' << r.meanSteps << ',' << r.p99Steps << ',' << r.maxSteps
+                << ',' << r.missRate << ',' << r.overshootRate << ',' << r.meanError
+                << ',' << r.shadow.meanSteps << ',' << r.shadow.meanError << ',' << r.shadow.leakRate
+                << ',' << r.linearShadow.meanSteps << ',' << r.linearShadow.meanError << ',' << r.linearShadow.leakRate << '\n';
+        }
+        if (!file) throw std::runtime_error("Cannot write '" + filename + "'");
+    }
+
+    void writeJson(const std::string& filename, const std::vector<Result>& results, uint32_t rayCount, float maxOffset, const TraceSettings& traceSettings, const ShadowSettings& shadowSettings)
+    {
+        std::ofstream file(filename);
+        if (!file) throw std::runtime_error("Cannot open '" + filename + "'");
+        file << std::setprecision(9);
+        file << "{\n  \"rays\": " << rayCount << ",\n  \"maxOffset\": " << maxOffset << ",\n  \"steps\": " << traceSettings.steps << ",\n  \"relax\": " << traceSettings.relax
+            << ",\n  \"shadowSteps\": " << shadowSettings.steps << ",\n  \"penumbra\": " << shadowSettings.penumbra << ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            file << (i ? ",\n" : "\n") << "    {\"texture\": \"" << escapeJson(r.texture) << "\", \"width\": " << r.width << ", \"height\": " << r.height
+                << ", \"variant\": \"" << r.variant << "\", \"bakeSeconds\": " << r.bakeSeconds << ", \"testedTexels\": " << r.testedTexels
+                << ", \"meanCone\": " << r.meanCone << ", \"coneVolumeRatio\": " << r.coneVolumeRatio << ", \"meanTightness\": " << r.meanTightness
+                << ", \"meanSteps\": " << r.meanSteps << ", \"p99Steps\": " << r.p99Steps << ", \"maxSteps\": " << r.maxSteps
+                << ", \"missRate\": " << r.missRate << ", \"overshootRate\": " << r.overshootRate << ", \"meanError\": " << r.meanError
+                << ", \"shadowSteps\": " << r.shadow.meanSteps << ", \"shadowError\": " << r.shadow.meanError << ", \"shadowLeakRate\": " << r.shadow.leakRate
+                << ", \"linearShadowSteps\": " << r.linearShadow.meanSteps << ", \"linearShadowError\": " << r.linearShadow.meanError
+                << ", \"linearShadowLeakRate\": " << r.linearShadow.leakRate << "}";
+        }
+        file << "\n  ]\n}\n";
+        if (!file) throw std::runtime_error("Cannot write '" + filename + "'");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    args::ArgumentParser parser("Bakes every cone map variant of a set of height maps and traces the same rays through them with the CPU port of cone step mapping.");
+    parser.helpParams.programName = "ConemapBenchmark";
+    args::HelpFlag helpFlag(parser, "help", "Display this help menu.", {'h', "help"});
+    args::ValueFlagList<std::string> algorithmFlag(parser, "algorithm", "Generator to benchmark, can be repeated: conservative, relaxed, quick-naive, quick, quick-5x5, quick-7x7 or quick-adaptive (default: all). The quick generators run with and without the texel center heuristic.", {'a', "algorithm"});
+    args::ValueFlag<uint32_t> searchStepsFlag(parser, "steps", "Search steps of the relaxed cones (default: 64).", {'s', "search-steps"});
+    args::ValueFlag<uint32_t> threadsFlag(parser, "threads", "Number of threads (default: all hardware threads).", {'j', "threads"});
+    args::ValueFlag<uint32_t> raysFlag(parser, "count", "Number of traced rays per height map (default: 16384).", {'r', "rays"});
+    args::ValueFlag<float> offsetFlag(parser, "offset", "Largest texture space length of the rays from height 1 to height 0 (default: 0.5).", {"max-offset"});
+    args::ValueFlag<uint32_t> traceStepsFlag(parser, "steps", "Step limit of cone step mapping, `steps` of the sample (default: 64).", {"trace-steps"});
+    args::ValueFlag<float> relaxFlag(parser, "relax", "Step multiplier of cone step mapping, `relax` of the sample (default: 1).", {"relax"});
+    args::ValueFlag<uint32_t> shadowStepsFlag(parser, "steps", "Step number of the self-shadow marches, `shadowSteps` of the sample (default: 32).", {"shadow-steps"});
+    args::ValueFlag<float> penumbraFlag(parser, "penumbra", "Tangent of the angular radius of the light, `shadowPenumbra` of the sample (default: 0.02).", {"penumbra"});
+    args::ValueFlag<std::string> csvFlag(parser, "file", "Write the results to a CSV file.", {"csv"});
+    args::ValueFlag<std::string> jsonFlag(parser, "file", "Write the results to a JSON file.", {"json"});
+    args::PositionalList<std::string> inputsFlag(parser, "heightmaps", "Height maps, or .txt files listing one height map per line.", args::Options::Required);
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (const args::Help&)
+    {
+        std::cout << parser;
+        return 0;
+    }
+    catch (const args::ParseError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const args::RequiredError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::vector<Variant> variants;
+    std::vector<Algorithm> algorithms = { Algorithm::Conservative, Algorithm::Relaxed, Algorithm::QuickNaive, Algorithm::QuickRegionGrowing,
+        Algorithm::QuickRing5x5, Algorithm::QuickRing7x7, Algorithm::QuickRingAdaptive };
+    if (algorithmFlag)
+    {
+        algorithms.clear();
+        for (const auto& name : args::get(algorithmFlag))
+        {
+            Algorithm algorithm;
+            if (!parseAlgorithm(name, algorithm))
+            {
+                std::cerr << "Unknown algorithm '" << name << "'." << std::endl;
+                return 1;
+            }
+            algorithms.push_back(algorithm);
+        }
+    }
+    for (Algorithm algorithm : algorithms)
+    {
+        for (const auto& variant : getVariants(algorithm)) variants.push_back(variant);
+    }
+
+    Settings bakeSettings;
+    if (searchStepsFlag) bakeSettings.relaxedConeSearchSteps = std::max(1u, args::get(searchStepsFlag));
+    if (threadsFlag) bakeSettings.threadCount = args::get(threadsFlag);
+    TraceSettings traceSettings;
+    if (traceStepsFlag) traceSettings.steps = args::get(traceStepsFlag);
+    if (relaxFlag) traceSettings.relax = args::get(relaxFlag);
+    const uint32_t rayCount = std::max(1u, raysFlag ? args::get(raysFlag) : 16384u);
+    const float maxOffset = offsetFlag ? args::get(offsetFlag) : 0.5f;
+    const std::vector<TraceRay> rays = generateRays(rayCount, maxOffset);
+    ShadowSettings shadowSettings;
+    if (shadowStepsFlag) shadowSettings.steps = std::max(1u, args::get(shadowStepsFlag));
+    if (penumbraFlag) shadowSettings.penumbra = std::max(0.f, args::get(penumbraFlag));
+    const std::vector<ShadowRay> shadowRays = generateShadowRays(rayCount, maxOffset);
+
+    FreeImage_Initialise();
+    int exitCode = 0;
+    std::vector<Result> results;
+    try
+    {
+        for (const auto& filename : expandInputs(args::get(inputsFlag)))
+        {
+            try
+            {
+                for (const auto& r : benchmarkTexture(filename, variants, bakeSettings, rays, traceSettings, shadowRays, shadowSettings))
+                {
+                    std::cout << r.texture << " (" << r.width << "x" << r.height << ") " << r.variant
+                        << ": " << r.bakeSeconds << " s, volume ratio " << r.coneVolumeRatio << ", tightness " << r.meanTightness
+                        << ", steps mean " << r.meanSteps << " p99 " << r.p99Steps
+                        << ", miss " << r.missRate << ", overshoot " << r.overshootRate
+                        << ", shadow steps " << r.shadow.meanSteps << " (linear " << r.linearShadow.meanSteps << ") error " << r.shadow.meanError
+                        << " (linear " << r.linearShadow.meanError << ") leak " << r.shadow.leakRate << std::endl;
+                    results.push_back(r);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Cannot benchmark '" << filename << "' (Error: " << e.what() << ")." << std::endl;
+                exitCode = 1;
+            }
+        }
+        if (csvFlag) writeCsv(args::get(csvFlag), results);
+        if (jsonFlag) writeJson(args::get(jsonFlag), results, rayCount, maxOffset, traceSettings, shadowSettings);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        exitCode = 1;
+    }
+    FreeImage_DeInitialise();
+    return exitCode;
+}
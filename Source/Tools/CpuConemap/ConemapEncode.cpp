@@ -0,0 +1,396 @@
+#include "ConemapEncode.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace CpuConemap
+{
+    namespace
+    {
+        // Interpolated BC4 entries are decoded with float math on the GPU and
+        // may come out a few ulps off the exact value; entries closer than this
+        // above the value are not used when rounding down. The endpoints decode exactly.
+        const double kInterpolatedMargin = 1e-5;
+
+        // Texels up to this many texels away narrow the cones by their own height error,
+        // the farther ones by the largest error of the conemap.
+        const uint32_t kHeightErrorRadius = 4;
+
+        float saturate(float x) { return std::max(0.f, std::min(1.f, x)); }
+
+        /** Palette of a BC4 block, with flags telling which entries decode exactly.
+        */
+        void getPalette(uint8_t red0, uint8_t red1, double palette[8], bool exact[8])
+        {
+            palette[0] = red0 / 255.0;
+            palette[1] = red1 / 255.0;
+            exact[0] = exact[1] = true;
+            if (red0 > red1)
+            {
+                for (int i = 2; i < 8; ++i)
+                {
+                    palette[i] = ((8 - i) * red0 + (i - 1) * red1) / (7.0 * 255.0);
+                    exact[i] = false;
+                }
+            }
+            else
+            {
+                for (int i = 2; i < 6; ++i)
+                {
+                    palette[i] = ((6 - i) * red0 + (i - 1) * red1) / (5.0 * 255.0);
+                    exact[i] = false;
+                }
+                palette[6] = 0.0;
+                palette[7] = 1.0;
+                exact[6] = exact[7] = true;
+            }
+        }
+
+        /** Picks the palette entry of every value.
+            \return Sum of squared errors, infinity if a value has no entry below it when rounding down.
+        */
+        double fitBlock(const float values[16], uint8_t red0, uint8_t red1, bool roundDown, uint8_t indices[16])
+        {
+            double palette[8];
+            bool exact[8];
+            getPalette(red0, red1, palette, exact);
+
+            double error = 0.0;
+            for (int t = 0; t < 16; ++t)
+            {
+                const double v = values[t];
+                double bestError = std::numeric_limits<double>::infinity();
+                for (uint8_t i = 0; i < 8; ++i)
+                {
+                    if (roundDown)
+                    {
+                        // compare the endpoints as floats, that is what the texture sampler returns
+                        bool below = exact[i] ? float(palette[i]) <= values[t] : palette[i] <= v - kInterpolatedMargin;
+                        if (!below) continue;
+                    }
+                    double e = (palette[i] - v) * (palette[i] - v);
+                    if (e < bestError)
+                    {
+                        bestError = e;
+                        indices[t] = i;
+                    }
+                }
+                error += bestError;
+                if (!(error < std::numeric_limits<double>::infinity())) break;
+            }
+            return error;
+        }
+
+        void writeBlock(uint8_t red0, uint8_t red1, const uint8_t indices[16], uint8_t block[8])
+        {
+            block[0] = red0;
+            block[1] = red1;
+            uint64_t bits = 0;
+            for (int t = 0; t < 16; ++t) bits |= uint64_t(indices[t]) << (3 * t);
+            for (int b = 0; b < 6; ++b) block[2 + b] = uint8_t(bits >> (8 * b));
+        }
+
+        /** Loads the 4x4 block at (bx, by) of one channel, clamping to the edges of the conemap.
+        */
+        void loadBlock(const Conemap& conemap, uint32_t bx, uint32_t by, uint32_t channel, float values[16])
+        {
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    uint32_t x = std::min(4 * bx + i, conemap.width - 1);
+                    uint32_t y = std::min(4 * by + j, conemap.height - 1);
+                    values[4 * j + i] = saturate(conemap.texels[2 * (size_t(y) * conemap.width + x) + channel]);
+                }
+            }
+        }
+    }
+
+    float narrowCone(float cone, float texelSize, float heightError)
+    {
+        // a texel at distance d >= texelSize that is at most dh + heightError higher
+        // is outside the cone of ratio c' if c' * (d / c + heightError) <= d
+        if (heightError <= 0.f) return cone;
+        return cone * texelSize / (texelSize + heightError * cone);
+    }
+
+    void narrowConesToHeightError(Conemap& conemap, const std::vector<float>& heightErrors)
+    {
+        const uint32_t w = conemap.width;
+        const uint32_t h = conemap.height;
+        if (heightErrors.size() != size_t(w) * h) throw std::runtime_error("Height error size mismatch");
+        if (heightErrors.empty()) return;
+        const float texelSize = 1.f / float(std::max(w, h));
+        const float maxError = *std::max_element(heightErrors.begin(), heightErrors.end());
+
+        // windowMax[k] is the largest error within k texels (Chebyshev distance), grown by a 3x3 max filter per ring
+        std::vector<float> windowMax = heightErrors;
+        std::vector<float> rowMax(windowMax.size());
+        std::vector<float> narrowed(windowMax.size());
+        for (size_t i = 0; i < narrowed.size(); ++i)
+        {
+            // every texel farther than the rings
+            narrowed[i] = narrowCone(conemap.texels[2 * i + 1], (kHeightErrorRadius + 1) * texelSize, heightErrors[i] + maxError);
+        }
+        for (uint32_t ring = 1; ring <= kHeightErrorRadius; ++ring)
+        {
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                for (uint32_t x = 0; x < w; ++x)
+                {
+                    const float* row = windowMax.data() + size_t(y) * w;
+                    rowMax[size_t(y) * w + x] = std::max({ row[x > 0 ? x - 1 : x], row[x], row[x + 1 < w ? x + 1 : x] });
+                }
+            }
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                for (uint32_t x = 0; x < w; ++x)
+                {
+                    const size_t i = size_t(y) * w + x;
+                    windowMax[i] = std::max({ rowMax[i - (y > 0 ? w : 0)], rowMax[i], rowMax[i + (y + 1 < h ? w : 0)] });
+                    // the texels of this ring are at least ring texels away
+                    narrowed[i] = std::min(narrowed[i], narrowCone(conemap.texels[2 * i + 1], ring * texelSize, heightErrors[i] + windowMax[i]));
+                }
+            }
+        }
+        for (size_t i = 0; i < narrowed.size(); ++i) conemap.texels[2 * i + 1] = narrowed[i];
+    }
+
+    uint16_t packHeightCone(float height, float cone, float texelSize)
+    {
+        uint32_t h = uint32_t(std::lround(saturate(height) * 1023.f));
+        // the base texel and the others can both be off by the rounding of the height
+        cone = narrowCone(saturate(cone), texelSize, 2.f * kPackedHeightError);
+        uint32_t c = uint32_t(std::floor(std::sqrt(cone) * 63.f));
+        // the float sqrt can round up, make sure the decoded cone is not wider
+        while (c > 0 && (c / 63.f) * (c / 63.f) > cone) --c;
+        return uint16_t((h << 6) | c);
+    }
+
+    void unpackHeightCone(uint16_t packed, float& height, float& cone)
+    {
+        height = (packed >> 6) / 1023.f;
+        float c = (packed & 63) / 63.f;
+        cone = c * c;
+    }
+
+    std::vector<uint16_t> encodePackedR16(const Conemap& conemap)
+    {
+        std::vector<uint16_t> packed(size_t(conemap.width) * conemap.height);
+        const float texelSize = 1.f / float(std::max(conemap.width, conemap.height));
+        for (size_t i = 0; i < packed.size(); ++i) packed[i] = packHeightCone(conemap.texels[2 * i + 0], conemap.texels[2 * i + 1], texelSize);
+        return packed;
+    }
+
+    Conemap decodePackedR16(const std::vector<uint16_t>& packed, uint32_t width, uint32_t height)
+    {
+        if (packed.size() != size_t(width) * height) throw std::runtime_error("Packed conemap size mismatch");
+        Conemap conemap;
+        conemap.width = width;
+        conemap.height = height;
+        conemap.texels.resize(2 * packed.size());
+        for (size_t i = 0; i < packed.size(); ++i) unpackHeightCone(packed[i], conemap.texels[2 * i + 0], conemap.texels[2 * i + 1]);
+        return conemap;
+    }
+
+    float getUnormHeightError(uint32_t bits)
+    {
+        return 0.5f / float((1u << bits) - 1) + 1e-7f;
+    }
+
+    std::vector<uint16_t> encodeUnormRG(const Conemap& conemap, uint32_t bits)
+    {
+        if (bits != 8 && bits != 16) throw std::invalid_argument("Unorm conemaps have 8 or 16 bits per channel");
+        const float maxValue = float((1u << bits) - 1);
+        const size_t texelCount = size_t(conemap.width) * conemap.height;
+        std::vector<uint16_t> texels(2 * texelCount);
+        std::vector<float> heightErrors(texelCount);
+        for (size_t i = 0; i < texelCount; ++i)
+        {
+            const float height = saturate(conemap.texels[2 * i + 0]);
+            texels[2 * i + 0] = uint16_t(std::lround(height * maxValue));
+            // the margin covers the float division of the decoder
+            heightErrors[i] = std::abs(texels[2 * i + 0] / maxValue - height) + 1e-7f;
+        }
+        Conemap narrowed = conemap;
+        narrowConesToHeightError(narrowed, heightErrors);
+        for (size_t i = 0; i < texelCount; ++i)
+        {
+            const float cone = saturate(narrowed.texels[2 * i + 1]);
+            uint32_t c = uint32_t(std::floor(cone * maxValue));
+            // the float product can round up, make sure the decoded cone is not wider
+            while (c > 0 && c / maxValue > cone) --c;
+            texels[2 * i + 1] = uint16_t(c);
+        }
+        return texels;
+    }
+
+    Conemap decodeUnormRG(const std::vector<uint16_t>& texels, uint32_t width, uint32_t height, uint32_t bits)
+    {
+        if (texels.size() != 2 * size_t(width) * height) throw std::runtime_error("Unorm conemap size mismatch");
+        const float maxValue = float((1u << bits) - 1);
+        Conemap conemap;
+        conemap.width = width;
+        conemap.height = height;
+        conemap.texels.resize(texels.size());
+        for (size_t i = 0; i < texels.size(); ++i) conemap.texels[i] = texels[i] / maxValue;
+        return conemap;
+    }
+
+    void encodeBC4Block(const float values[16], bool roundDown, uint8_t block[8])
+    {
+        float lo = 1.f, hi = 0.f;            // range of every value
+        float innerLo = 1.f, innerHi = 0.f;  // range without the values the 6 entry palette has for free
+        for (int t = 0; t < 16; ++t)
+        {
+            float v = saturate(values[t]);
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+            if (v > 0.f && v < 1.f)
+            {
+                innerLo = std::min(innerLo, v);
+                innerHi = std::max(innerHi, v);
+            }
+        }
+        if (innerLo > innerHi) innerLo = innerHi = lo;
+
+        double bestError = std::numeric_limits<double>::infinity();
+        uint8_t bestRed0 = 0, bestRed1 = 0;
+        uint8_t bestIndices[16] = {};
+        uint8_t indices[16];
+        auto tryEndpoints = [&](int red0, int red1)
+        {
+            if (red0 < 0 || red0 > 255 || red1 < 0 || red1 > 255) return;
+            double error = fitBlock(values, uint8_t(red0), uint8_t(red1), roundDown, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestRed0 = uint8_t(red0);
+                bestRed1 = uint8_t(red1);
+                std::copy(indices, indices + 16, bestIndices);
+            }
+        };
+
+        // Search the endpoints around the quantized range. When rounding down,
+        // the low endpoint must not be above the smallest value.
+        const int loQ = roundDown ? int(std::floor(lo * 255.f)) : int(std::lround(lo * 255.f));
+        const int hiQ = int(std::lround(hi * 255.f));
+        const int innerLoQ = roundDown ? int(std::floor(innerLo * 255.f)) : int(std::lround(innerLo * 255.f));
+        const int innerHiQ = int(std::lround(innerHi * 255.f));
+        for (int dl = -3; dl <= 1; ++dl)
+        {
+            for (int dh = -3; dh <= 3; ++dh)
+            {
+                // 8 entry palette: red0 > red1
+                if (hiQ + dh > loQ + dl) tryEndpoints(hiQ + dh, loQ + dl);
+                // 6 entry palette with 0 and 1: red0 <= red1
+                if (innerLoQ + dl <= innerHiQ + dh) tryEndpoints(innerLoQ + dl, innerHiQ + dh);
+            }
+        }
+        // a constant block, or every value is 0 or 1
+        if (!(bestError < std::numeric_limits<double>::infinity())) tryEndpoints(0, 255);
+
+        writeBlock(bestRed0, bestRed1, bestIndices, block);
+    }
+
+    void decodeBC4Block(const uint8_t block[8], float values[16])
+    {
+        double palette[8];
+        bool exact[8];
+        getPalette(block[0], block[1], palette, exact);
+        uint64_t bits = 0;
+        for (int b = 0; b < 6; ++b) bits |= uint64_t(block[2 + b]) << (8 * b);
+        for (int t = 0; t < 16; ++t) values[t] = float(palette[(bits >> (3 * t)) & 7]);
+    }
+
+    std::vector<uint8_t> encodeBC5(const Conemap& conemap)
+    {
+        const uint32_t blocksX = (conemap.width + 3) / 4;
+        const uint32_t blocksY = (conemap.height + 3) / 4;
+        std::vector<uint8_t> blocks(size_t(blocksX) * blocksY * 16);
+        float values[16];
+        float decoded[16];
+
+        // the heights first, the cones are narrowed by their errors
+        std::vector<float> heightErrors(size_t(conemap.width) * conemap.height);
+        for (uint32_t by = 0; by < blocksY; ++by)
+        {
+            for (uint32_t bx = 0; bx < blocksX; ++bx)
+            {
+                uint8_t* dst = blocks.data() + (size_t(by) * blocksX + bx) * 16;
+                loadBlock(conemap, bx, by, 0, values);
+                encodeBC4Block(values, false, dst);
+                decodeBC4Block(dst, decoded);
+                for (uint32_t j = 0; j < 4 && 4 * by + j < conemap.height; ++j)
+                {
+                    for (uint32_t i = 0; i < 4 && 4 * bx + i < conemap.width; ++i)
+                    {
+                        // the GPU may decode the interpolated entries a few ulps off
+                        const float error = std::abs(decoded[4 * j + i] - values[4 * j + i]);
+                        heightErrors[size_t(4 * by + j) * conemap.width + 4 * bx + i] = error + float(kInterpolatedMargin);
+                    }
+                }
+            }
+        }
+        Conemap narrowed = conemap;
+        narrowConesToHeightError(narrowed, heightErrors);
+
+        for (uint32_t by = 0; by < blocksY; ++by)
+        {
+            for (uint32_t bx = 0; bx < blocksX; ++bx)
+            {
+                uint8_t* dst = blocks.data() + (size_t(by) * blocksX + bx) * 16;
+                loadBlock(narrowed, bx, by, 1, values);
+                encodeBC4Block(values, true, dst + 8);
+            }
+        }
+        return blocks;
+    }
+
+    Conemap decodeBC5(const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height)
+    {
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+        if (blocks.size() != size_t(blocksX) * blocksY * 16) throw std::runtime_error("BC5 conemap size mismatch");
+        Conemap conemap;
+        conemap.width = width;
+        conemap.height = height;
+        conemap.texels.resize(2 * size_t(width) * height);
+        float values[2][16];
+        for (uint32_t by = 0; by < blocksY; ++by)
+        {
+            for (uint32_t bx = 0; bx < blocksX; ++bx)
+            {
+                const uint8_t* src = blocks.data() + (size_t(by) * blocksX + bx) * 16;
+                decodeBC4Block(src, values[0]);
+                decodeBC4Block(src + 8, values[1]);
+                for (uint32_t j = 0; j < 4 && 4 * by + j < height; ++j)
+                {
+                    for (uint32_t i = 0; i < 4 && 4 * bx + i < width; ++i)
+                    {
+                        size_t texel = size_t(4 * by + j) * width + 4 * bx + i;
+                        conemap.texels[2 * texel + 0] = values[0][4 * j + i];
+                        conemap.texels[2 * texel + 1] = values[1][4 * j + i];
+                    }
+                }
+            }
+        }
+        return conemap;
+    }
+
+    EncodeError measureEncodeError(const Conemap& baked, const Conemap& decoded)
+    {
+        if (baked.width != decoded.width || baked.height != decoded.height) throw std::runtime_error("Conemap size mismatch");
+        EncodeError result;
+        for (size_t i = 0; i < baked.texels.size() / 2; ++i)
+        {
+            double dh = std::abs(double(decoded.texels[2 * i + 0]) - saturate(baked.texels[2 * i + 0]));
+            double dc = double(saturate(baked.texels[2 * i + 1])) - decoded.texels[2 * i + 1];
+            result.maxHeightError = std::max(result.maxHeightError, dh);
+            result.maxConeError = std::max(result.maxConeError, dc);
+            if (dc < 0.0) ++result.wideCones;
+        }
+        return result;
+    }
+}
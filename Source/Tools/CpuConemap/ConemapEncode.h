@@ -0,0 +1,100 @@
+#pragma once
+#include "CpuConemap.h"
+#include <cstdint>
+#include <vector>
+
+// Compact encodings of conemaps. Cone step mapping is bandwidth bound, every
+// step fetches a [height, cone ratio] texel, so smaller texels are faster.
+// Heights are rounded to the nearest representable value. The shaders march the
+// decoded heights, so the cones are first narrowed by the height error (see
+// narrowConesToHeightError) and then rounded down: a conservative conemap stays
+// conservative for its decoded heights and the ray can not overshoot.
+namespace CpuConemap
+{
+    /** Largest height error of the packed R16 encoding, the rounding error of a 10 bit unorm plus a float margin.
+    */
+    const float kPackedHeightError = 0.5f / 1023.f + 1e-6f;
+
+    /** Narrows a cone ratio so that it stays conservative when the height difference between the base texel
+        and any texel at least texelSize away grows by up to heightError. The narrowed cone is d / (d / cone + heightError)
+        at distance d, which is narrowest at the nearest texel.
+        \param[in] cone The cone ratio of the exact heights.
+        \param[in] texelSize UV distance of the nearest texel, 1 / max(width, height).
+        \param[in] heightError Largest height error of the base texel plus the one of the other texels.
+    */
+    float narrowCone(float cone, float texelSize, float heightError);
+
+    /** Narrows every cone of the conemap with narrowCone, taking the height error of the texels around the
+        base texel from heightErrors and the largest one for the farther texels.
+        \param[in,out] conemap The cones are narrowed, the heights are not used.
+        \param[in] heightErrors |decoded - baked| height of every texel, row major.
+    */
+    void narrowConesToHeightError(Conemap& conemap, const std::vector<float>& heightErrors);
+
+    /** Packed R16 layout: bits 15..6 store the height as a 10 bit unorm,
+        bits 5..0 store the square root of the cone ratio as a 6 bit unorm.
+        The square root spends more codes on the narrow cones, where a small
+        absolute error is a large relative error of the step size.
+        The cone is narrowed by kPackedHeightError, then rounded down.
+        \param[in] texelSize 1 / max(width, height) of the conemap.
+    */
+    uint16_t packHeightCone(float height, float cone, float texelSize);
+
+    /** Inverse of packHeightCone, matches unpackHeightCone in Parallax.ps.slang.
+    */
+    void unpackHeightCone(uint16_t packed, float& height, float& cone);
+
+    /** Packs every texel of the conemap with packHeightCone, row major.
+    */
+    std::vector<uint16_t> encodePackedR16(const Conemap& conemap);
+
+    /** Largest height error of a unorm encoding with the given number of bits, the rounding error plus a float margin.
+    */
+    float getUnormHeightError(uint32_t bits);
+
+    /** Encodes the conemap as RG unorm values with 8 or 16 bits per channel, [height, cone ratio] pairs, row major.
+        The heights are rounded to nearest, the cones are narrowed by the errors of the rounded heights, then rounded down.
+    */
+    std::vector<uint16_t> encodeUnormRG(const Conemap& conemap, uint32_t bits);
+
+    /** Encodes a 4x4 block of BC4 (unorm) values.
+        The endpoints are searched around the range of the values, the same way
+        as Scene/Volume/BC4Encode.h, but every candidate is evaluated exactly
+        against the palette the hardware decodes.
+        \param[in] values 16 values in [0,1], row major.
+        \param[in] roundDown If true, every texel gets the largest palette entry not above its value,
+            otherwise the nearest one.
+        \param[out] block The 8 byte BC4 block.
+    */
+    void encodeBC4Block(const float values[16], bool roundDown, uint8_t block[8]);
+
+    /** Decodes a BC4 (unorm) block to 16 values, row major.
+    */
+    void decodeBC4Block(const uint8_t block[8], float values[16]);
+
+    /** Encodes the conemap as BC5 (unorm): red is the height, green is the cone ratio.
+        The cones are narrowed by the errors of the encoded heights, then rounded down.
+        The blocks are stored row major, 16 bytes per 4x4 block, ready to be
+        uploaded as a BC5Unorm texture or written into a DDS file.
+        Texels of partial blocks on the right and bottom edges repeat the last row/column.
+    */
+    std::vector<uint8_t> encodeBC5(const Conemap& conemap);
+
+    struct EncodeError
+    {
+        double maxHeightError = 0.0; // largest |decoded - baked| height
+        double maxConeError = 0.0;   // largest baked - decoded cone ratio
+        uint32_t wideCones = 0;      // texels whose decoded cone is wider than the baked one, must be 0
+                                     // (the cones are also narrowed by the height errors, which is not measured here)
+    };
+
+    /** Compares a decoded conemap with the baked one.
+    */
+    EncodeError measureEncodeError(const Conemap& baked, const Conemap& decoded);
+
+    /** Decodes conemaps produced by encodePackedR16 and encodeBC5.
+    */
+    Conemap decodePackedR16(const std::vector<uint16_t>& packed, uint32_t width, uint32_t height);
+    Conemap decodeBC5(const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height);
+    Conemap decodeUnormRG(const std::vector<uint16_t>& texels, uint32_t width, uint32_t height, uint32_t bits);
+}
@@ -0,0 +1,235 @@
+#include "ConemapMips.h"
+#include "HeightfieldTrace.h"
+#include "TileScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace CpuConemap
+{
+    namespace
+    {
+        const float kFar = 1e6f;
+        const uint32_t kMaxLines = 37;
+
+        struct Line
+        {
+            float a; // value at x = 0
+            float b; // slope
+        };
+
+        // min over x >= x0 of max(a.a + a.b * x, b.a + b.b * x)
+        float minOfMaxLines(const Line& a, const Line& b, float x0)
+        {
+            if (std::max(a.b, b.b) < 0)
+                return -kFar;
+            float m = std::max(a.a + a.b * x0, b.a + b.b * x0);
+            if (a.b != b.b)
+            {
+                const float x = (b.a - a.a) / (a.b - b.b);
+                if (x > x0)
+                    m = std::min(m, a.a + a.b * x);
+            }
+            return m;
+        }
+
+        // see footprintDistance in ConemapMip.cs.slang
+        float footprintDistance(float Px, float Py, const uint32_t begin[2], const uint32_t end[2], uint32_t fineW, uint32_t fineH)
+        {
+            float d = kFar;
+            const float texelX = 1.0f / float(fineW);
+            const float texelY = 1.0f / float(fineH);
+            if (begin[0] > 0) d = std::min(d, Px - (float(begin[0]) - 0.5f) * texelX);
+            if (begin[1] > 0) d = std::min(d, Py - (float(begin[1]) - 0.5f) * texelY);
+            if (end[0] < fineW) d = std::min(d, (float(end[0]) + 0.5f) * texelX - Px);
+            if (end[1] < fineH) d = std::min(d, (float(end[1]) + 0.5f) * texelY - Py);
+            return std::max(d, 0.0f);
+        }
+
+        int wrap(int i, int size)
+        {
+            return (i % size + size) % size;
+        }
+
+        // footprint of a texel of the given level in level 0 texels, [begin, end)
+        void getFootprint(const Conemap& level, uint32_t levelIndex, uint32_t fineW, uint32_t fineH, uint32_t x, uint32_t y, uint32_t begin[2], uint32_t end[2])
+        {
+            begin[0] = x << levelIndex;
+            begin[1] = y << levelIndex;
+            end[0] = x == level.width - 1 ? fineW : (x + 1) << levelIndex;
+            end[1] = y == level.height - 1 ? fineH : (y + 1) << levelIndex;
+        }
+
+        // port of mipmapConemap
+        void mipmapTexel(const Conemap& src, Conemap& dst, uint32_t dstLevel, uint32_t fineW, uint32_t fineH, float coneQuantum, uint32_t x, uint32_t y)
+        {
+            const float sizeX = float(dst.width), sizeY = float(dst.height);
+            const float srcX = float(src.width), srcY = float(src.height);
+            const float Px = (float(x) + 0.5f) / sizeX;
+            const float Py = (float(y) + 0.5f) / sizeY;
+            const float reachX = (1.0f / sizeX) * srcX + 1;
+            const float reachY = (1.0f / sizeY) * srcY + 1;
+            const int beginX = int(std::floor(Px * srcX - 0.5f - reachX)) + 1;
+            const int beginY = int(std::floor(Py * srcY - 0.5f - reachY)) + 1;
+            const int endX = int(std::ceil(Px * srcX - 0.5f + reachX));
+            const int endY = int(std::ceil(Py * srcY - 0.5f + reachY));
+
+            float H = 0;
+            float coneLimit = 1;
+            for (int i = beginX; i < endX; ++i)
+            {
+                for (int j = beginY; j < endY; ++j)
+                {
+                    const uint32_t ix = uint32_t(wrap(i, int(src.width)));
+                    const uint32_t iy = uint32_t(wrap(j, int(src.height)));
+                    H = std::max(H, src.getHeight(ix, iy));
+                    coneLimit = std::min(coneLimit, src.getCone(ix, iy));
+                }
+            }
+
+            float* pDst = &dst.texels[2 * (size_t(y) * dst.width + x)];
+            pDst[0] = H;
+            if (H >= 1)
+            {
+                pDst[1] = coneLimit;
+                return;
+            }
+
+            uint32_t fineBegin[2], fineEnd[2];
+            getFootprint(dst, dstLevel, fineW, fineH, x, y, fineBegin, fineEnd);
+
+            Line lines[kMaxLines];
+            uint32_t lineCount = 0;
+            lines[lineCount++] = { 0, footprintDistance(Px, Py, fineBegin, fineEnd, fineW, fineH) };
+            for (int i = std::max(beginX, 0); i < std::min(endX, int(src.width)); ++i)
+            {
+                for (int j = std::max(beginY, 0); j < std::min(endY, int(src.height)); ++j)
+                {
+                    if (lineCount == kMaxLines) break;
+                    const float h = src.getHeight(uint32_t(i), uint32_t(j));
+                    const float c = src.getCone(uint32_t(i), uint32_t(j));
+                    const float dx = Px - (float(i) + 0.5f) / srcX;
+                    const float dy = Py - (float(j) + 0.5f) / srcY;
+                    const float d = std::sqrt(dx * dx + dy * dy);
+                    lines[lineCount++] = { c, c * (H - h) - d };
+                }
+            }
+
+            const float x0 = 1 / (1 - H);
+            float cone = 0;
+            for (uint32_t a = 0; a < lineCount; ++a)
+                for (uint32_t b = a; b < lineCount; ++b)
+                    cone = std::max(cone, minOfMaxLines(lines[a], lines[b], x0));
+
+            cone = std::clamp(std::min(cone, coneLimit), 0.0f, 1.0f);
+            if (coneQuantum > 0)
+                cone = std::floor(cone / coneQuantum) * coneQuantum;
+            pDst[1] = cone;
+        }
+
+        // exact cone ratio of a point at uv (Px, Py) and height H against every level 0 texel center
+        float bruteForceCone(const Conemap& level0, float Px, float Py, float H)
+        {
+            float cone = 1;
+            for (uint32_t j = 0; j < level0.height; ++j)
+            {
+                for (uint32_t i = 0; i < level0.width; ++i)
+                {
+                    const float dh = level0.getHeight(i, j) - H;
+                    if (dh <= 0) continue;
+                    const float dx = (float(i) + 0.5f) / float(level0.width) - Px;
+                    const float dy = (float(j) + 0.5f) / float(level0.height) - Py;
+                    cone = std::min(cone, std::sqrt(dx * dx + dy * dy) / dh);
+                }
+            }
+            return cone;
+        }
+    }
+
+    std::vector<Conemap> buildConservativeMips(const Conemap& level0, float coneQuantum, uint32_t threadCount)
+    {
+        std::vector<Conemap> levels;
+        levels.push_back(level0);
+        TileScheduler scheduler(threadCount);
+        while (levels.back().width > 1 || levels.back().height > 1)
+        {
+            const Conemap& src = levels.back();
+            Conemap dst;
+            dst.width = std::max(src.width / 2, 1u);
+            dst.height = std::max(src.height / 2, 1u);
+            dst.texels.resize(size_t(dst.width) * dst.height * 2);
+            const uint32_t dstLevel = uint32_t(levels.size());
+            scheduler.run(dst.height, [&](uint32_t y, uint32_t)
+            {
+                for (uint32_t x = 0; x < dst.width; ++x)
+                    mipmapTexel(src, dst, dstLevel, level0.width, level0.height, coneQuantum, x, y);
+            });
+            levels.push_back(std::move(dst));
+        }
+        return levels;
+    }
+
+    MipCheckResult checkConservativeMips(const std::vector<Conemap>& levels, uint32_t sampleCount, float tolerance)
+    {
+        MipCheckResult result;
+        if (levels.size() < 2 || sampleCount == 0)
+            return result;
+        const Conemap& level0 = levels[0];
+
+        double tightnessSum = 0.0;
+        uint32_t tightnessCount = 0;
+        for (uint32_t l = 1; l < uint32_t(levels.size()); ++l)
+        {
+            const Conemap& level = levels[l];
+            const size_t texelCount = size_t(level.width) * level.height;
+            const size_t stride = std::max<size_t>(texelCount / sampleCount, 1);
+            for (size_t t = 0; t < texelCount; t += stride)
+            {
+                const uint32_t x = uint32_t(t % level.width);
+                const uint32_t y = uint32_t(t / level.width);
+                const float H = level.getHeight(x, y);
+                const float cone = level.getCone(x, y);
+
+                uint32_t begin[2], end[2];
+                getFootprint(level, l, level0.width, level0.height, x, y, begin, end);
+                bool heightOk = true;
+                for (uint32_t j = begin[1]; j < end[1] && heightOk; ++j)
+                    for (uint32_t i = begin[0]; i < end[0] && heightOk; ++i)
+                        heightOk = level0.getHeight(i, j) <= H + tolerance;
+                if (!heightOk) ++result.heightViolations;
+
+                const float Px = (float(x) + 0.5f) / float(level.width);
+                const float Py = (float(y) + 0.5f) / float(level.height);
+                const float exact = bruteForceCone(level0, Px, Py, H);
+                if (cone > exact + tolerance) ++result.coneViolations;
+                if (exact > 0)
+                {
+                    tightnessSum += std::min(cone / exact, 1.0f);
+                    ++tightnessCount;
+                }
+                ++result.checkedTexels;
+            }
+        }
+        result.meanTightness = tightnessCount ? tightnessSum / tightnessCount : 1.0;
+
+        // the sample of a level has to be inside the cone of the finer level's sample at the same uv
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<float> uni(0.f, 1.f);
+        for (uint32_t s = 0; s < sampleCount; ++s)
+        {
+            const float u = uni(rng), v = uni(rng);
+            float fineH, fineC;
+            sampleBilinear(levels[0], u, v, fineH, fineC);
+            for (uint32_t l = 1; l < uint32_t(levels.size()); ++l)
+            {
+                float h, c;
+                sampleBilinear(levels[l], u, v, h, c);
+                if (h < fineH - tolerance || c > fineC + tolerance) ++result.filterViolations;
+                ++result.checkedSamples;
+                fineH = h;
+                fineC = c;
+            }
+        }
+        return result;
+    }
+}
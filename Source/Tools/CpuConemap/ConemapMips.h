@@ -0,0 +1,38 @@
+#pragma once
+#include "CpuConemap.h"
+
+// Conservative mipmap of a conemap, CPU port of ConemapMip.cs.slang.
+// Every coarser texel is at least as high as the texels of its footprint and
+// its cone is the tightest one the finer level proves, and the levels are
+// nested so that trilinear sampling stays inside the cones of level 0.
+namespace CpuConemap
+{
+    /** Builds the mip chain of a conemap, port of mipmapConemap.
+        Level sizes are halved and rounded down like the texture mips, the last
+        texel of a row/column also covers the extra texel of an odd sized level.
+        \param[in] level0 The full resolution conemap.
+        \param[in] coneQuantum The cones are rounded down to a multiple of this (the unorm step of the texture format), 0 keeps them as they are.
+        \param[in] threadCount Number of threads, 0 means hardware concurrency.
+        \return levels[0] is a copy of level0, the last level is 1x1.
+    */
+    std::vector<Conemap> buildConservativeMips(const Conemap& level0, float coneQuantum = 0.0f, uint32_t threadCount = 0);
+
+    struct MipCheckResult
+    {
+        uint32_t checkedTexels = 0;    // coarse texels compared with the brute force cone
+        uint32_t heightViolations = 0; // a level 0 texel of the footprint is above the coarse texel
+        uint32_t coneViolations = 0;   // the coarse cone contains a level 0 texel center
+        double meanTightness = 0.0;    // mean of coarse / brute force cone, over the texels with a nonzero brute force cone
+        uint32_t checkedSamples = 0;   // (uv, level) pairs of the filtering check
+        uint32_t filterViolations = 0; // the bilinear sample of a level is lower or has a wider cone than the finer level's
+    };
+
+    /** Checks a conservative mip chain against level 0.
+        The brute force cone of a coarse texel is its exact cone ratio against every level 0 texel center,
+        and the filtering check compares the bilinear samples of neighboring levels at random uvs.
+        \param[in] levels The mip chain, e.g. read back from the GPU.
+        \param[in] sampleCount Number of texels checked per level (spread evenly) and of uvs of the filtering check.
+        \param[in] tolerance Allowed error of the heights and cones, covers the rounding of the texture format.
+    */
+    MipCheckResult checkConservativeMips(const std::vector<Conemap>& levels, uint32_t sampleCount, float tolerance = 0.0f);
+}
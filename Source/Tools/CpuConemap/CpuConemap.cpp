@@ -0,0 +1,889 @@
+#include "CpuConemap.h"
+#include "TileScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "Simd.h"
+
+namespace CpuConemap
+{
+    namespace
+    {
+        const float kInf = std::numeric_limits<float>::infinity();
+        const float kFar = 1e6f;            // see QuickConemap.cs.slang
+        const int64_t kMaxRingRadius = 3;   // the adaptive ring grows up to 7x7 blocks
+
+#if CPUCONEMAP_AVX2
+CPUCONEMAP_AVX2_BEGIN
+        /** AVX2 part of rowMinSquaredRatio, processes the texels in groups of 8 and returns the first unprocessed one in i.
+        */
+        float rowMinSquaredRatioAvx2(const float* heights, const float* us, uint32_t count, float baseU, float baseH, float dv2, float minQ, uint32_t& i)
+        {
+            const __m256 vBaseU = _mm256_set1_ps(baseU);
+            const __m256 vBaseH = _mm256_set1_ps(baseH);
+            const __m256 vDv2 = _mm256_set1_ps(dv2);
+            const __m256 vZero = _mm256_setzero_ps();
+            const __m256 vInf = _mm256_set1_ps(kInf);
+            __m256 vMin = _mm256_set1_ps(minQ);
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 du = _mm256_sub_ps(vBaseU, _mm256_loadu_ps(us + i));
+                __m256 dh = _mm256_sub_ps(_mm256_loadu_ps(heights + i), vBaseH);
+                __m256 d2 = _mm256_add_ps(_mm256_mul_ps(du, du), vDv2);
+                __m256 q = _mm256_div_ps(d2, _mm256_mul_ps(dh, dh));
+                q = _mm256_blendv_ps(vInf, q, _mm256_cmp_ps(dh, vZero, _CMP_GT_OQ));
+                vMin = _mm256_min_ps(vMin, q);
+            }
+            __m128 m = _mm_min_ps(_mm256_castps256_ps128(vMin), _mm256_extractf128_ps(vMin, 1));
+            m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+            m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+            return _mm_cvtss_f32(m);
+        }
+
+        /** AVX2 part of rowSquaredRatios.
+        */
+        void rowSquaredRatiosAvx2(const float* heights, const float* us, uint32_t count, float baseU, float baseH, float dv2, float* outQ, uint32_t& i)
+        {
+            const __m256 vBaseU = _mm256_set1_ps(baseU);
+            const __m256 vBaseH = _mm256_set1_ps(baseH);
+            const __m256 vDv2 = _mm256_set1_ps(dv2);
+            const __m256 vZero = _mm256_setzero_ps();
+            const __m256 vInf = _mm256_set1_ps(kInf);
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 du = _mm256_sub_ps(vBaseU, _mm256_loadu_ps(us + i));
+                __m256 dh = _mm256_sub_ps(_mm256_loadu_ps(heights + i), vBaseH);
+                __m256 d2 = _mm256_add_ps(_mm256_mul_ps(du, du), vDv2);
+                __m256 q = _mm256_div_ps(d2, _mm256_mul_ps(dh, dh));
+                _mm256_storeu_ps(outQ + i, _mm256_blendv_ps(vInf, q, _mm256_cmp_ps(dh, vZero, _CMP_GT_OQ)));
+            }
+        }
+CPUCONEMAP_AVX2_END
+#endif
+
+        /** Minimum of the squared cone ratio (du^2 + dv^2) / dh^2 over a row segment,
+            where dh = heights[i] - baseH and only texels with dh > 0 count.
+            Comparing squared ratios avoids a sqrt per texel; the ratios are positive so the minimum is the same.
+        */
+        float rowMinSquaredRatio(const float* heights, const float* us, uint32_t count, float baseU, float baseH, float dv2, float minQ)
+        {
+            uint32_t i = 0;
+#if CPUCONEMAP_AVX2
+            if (useAvx2()) minQ = rowMinSquaredRatioAvx2(heights, us, count, baseU, baseH, dv2, minQ, i);
+#elif CPUCONEMAP_NEON
+            if (isSimdEnabled())
+            {
+                const float32x4_t vBaseU = vdupq_n_f32(baseU);
+                const float32x4_t vBaseH = vdupq_n_f32(baseH);
+                const float32x4_t vDv2 = vdupq_n_f32(dv2);
+                const float32x4_t vZero = vdupq_n_f32(0.0f);
+                const float32x4_t vInf = vdupq_n_f32(kInf);
+                float32x4_t vMin = vdupq_n_f32(minQ);
+                for (; i + 4 <= count; i += 4)
+                {
+                    float32x4_t du = vsubq_f32(vBaseU, vld1q_f32(us + i));
+                    float32x4_t dh = vsubq_f32(vld1q_f32(heights + i), vBaseH);
+                    float32x4_t d2 = vaddq_f32(vmulq_f32(du, du), vDv2);
+                    float32x4_t q = vdivq_f32(d2, vmulq_f32(dh, dh));
+                    q = vbslq_f32(vcgtq_f32(dh, vZero), q, vInf);
+                    vMin = vminq_f32(vMin, q);
+                }
+                minQ = vminvq_f32(vMin);
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                float du = baseU - us[i];
+                float dh = heights[i] - baseH;
+                if (dh > 0) minQ = std::min(minQ, (du * du + dv2) / (dh * dh));
+            }
+            return minQ;
+        }
+
+        /** Same as rowMinSquaredRatio, but stores the squared ratio of every texel (infinity for lower texels).
+        */
+        void rowSquaredRatios(const float* heights, const float* us, uint32_t count, float baseU, float baseH, float dv2, float* outQ)
+        {
+            uint32_t i = 0;
+#if CPUCONEMAP_AVX2
+            if (useAvx2()) rowSquaredRatiosAvx2(heights, us, count, baseU, baseH, dv2, outQ, i);
+#elif CPUCONEMAP_NEON
+            if (isSimdEnabled())
+            {
+                const float32x4_t vBaseU = vdupq_n_f32(baseU);
+                const float32x4_t vBaseH = vdupq_n_f32(baseH);
+                const float32x4_t vDv2 = vdupq_n_f32(dv2);
+                const float32x4_t vZero = vdupq_n_f32(0.0f);
+                const float32x4_t vInf = vdupq_n_f32(kInf);
+                for (; i + 4 <= count; i += 4)
+                {
+                    float32x4_t du = vsubq_f32(vBaseU, vld1q_f32(us + i));
+                    float32x4_t dh = vsubq_f32(vld1q_f32(heights + i), vBaseH);
+                    float32x4_t d2 = vaddq_f32(vmulq_f32(du, du), vDv2);
+                    float32x4_t q = vdivq_f32(d2, vmulq_f32(dh, dh));
+                    vst1q_f32(outQ + i, vbslq_f32(vcgtq_f32(dh, vZero), q, vInf));
+                }
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                float du = baseU - us[i];
+                float dh = heights[i] - baseH;
+                outQ[i] = dh > 0 ? (du * du + dv2) / (dh * dh) : kInf;
+            }
+        }
+
+        /** Bilinear sample with wrap addressing, as the linear sampler of the sample does.
+        */
+        float sampleBilinear(const Heightmap& hmap, float u, float v)
+        {
+            float x = u * hmap.width - 0.5f;
+            float y = v * hmap.height - 0.5f;
+            float x0 = std::floor(x);
+            float y0 = std::floor(y);
+            float fx = x - x0;
+            float fy = y - y0;
+            auto wrap = [](int64_t i, uint32_t size) { int64_t m = i % int64_t(size); return uint32_t(m < 0 ? m + size : m); };
+            uint32_t ix0 = wrap(int64_t(x0), hmap.width);
+            uint32_t ix1 = wrap(int64_t(x0) + 1, hmap.width);
+            uint32_t iy0 = wrap(int64_t(y0), hmap.height);
+            uint32_t iy1 = wrap(int64_t(y0) + 1, hmap.height);
+            float top = hmap.load(ix0, iy0) * (1 - fx) + hmap.load(ix1, iy0) * fx;
+            float bottom = hmap.load(ix0, iy1) * (1 - fx) + hmap.load(ix1, iy1) * fx;
+            return top * (1 - fy) + bottom * fy;
+        }
+
+        // Port of getRelaxedCone() in Conemap.cs.slang, the early out test is done by the caller.
+        float relaxedCone(const Heightmap& hmap, float baseU, float baseV, float baseH, float dstU, float dstV, float dstH, uint32_t searchSteps)
+        {
+            float srcZ = 1 + 0.001f;
+            float vx = dstU - baseU;
+            float vy = dstV - baseV;
+            float vz = dstH - srcZ;
+            // scale the direction so that vz = -1, then by dstH
+            float s = dstH / -vz;
+            float oneOverSearchSteps = 1.0f / searchSteps;
+            float stepX = vx * s * oneOverSearchSteps;
+            float stepY = vy * s * oneOverSearchSteps;
+            float stepZ = -dstH * oneOverSearchSteps;
+            float rayX = dstU + stepX;
+            float rayY = dstV + stepY;
+            float rayZ = dstH + stepZ;
+            for (uint32_t i = 1; i < searchSteps; ++i)
+            {
+                if (sampleBilinear(hmap, rayX, rayY) >= rayZ)
+                {
+                    rayX += stepX;
+                    rayY += stepY;
+                    rayZ += stepZ;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            if (rayZ <= baseH) return 1.0f;
+            float dx = rayX - baseU;
+            float dy = rayY - baseV;
+            return std::sqrt(dx * dx + dy * dy) / (rayZ - baseH);
+        }
+
+        const float kOvershootConeTolerance = 1 - 1e-5f;
+
+        // Port of getConeOvershoot() in Conemap.cs.slang.
+        float coneOvershoot(const Heightmap& hmap, float baseU, float baseV, float baseH, float cone, float dstU, float dstV, float dstH, uint32_t searchSteps)
+        {
+            const float srcZ = 1 + 0.001f;
+            const float dx = dstU - baseU;
+            const float dy = dstV - baseV;
+            const float d = std::sqrt(dx * dx + dy * dy);
+            // the texels that bound the cone are on its surface, do not march them for a rounding error
+            if (dstH <= baseH || d >= cone * (dstH - baseH) * kOvershootConeTolerance) return 0.0f;
+
+            // height where the ray leaves the cone
+            const float k = d / (srcZ - dstH);
+            const float coneZ = (srcZ * k + cone * baseH) / (k + cone);
+
+            const float oneOverSearchSteps = 1.0f / searchSteps;
+            const float stepX = dx * oneOverSearchSteps;
+            const float stepY = dy * oneOverSearchSteps;
+            const float stepZ = (dstH - srcZ) * oneOverSearchSteps;
+            float rayX = baseU, rayY = baseV, rayZ = srcZ;
+            for (uint32_t i = 1; i < searchSteps; ++i)
+            {
+                if (sampleBilinear(hmap, rayX + stepX, rayY + stepY) >= rayZ + stepZ) break;
+                rayX += stepX;
+                rayY += stepY;
+                rayZ += stepZ;
+            }
+            return std::max(rayZ - coneZ, 0.0f);
+        }
+
+        /** Shared data of the exact (conservative and relaxed) cone searches.
+        */
+        struct ExactSearchContext
+        {
+            const Heightmap& hmap;
+            const Settings& settings;
+            std::vector<float> us;      // texel center u coordinates
+            std::vector<float> vs;      // texel center v coordinates
+            std::vector<float> rowMax;  // maximum height of every row
+            float globalMax = 0;
+            float texelSizeU, texelSizeV;
+
+            /** \param[in] texelSizeU, texelSizeV UV size of a texel, 0 means 1/size of hmap. A window of a
+                larger heightmap uses the texel size of the whole map, so its cones are the same.
+            */
+            ExactSearchContext(const Heightmap& hmap, const Settings& settings, float texelSizeU = 0, float texelSizeV = 0)
+                : hmap(hmap), settings(settings)
+                , texelSizeU(texelSizeU > 0 ? texelSizeU : 1.0f / hmap.width)
+                , texelSizeV(texelSizeV > 0 ? texelSizeV : 1.0f / hmap.height)
+            {
+                const float oneOverW = this->texelSizeU;
+                const float oneOverH = this->texelSizeV;
+                us.resize(hmap.width);
+                vs.resize(hmap.height);
+                rowMax.resize(hmap.height);
+                for (uint32_t i = 0; i < hmap.width; ++i) us[i] = (float(i) + 0.5f) * oneOverW;
+                for (uint32_t j = 0; j < hmap.height; ++j)
+                {
+                    vs[j] = (float(j) + 0.5f) * oneOverH;
+                    const float* row = hmap.texels.data() + size_t(j) * hmap.width;
+                    rowMax[j] = *std::max_element(row, row + hmap.width);
+                }
+                globalMax = *std::max_element(rowMax.begin(), rowMax.end());
+            }
+
+            /** Cone ratio of the texel (x, y).
+                Rows are visited in order of their distance from the base row, and only
+                the columns that could still lower the current cone are tested. The
+                search stops when even the highest texel of the map could not lower it.
+                Relaxed cones are never smaller than the conservative cone towards the
+                same texel, so the same bounds apply to them.
+                \param[in] maxCone Upper bound of the result, a tighter bound shortens the search.
+            */
+            float cone(uint32_t x, uint32_t y, std::vector<float>& scratch, uint64_t& testedTexels, float maxCone = 1.0f) const
+            {
+                const float baseU = us[x];
+                const float baseV = vs[y];
+                const float baseH = hmap.load(x, y);
+                const float maxDh = globalMax - baseH;
+                if (maxDh <= 0) return maxCone;
+
+                const bool relaxed = settings.algorithm == Algorithm::Relaxed;
+                float minQ = maxCone * maxCone; // squared cone ratio
+                for (uint32_t r = 0; r < hmap.height; ++r)
+                {
+                    bool anyRow = false;
+                    for (int side = 0; side < (r == 0 ? 1 : 2); ++side)
+                    {
+                        int64_t j = side == 0 ? int64_t(y) + r : int64_t(y) - r;
+                        if (j < 0 || j >= int64_t(hmap.height)) continue;
+                        anyRow = true;
+                        const float dv = baseV - vs[j];
+                        const float dv2 = dv * dv;
+                        const float rowDh = rowMax[j] - baseH;
+                        if (rowDh <= 0) continue;
+                        // squared horizontal distance that could still lower the cone
+                        const float du2Limit = minQ * rowDh * rowDh - dv2;
+                        if (du2Limit <= 0) continue;
+                        // one texel margin against rounding
+                        const float duLimit = std::sqrt(du2Limit) / texelSizeU + 1.0f;
+                        const uint32_t begin = uint32_t(std::max(0.0f, std::floor(float(x) - duLimit)));
+                        const uint32_t end = uint32_t(std::min(float(hmap.width), std::ceil(float(x) + duLimit) + 1.0f));
+                        if (begin >= end) continue;
+                        const float* row = hmap.texels.data() + size_t(j) * hmap.width;
+                        testedTexels += end - begin;
+
+                        if (!relaxed)
+                        {
+                            minQ = rowMinSquaredRatio(row + begin, us.data() + begin, end - begin, baseU, baseH, dv2, minQ);
+                        }
+                        else
+                        {
+                            scratch.resize(hmap.width);
+                            rowSquaredRatios(row + begin, us.data() + begin, end - begin, baseU, baseH, dv2, scratch.data());
+                            for (uint32_t i = begin; i < end; ++i)
+                            {
+                                // the early out of getRelaxedCone() in squared form
+                                if (!(scratch[i - begin] <= minQ)) continue;
+                                float c = relaxedCone(hmap, baseU, baseV, baseH, us[i], vs[j], row[i], settings.relaxedConeSearchSteps);
+                                minQ = std::min(minQ, c * c);
+                            }
+                        }
+                    }
+                    if (!anyRow) break;
+                    // every further row is at least this far vertically
+                    const float dvNext = (float(r) + 0.5f) * texelSizeV;
+                    if (dvNext > 0 && dvNext * dvNext >= minQ * maxDh * maxDh) break;
+                }
+                return std::sqrt(minQ);
+            }
+        };
+
+        /** Port of QuickConemap.cs.slang. Block centers are computed from the block size
+            in texels instead of the size of the mip level, which is the same for
+            power of two textures and stays correct for other sizes.
+        */
+        struct QuickSearchContext
+        {
+            const MinmaxPyramid& pyramid;
+            const Settings& settings;
+            float deltaHalfX, deltaHalfY; // (UV size of a texel)/2
+            uint32_t maxLevel;
+
+            QuickSearchContext(const MinmaxPyramid& pyramid, const Settings& settings)
+                : pyramid(pyramid), settings(settings)
+            {
+                deltaHalfX = 0.5f / pyramid.levels[0].width;
+                deltaHalfY = 0.5f / pyramid.levels[0].height;
+                maxLevel = uint32_t(pyramid.levels.size()) >= 2 ? uint32_t(pyramid.levels.size()) - 2 : 0;
+            }
+
+            float blockCenterU(uint32_t i, uint32_t level) const { return (float(i) + 0.5f) * float(1u << level) * 2 * deltaHalfX; }
+            float blockCenterV(uint32_t j, uint32_t level) const { return (float(j) + 0.5f) * float(1u << level) * 2 * deltaHalfY; }
+
+            void checkNeighbour(bool cond, float dist, int64_t i, int64_t j, uint32_t level, float baseH, float& minTan, uint64_t& testedTexels) const
+            {
+                if (!cond) return;
+                ++testedTexels;
+                float heightDiff = pyramid.levels[level].getMax(uint32_t(i), uint32_t(j)) - baseH;
+                if (heightDiff > dist) minTan = std::min(minTan, dist / heightDiff);
+            }
+
+            void check8(int64_t ci, int64_t cj, uint32_t level, float l, float t, float r, float b, float baseH, float& minTan, uint64_t& testedTexels) const
+            {
+                const auto& lvl = pyramid.levels[level];
+                const int64_t w = lvl.width, h = lvl.height;
+                checkNeighbour(ci - 1 >= 0, l, ci - 1, cj, level, baseH, minTan, testedTexels);
+                checkNeighbour(ci + 1 < w, r, ci + 1, cj, level, baseH, minTan, testedTexels);
+                checkNeighbour(cj - 1 >= 0, t, ci, cj - 1, level, baseH, minTan, testedTexels);
+                checkNeighbour(cj + 1 < h, b, ci, cj + 1, level, baseH, minTan, testedTexels);
+                checkNeighbour(ci - 1 >= 0 && cj - 1 >= 0, std::hypot(l, t), ci - 1, cj - 1, level, baseH, minTan, testedTexels);
+                checkNeighbour(ci + 1 < w && cj - 1 >= 0, std::hypot(r, t), ci + 1, cj - 1, level, baseH, minTan, testedTexels);
+                checkNeighbour(ci + 1 < w && cj + 1 < h, std::hypot(r, b), ci + 1, cj + 1, level, baseH, minTan, testedTexels);
+                checkNeighbour(ci - 1 >= 0 && cj + 1 < h, std::hypot(l, b), ci - 1, cj + 1, level, baseH, minTan, testedTexels);
+            }
+
+            float naive(uint32_t x, uint32_t y, uint64_t& testedTexels) const
+            {
+                const bool center = settings.maxAtTexelCenter;
+                const float baseH = pyramid.levels[0].getMax(x, y);
+                float minTan = 1;
+                uint32_t ci = x, cj = y;
+                float cdhX = deltaHalfX, cdhY = deltaHalfY;
+                const float baseU = blockCenterU(x, 0), baseV = blockCenterV(y, 0);
+                float l = 2 * deltaHalfX, t = 2 * deltaHalfY, r = 2 * deltaHalfX, b = 2 * deltaHalfY;
+                for (uint32_t level = 0; level <= maxLevel; ++level)
+                {
+                    check8(ci, cj, level, l, t, r, b, baseH, minTan, testedTexels);
+                    ci /= 2;
+                    cj /= 2;
+                    cdhX *= 2;
+                    cdhY *= 2;
+                    float relX = baseU - blockCenterU(ci, level + 1);
+                    float relY = baseV - blockCenterV(cj, level + 1);
+                    float addX = center ? cdhX : deltaHalfX;
+                    float addY = center ? cdhY : deltaHalfY;
+                    l = cdhX + relX + addX;
+                    t = cdhY + relY + addY;
+                    r = cdhX - relX + addX;
+                    b = cdhY - relY + addY;
+                }
+                return minTan;
+            }
+
+            static float nearestUncheckedDiagonalDist(bool specX, bool specY, float distX, float distY, float deltaX, float deltaY)
+            {
+                float sx = distX - (specX ? deltaX : 0.0f);
+                float sy = distY - (specY ? deltaY : 0.0f);
+                // the unchecked part of the diagonal neighbour is L shaped, its nearest point is one of the two inner corners
+                if (specX && specY) return std::min(std::hypot(distX, sy), std::hypot(sx, distY));
+                return std::hypot(sx, sy);
+            }
+
+            float regionGrowing3x3(uint32_t x, uint32_t y, uint64_t& testedTexels) const
+            {
+                const bool center = settings.maxAtTexelCenter;
+                const float baseH = pyramid.levels[0].getMax(x, y);
+                float minTan = 1;
+                uint32_t ci = x, cj = y;
+                float cdhX = deltaHalfX, cdhY = deltaHalfY;
+                const float baseU = blockCenterU(x, 0), baseV = blockCenterV(y, 0);
+                float relX = 0, relY = 0;
+
+                // first step is the 8 neighbour
+                check8(ci, cj, 0, 2 * deltaHalfX, 2 * deltaHalfY, 2 * deltaHalfX, 2 * deltaHalfY, baseH, minTan, testedTexels);
+
+                for (uint32_t level = 1; level <= maxLevel; ++level)
+                {
+                    const uint32_t li = ci, lj = cj;
+                    const float lastRelX = relX, lastRelY = relY;
+                    ci /= 2;
+                    cj /= 2;
+                    relX = baseU - blockCenterU(ci, level);
+                    relY = baseV - blockCenterV(cj, level);
+
+                    float l, t, r, b;
+                    if (center)
+                    {
+                        l = 4 * cdhX + relX;
+                        t = 4 * cdhY + relY;
+                        r = 4 * cdhX - relX;
+                        b = 4 * cdhY - relY;
+                    }
+                    else
+                    {
+                        l = 3 * cdhX + lastRelX + deltaHalfX;
+                        t = 3 * cdhY + lastRelY + deltaHalfY;
+                        r = 3 * cdhX - lastRelX + deltaHalfX;
+                        b = 3 * cdhY - lastRelY + deltaHalfY;
+                    }
+                    cdhX *= 2;
+                    cdhY *= 2;
+
+                    const auto& lvl = pyramid.levels[level];
+                    const int64_t w = lvl.width, h = lvl.height;
+                    const int64_t i = ci, j = cj;
+                    checkNeighbour(i - 1 >= 0, l, i - 1, j, level, baseH, minTan, testedTexels);
+                    checkNeighbour(i + 1 < w, r, i + 1, j, level, baseH, minTan, testedTexels);
+                    checkNeighbour(j - 1 >= 0, t, i, j - 1, level, baseH, minTan, testedTexels);
+                    checkNeighbour(j + 1 < h, b, i, j + 1, level, baseH, minTan, testedTexels);
+
+                    // The corner cases follow the shader exactly, so both produce the same cones.
+                    const bool oddX = li % 2 == 1, oddY = lj % 2 == 1;
+                    float dTL = center ? std::hypot(l, t) : nearestUncheckedDiagonalDist(!oddX, !oddY, l, t, cdhX, cdhY);
+                    float dTR = center ? std::hypot(r, t) : nearestUncheckedDiagonalDist(oddX, !oddY, r, t, cdhX, cdhY);
+                    float dBR = center ? std::hypot(r, b) : nearestUncheckedDiagonalDist(oddX, oddY, r, b, cdhX, cdhY);
+                    float dBL = center ? std::hypot(l, b) : nearestUncheckedDiagonalDist(!oddX, oddY, l, b, cdhX, cdhY);
+                    checkNeighbour(i - 1 >= 0 && j - 1 >= 0, dTL, i - 1, j - 1, level, baseH, minTan, testedTexels);
+                    checkNeighbour(i + 1 < w && j - 1 >= 0, dTR, i + 1, j - 1, level, baseH, minTan, testedTexels);
+                    checkNeighbour(i + 1 < w && j + 1 < h, dBR, i + 1, j + 1, level, baseH, minTan, testedTexels);
+                    checkNeighbour(i - 1 >= 0 && j + 1 < h, dBL, i - 1, j + 1, level, baseH, minTan, testedTexels);
+                }
+                return minTan;
+            }
+
+            // Rectangle of level 0 texels, [lo, hi] inclusive
+            struct TexelRect
+            {
+                int64_t lo[2];
+                int64_t hi[2];
+            };
+
+            TexelRect blockRect(int64_t i, int64_t j, uint32_t level) const
+            {
+                const int64_t size[2] = { pyramid.levels[0].width, pyramid.levels[0].height };
+                const int64_t ij[2] = { i, j };
+                TexelRect r;
+                for (int a = 0; a < 2; ++a)
+                {
+                    r.lo[a] = ij[a] << level;
+                    r.hi[a] = std::min((ij[a] + 1) << level, size[a]) - 1;
+                }
+                return r;
+            }
+
+            float rectDistance(int64_t px, int64_t py, int64_t loX, int64_t loY, int64_t hiX, int64_t hiY) const
+            {
+                const float dx = float(std::max({ loX - px, px - hiX, int64_t(0) })) * 2 * deltaHalfX;
+                const float dy = float(std::max({ loY - py, py - hiY, int64_t(0) })) * 2 * deltaHalfY;
+                return std::hypot(dx, dy);
+            }
+
+            // see uncheckedDistance in QuickConemap.cs.slang
+            float uncheckedDistance(int64_t px, int64_t py, const TexelRect& A, const TexelRect& C) const
+            {
+                float d = kFar;
+                if (A.lo[0] < C.lo[0]) d = std::min(d, rectDistance(px, py, A.lo[0], A.lo[1], std::min(A.hi[0], C.lo[0] - 1), A.hi[1]));
+                if (A.hi[0] > C.hi[0]) d = std::min(d, rectDistance(px, py, std::max(A.lo[0], C.hi[0] + 1), A.lo[1], A.hi[0], A.hi[1]));
+                if (A.lo[1] < C.lo[1]) d = std::min(d, rectDistance(px, py, A.lo[0], A.lo[1], A.hi[0], std::min(A.hi[1], C.lo[1] - 1)));
+                if (A.hi[1] > C.hi[1]) d = std::min(d, rectDistance(px, py, A.lo[0], std::max(A.lo[1], C.hi[1] + 1), A.hi[0], A.hi[1]));
+                return d;
+            }
+
+            float outsideDistance(int64_t px, int64_t py, const TexelRect& C) const
+            {
+                float d = kFar;
+                if (C.lo[0] > 0) d = std::min(d, float(px - C.lo[0] + 1) * 2 * deltaHalfX);
+                if (C.lo[1] > 0) d = std::min(d, float(py - C.lo[1] + 1) * 2 * deltaHalfY);
+                if (C.hi[0] < int64_t(pyramid.levels[0].width) - 1) d = std::min(d, float(C.hi[0] + 1 - px) * 2 * deltaHalfX);
+                if (C.hi[1] < int64_t(pyramid.levels[0].height) - 1) d = std::min(d, float(C.hi[1] + 1 - py) * 2 * deltaHalfY);
+                return d;
+            }
+
+            TexelRect ringRect(int64_t ci, int64_t cj, int64_t radius, uint32_t level) const
+            {
+                const auto& lvl = pyramid.levels[level];
+                TexelRect r = blockRect(std::max(ci - radius, int64_t(0)), std::max(cj - radius, int64_t(0)), level);
+                const TexelRect hi = blockRect(std::min(ci + radius, int64_t(lvl.width) - 1), std::min(cj + radius, int64_t(lvl.height) - 1), level);
+                r.hi[0] = hi.hi[0];
+                r.hi[1] = hi.hi[1];
+                return r;
+            }
+
+            void checkRing(int64_t px, int64_t py, int64_t ci, int64_t cj, int64_t radius, uint32_t level, const TexelRect& checked, float baseH, float& minTan, uint64_t& testedTexels) const
+            {
+                const auto& lvl = pyramid.levels[level];
+                for (int64_t j = cj - radius; j <= cj + radius; ++j)
+                {
+                    for (int64_t i = ci - radius; i <= ci + radius; ++i)
+                    {
+                        if (std::max(std::abs(i - ci), std::abs(j - cj)) != radius) continue;
+                        if (i < 0 || j < 0 || i >= int64_t(lvl.width) || j >= int64_t(lvl.height)) continue;
+                        const TexelRect A = blockRect(i, j, level);
+                        float dist = uncheckedDistance(px, py, A, checked);
+                        if (dist >= kFar) continue;
+                        if (settings.maxAtTexelCenter)
+                            dist = std::hypot((float(A.lo[0] + A.hi[0]) * 0.5f - float(px)) * 2 * deltaHalfX, (float(A.lo[1] + A.hi[1]) * 0.5f - float(py)) * 2 * deltaHalfY);
+                        checkNeighbour(true, dist, i, j, level, baseH, minTan, testedTexels);
+                    }
+                }
+            }
+
+            float regionMax(int64_t ci, int64_t cj, int64_t radius, uint32_t level) const
+            {
+                const auto& lvl = pyramid.levels[level];
+                float h = 0;
+                for (int64_t j = std::max(cj - radius, int64_t(0)); j <= std::min(cj + radius, int64_t(lvl.height) - 1); ++j)
+                    for (int64_t i = std::max(ci - radius, int64_t(0)); i <= std::min(ci + radius, int64_t(lvl.width) - 1); ++i)
+                        h = std::max(h, lvl.getMax(uint32_t(i), uint32_t(j)));
+                return h;
+            }
+
+            // port of generateQuickConeMap_regionGrowingRing
+            float regionGrowingRing(uint32_t x, uint32_t y, int64_t ringRadius, bool adaptive, uint64_t& testedTexels) const
+            {
+                const int64_t px = x, py = y;
+                const float baseH = pyramid.levels[0].getMax(x, y);
+                const uint32_t topLevel = uint32_t(pyramid.levels.size()) - 1;
+                const float globalMaxH = pyramid.levels[topLevel].getMax(0, 0);
+                float minTan = 1;
+                TexelRect checked = { { px, py }, { px, py } };
+
+                for (uint32_t level = 0; level <= topLevel; ++level)
+                {
+                    const float outside = outsideDistance(px, py, checked);
+                    if (outside >= kFar || minTan * (globalMaxH - baseH) <= outside) break;
+
+                    const int64_t ci = px >> level, cj = py >> level;
+                    int64_t radius = std::max({ ci - (checked.lo[0] >> level), cj - (checked.lo[1] >> level), (checked.hi[0] >> level) - ci, (checked.hi[1] >> level) - cj });
+                    radius = std::max(radius, adaptive ? int64_t(1) : ringRadius);
+                    for (int64_t r = 0; r <= radius; ++r)
+                        checkRing(px, py, ci, cj, r, level, checked, baseH, minTan, testedTexels);
+                    TexelRect ring = ringRect(ci, cj, radius, level);
+
+                    const uint32_t boundLevel = std::min(level + 2, topLevel);
+                    const int64_t bi = ci >> (boundLevel - level), bj = cj >> (boundLevel - level);
+                    while (adaptive && radius < kMaxRingRadius)
+                    {
+                        const float ringOutside = outsideDistance(px, py, ring);
+                        if (ringOutside >= kFar || minTan * (regionMax(bi, bj, 1, boundLevel) - baseH) <= ringOutside) break;
+                        checkRing(px, py, ci, cj, ++radius, level, checked, baseH, minTan, testedTexels);
+                        ring = ringRect(ci, cj, radius, level);
+                    }
+                    checked = ring;
+                }
+                return minTan;
+            }
+        };
+    }
+
+    bool parseAlgorithm(const std::string& name, Algorithm& algorithm)
+    {
+        for (Algorithm a : { Algorithm::Conservative, Algorithm::Relaxed, Algorithm::QuickNaive, Algorithm::QuickRegionGrowing,
+            Algorithm::QuickRing5x5, Algorithm::QuickRing7x7, Algorithm::QuickRingAdaptive })
+        {
+            if (name == to_string(a))
+            {
+                algorithm = a;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char* to_string(Algorithm algorithm)
+    {
+        switch (algorithm)
+        {
+        case Algorithm::Conservative: return "conservative";
+        case Algorithm::Relaxed: return "relaxed";
+        case Algorithm::QuickNaive: return "quick-naive";
+        case Algorithm::QuickRegionGrowing: return "quick";
+        case Algorithm::QuickRing5x5: return "quick-5x5";
+        case Algorithm::QuickRing7x7: return "quick-7x7";
+        case Algorithm::QuickRingAdaptive: return "quick-adaptive";
+        }
+        return "unknown";
+    }
+
+    const char* getSimdName()
+    {
+#if CPUCONEMAP_AVX2
+        if (useAvx2()) return "AVX2";
+#elif CPUCONEMAP_NEON
+        if (isSimdEnabled()) return "NEON";
+#endif
+        return "scalar";
+    }
+
+    void setSimdEnabled(bool enabled)
+    {
+        gSimdEnabled.store(enabled);
+    }
+
+    MinmaxPyramid buildMinmaxPyramid(const Heightmap& hmap)
+    {
+        if (hmap.width == 0 || hmap.height == 0) throw std::invalid_argument("buildMinmaxPyramid: empty heightmap");
+        MinmaxPyramid pyramid;
+        {
+            MinmaxPyramid::Level level0;
+            level0.width = hmap.width;
+            level0.height = hmap.height;
+            level0.texels.resize(2 * hmap.texels.size());
+            for (size_t i = 0; i < hmap.texels.size(); ++i)
+            {
+                level0.texels[2 * i + 0] = hmap.texels[i];
+                level0.texels[2 * i + 1] = hmap.texels[i];
+            }
+            pyramid.levels.push_back(std::move(level0));
+        }
+        buildMinmaxLevels(pyramid);
+        return pyramid;
+    }
+
+    MinmaxPyramid buildMinmaxMipmap(const Heightmap& hmap)
+    {
+        MinmaxPyramid pyramid = buildMinmaxPyramid(hmap);
+        pyramid.levels.resize(1);
+        while (pyramid.levels.back().width > 1 || pyramid.levels.back().height > 1)
+        {
+            const auto& src = pyramid.levels.back();
+            MinmaxPyramid::Level dst;
+            dst.width = std::max(src.width / 2, 1u);
+            dst.height = std::max(src.height / 2, 1u);
+            dst.texels.resize(2 * size_t(dst.width) * dst.height);
+            for (uint32_t y = 0; y < dst.height; ++y)
+            {
+                // the last texel also pools the extra row/column of an odd sized level
+                const uint32_t syEnd = y == dst.height - 1 ? src.height : 2 * y + 2;
+                for (uint32_t x = 0; x < dst.width; ++x)
+                {
+                    const uint32_t sxEnd = x == dst.width - 1 ? src.width : 2 * x + 2;
+                    float mn = std::numeric_limits<float>::max();
+                    float mx = std::numeric_limits<float>::lowest();
+                    for (uint32_t sy = 2 * y; sy < syEnd; ++sy)
+                    {
+                        for (uint32_t sx = 2 * x; sx < sxEnd; ++sx)
+                        {
+                            mn = std::min(mn, src.getMin(sx, sy));
+                            mx = std::max(mx, src.getMax(sx, sy));
+                        }
+                    }
+                    size_t ind = size_t(y) * dst.width + x;
+                    dst.texels[2 * ind + 0] = mn;
+                    dst.texels[2 * ind + 1] = mx;
+                }
+            }
+            pyramid.levels.push_back(std::move(dst));
+        }
+        return pyramid;
+    }
+
+    void buildMinmaxLevels(MinmaxPyramid& pyramid)
+    {
+        if (pyramid.levels.empty()) throw std::invalid_argument("buildMinmaxLevels: no base level");
+        pyramid.levels.resize(1);
+        while (pyramid.levels.back().width > 1 || pyramid.levels.back().height > 1)
+        {
+            const auto& src = pyramid.levels.back();
+            MinmaxPyramid::Level dst;
+            dst.width = (src.width + 1) / 2;
+            dst.height = (src.height + 1) / 2;
+            dst.texels.resize(2 * size_t(dst.width) * dst.height);
+            for (uint32_t y = 0; y < dst.height; ++y)
+            {
+                for (uint32_t x = 0; x < dst.width; ++x)
+                {
+                    float mn = std::numeric_limits<float>::max();
+                    float mx = std::numeric_limits<float>::lowest();
+                    for (uint32_t sy = 2 * y; sy < std::min(2 * y + 2, src.height); ++sy)
+                    {
+                        for (uint32_t sx = 2 * x; sx < std::min(2 * x + 2, src.width); ++sx)
+                        {
+                            mn = std::min(mn, src.getMin(sx, sy));
+                            mx = std::max(mx, src.getMax(sx, sy));
+                        }
+                    }
+                    size_t ind = size_t(y) * dst.width + x;
+                    dst.texels[2 * ind + 0] = mn;
+                    dst.texels[2 * ind + 1] = mx;
+                }
+            }
+            pyramid.levels.push_back(std::move(dst));
+        }
+    }
+
+    uint64_t bakeWindowCones(const Heightmap& window, float texelSizeU, float texelSizeV, uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, float* cones)
+    {
+        if (window.texels.size() != size_t(window.width) * window.height) throw std::invalid_argument("bakeWindowCones: heightmap size mismatch");
+        if (x0 + w > window.width || y0 + h > window.height) throw std::invalid_argument("bakeWindowCones: rectangle is outside the window");
+
+        Settings settings;
+        ExactSearchContext ctx(window, settings, texelSizeU, texelSizeV);
+        std::vector<float> scratch;
+        uint64_t testedTexels = 0;
+        for (uint32_t y = 0; y < h; ++y)
+        {
+            for (uint32_t x = 0; x < w; ++x)
+            {
+                float& cone = cones[size_t(y) * w + x];
+                cone = ctx.cone(x0 + x, y0 + y, scratch, testedTexels, std::min(cone, 1.0f));
+            }
+        }
+        return testedTexels;
+    }
+
+    float measureOvershoot(const Heightmap& hmap, const Conemap& conemap, uint32_t searchSteps, float coneQuantum, uint32_t threadCount, std::vector<float>* pPerTexel)
+    {
+        if (conemap.width != hmap.width || conemap.height != hmap.height) throw std::invalid_argument("measureOvershoot: the conemap and the heightmap sizes differ");
+        if (searchSteps < 1) throw std::invalid_argument("measureOvershoot: searchSteps must be positive");
+
+        std::vector<float> overshoot(size_t(hmap.width) * hmap.height, 0.0f);
+        const float oneOverW = 1.0f / hmap.width;
+        const float oneOverH = 1.0f / hmap.height;
+        std::vector<float> rowMax(hmap.height);
+        for (uint32_t j = 0; j < hmap.height; ++j)
+        {
+            const auto row = hmap.texels.begin() + size_t(j) * hmap.width;
+            rowMax[j] = *std::max_element(row, row + hmap.width);
+        }
+        TileScheduler scheduler(threadCount);
+        scheduler.run(hmap.height, [&](uint32_t y, uint32_t)
+        {
+            for (uint32_t x = 0; x < hmap.width; ++x)
+            {
+                const float baseU = (float(x) + 0.5f) * oneOverW;
+                const float baseV = (float(y) + 0.5f) * oneOverH;
+                const float baseH = hmap.load(x, y);
+                const float cone = conemap.getCone(x, y) + coneQuantum;
+                float o = 0.0f;
+                for (uint32_t j = 0; j < hmap.height; ++j)
+                {
+                    // no texel of the row is inside the cone, the result is the same as the all-pairs search of the shader
+                    const float dy = (float(j) + 0.5f) * oneOverH - baseV;
+                    if (rowMax[j] <= baseH || std::sqrt(dy * dy) >= cone * (rowMax[j] - baseH) * kOvershootConeTolerance) continue;
+                    for (uint32_t i = 0; i < hmap.width; ++i)
+                    {
+                        if (i == x && j == y) continue;
+                        o = std::max(o, coneOvershoot(hmap, baseU, baseV, baseH, cone, (float(i) + 0.5f) * oneOverW, (float(j) + 0.5f) * oneOverH, hmap.load(i, j), searchSteps));
+                    }
+                }
+                overshoot[size_t(y) * hmap.width + x] = o;
+            }
+        });
+
+        const float maxOvershoot = *std::max_element(overshoot.begin(), overshoot.end());
+        if (pPerTexel) *pPerTexel = std::move(overshoot);
+        return maxOvershoot;
+    }
+
+    Conemap bake(const Heightmap& hmap, const Settings& settings, BakeStats* pStats)
+    {
+        if (hmap.width == 0 || hmap.height == 0) throw std::invalid_argument("bake: empty heightmap");
+        if (hmap.texels.size() != size_t(hmap.width) * hmap.height) throw std::invalid_argument("bake: heightmap size mismatch");
+        if (settings.algorithm == Algorithm::Relaxed && settings.relaxedConeSearchSteps < 1) throw std::invalid_argument("bake: relaxedConeSearchSteps must be positive");
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        Conemap result;
+        result.width = hmap.width;
+        result.height = hmap.height;
+        result.texels.resize(2 * hmap.texels.size());
+
+        const uint32_t tileSize = std::max(1u, settings.tileSize);
+        const uint32_t tilesX = (hmap.width + tileSize - 1) / tileSize;
+        const uint32_t tilesY = (hmap.height + tileSize - 1) / tileSize;
+        TileScheduler scheduler(settings.threadCount);
+        std::atomic<uint64_t> testedTexels = 0;
+
+        // runs texelFun(x, y, testedTexels) for every texel of a tile
+        auto runTiles = [&](auto texelFun)
+        {
+            return scheduler.run(tilesX * tilesY, [&](uint32_t tile, uint32_t)
+            {
+                const uint32_t x0 = (tile % tilesX) * tileSize;
+                const uint32_t y0 = (tile / tilesX) * tileSize;
+                const uint32_t x1 = std::min(x0 + tileSize, hmap.width);
+                const uint32_t y1 = std::min(y0 + tileSize, hmap.height);
+                uint64_t tested = 0;
+                for (uint32_t y = y0; y < y1; ++y)
+                {
+                    for (uint32_t x = x0; x < x1; ++x)
+                    {
+                        size_t ind = size_t(y) * hmap.width + x;
+                        result.texels[2 * ind + 0] = hmap.texels[ind];
+                        result.texels[2 * ind + 1] = texelFun(x, y, tested);
+                    }
+                }
+                testedTexels += tested;
+            });
+        };
+
+        uint32_t stolenTiles = 0;
+        switch (settings.algorithm)
+        {
+        case Algorithm::Conservative:
+        case Algorithm::Relaxed:
+        {
+            ExactSearchContext ctx(hmap, settings);
+            stolenTiles = runTiles([&ctx](uint32_t x, uint32_t y, uint64_t& tested)
+            {
+                thread_local std::vector<float> scratch;
+                return ctx.cone(x, y, scratch, tested);
+            });
+            break;
+        }
+        case Algorithm::QuickNaive:
+        case Algorithm::QuickRegionGrowing:
+        {
+            MinmaxPyramid pyramid = buildMinmaxPyramid(hmap);
+            QuickSearchContext ctx(pyramid, settings);
+            const bool naive = settings.algorithm == Algorithm::QuickNaive;
+            stolenTiles = runTiles([&ctx, naive](uint32_t x, uint32_t y, uint64_t& tested)
+            {
+                return naive ? ctx.naive(x, y, tested) : ctx.regionGrowing3x3(x, y, tested);
+            });
+            break;
+        }
+        case Algorithm::QuickRing5x5:
+        case Algorithm::QuickRing7x7:
+        case Algorithm::QuickRingAdaptive:
+        {
+            MinmaxPyramid pyramid = buildMinmaxPyramid(hmap);
+            QuickSearchContext ctx(pyramid, settings);
+            const bool adaptive = settings.algorithm == Algorithm::QuickRingAdaptive;
+            const int64_t radius = settings.algorithm == Algorithm::QuickRing7x7 ? 3 : settings.algorithm == Algorithm::QuickRing5x5 ? 2 : 1;
+            stolenTiles = runTiles([&ctx, radius, adaptive](uint32_t x, uint32_t y, uint64_t& tested)
+            {
+                return ctx.regionGrowingRing(x, y, radius, adaptive, tested);
+            });
+            break;
+        }
+        }
+
+        if (pStats)
+        {
+            pStats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            pStats->testedTexels = testedTexels;
+            pStats->threadCount = scheduler.getThreadCount();
+            pStats->stolenTiles = stolenTiles;
+        }
+        return result;
+    }
+}
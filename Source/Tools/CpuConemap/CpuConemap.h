@@ -0,0 +1,147 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU implementation of the conemap generators of the Parallax sample.
+// The library only depends on the standard library, so conemaps can be baked
+// on machines without a GPU. The algorithms follow the compute shaders:
+//  - Conemap.cs.slang      : conservative (CONE_TYPE 1) and relaxed (CONE_TYPE 2) cones
+//  - Minmax.cs.slang       : minmax mipmap, see buildMinmaxMipmap
+//  - QuickConemap.cs.slang : naive (QUICK_GEN_ALG 1), region growing 3x3 (QUICK_GEN_ALG 2) and 5x5, 7x7, adaptive ring (QUICK_GEN_ALG 3-5) quick cones
+//  - ConemapMip.cs.slang   : conservative conemap mipmap, see ConemapMips.h
+namespace CpuConemap
+{
+    /** Single channel heightmap, heights are in [0,1].
+    */
+    struct Heightmap
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<float> texels; // row major, texels[y * width + x]
+
+        float load(uint32_t x, uint32_t y) const { return texels[size_t(y) * width + x]; }
+    };
+
+    /** Conemap with the same layout as the RG textures of the sample.
+    */
+    struct Conemap
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<float> texels; // row major, interleaved [height, cone ratio] pairs
+
+        float getHeight(uint32_t x, uint32_t y) const { return texels[2 * (size_t(y) * width + x) + 0]; }
+        float getCone(uint32_t x, uint32_t y) const { return texels[2 * (size_t(y) * width + x) + 1]; }
+    };
+
+    /** Minmax mip chain of a heightmap.
+        Level sizes are rounded up, so the texel (x,y) of level l bounds every
+        height in the 2^l x 2^l block starting at (x,y) * 2^l, even for
+        non-power-of-two sizes (blocks on the edge are clipped).
+    */
+    struct MinmaxPyramid
+    {
+        struct Level
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            std::vector<float> texels; // row major, interleaved [min, max] pairs
+
+            float getMin(uint32_t x, uint32_t y) const { return texels[2 * (size_t(y) * width + x) + 0]; }
+            float getMax(uint32_t x, uint32_t y) const { return texels[2 * (size_t(y) * width + x) + 1]; }
+        };
+        std::vector<Level> levels; // levels[0] has the size of the heightmap, the last level is 1x1
+    };
+
+    enum class Algorithm
+    {
+        Conservative,       // exact conservative cones, Conemap.cs.slang CONE_TYPE 1
+        Relaxed,            // relaxed cones, Conemap.cs.slang CONE_TYPE 2
+        QuickNaive,         // QuickConemap.cs.slang QUICK_GEN_ALG 1
+        QuickRegionGrowing, // QuickConemap.cs.slang QUICK_GEN_ALG 2
+        QuickRing5x5,       // QuickConemap.cs.slang QUICK_GEN_ALG 3
+        QuickRing7x7,       // QuickConemap.cs.slang QUICK_GEN_ALG 4
+        QuickRingAdaptive,  // QuickConemap.cs.slang QUICK_GEN_ALG 5
+    };
+
+    struct Settings
+    {
+        Algorithm algorithm = Algorithm::Conservative;
+        uint32_t relaxedConeSearchSteps = 64; // Relaxed only
+        bool maxAtTexelCenter = false;        // Quick algorithms only, see MAX_AT_TEXEL_CENTER
+        uint32_t threadCount = 0;             // 0: use every hardware thread
+        uint32_t tileSize = 32;               // texels per side of a scheduled tile
+    };
+
+    struct BakeStats
+    {
+        double seconds = 0.0;       // wall clock time of the bake
+        uint64_t testedTexels = 0;  // (base texel, tested texel) pairs evaluated by the cone search
+        uint32_t threadCount = 0;   // number of threads that took part
+        uint32_t stolenTiles = 0;   // tiles executed by a worker other than their initial owner
+    };
+
+    /** Parses algorithm names: "conservative", "relaxed", "quick-naive", "quick", "quick-5x5", "quick-7x7" and "quick-adaptive".
+        \return false if the name is unknown.
+    */
+    bool parseAlgorithm(const std::string& name, Algorithm& algorithm);
+    const char* to_string(Algorithm algorithm);
+
+    /** Name of the SIMD instruction set the inner loops use, AVX2 is selected at run time (see Simd.h).
+    */
+    const char* getSimdName();
+
+    /** Enables or disables the SIMD code paths of the library, e.g. to compare them with the scalar code.
+        Should not be changed while a bake or a trace is running.
+    */
+    void setSimdEnabled(bool enabled);
+
+    MinmaxPyramid buildMinmaxPyramid(const Heightmap& hmap);
+
+    /** Minmax mipmap with the layout of the minmax texture of the sample (Minmax.cs.slang), in a MinmaxPyramid:
+        the level sizes are rounded down like the mips of a texture, so the texel x of level l covers the
+        level 0 texels [x << l, (x + 1) << l), and the last texel of a row/column extends to the edge.
+    */
+    MinmaxPyramid buildMinmaxMipmap(const Heightmap& hmap);
+
+    /** Replaces the levels above levels[0] with the coarser levels of the chain.
+        Used when the base level is not a heightmap, e.g. the per-block minmax of a streamed heightmap.
+    */
+    void buildMinmaxLevels(MinmaxPyramid& pyramid);
+
+    /** Conservative cones of a rectangle of texels, only searching a window of a larger heightmap.
+        Cones towards the texels outside the window have to be bounded by the caller (see StreamingBake.h).
+        \param[in] window The loaded part of the heightmap.
+        \param[in] texelSizeU, texelSizeV UV size of a texel of the whole heightmap.
+        \param[in] x0, y0, w, h The rectangle, in window coordinates.
+        \param[in,out] cones w * h cone ratios, row major. Upper bounds of the cones on input (1 if there is none), the results on output.
+        \return Number of tested texels.
+    */
+    uint64_t bakeWindowCones(const Heightmap& window, float texelSizeU, float texelSizeV, uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, float* cones);
+
+    /** Estimate of how far a cone step can end below the first intersection, port of mainOvershoot in Conemap.cs.slang.
+        Relaxed cones let the steps tunnel into the surface, this estimates the interval the refinement has to search.
+        The rays are sampled like the relaxed cone search does: from the top of a texel towards the texel centers,
+        so it is not a bound: rays in other directions, the bilinear filtering and the march sampling can end farther.
+        It is 0 for conservative cones. Only the texels inside the cones are marched, and the rows that cannot
+        reach into a cone are skipped, so narrow cones are cheap.
+        \param[in] hmap The heightmap the conemap was baked from.
+        \param[in] conemap The cones to measure.
+        \param[in] searchSteps Samples along every ray.
+        \param[in] coneQuantum Rounding error of the stored cones, e.g. the unorm step of the texture format.
+        \param[in] threadCount Number of threads, 0 means hardware concurrency.
+        \param[out] pPerTexel Optional, the estimate of every texel, row major.
+        \return The largest estimate, in heights (which is t of the primary search).
+    */
+    float measureOvershoot(const Heightmap& hmap, const Conemap& conemap, uint32_t searchSteps, float coneQuantum = 0.0f, uint32_t threadCount = 0, std::vector<float>* pPerTexel = nullptr);
+
+    /** Bakes a conemap.
+        \param[in] hmap The source heightmap.
+        \param[in] settings Algorithm and scheduling settings.
+        \param[out] pStats Optional statistics of the bake.
+        \return The conemap, same size as the heightmap.
+    */
+    Conemap bake(const Heightmap& hmap, const Settings& settings, BakeStats* pStats = nullptr);
+}
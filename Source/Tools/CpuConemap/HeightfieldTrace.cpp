@@ -0,0 +1,921 @@
+#include "HeightfieldTrace.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "Simd.h"
+
+namespace CpuConemap
+{
+    namespace
+    {
+        // texel index of a (possibly negative) integer valued coordinate, the SIMD version does the same operations
+        float wrapCoord(float i, float size)
+        {
+            float r = i - std::floor(i / size) * size;
+            if (r >= size) r -= size;
+            if (r < 0) r += size;
+            return r;
+        }
+
+        float lerp(float a, float b, float t)
+        {
+            return a + (b - a) * t;
+        }
+
+        float sampleHeight(const Conemap& conemap, float u, float v)
+        {
+            float height, cone;
+            sampleBilinear(conemap, u, v, height, cone);
+            return height;
+        }
+
+        // port of ConemapFootprint, the texels that are blended by the bilinear filtering
+        struct Footprint
+        {
+            const float* texels[4]; // [height, cone] of the texels 00, 10, 01, 11
+            float f[2];             // weights of the 10 and 01 texels
+        };
+
+        // port of gatherHC_texture, with the wrap addressing of gSampler
+        Footprint gatherFootprint(const Conemap& conemap, float u, float v)
+        {
+            // texel centers are at half integers, like D3D's linear filtering
+            const float x = u * float(conemap.width) - 0.5f;
+            const float y = v * float(conemap.height) - 0.5f;
+            const float fx0 = std::floor(x);
+            const float fy0 = std::floor(y);
+            const uint32_t x0 = uint32_t(wrapCoord(fx0, float(conemap.width)));
+            const uint32_t y0 = uint32_t(wrapCoord(fy0, float(conemap.height)));
+            const uint32_t x1 = x0 + 1 == conemap.width ? 0 : x0 + 1;
+            const uint32_t y1 = y0 + 1 == conemap.height ? 0 : y0 + 1;
+
+            Footprint fp;
+            fp.texels[0] = conemap.texels.data() + 2 * (size_t(y0) * conemap.width + x0);
+            fp.texels[1] = conemap.texels.data() + 2 * (size_t(y0) * conemap.width + x1);
+            fp.texels[2] = conemap.texels.data() + 2 * (size_t(y1) * conemap.width + x0);
+            fp.texels[3] = conemap.texels.data() + 2 * (size_t(y1) * conemap.width + x1);
+            fp.f[0] = x - fx0;
+            fp.f[1] = y - fy0;
+            return fp;
+        }
+
+        const float kShadowBias = 1e-3f; // kShadowBias of SelfShadow.slang
+        const float kShadowMinStep = 0.25f; // kShadowMinStep of SelfShadow.slang
+
+        // ShadowRay of SelfShadow.slang
+        struct ShadowMarch
+        {
+            float u[2];
+            float z;
+            float dir[2];
+            float m;
+            float rMax;
+        };
+
+        // port of setupShadowRay
+        bool setupShadowMarch(const Conemap& conemap, const ShadowRay& ray, ShadowMarch& march)
+        {
+            march.u[0] = ray.u[0];
+            march.u[1] = ray.u[1];
+            march.z = sampleHeight(conemap, ray.u[0], ray.u[1]) + kShadowBias;
+            march.dir[0] = 1;
+            march.dir[1] = 0;
+            march.m = 0;
+            march.rMax = 0;
+            if (ray.light[2] <= 0)
+                return false;
+            const float lenXY = std::sqrt(ray.light[0] * ray.light[0] + ray.light[1] * ray.light[1]);
+            if (lenXY == 0)
+                return true;
+            march.dir[0] = ray.light[0] / lenXY;
+            march.dir[1] = ray.light[1] / lenXY;
+            march.m = ray.light[2] / lenXY;
+            march.rMax = (1 - march.z) / march.m;
+            const float edge[2] = { 0.5f / float(conemap.width), 0.5f / float(conemap.height) };
+            for (int a = 0; a < 2; ++a)
+                if (march.dir[a] != 0)
+                    march.rMax = std::min(march.rMax, ((march.dir[a] > 0 ? 1 - edge[a] : edge[a]) - ray.u[a]) / march.dir[a]);
+            return true;
+        }
+
+        // port of getShadowSampleVisibility
+        float getShadowSampleVisibility(float gap, float r, float penumbra)
+        {
+            if (gap <= 0)
+                return 0;
+            return penumbra > 0 ? std::clamp(gap / (r * penumbra), 0.0f, 1.0f) : 1.0f;
+        }
+
+        // smoothstep(0, 1, x) of HLSL
+        float smoothstep01(float x)
+        {
+            x = std::clamp(x, 0.0f, 1.0f);
+            return x * x * (3 - 2 * x);
+        }
+
+        ShadowResult traceShadowLinear(const Conemap& conemap, const ShadowMarch& march, const ShadowSettings& settings)
+        {
+            ShadowResult res;
+            const float dr = march.rMax / float(settings.steps);
+            float vis = 1;
+            for (uint32_t i = 1; i <= settings.steps && vis > 0; ++i)
+            {
+                const float r = dr * float(i);
+                const float h = sampleHeight(conemap, march.u[0] + march.dir[0] * r, march.u[1] + march.dir[1] * r);
+                ++res.stepCount;
+                vis = std::min(vis, getShadowSampleVisibility(march.z + march.m * r - h, r, settings.penumbra));
+            }
+            res.visibility = smoothstep01(vis);
+            return res;
+        }
+
+        ShadowResult traceShadowConeStep(const Conemap& conemap, const ShadowMarch& march, const ShadowSettings& settings)
+        {
+            ShadowResult res;
+            const float w = 1.0f / float(conemap.width);
+            if (march.rMax <= w)
+                return res;
+            const float texelSize[2] = { 1.0f / float(conemap.width), 1.0f / float(conemap.height) };
+            const float diagonal = std::sqrt(texelSize[0] * texelSize[0] + texelSize[1] * texelSize[1]);
+            const float minStep = std::max(kShadowMinStep * w, (march.rMax - w) / float(settings.steps));
+            float r = w;
+            float vis = 1;
+            while (res.stepCount < settings.steps)
+            {
+                const Footprint fp = gatherFootprint(conemap, march.u[0] + march.dir[0] * r, march.u[1] + march.dir[1] * r);
+                ++res.stepCount;
+                const float z = march.z + march.m * r;
+                const float h = lerp(lerp(fp.texels[0][0], fp.texels[1][0], fp.f[0]), lerp(fp.texels[2][0], fp.texels[3][0], fp.f[0]), fp.f[1]);
+                vis = std::min(vis, getShadowSampleVisibility(z - h, r, settings.penumbra));
+                if (vis <= 0)
+                    break;
+                float safe = 0;
+                bool escapes = false;
+                for (int i = 0; i < 4; ++i)
+                {
+                    const float dx = ((i & 1) ? 1 - fp.f[0] : fp.f[0]) * texelSize[0];
+                    const float dy = ((i & 2) ? 1 - fp.f[1] : fp.f[1]) * texelSize[1];
+                    const float margin = std::sqrt(dx * dx + dy * dy) + diagonal;
+                    const float c = fp.texels[i][1];
+                    const float bound = (z - fp.texels[i][0]) * c - margin;
+                    if (bound < 0)
+                        continue;
+                    if (march.m * c >= 1)
+                        escapes = true;
+                    else
+                        safe = std::max(safe, bound / (1 - march.m * c));
+                }
+                if (escapes || r == march.rMax)
+                    break;
+                // the last sample is at the end of the ray
+                r = std::min(r + std::max(safe, minStep), march.rMax);
+            }
+            res.visibility = smoothstep01(vis);
+            return res;
+        }
+
+        const float kNoExit = std::numeric_limits<float>::max();
+
+        // t where the ray leaves [lo, hi] along one axis, the same expression as in findIntersection_maxMipmap
+        float axisExit(float lo, float hi, float p0, float d, float invD)
+        {
+            return d > 0 ? (hi - p0) * invD : d < 0 ? (lo - p0) * invD : kNoExit;
+        }
+
+        // true if the ray is on the far side of the boundary b at t, ties go to the side the ray moves to
+        bool isBeyond(float b, float t, float p0, float d, float invD)
+        {
+            return d > 0 ? t >= (b - p0) * invD : d < 0 ? t < (b - p0) * invD : p0 >= b;
+        }
+
+        // texel space origin and direction of the ray, false if it starts outside of the texture
+        bool setupTraversal(const TraceRay& ray, const uint32_t maxSize[2], float p0[2], float d[2], float invD[2])
+        {
+            for (int a = 0; a < 2; ++a)
+            {
+                p0[a] = ray.u[a] * float(maxSize[a]);
+                d[a] = (ray.u2[a] - ray.u[a]) * float(maxSize[a]);
+                invD[a] = d[a] != 0 ? 1.0f / d[a] : 0.0f;
+                if (p0[a] < 0 || p0[a] > float(maxSize[a])) return false;
+            }
+            return true;
+        }
+
+        float getConeStepTexelSize(const Conemap& conemap, const TraceSettings& settings)
+        {
+            return settings.texelSize > 0 ? settings.texelSize : 1.0f / float(conemap.width);
+        }
+
+        void setUv(const TraceRay& ray, float t, float uv[2])
+        {
+            for (int a = 0; a < 2; ++a) uv[a] = (1 - t) * ray.u[a] + t * ray.u2[a];
+        }
+
+        float refineLinearApprox(const Conemap& conemap, const TraceRay& ray, const TraceResult& interval)
+        {
+            const float t0 = interval.lastT;
+            const float t1 = interval.t;
+            const float h0 = sampleHeight(conemap, lerp(ray.u[0], ray.u2[0], t0), lerp(ray.u[1], ray.u2[1], t0));
+            const float h1 = sampleHeight(conemap, lerp(ray.u[0], ray.u2[0], t1), lerp(ray.u[1], ray.u2[1], t1));
+            const float dt = t1 - t0;
+            float t = (dt + t0 * h1 - t1 * h0) / (dt + h1 - h0);
+            // clamp() of HLSL, a NaN (h0 == h1 + dt) gives t0
+            t = std::max(t0, t);
+            t = std::min(t1, t);
+            return t;
+        }
+
+        float refineBinarySearch(const Conemap& conemap, const TraceRay& ray, const TraceResult& interval, uint32_t refineSteps, float refineOvershoot)
+        {
+            float t0 = std::max(interval.lastT, interval.t - refineOvershoot);
+            float t1 = interval.t;
+            float th = 0.5f * (t0 + t1);
+            for (uint32_t i = 0; i < refineSteps; ++i)
+            {
+                const float fh = sampleHeight(conemap, lerp(ray.u[0], ray.u2[0], th), lerp(ray.u[1], ray.u2[1], th));
+                if (fh > 1 - th) t1 = th;
+                else t0 = th;
+                th = 0.5f * (t0 + t1);
+            }
+            return th;
+        }
+
+#if CPUCONEMAP_AVX2
+CPUCONEMAP_AVX2_BEGIN
+        const int kPacketWidth = 8;
+
+        __m256 lerp8(__m256 a, __m256 b, __m256 t)
+        {
+            return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+        }
+
+        __m256 wrapCoord8(__m256 i, __m256 size)
+        {
+            __m256 r = _mm256_sub_ps(i, _mm256_mul_ps(_mm256_floor_ps(_mm256_div_ps(i, size)), size));
+            r = _mm256_sub_ps(r, _mm256_and_ps(_mm256_cmp_ps(r, size, _CMP_GE_OQ), size));
+            r = _mm256_add_ps(r, _mm256_and_ps(_mm256_cmp_ps(r, _mm256_setzero_ps(), _CMP_LT_OQ), size));
+            return r;
+        }
+
+        /** Eight bilinear samples of a conemap, see sampleBilinear.
+        */
+        struct ConemapSampler8
+        {
+            const float* texels;
+            __m256 sizeX, sizeY;
+            __m256i width, height;
+
+            explicit ConemapSampler8(const Conemap& conemap)
+                : texels(conemap.texels.data())
+                , sizeX(_mm256_set1_ps(float(conemap.width))), sizeY(_mm256_set1_ps(float(conemap.height)))
+                , width(_mm256_set1_epi32(int(conemap.width))), height(_mm256_set1_epi32(int(conemap.height)))
+            {
+            }
+
+            void sample(__m256 u, __m256 v, __m256& h, __m256& c, bool needCone = true) const
+            {
+                const __m256 half = _mm256_set1_ps(0.5f);
+                const __m256 x = _mm256_sub_ps(_mm256_mul_ps(u, sizeX), half);
+                const __m256 y = _mm256_sub_ps(_mm256_mul_ps(v, sizeY), half);
+                const __m256 fx0 = _mm256_floor_ps(x);
+                const __m256 fy0 = _mm256_floor_ps(y);
+                const __m256 fx = _mm256_sub_ps(x, fx0);
+                const __m256 fy = _mm256_sub_ps(y, fy0);
+                const __m256i one = _mm256_set1_epi32(1);
+                const __m256i x0 = _mm256_cvttps_epi32(wrapCoord8(fx0, sizeX));
+                const __m256i y0 = _mm256_cvttps_epi32(wrapCoord8(fy0, sizeY));
+                __m256i x1 = _mm256_add_epi32(x0, one);
+                __m256i y1 = _mm256_add_epi32(y0, one);
+                x1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(x1, width), x1);
+                y1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(y1, height), y1);
+
+                // indices of the height channels
+                const __m256i row0 = _mm256_mullo_epi32(y0, width);
+                const __m256i row1 = _mm256_mullo_epi32(y1, width);
+                const __m256i i00 = _mm256_slli_epi32(_mm256_add_epi32(row0, x0), 1);
+                const __m256i i10 = _mm256_slli_epi32(_mm256_add_epi32(row0, x1), 1);
+                const __m256i i01 = _mm256_slli_epi32(_mm256_add_epi32(row1, x0), 1);
+                const __m256i i11 = _mm256_slli_epi32(_mm256_add_epi32(row1, x1), 1);
+                auto filter = [&](const float* base)
+                {
+                    const __m256 t00 = _mm256_i32gather_ps(base, i00, 4);
+                    const __m256 t10 = _mm256_i32gather_ps(base, i10, 4);
+                    const __m256 t01 = _mm256_i32gather_ps(base, i01, 4);
+                    const __m256 t11 = _mm256_i32gather_ps(base, i11, 4);
+                    return lerp8(lerp8(t00, t10, fx), lerp8(t01, t11, fx), fy);
+                };
+                h = filter(texels);
+                if (needCone) c = filter(texels + 1);
+            }
+
+            __m256 sampleHeight(__m256 u, __m256 v) const
+            {
+                __m256 h, c;
+                sample(u, v, h, c, false);
+                return h;
+            }
+        };
+
+        /** Rays of a packet in SoA layout. Missing rays of the last packet repeat the last ray.
+        */
+        struct RayPacket8
+        {
+            __m256 u[2];
+            __m256 u2[2];
+
+            RayPacket8(const TraceRay* rays, size_t count)
+            {
+                alignas(32) float lanes[4][kPacketWidth];
+                for (int i = 0; i < kPacketWidth; ++i)
+                {
+                    const TraceRay& ray = rays[std::min(size_t(i), count - 1)];
+                    lanes[0][i] = ray.u[0];
+                    lanes[1][i] = ray.u[1];
+                    lanes[2][i] = ray.u2[0];
+                    lanes[3][i] = ray.u2[1];
+                }
+                for (int a = 0; a < 2; ++a)
+                {
+                    u[a] = _mm256_load_ps(lanes[a]);
+                    u2[a] = _mm256_load_ps(lanes[2 + a]);
+                }
+            }
+
+            __m256 lerpU(int a, __m256 t) const { return lerp8(u[a], u2[a], t); }
+            __m256 pointU(int a, __m256 t) const
+            {
+                const __m256 one = _mm256_set1_ps(1.0f);
+                return _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(one, t), u[a]), _mm256_mul_ps(t, u2[a]));
+            }
+        };
+
+        /** Intersection results of a packet in SoA layout.
+        */
+        struct ResultPacket8
+        {
+            __m256 uv[2];
+            __m256 t;
+            __m256 lastT;
+            __m256 wasHit; // lane mask
+            __m256i stepCount;
+
+            void store(TraceResult* results, size_t count) const
+            {
+                alignas(32) float lanes[5][kPacketWidth];
+                alignas(32) int32_t steps[kPacketWidth];
+                _mm256_store_ps(lanes[0], uv[0]);
+                _mm256_store_ps(lanes[1], uv[1]);
+                _mm256_store_ps(lanes[2], t);
+                _mm256_store_ps(lanes[3], lastT);
+                const int hitMask = _mm256_movemask_ps(wasHit);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(steps), stepCount);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    results[i].uv[0] = lanes[0][i];
+                    results[i].uv[1] = lanes[1][i];
+                    results[i].t = lanes[2][i];
+                    results[i].lastT = lanes[3][i];
+                    results[i].wasHit = (hitMask >> i) & 1;
+                    results[i].stepCount = uint32_t(steps[i]);
+                }
+            }
+        };
+
+        ResultPacket8 traceBumpMapping8(const RayPacket8& rays)
+        {
+            ResultPacket8 res;
+            res.uv[0] = rays.u2[0];
+            res.uv[1] = rays.u2[1];
+            res.t = res.lastT = _mm256_set1_ps(1.0f);
+            res.wasHit = _mm256_setzero_ps();
+            res.stepCount = _mm256_setzero_si256();
+            return res;
+        }
+
+        ResultPacket8 traceParallaxMapping8(const ConemapSampler8& sampler, const RayPacket8& rays)
+        {
+            ResultPacket8 res;
+            res.t = _mm256_sub_ps(_mm256_set1_ps(1.0f), sampler.sampleHeight(rays.u2[0], rays.u2[1]));
+            res.lastT = res.t;
+            res.uv[0] = rays.pointU(0, res.t);
+            res.uv[1] = rays.pointU(1, res.t);
+            res.wasHit = _mm256_setzero_ps();
+            res.stepCount = _mm256_setzero_si256();
+            return res;
+        }
+
+        ResultPacket8 traceLinearSearch8(const ConemapSampler8& sampler, const RayPacket8& rays, const TraceSettings& settings)
+        {
+            const __m256 dt = _mm256_set1_ps(1.0f / settings.steps);
+            __m256 t = _mm256_set1_ps(1.0f);
+            const __m256 du[2] = { _mm256_mul_ps(_mm256_sub_ps(rays.u2[0], rays.u[0]), dt), _mm256_mul_ps(_mm256_sub_ps(rays.u2[1], rays.u[1]), dt) };
+            __m256 uu[2] = { rays.u[0], rays.u[1] };
+            __m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            __m256 wasHit = _mm256_setzero_ps();
+            __m256i i = _mm256_setzero_si256();
+            for (uint32_t step = 0; step < settings.steps && _mm256_movemask_ps(active); ++step)
+            {
+                t = _mm256_blendv_ps(t, _mm256_sub_ps(t, dt), active);
+                for (int a = 0; a < 2; ++a) uu[a] = _mm256_blendv_ps(uu[a], _mm256_add_ps(uu[a], du[a]), active);
+                const __m256 h = sampler.sampleHeight(uu[0], uu[1]);
+                const __m256 hit = _mm256_and_ps(active, _mm256_cmp_ps(h, t, _CMP_GE_OQ));
+                wasHit = _mm256_or_ps(wasHit, hit);
+                active = _mm256_andnot_ps(hit, active);
+                // lanes that hit stop counting, like the break of the shader
+                i = _mm256_sub_epi32(i, _mm256_castps_si256(active));
+            }
+
+            ResultPacket8 res;
+            res.uv[0] = uu[0];
+            res.uv[1] = uu[1];
+            const __m256 one = _mm256_set1_ps(1.0f);
+            res.t = _mm256_sub_ps(one, t);
+            res.lastT = _mm256_sub_ps(_mm256_sub_ps(one, t), dt);
+            res.wasHit = wasHit;
+            res.stepCount = _mm256_min_epu32(_mm256_add_epi32(i, _mm256_set1_epi32(1)), _mm256_set1_epi32(int(settings.steps)));
+            return res;
+        }
+
+        ResultPacket8 traceConeStep8(const ConemapSampler8& sampler, const RayPacket8& rays, const TraceSettings& settings, float texelSize)
+        {
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256 dx = _mm256_sub_ps(rays.u2[0], rays.u[0]);
+            const __m256 dy = _mm256_sub_ps(rays.u2[1], rays.u[1]);
+            const __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), one)));
+            const __m256 ds[3] = { _mm256_mul_ps(dx, invLength), _mm256_mul_ps(dy, invLength), _mm256_mul_ps(one, invLength) };
+            const __m256 w = _mm256_set1_ps(texelSize);
+            const __m256 iz = _mm256_sqrt_ps(_mm256_sub_ps(one, _mm256_mul_ps(ds[2], ds[2])));
+            const __m256 relax = _mm256_set1_ps(settings.relax);
+            const __m256 budget = _mm256_add_ps(_mm256_ceil_ps(_mm256_div_ps(one, _mm256_mul_ps(_mm256_mul_ps(ds[2], relax), w))), one);
+            const __m256i steps = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_set1_ps(float(settings.steps)), budget));
+            __m256 sc = _mm256_setzero_ps();
+            __m256 h, c;
+            sampler.sample(rays.u[0], rays.u[1], h, c);
+            __m256i stepCount = _mm256_setzero_si256();
+            __m256 zTimesSc = _mm256_setzero_ps();
+            auto isActive = [&]()
+            {
+                const __m256 above = _mm256_cmp_ps(_mm256_sub_ps(one, _mm256_mul_ps(ds[2], sc)), h, _CMP_GT_OQ);
+                return _mm256_and_ps(above, _mm256_castsi256_ps(_mm256_cmpgt_epi32(steps, stepCount)));
+            };
+            __m256 active = isActive();
+            while (_mm256_movemask_ps(active))
+            {
+                const __m256 z = _mm256_mul_ps(ds[2], sc);
+                zTimesSc = _mm256_blendv_ps(zTimesSc, z, active);
+                const __m256 step = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(one, z), h), _mm256_add_ps(ds[2], _mm256_div_ps(iz, c)));
+                sc = _mm256_blendv_ps(sc, _mm256_add_ps(sc, _mm256_mul_ps(relax, _mm256_add_ps(w, step))), active);
+                __m256 nh, nc;
+                sampler.sample(_mm256_add_ps(rays.u[0], _mm256_mul_ps(ds[0], sc)), _mm256_add_ps(rays.u[1], _mm256_mul_ps(ds[1], sc)), nh, nc);
+                h = _mm256_blendv_ps(h, nh, active);
+                c = _mm256_blendv_ps(c, nc, active);
+                stepCount = _mm256_sub_epi32(stepCount, _mm256_castps_si256(active));
+                active = _mm256_and_ps(active, isActive());
+            }
+
+            ResultPacket8 res;
+            res.lastT = zTimesSc;
+            res.wasHit = _mm256_castsi256_ps(_mm256_cmpgt_epi32(steps, stepCount));
+            res.stepCount = stepCount;
+            sc = _mm256_sub_ps(sc, w);
+            res.t = _mm256_mul_ps(ds[2], sc);
+            res.uv[0] = rays.pointU(0, res.t);
+            res.uv[1] = rays.pointU(1, res.t);
+            return res;
+        }
+
+        void refine8(const ConemapSampler8& sampler, RefinementFunction function, const RayPacket8& rays, const ResultPacket8& interval, const TraceSettings& settings, __m256 uv[2])
+        {
+            if (function == RefinementFunction::None)
+            {
+                uv[0] = interval.uv[0];
+                uv[1] = interval.uv[1];
+                return;
+            }
+            __m256 t0 = interval.lastT;
+            __m256 t1 = interval.t;
+            __m256 t;
+            if (function == RefinementFunction::LinearApprox)
+            {
+                const __m256 h0 = sampler.sampleHeight(rays.lerpU(0, t0), rays.lerpU(1, t0));
+                const __m256 h1 = sampler.sampleHeight(rays.lerpU(0, t1), rays.lerpU(1, t1));
+                const __m256 dt = _mm256_sub_ps(t1, t0);
+                t = _mm256_div_ps(_mm256_sub_ps(_mm256_add_ps(dt, _mm256_mul_ps(t0, h1)), _mm256_mul_ps(t1, h0)), _mm256_sub_ps(_mm256_add_ps(dt, h1), h0));
+                // maxps returns the second operand for NaNs, like std::max(t0, t)
+                t = _mm256_max_ps(t, t0);
+                t = _mm256_min_ps(t, t1);
+            }
+            else
+            {
+                const __m256 half = _mm256_set1_ps(0.5f);
+                const __m256 one = _mm256_set1_ps(1.0f);
+                t0 = _mm256_max_ps(_mm256_sub_ps(t1, _mm256_set1_ps(settings.refineOvershoot)), t0);
+                t = _mm256_mul_ps(half, _mm256_add_ps(t0, t1));
+                for (uint32_t i = 0; i < settings.refineSteps; ++i)
+                {
+                    const __m256 fh = sampler.sampleHeight(rays.lerpU(0, t), rays.lerpU(1, t));
+                    const __m256 below = _mm256_cmp_ps(fh, _mm256_sub_ps(one, t), _CMP_GT_OQ);
+                    t1 = _mm256_blendv_ps(t1, t, below);
+                    t0 = _mm256_blendv_ps(t, t0, below);
+                    t = _mm256_mul_ps(half, _mm256_add_ps(t0, t1));
+                }
+            }
+            uv[0] = rays.lerpU(0, t);
+            uv[1] = rays.lerpU(1, t);
+        }
+
+        /** Packet part of traceRays.
+        */
+        void traceRays8(const Conemap& conemap, IntersectionFunction function, RefinementFunction refinement, const TraceRay* rays, size_t count, const TraceSettings& settings, TraceResult* results, float* refinedUvs)
+        {
+            const ConemapSampler8 sampler(conemap);
+            for (size_t first = 0; first < count; first += kPacketWidth)
+            {
+                const size_t n = std::min(count - first, size_t(kPacketWidth));
+                const RayPacket8 packet(rays + first, n);
+                ResultPacket8 res;
+                switch (function)
+                {
+                case IntersectionFunction::BumpMapping: res = traceBumpMapping8(packet); break;
+                case IntersectionFunction::ParallaxMapping: res = traceParallaxMapping8(sampler, packet); break;
+                case IntersectionFunction::LinearSearch: res = traceLinearSearch8(sampler, packet, settings); break;
+                case IntersectionFunction::ConeStepMapping: res = traceConeStep8(sampler, packet, settings, getConeStepTexelSize(conemap, settings)); break;
+                default: throw std::invalid_argument("traceRays: unknown intersection function");
+                }
+                res.store(results + first, n);
+                if (!refinedUvs) continue;
+
+                __m256 uv[2];
+                refine8(sampler, refinement, packet, res, settings, uv);
+                alignas(32) float lanes[2][kPacketWidth];
+                _mm256_store_ps(lanes[0], uv[0]);
+                _mm256_store_ps(lanes[1], uv[1]);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    refinedUvs[2 * (first + i) + 0] = lanes[0][i];
+                    refinedUvs[2 * (first + i) + 1] = lanes[1][i];
+                }
+            }
+        }
+CPUCONEMAP_AVX2_END
+#endif
+    }
+
+    void sampleBilinear(const Conemap& conemap, float u, float v, float& height, float& cone)
+    {
+        const Footprint fp = gatherFootprint(conemap, u, v);
+        height = lerp(lerp(fp.texels[0][0], fp.texels[1][0], fp.f[0]), lerp(fp.texels[2][0], fp.texels[3][0], fp.f[0]), fp.f[1]);
+        cone = lerp(lerp(fp.texels[0][1], fp.texels[1][1], fp.f[0]), lerp(fp.texels[2][1], fp.texels[3][1], fp.f[0]), fp.f[1]);
+    }
+
+    TraceResult traceBumpMapping(const Conemap&, const TraceRay& ray, const TraceSettings&)
+    {
+        TraceResult res;
+        res.uv[0] = ray.u2[0];
+        res.uv[1] = ray.u2[1];
+        res.t = 1;
+        res.lastT = 1;
+        return res;
+    }
+
+    TraceResult traceParallaxMapping(const Conemap& conemap, const TraceRay& ray, const TraceSettings&)
+    {
+        TraceResult res;
+        res.t = 1 - sampleHeight(conemap, ray.u2[0], ray.u2[1]);
+        res.lastT = res.t;
+        setUv(ray, res.t, res.uv);
+        return res;
+    }
+
+    TraceResult traceLinearSearch(const Conemap& conemap, const TraceRay& ray, const TraceSettings& settings)
+    {
+        TraceResult res;
+        const float dt = 1.0f / settings.steps;
+        float t = 1;
+        const float du[2] = { (ray.u2[0] - ray.u[0]) * dt, (ray.u2[1] - ray.u[1]) * dt };
+        float uu[2] = { ray.u[0], ray.u[1] };
+        uint32_t i = 0;
+        for (; i < settings.steps; ++i)
+        {
+            t -= dt;
+            uu[0] += du[0];
+            uu[1] += du[1];
+            if (sampleHeight(conemap, uu[0], uu[1]) >= t)
+            {
+                res.wasHit = true;
+                break;
+            }
+        }
+
+        res.uv[0] = uu[0];
+        res.uv[1] = uu[1];
+        res.t = 1 - t;
+        res.lastT = 1 - t - dt;
+        res.stepCount = std::min(i + 1, settings.steps);
+        return res;
+    }
+
+    uint32_t getConeStepBudget(float dirZ, float texelSize, const TraceSettings& settings)
+    {
+        return uint32_t(std::min(float(settings.steps), std::ceil(1.0f / (dirZ * settings.relax * texelSize)) + 1));
+    }
+
+    TraceResult traceConeStep(const Conemap& conemap, const TraceRay& ray, const TraceSettings& settings)
+    {
+        float ds[3] = { ray.u2[0] - ray.u[0], ray.u2[1] - ray.u[1], 1.0f };
+        const float invLength = 1.0f / std::sqrt(ds[0] * ds[0] + ds[1] * ds[1] + ds[2] * ds[2]);
+        for (float& c : ds) c *= invLength;
+        const float w = getConeStepTexelSize(conemap, settings);
+        const uint32_t stepLimit = getConeStepBudget(ds[2], w, settings);
+        const float iz = std::sqrt(1.0f - ds[2] * ds[2]);
+        float sc = 0;
+        float h, c;
+        sampleBilinear(conemap, ray.u[0], ray.u[1], h, c);
+        uint32_t stepCount = 0;
+        float zTimesSc = 0.0f;
+        while (1.0f - ds[2] * sc > h && stepCount < stepLimit)
+        {
+            zTimesSc = ds[2] * sc;
+            // a zero cone gives an infinite denominator and a step of w, like on the GPU
+            sc += settings.relax * (w + (1.0f - zTimesSc - h) / (ds[2] + iz / c));
+            sampleBilinear(conemap, ray.u[0] + ds[0] * sc, ray.u[1] + ds[1] * sc, h, c);
+            ++stepCount;
+        }
+
+        TraceResult res;
+        res.lastT = zTimesSc;
+        res.wasHit = stepCount < stepLimit;
+        res.stepCount = stepCount;
+        sc -= w;
+        res.t = ds[2] * sc;
+        setUv(ray, res.t, res.uv);
+        return res;
+    }
+
+    TraceResult trace(const Conemap& conemap, IntersectionFunction function, const TraceRay& ray, const TraceSettings& settings)
+    {
+        switch (function)
+        {
+        case IntersectionFunction::BumpMapping: return traceBumpMapping(conemap, ray, settings);
+        case IntersectionFunction::ParallaxMapping: return traceParallaxMapping(conemap, ray, settings);
+        case IntersectionFunction::LinearSearch: return traceLinearSearch(conemap, ray, settings);
+        case IntersectionFunction::ConeStepMapping: return traceConeStep(conemap, ray, settings);
+        }
+        throw std::invalid_argument("trace: unknown intersection function");
+    }
+
+    void refine(const Conemap& conemap, RefinementFunction function, const TraceRay& ray, const TraceResult& interval, const TraceSettings& settings, float uv[2])
+    {
+        float t;
+        switch (function)
+        {
+        case RefinementFunction::None:
+            uv[0] = interval.uv[0];
+            uv[1] = interval.uv[1];
+            return;
+        case RefinementFunction::LinearApprox:
+            t = refineLinearApprox(conemap, ray, interval);
+            break;
+        case RefinementFunction::BinarySearch:
+            t = refineBinarySearch(conemap, ray, interval, settings.refineSteps, settings.refineOvershoot);
+            break;
+        default:
+            throw std::invalid_argument("refine: unknown refinement function");
+        }
+        uv[0] = lerp(ray.u[0], ray.u2[0], t);
+        uv[1] = lerp(ray.u[1], ray.u2[1], t);
+    }
+
+    uint32_t getTracePacketWidth()
+    {
+#if CPUCONEMAP_AVX2
+        if (useAvx2()) return kPacketWidth;
+#endif
+        return 1;
+    }
+
+    void traceRays(const Conemap& conemap, IntersectionFunction function, RefinementFunction refinement, const TraceRay* rays, size_t count, const TraceSettings& settings, TraceResult* results, float* refinedUvs)
+    {
+#if CPUCONEMAP_AVX2
+        // the gathers use 32 bit indices
+        if (useAvx2() && 2 * size_t(conemap.width) * conemap.height <= size_t(INT32_MAX))
+        {
+            traceRays8(conemap, function, refinement, rays, count, settings, results, refinedUvs);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < count; ++i)
+        {
+            results[i] = trace(conemap, function, rays[i], settings);
+            if (refinedUvs) refine(conemap, refinement, rays[i], results[i], settings, refinedUvs + 2 * i);
+        }
+    }
+
+    TraceResult traceMaxMipmap(const MinmaxPyramid& mipmap, const TraceRay& ray, uint32_t maxSteps)
+    {
+        if (mipmap.levels.empty()) throw std::invalid_argument("traceMaxMipmap: empty mipmap");
+        TraceResult res;
+        const uint32_t maxSize[2] = { mipmap.levels[0].width, mipmap.levels[0].height };
+        const uint32_t topLevel = uint32_t(mipmap.levels.size()) - 1;
+        float p0[2], d[2], invD[2];
+        if (!setupTraversal(ray, maxSize, p0, d, invD))
+        {
+            setUv(ray, res.t, res.uv);
+            return res;
+        }
+
+        uint32_t level = topLevel;
+        uint32_t cell[2] = { 0, 0 };
+        float t = 0;
+        while (res.stepCount < maxSteps)
+        {
+            ++res.stepCount;
+            const auto& lvl = mipmap.levels[level];
+            const uint32_t size[2] = { lvl.width, lvl.height };
+            uint32_t lo[2], hi[2];
+            float tAxis[2];
+            for (int a = 0; a < 2; ++a)
+            {
+                lo[a] = cell[a] << level;
+                hi[a] = cell[a] == size[a] - 1 ? maxSize[a] : (cell[a] + 1) << level;
+                tAxis[a] = axisExit(float(lo[a]), float(hi[a]), p0[a], d[a], invD[a]);
+            }
+            const float tExit = std::min(tAxis[0], tAxis[1]);
+            const float tHit = std::max(t, 1 - lvl.getMax(cell[0], cell[1]));
+            if (tHit <= tExit)
+            {
+                if (level == 0)
+                {
+                    res.wasHit = true;
+                    res.lastT = t;
+                    res.t = tHit;
+                    setUv(ray, res.t, res.uv);
+                    return res;
+                }
+                // descend to the child the ray is in when it gets below the max height
+                t = tHit;
+                --level;
+                const uint32_t childSize[2] = { mipmap.levels[level].width, mipmap.levels[level].height };
+                for (int a = 0; a < 2; ++a)
+                {
+                    const uint32_t childBegin = 2 * cell[a];
+                    const uint32_t childEnd = cell[a] == size[a] - 1 ? childSize[a] : std::min(childBegin + 2, childSize[a]);
+                    uint32_t c = childBegin;
+                    for (uint32_t k = childBegin; k + 1 < childEnd; ++k)
+                    {
+                        if (isBeyond(float((k + 1) << level), t, p0[a], d[a], invD[a])) c = k + 1;
+                    }
+                    cell[a] = c;
+                }
+                continue;
+            }
+            // step to the neighbor through the exit face (both faces at a corner),
+            // go up a level if the neighbor has a different parent
+            t = tExit;
+            const uint32_t oldCell[2] = { cell[0], cell[1] };
+            for (int a = 0; a < 2; ++a)
+            {
+                if (tAxis[a] != tExit) continue;
+                if (d[a] > 0 ? hi[a] == maxSize[a] : lo[a] == 0)
+                {
+                    // left the texture, lerp(u, u2, 1) is outside of it
+                    res.lastT = res.t = 1;
+                    setUv(ray, res.t, res.uv);
+                    return res;
+                }
+                cell[a] = d[a] > 0 ? cell[a] + 1 : cell[a] - 1;
+            }
+            if (level < topLevel)
+            {
+                const uint32_t parentSize[2] = { mipmap.levels[level + 1].width, mipmap.levels[level + 1].height };
+                bool newParent = false;
+                for (int a = 0; a < 2; ++a) newParent |= std::min(oldCell[a] >> 1, parentSize[a] - 1) != std::min(cell[a] >> 1, parentSize[a] - 1);
+                if (newParent)
+                {
+                    ++level;
+                    for (int a = 0; a < 2; ++a) cell[a] = std::min(cell[a] >> 1, parentSize[a] - 1);
+                }
+            }
+        }
+        res.lastT = res.t = t;
+        setUv(ray, res.t, res.uv);
+        return res;
+    }
+
+    TraceResult traceTexels(const MinmaxPyramid::Level& level0, const TraceRay& ray)
+    {
+        TraceResult res;
+        const uint32_t maxSize[2] = { level0.width, level0.height };
+        float p0[2], d[2], invD[2];
+        if (!setupTraversal(ray, maxSize, p0, d, invD))
+        {
+            setUv(ray, res.t, res.uv);
+            return res;
+        }
+
+        // the texel of the origin, with the tie breaking of isBeyond
+        uint32_t cell[2];
+        for (int a = 0; a < 2; ++a)
+        {
+            cell[a] = std::min(uint32_t(p0[a]), maxSize[a] - 1);
+            if (d[a] < 0 && cell[a] > 0 && p0[a] == float(cell[a])) --cell[a];
+        }
+        float t = 0;
+        for (;;)
+        {
+            ++res.stepCount;
+            float tAxis[2];
+            for (int a = 0; a < 2; ++a) tAxis[a] = axisExit(float(cell[a]), float(cell[a] + 1), p0[a], d[a], invD[a]);
+            const float tExit = std::min(tAxis[0], tAxis[1]);
+            const float tHit = std::max(t, 1 - level0.getMax(cell[0], cell[1]));
+            if (tHit <= tExit)
+            {
+                res.wasHit = true;
+                res.lastT = t;
+                res.t = tHit;
+                setUv(ray, res.t, res.uv);
+                return res;
+            }
+            t = tExit;
+            for (int a = 0; a < 2; ++a)
+            {
+                if (tAxis[a] != tExit) continue;
+                if (d[a] > 0 ? cell[a] + 1 == maxSize[a] : cell[a] == 0)
+                {
+                    res.lastT = res.t = 1;
+                    setUv(ray, res.t, res.uv);
+                    return res;
+                }
+                cell[a] = d[a] > 0 ? cell[a] + 1 : cell[a] - 1;
+            }
+        }
+    }
+
+    float traceReference(const Conemap& conemap, const TraceRay& ray)
+    {
+        const float du = ray.u2[0] - ray.u[0];
+        const float dv = ray.u2[1] - ray.u[1];
+        auto isBelow = [&](float t) { return sampleHeight(conemap, ray.u[0] + du * t, ray.u[1] + dv * t) >= 1.0f - t; };
+
+        // the ray always hits by t = 1, where it reaches height 0
+        const float texels = std::max(std::abs(du) * conemap.width, std::abs(dv) * conemap.height);
+        const uint32_t stepCount = std::max(1u, uint32_t(std::ceil(4.0f * texels)));
+        if (isBelow(0.0f)) return 0.0f;
+        float t0 = 0.0f;
+        float t1 = 1.0f;
+        for (uint32_t i = 1; i <= stepCount; ++i)
+        {
+            const float t = float(i) / float(stepCount);
+            if (isBelow(t))
+            {
+                t1 = t;
+                break;
+            }
+            t0 = t;
+        }
+        for (int i = 0; i < 24; ++i)
+        {
+            const float t = 0.5f * (t0 + t1);
+            if (isBelow(t)) t1 = t;
+            else t0 = t;
+        }
+        return t1;
+    }
+
+    ShadowResult traceShadow(const Conemap& conemap, ShadowFunction function, const ShadowRay& ray, const ShadowSettings& settings)
+    {
+        ShadowMarch march;
+        if (!setupShadowMarch(conemap, ray, march))
+            return { 0, 0 };
+        if (march.rMax <= 0)
+            return {};
+        switch (function)
+        {
+        case ShadowFunction::Off: return {};
+        case ShadowFunction::LinearMarch: return traceShadowLinear(conemap, march, settings);
+        case ShadowFunction::ConeTracing: return traceShadowConeStep(conemap, march, settings);
+        }
+        throw std::invalid_argument("traceShadow: unknown shadow function");
+    }
+
+    float traceShadowReference(const Conemap& conemap, const ShadowRay& ray, const ShadowSettings& settings)
+    {
+        ShadowMarch march;
+        if (!setupShadowMarch(conemap, ray, march))
+            return 0;
+        const float w = 1.0f / float(std::max(conemap.width, conemap.height));
+        const float first = 1.0f / float(conemap.width);
+        if (march.rMax <= first)
+            return 1;
+        const uint32_t stepCount = std::max(1u, uint32_t(std::ceil(4.0f * (march.rMax - first) / w)));
+        float vis = 1;
+        for (uint32_t i = 0; i <= stepCount && vis > 0; ++i)
+        {
+            const float r = first + (march.rMax - first) * float(i) / float(stepCount);
+            const float h = sampleHeight(conemap, march.u[0] + march.dir[0] * r, march.u[1] + march.dir[1] * r);
+            vis = std::min(vis, getShadowSampleVisibility(march.z + march.m * r - h, r, settings.penumbra));
+        }
+        return smoothstep01(vis);
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include "CpuConemap.h"
+
+// CPU ports of the ray - height field intersection functions of the Parallax
+// sample (FindIntersection.slang and Refinement.slang), operating on baked
+// conemaps. Textures are sampled like gSampler does: bilinear filtering with
+// wrap addressing. The functions are the golden model of the shaders, they
+// follow the shader code operation by operation.
+namespace CpuConemap
+{
+    /** [height, cone ratio] of the conemap at uv, bilinearly filtered with wrap addressing.
+    */
+    void sampleBilinear(const Conemap& conemap, float u, float v, float& height, float& cone);
+
+    /** Ray through the height field, from u (height 1) to u2 (height 0) in texture space.
+    */
+    struct TraceRay
+    {
+        float u[2];
+        float u2[2];
+    };
+
+    /** HMapIntersection of the shaders.
+    */
+    struct TraceResult
+    {
+        float uv[2] = { 0, 0 }; // the intersection found by the function
+        float t = 1;            // uv = (1 - t) * u + t * u2, up to rounding
+        float lastT = 1;        // t of the last step that was surely above the height field
+        bool wasHit = false;    // false if the function ran out of steps (or does not search)
+        uint32_t stepCount = 0; // iterations of the primary search
+    };
+
+    struct TraceSettings
+    {
+        uint32_t steps = 64;          // `steps` of FScb, oneOverSteps is 1 / steps
+        float relax = 1.0f;           // `relax` of FScb
+        uint32_t refineSteps = 5;     // `refine_steps` of FScb
+        float refineOvershoot = 1.0f; // `refineOvershoot` of FScb, the binary search starts at most this far before t
+        float texelSize = 0.0f;       // `w` of the cone step mapping, 0 is 1 / width; a mip level of CONE_LOD is traced with the texel size of the level
+    };
+
+    enum class IntersectionFunction
+    {
+        BumpMapping,        // PARALLAX_FUN 0
+        ParallaxMapping,    // PARALLAX_FUN 1
+        LinearSearch,       // PARALLAX_FUN 2
+        ConeStepMapping,    // PARALLAX_FUN 3
+    };
+
+    enum class RefinementFunction
+    {
+        None,           // REFINE_FUN 0
+        LinearApprox,   // REFINE_FUN 1
+        BinarySearch,   // REFINE_FUN 2
+    };
+
+    TraceResult traceBumpMapping(const Conemap& conemap, const TraceRay& ray, const TraceSettings& settings);
+    TraceResult traceParallaxMapping(const Conemap& conemap, const TraceRay& ray, const TraceSettings& settings);
+    TraceResult traceLinearSearch(const Conemap& conemap, const TraceRay& ray, const TraceSettings& settings);
+
+    /** Port of getConeStepBudget: every cone step advances at least relax * texelSize along the ray,
+        so the search ends within this many steps whatever the cones are, capped at settings.steps.
+        \param[in] dirZ z of the normalized ray direction.
+    */
+    uint32_t getConeStepBudget(float dirZ, float texelSize, const TraceSettings& settings);
+
+    /** Port of findIntersection_coneStepMapping. HMres.x is the width of the conemap.
+        The search takes at most getConeStepBudget steps.
+    */
+    TraceResult traceConeStep(const Conemap& conemap, const TraceRay& ray, const TraceSettings& settings);
+
+    TraceResult trace(const Conemap& conemap, IntersectionFunction function, const TraceRay& ray, const TraceSettings& settings);
+
+    /** Port of refineIntersection.
+        \param[in] interval The result of an intersection function for the ray.
+        \param[out] uv The refined intersection (u3 of the shader).
+    */
+    void refine(const Conemap& conemap, RefinementFunction function, const TraceRay& ray, const TraceResult& interval, const TraceSettings& settings, float uv[2]);
+
+    /** Number of rays traced together by traceRays, 8 if the CPU supports AVX2, 1 without SIMD.
+    */
+    uint32_t getTracePacketWidth();
+
+    /** Traces a batch of rays in packets of getTracePacketWidth() rays, one ray per SIMD lane.
+        The results are the same as the ones of trace() and refine() for every ray, as long as the
+        compiler does not fuse the multiplies and adds of the scalar code.
+        \param[out] results count results.
+        \param[out] refinedUvs Optional, 2 * count floats: the refined intersection of every ray.
+    */
+    void traceRays(const Conemap& conemap, IntersectionFunction function, RefinementFunction refinement, const TraceRay* rays, size_t count, const TraceSettings& settings, TraceResult* results, float* refinedUvs = nullptr);
+
+    /** First intersection of the ray with the bilinearly filtered heights, found by stepping a
+        quarter texel along the ray and bisecting the first step that gets below the surface.
+        Used as the ground truth of the other functions. Misses intersections thinner than a quarter texel.
+    */
+    float traceReference(const Conemap& conemap, const TraceRay& ray);
+
+    /** Port of traverseMaxMipmap in FindIntersection.slang, started at t = 0 (findIntersection_maxMipmap, PARALLAX_FUN 5).
+        Intersects the ray with the height field made of texel sized boxes, skipping the cells
+        of the minmax mipmap whose max height the ray does not get below.
+        \param[in] mipmap Minmax mipmap with the layout of the texture, see buildMinmaxMipmap.
+        \param[in] maxSteps `steps` of FScb, the number of visited cells.
+        \return lastT is t when the traversal entered the hit texel. A ray that leaves the texture returns t = 1 without a hit.
+    */
+    TraceResult traceMaxMipmap(const MinmaxPyramid& mipmap, const TraceRay& ray, uint32_t maxSteps);
+
+    /** Intersects the ray with the same box height field, visiting every texel along the ray.
+        Used to check the traversal, the returned t is bit exact with traceMaxMipmap.
+    */
+    TraceResult traceTexels(const MinmaxPyramid::Level& level0, const TraceRay& ray);
+
+    /** Self-shadow ray of SelfShadow.slang, from the intersection uv toward the light.
+    */
+    struct ShadowRay
+    {
+        float u[2];     // the intersection, the ray starts at its height
+        float light[3]; // direction toward the light in the TBN space of the height field, need not be normalized
+    };
+
+    struct ShadowSettings
+    {
+        uint32_t steps = 32;     // `shadowSteps` of FScb
+        float penumbra = 0.02f;  // `shadowPenumbra` of FScb
+    };
+
+    struct ShadowResult
+    {
+        float visibility = 1;   // 0 is fully shadowed
+        uint32_t stepCount = 0; // conemap samples of the march
+    };
+
+    enum class ShadowFunction
+    {
+        Off,            // SELF_SHADOW 0
+        LinearMarch,    // SELF_SHADOW 1
+        ConeTracing,    // SELF_SHADOW 2
+    };
+
+    /** Port of selfShadow. HMres.x is the width of the conemap.
+    */
+    ShadowResult traceShadow(const Conemap& conemap, ShadowFunction function, const ShadowRay& ray, const ShadowSettings& settings);
+
+    /** Visibility of the light with the penumbra of the shaders, sampled every quarter texel along the ray.
+        Like the cone traced march, it skips the first texel and takes the tightest occluder ratio of the samples.
+        Used as the ground truth of the marches. Misses occluders thinner than a quarter texel.
+    */
+    float traceShadowReference(const Conemap& conemap, const ShadowRay& ray, const ShadowSettings& settings);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+/** SIMD code path selection of the library.
+
+    The AVX2 paths are compiled for x64 without raising the instruction set of the whole library,
+    and are selected at run time when the CPU supports them, otherwise the scalar code runs.
+    Define CPUCONEMAP_NO_AVX2 to leave them out. NEON is part of the aarch64 baseline, so it is
+    selected at compile time. setSimdEnabled() (CpuConemap.h) switches to the scalar code at run time.
+
+    The AVX2 code is placed between CPUCONEMAP_AVX2_BEGIN and CPUCONEMAP_AVX2_END. MSVC compiles
+    intrinsics for any instruction set, GCC and Clang need the target to be raised for that code.
+*/
+
+#if !defined(CPUCONEMAP_NO_AVX2) && (defined(_M_X64) || defined(__x86_64__))
+#include <immintrin.h>
+#define CPUCONEMAP_AVX2 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CPUCONEMAP_AVX2_BEGIN
+#define CPUCONEMAP_AVX2_END
+#elif defined(__clang__)
+#define CPUCONEMAP_AVX2_BEGIN _Pragma("clang attribute push(__attribute__((target(\"avx2\"))), apply_to = function)")
+#define CPUCONEMAP_AVX2_END _Pragma("clang attribute pop")
+#else
+#define CPUCONEMAP_AVX2_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+#define CPUCONEMAP_AVX2_END _Pragma("GCC pop_options")
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CPUCONEMAP_NEON 1
+#endif
+
+#include <atomic>
+
+namespace CpuConemap
+{
+    inline std::atomic<bool> gSimdEnabled{ true }; ///< See setSimdEnabled().
+
+    inline bool isSimdEnabled()
+    {
+        return gSimdEnabled.load(std::memory_order_relaxed);
+    }
+
+#if CPUCONEMAP_AVX2
+    /** Checks once if the CPU and the OS support AVX2.
+    */
+    inline bool hasAvx2()
+    {
+        static const bool supported = []()
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            int regs[4];
+            __cpuid(regs, 0);
+            if (regs[0] < 7) return false;
+            __cpuid(regs, 1);
+            const bool osxsave = (regs[2] & (1 << 27)) != 0;
+            const bool avx = (regs[2] & (1 << 28)) != 0;
+            // the OS has to save the ymm registers
+            if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+            __cpuidex(regs, 7, 0);
+            return (regs[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+#endif
+        }();
+        return supported;
+    }
+
+    /** True if the AVX2 paths should run.
+    */
+    inline bool useAvx2()
+    {
+        return isSimdEnabled() && hasAvx2();
+    }
+#endif
+}
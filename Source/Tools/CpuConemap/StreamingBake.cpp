@@ -0,0 +1,371 @@
+#include "StreamingBake.h"
+#include "TiledConemapFile.h"
+#include "TileScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace CpuConemap
+{
+    namespace
+    {
+        // The texels of a block are split into this many height ranges when bounding the halo.
+        const uint32_t kHaloHeightSteps = 16;
+
+        // Rings of level 0 blocks, and of blocks of every coarser level, used to bound the cones of a block.
+        const int64_t kHaloBoundRadius = 2;
+
+        /** Rectangle of texel indices [x0, x1) x [y0, y1).
+        */
+        struct Rect
+        {
+            int64_t x0, y0, x1, y1;
+
+            bool contains(const Rect& r) const { return r.x0 >= x0 && r.y0 >= y0 && r.x1 <= x1 && r.y1 <= y1; }
+        };
+
+        /** Coarse pyramid of the heightmap and the geometry of its blocks.
+        */
+        struct CoarseContext
+        {
+            const MinmaxPyramid& pyramid;
+            uint32_t width, height, blockSize;
+            float texelSizeU, texelSizeV;
+
+            /** Texels covered by the texel (i, j) of a level, clipped to the heightmap. */
+            Rect getTexels(uint32_t level, int64_t i, int64_t j) const
+            {
+                const int64_t size = int64_t(blockSize) << level;
+                return { i * size, j * size, std::min(int64_t(width), (i + 1) * size), std::min(int64_t(height), (j + 1) * size) };
+            }
+
+            /** Smallest UV distance between the texel centers of two rectangles. */
+            float minDist(const Rect& a, const Rect& b) const
+            {
+                float dx = float(std::max<int64_t>({ 0, b.x0 - (a.x1 - 1), a.x0 - (b.x1 - 1) })) * texelSizeU;
+                float dy = float(std::max<int64_t>({ 0, b.y0 - (a.y1 - 1), a.y0 - (b.y1 - 1) })) * texelSizeV;
+                return std::sqrt(dx * dx + dy * dy);
+            }
+
+            /** Largest UV distance between the texel centers of two rectangles. */
+            float maxDist(const Rect& a, const Rect& b) const
+            {
+                float dx = float(std::max(std::abs(b.x1 - 1 - a.x0), std::abs(a.x1 - 1 - b.x0))) * texelSizeU;
+                float dy = float(std::max(std::abs(b.y1 - 1 - a.y0), std::abs(a.y1 - 1 - b.y0))) * texelSizeV;
+                return std::sqrt(dx * dx + dy * dy);
+            }
+
+            /** Upper bound of c * (globalMax - h) over the texels of the level 0 block (i, j), where c is the cone and h the height of a texel.
+                No texel farther than this can narrow the cone of a texel of the block. Every block B with
+                a maximum above h has a texel at most maxDist(A, B) away that is at least that high, so
+                c <= maxDist(A, B) / (max(B) - h). The product grows with h, so splitting the heights of
+                the block into ranges and taking the top of the range is conservative.
+            */
+            float haloBound(uint32_t i, uint32_t j) const
+            {
+                const auto& level0 = pyramid.levels[0];
+                const float globalMax = pyramid.levels.back().getMax(0, 0);
+                const float lo = level0.getMin(i, j);
+                const float hi = level0.getMax(i, j);
+                const Rect a = getTexels(0, i, j);
+
+                // (maxDist, max height) of the nearby blocks of every level
+                struct Candidate { float dist, max; };
+                std::vector<Candidate> candidates;
+                for (uint32_t level = 0; level < pyramid.levels.size(); ++level)
+                {
+                    const auto& lvl = pyramid.levels[level];
+                    const int64_t ci = i >> level, cj = j >> level;
+                    for (int64_t nj = std::max<int64_t>(0, cj - kHaloBoundRadius); nj <= std::min<int64_t>(lvl.height - 1, cj + kHaloBoundRadius); ++nj)
+                    {
+                        for (int64_t ni = std::max<int64_t>(0, ci - kHaloBoundRadius); ni <= std::min<int64_t>(lvl.width - 1, ci + kHaloBoundRadius); ++ni)
+                        {
+                            float mx = lvl.getMax(uint32_t(ni), uint32_t(nj));
+                            if (mx > lo) candidates.push_back({ maxDist(a, getTexels(level, ni, nj)), mx });
+                        }
+                    }
+                }
+
+                float bound = 0;
+                for (uint32_t s = 0; s < kHaloHeightSteps; ++s)
+                {
+                    const float hLo = lo + (hi - lo) * s / kHaloHeightSteps;
+                    const float hHi = s + 1 == kHaloHeightSteps ? hi : lo + (hi - lo) * (s + 1) / kHaloHeightSteps;
+                    if (globalMax <= hLo) break;
+                    // cones are at most 1
+                    float rangeBound = globalMax - hLo;
+                    for (const auto& c : candidates)
+                    {
+                        if (c.max > hHi) rangeBound = std::min(rangeBound, c.dist * (globalMax - hHi) / (c.max - hHi));
+                    }
+                    bound = std::max(bound, rangeBound);
+                }
+                return bound;
+            }
+
+            /** Lower bound of the cones of the texels of the level 0 block (i, j) towards every texel outside the window.
+                A texel of a block B is at least minDist(A, B) away and at most max(B) - min(A) higher.
+            */
+            float farFieldCone(uint32_t i, uint32_t j, const Rect& window) const
+            {
+                const float lo = pyramid.levels[0].getMin(i, j);
+                const Rect a = getTexels(0, i, j);
+                float cone = 1.0f;
+                // branch and bound from the top of the pyramid
+                struct Node { uint32_t level; int64_t i, j; };
+                std::vector<Node> stack = { { uint32_t(pyramid.levels.size() - 1), 0, 0 } };
+                while (!stack.empty())
+                {
+                    const auto [level, ni, nj] = stack.back();
+                    stack.pop_back();
+                    const auto& lvl = pyramid.levels[level];
+                    if (ni >= lvl.width || nj >= lvl.height) continue;
+                    const Rect b = getTexels(level, ni, nj);
+                    if (window.contains(b)) continue; // searched exactly
+                    const float dh = lvl.getMax(uint32_t(ni), uint32_t(nj)) - lo;
+                    if (dh <= 0) continue;
+                    const float c = minDist(a, b) / dh;
+                    if (c >= cone) continue;
+                    if (level == 0)
+                    {
+                        // the window is aligned to the blocks, so the block is completely outside
+                        cone = c;
+                        continue;
+                    }
+                    for (int64_t dj = 0; dj < 2; ++dj)
+                    {
+                        for (int64_t di = 0; di < 2; ++di) stack.push_back({ level - 1, 2 * ni + di, 2 * nj + dj });
+                    }
+                }
+                return cone;
+            }
+        };
+
+        void updateMax(std::atomic<uint64_t>& target, uint64_t value)
+        {
+            uint64_t current = target.load();
+            while (current < value && !target.compare_exchange_weak(current, value)) {}
+        }
+    }
+
+    bool parseRawFormat(const std::string& name, RawFormat& format)
+    {
+        if (name == "u16") format = RawFormat::UNorm16;
+        else if (name == "f32") format = RawFormat::Float32;
+        else return false;
+        return true;
+    }
+
+    RawHeightmapFile::RawHeightmapFile(const std::string& filename, uint32_t width, uint32_t height, RawFormat format)
+        : mFilename(filename), mWidth(width), mHeight(height), mFormat(format)
+    {
+        if (width == 0 || height == 0) throw std::invalid_argument("RawHeightmapFile: empty heightmap");
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file) throw std::runtime_error("Cannot open heightmap '" + filename + "'");
+        const uint64_t texelBytes = format == RawFormat::UNorm16 ? 2 : 4;
+        if (uint64_t(file.tellg()) != uint64_t(width) * height * texelBytes) throw std::runtime_error("Size of '" + filename + "' does not match the heightmap size");
+    }
+
+    Heightmap RawHeightmapFile::read(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+    {
+        if (uint64_t(x0) + w > mWidth || uint64_t(y0) + h > mHeight) throw std::out_of_range("RawHeightmapFile: rectangle is outside the heightmap");
+
+        // every call has its own stream, so the workers read in parallel
+        std::ifstream file(mFilename, std::ios::binary);
+        if (!file) throw std::runtime_error("Cannot open heightmap '" + mFilename + "'");
+
+        Heightmap hmap;
+        hmap.width = w;
+        hmap.height = h;
+        hmap.texels.resize(size_t(w) * h);
+        const uint64_t texelBytes = mFormat == RawFormat::UNorm16 ? 2 : 4;
+        std::vector<uint8_t> row(w * texelBytes);
+        for (uint32_t y = 0; y < h; ++y)
+        {
+            file.seekg(std::streamoff((uint64_t(y0 + y) * mWidth + x0) * texelBytes));
+            file.read(reinterpret_cast<char*>(row.data()), row.size());
+            if (!file) throw std::runtime_error("Cannot read heightmap '" + mFilename + "'");
+            float* dst = hmap.texels.data() + size_t(y) * w;
+            for (uint32_t x = 0; x < w; ++x)
+            {
+                const uint8_t* p = row.data() + x * texelBytes;
+                if (mFormat == RawFormat::UNorm16)
+                {
+                    dst[x] = uint16_t(p[0] | (p[1] << 8)) / 65535.f;
+                }
+                else
+                {
+                    uint32_t bits = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+                    float v;
+                    std::memcpy(&v, &bits, sizeof(v));
+                    dst[x] = std::isnan(v) ? 0.f : std::max(0.f, std::min(1.f, v));
+                }
+            }
+        }
+        return hmap;
+    }
+
+    MinmaxPyramid buildCoarseMinmaxPyramid(const RawHeightmapFile& input, uint32_t blockSize, uint32_t threadCount)
+    {
+        if (blockSize == 0) throw std::invalid_argument("buildCoarseMinmaxPyramid: blockSize must be positive");
+        const uint32_t width = input.getWidth();
+        const uint32_t height = input.getHeight();
+
+        MinmaxPyramid pyramid;
+        pyramid.levels.resize(1);
+        auto& level0 = pyramid.levels[0];
+        level0.width = (width + blockSize - 1) / blockSize;
+        level0.height = (height + blockSize - 1) / blockSize;
+        level0.texels.resize(2 * size_t(level0.width) * level0.height);
+
+        // one task per strip of blocks, a strip is blockSize full rows
+        TileScheduler scheduler(threadCount);
+        scheduler.run(level0.height, [&](uint32_t j, uint32_t)
+        {
+            const uint32_t y0 = j * blockSize;
+            Heightmap strip = input.read(0, y0, width, std::min(blockSize, height - y0));
+            for (uint32_t i = 0; i < level0.width; ++i)
+            {
+                float mn = std::numeric_limits<float>::max();
+                float mx = std::numeric_limits<float>::lowest();
+                for (uint32_t y = 0; y < strip.height; ++y)
+                {
+                    const float* row = strip.texels.data() + size_t(y) * width;
+                    const auto range = std::minmax_element(row + i * blockSize, row + std::min(width, (i + 1) * blockSize));
+                    mn = std::min(mn, *range.first);
+                    mx = std::max(mx, *range.second);
+                }
+                size_t ind = size_t(j) * level0.width + i;
+                level0.texels[2 * ind + 0] = mn;
+                level0.texels[2 * ind + 1] = mx;
+            }
+        });
+        buildMinmaxLevels(pyramid);
+        return pyramid;
+    }
+
+    void bakeStreaming(const RawHeightmapFile& input, const std::string& outputFilename, const StreamingSettings& settings, StreamingStats* pStats)
+    {
+        if (settings.blockSize == 0 || settings.tileSize == 0 || settings.tileSize % settings.blockSize != 0)
+            throw std::invalid_argument("bakeStreaming: tileSize must be a positive multiple of blockSize");
+
+        auto startTime = std::chrono::steady_clock::now();
+        const uint32_t width = input.getWidth();
+        const uint32_t height = input.getHeight();
+        const uint32_t blockSize = settings.blockSize;
+        const uint32_t tileSize = settings.tileSize;
+        const uint32_t maxHalo = settings.maxHalo / blockSize * blockSize;
+
+        const MinmaxPyramid pyramid = buildCoarseMinmaxPyramid(input, blockSize, settings.threadCount);
+        const double pyramidSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        const CoarseContext coarse{ pyramid, width, height, blockSize, 1.0f / width, 1.0f / height };
+        const float texelsPerUV = float(std::max(width, height));
+
+        TiledConemapWriter writer(outputFilename, width, height, tileSize);
+        const uint32_t tilesX = writer.getHeader().tilesX;
+        const uint32_t tilesY = writer.getHeader().tilesY;
+        const uint32_t blocksPerTile = tileSize / blockSize;
+
+        TileScheduler scheduler(settings.threadCount);
+        std::atomic<uint64_t> testedTexels = 0;
+        std::atomic<uint64_t> peakWindowTexels = 0;
+        std::atomic<uint64_t> largestHalo = 0;
+        std::atomic<uint32_t> exactTiles = 0;
+        const uint32_t stolenTiles = scheduler.run(tilesX * tilesY, [&](uint32_t tile, uint32_t)
+        {
+            const uint32_t tx = tile % tilesX;
+            const uint32_t ty = tile / tilesX;
+            const Rect tileRect = { int64_t(tx) * tileSize, int64_t(ty) * tileSize, std::min<int64_t>(width, int64_t(tx + 1) * tileSize), std::min<int64_t>(height, int64_t(ty + 1) * tileSize) };
+            const uint32_t bi0 = tx * blocksPerTile, bj0 = ty * blocksPerTile;
+            const uint32_t bi1 = std::min(pyramid.levels[0].width, bi0 + blocksPerTile);
+            const uint32_t bj1 = std::min(pyramid.levels[0].height, bj0 + blocksPerTile);
+
+            // halo needed for exact cones, in whole blocks so the window stays aligned to them
+            float bound = 0;
+            for (uint32_t j = bj0; j < bj1; ++j)
+            {
+                for (uint32_t i = bi0; i < bi1; ++i) bound = std::max(bound, coarse.haloBound(i, j));
+            }
+            const uint64_t neededHalo = (uint64_t(std::ceil(bound * texelsPerUV)) + blockSize) / blockSize * blockSize;
+            updateMax(largestHalo, neededHalo);
+            const int64_t halo = int64_t(std::min<uint64_t>(neededHalo, maxHalo));
+            const Rect window = { std::max<int64_t>(0, tileRect.x0 - halo), std::max<int64_t>(0, tileRect.y0 - halo),
+                std::min<int64_t>(width, tileRect.x1 + halo), std::min<int64_t>(height, tileRect.y1 + halo) };
+            const bool exact = neededHalo <= uint64_t(halo) || window.contains({ 0, 0, width, height });
+            if (exact) ++exactTiles;
+
+            const Heightmap windowHmap = input.read(uint32_t(window.x0), uint32_t(window.y0), uint32_t(window.x1 - window.x0), uint32_t(window.y1 - window.y0));
+            updateMax(peakWindowTexels, windowHmap.texels.size());
+
+            const uint32_t w = uint32_t(tileRect.x1 - tileRect.x0);
+            const uint32_t h = uint32_t(tileRect.y1 - tileRect.y0);
+            std::vector<float> cones(size_t(w) * h, 1.0f);
+            if (!exact)
+            {
+                // the texels outside the window are bounded by their blocks
+                for (uint32_t j = bj0; j < bj1; ++j)
+                {
+                    for (uint32_t i = bi0; i < bi1; ++i)
+                    {
+                        const float farCone = coarse.farFieldCone(i, j, window);
+                        const Rect block = coarse.getTexels(0, i, j);
+                        for (int64_t y = block.y0; y < block.y1; ++y)
+                        {
+                            for (int64_t x = block.x0; x < block.x1; ++x) cones[size_t(y - tileRect.y0) * w + size_t(x - tileRect.x0)] = farCone;
+                        }
+                    }
+                }
+            }
+            const uint32_t x0 = uint32_t(tileRect.x0 - window.x0);
+            const uint32_t y0 = uint32_t(tileRect.y0 - window.y0);
+            testedTexels += bakeWindowCones(windowHmap, coarse.texelSizeU, coarse.texelSizeV, x0, y0, w, h, cones.data());
+
+            Conemap result;
+            result.width = w;
+            result.height = h;
+            result.texels.resize(2 * cones.size());
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                for (uint32_t x = 0; x < w; ++x)
+                {
+                    size_t ind = size_t(y) * w + x;
+                    result.texels[2 * ind + 0] = windowHmap.load(x0 + x, y0 + y);
+                    result.texels[2 * ind + 1] = cones[ind];
+                }
+            }
+            writer.writeTile(tx, ty, result);
+        });
+
+        // Low resolution conemap of the block maxima for renderers that stream the tiles (VirtualConemap in the
+        // Parallax sample). The envelope is above every texel of the heightmap, so it is shown while a tile is missing.
+        {
+            const auto& level0 = pyramid.levels[0];
+            Heightmap envelope;
+            envelope.width = level0.width;
+            envelope.height = level0.height;
+            envelope.texels.resize(size_t(level0.width) * level0.height);
+            for (size_t i = 0; i < envelope.texels.size(); ++i) envelope.texels[i] = level0.texels[2 * i + 1];
+            Settings tailSettings;
+            tailSettings.threadCount = settings.threadCount;
+            writer.writeTail(bake(envelope, tailSettings), blockSize);
+        }
+
+        if (pStats)
+        {
+            pStats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            pStats->pyramidSeconds = pyramidSeconds;
+            pStats->tileCount = tilesX * tilesY;
+            pStats->exactTiles = exactTiles;
+            pStats->largestHalo = uint32_t(largestHalo);
+            pStats->peakWindowTexels = peakWindowTexels;
+            pStats->testedTexels = testedTexels;
+            pStats->threadCount = scheduler.getThreadCount();
+            pStats->stolenTiles = stolenTiles;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "CpuConemap.h"
+#include <string>
+
+// Out-of-core baking of conservative cones for heightmaps that do not fit in
+// memory (or in a single texture), e.g. 32K-64K terrains.
+//  1. The heightmap is streamed once in strips of rows to build a coarse global
+//     minmax pyramid, one texel per blockSize x blockSize block.
+//  2. Every output tile loads itself and a halo around it. The halo is sized from
+//     the coarse pyramid: no texel farther than c * (globalMax - h) can lower the
+//     cone c of a texel at height h, and the cones of the tile are bounded from
+//     above by the maxima of the nearby blocks.
+//  3. If the needed halo is larger than maxHalo, the texels outside the halo are
+//     bounded by their coarse blocks instead. The cones stay conservative, but can
+//     be narrower than the exact ones.
+//  4. Finished tiles are written straight to a tiled conemap file (TiledConemapFile.h).
+//     The file also gets a low resolution conemap of the block maxima.
+// Peak memory is the coarse pyramid plus one (tileSize + 2 * maxHalo)^2 window per thread.
+namespace CpuConemap
+{
+    enum class RawFormat
+    {
+        UNorm16, // little endian 16 bit unsigned normalized
+        Float32, // little endian 32 bit float, clamped to [0,1]
+    };
+
+    /** Parses raw format names: "u16" and "f32".
+        \return false if the name is unknown.
+    */
+    bool parseRawFormat(const std::string& name, RawFormat& format);
+
+    /** Headerless row major heightmap file, the first row is the top row.
+        Only the requested rectangles are read, the file is never loaded as a whole.
+    */
+    class RawHeightmapFile
+    {
+    public:
+        /** Throws if the file does not exist or its size does not match.
+        */
+        RawHeightmapFile(const std::string& filename, uint32_t width, uint32_t height, RawFormat format);
+
+        uint32_t getWidth() const { return mWidth; }
+        uint32_t getHeight() const { return mHeight; }
+
+        /** Reads the texels [x0, x0 + w) x [y0, y0 + h). Can be called from several threads.
+        */
+        Heightmap read(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const;
+
+    private:
+        std::string mFilename;
+        uint32_t mWidth;
+        uint32_t mHeight;
+        RawFormat mFormat;
+    };
+
+    struct StreamingSettings
+    {
+        uint32_t tileSize = 1024;   // texels per side of an output tile, a multiple of blockSize
+        uint32_t blockSize = 64;    // texels per side of a block of the coarse minmax pyramid
+        uint32_t maxHalo = 1024;    // largest halo loaded around a tile, rounded down to a multiple of blockSize
+        uint32_t threadCount = 0;   // 0: use every hardware thread
+    };
+
+    struct StreamingStats
+    {
+        double seconds = 0.0;           // wall clock time of the bake
+        double pyramidSeconds = 0.0;    // time of the coarse minmax pass
+        uint32_t tileCount = 0;
+        uint32_t exactTiles = 0;        // tiles whose halo covered every texel that could narrow their cones
+        uint32_t largestHalo = 0;       // largest halo needed for exact cones, in texels
+        uint64_t peakWindowTexels = 0;  // largest window (tile and halo) loaded by a worker
+        uint64_t testedTexels = 0;
+        uint32_t threadCount = 0;
+        uint32_t stolenTiles = 0;
+    };
+
+    /** Builds the minmax pyramid of the blocks of a heightmap in one streaming pass.
+        levels[0] has one texel per blockSize x blockSize block (clipped on the edges).
+    */
+    MinmaxPyramid buildCoarseMinmaxPyramid(const RawHeightmapFile& input, uint32_t blockSize, uint32_t threadCount = 0);
+
+    /** Bakes the conservative cones of a heightmap tile by tile into a tiled conemap file.
+        \param[in] input The heightmap.
+        \param[in] outputFilename The tiled conemap file, tile size is settings.tileSize.
+        \param[in] settings Tiling and scheduling settings.
+        \param[out] pStats Optional statistics of the bake.
+    */
+    void bakeStreaming(const RawHeightmapFile& input, const std::string& outputFilename, const StreamingSettings& settings, StreamingStats* pStats = nullptr);
+}
@@ -0,0 +1,81 @@
+#include "Testing/UnitTest.h"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <regex>
+
+// Runs the CPU_TEST cases linked into the executable, like FalcorTest does for the CPU tests.
+// Usage: CpuConemapTests [test filter regex]
+namespace Falcor
+{
+    namespace
+    {
+        struct Test
+        {
+            std::string filename;
+            std::string name;
+            std::string skipMessage;
+            CPUTestFunc func;
+        };
+
+        // constructed on first use, the registerers run during static initialization
+        std::vector<Test>& getRegistry()
+        {
+            static std::vector<Test> registry;
+            return registry;
+        }
+    }
+
+    void registerCPUTest(const std::string& filename, const std::string& name, const std::string& skipMessage, CPUTestFunc func)
+    {
+        getRegistry().push_back({ filename, name, skipMessage, std::move(func) });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace Falcor;
+    const std::regex filter(argc > 1 ? argv[1] : "");
+    int failedCount = 0;
+    for (const auto& test : getRegistry())
+    {
+        if (argc > 1 && !std::regex_search(test.name, filter)) continue;
+
+        std::cout << "  " << test.name << " (CPU) ... " << std::flush;
+        if (!test.skipMessage.empty())
+        {
+            std::cout << "SKIPPED (" << test.skipMessage << ")" << std::endl;
+            continue;
+        }
+
+        CPUUnitTestContext ctx;
+        std::vector<std::string> messages;
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            test.func(ctx);
+        }
+        catch (const TooManyFailedTestsException&)
+        {
+            messages.push_back("Gave up after " + std::to_string(kMaxTestFailures) + " failures.");
+        }
+        catch (const SkippingTestException& e)
+        {
+            std::cout << "SKIPPED (" << e.what() << ")" << std::endl;
+            continue;
+        }
+        catch (const std::exception& e)
+        {
+            messages.push_back(std::string("Exception: ") + e.what());
+        }
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        auto failures = ctx.getFailureMessages();
+        failures.insert(failures.end(), messages.begin(), messages.end());
+        std::cout << (failures.empty() ? "PASSED" : "FAILED") << " (" << ms << " ms)" << std::endl;
+        for (const auto& message : failures) std::cout << "    " << message << std::endl;
+        if (!failures.empty()) ++failedCount;
+    }
+    std::cout << failedCount << " tests failed" << std::endl;
+    return failedCount == 0 ? 0 : 1;
+}
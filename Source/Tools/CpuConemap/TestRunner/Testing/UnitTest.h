@@ -0,0 +1,123 @@
+#pragma once
+#include <exception>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Stand-in for Falcor's Testing/UnitTest.h with the same CPU_TEST and EXPECT macros, so the tests of the
+// CpuConemap library in Source/Tools/FalcorTest/Tests/CpuConemap also build and run without Falcor (see CMakeLists.txt).
+namespace Falcor
+{
+    static constexpr int kMaxTestFailures = 25;
+
+    class CPUUnitTestContext;
+
+    struct TooManyFailedTestsException : public std::exception { };
+
+    class SkippingTestException : public std::exception
+    {
+    public:
+        SkippingTestException(const std::string& what) : mWhat(what) { }
+
+        const char* what() const noexcept override { return mWhat.c_str(); }
+
+    private:
+        std::string mWhat;
+    };
+
+    using CPUTestFunc = std::function<void(CPUUnitTestContext& ctx)>;
+
+    void registerCPUTest(const std::string& filename, const std::string& name, const std::string& skipMessage, CPUTestFunc func);
+
+    class UnitTestContext
+    {
+    public:
+        void reportFailure(const std::string& message)
+        {
+            if (message.empty()) return;
+            mFailureMessages.push_back(message);
+        }
+
+        std::vector<std::string> getFailureMessages() const { return mFailureMessages; }
+
+        int mNumFailures = 0;
+
+    private:
+        std::vector<std::string> mFailureMessages;
+    };
+
+    class CPUUnitTestContext : public UnitTestContext
+    {
+    };
+
+    class StreamSink
+    {
+    public:
+        StreamSink(StreamSink &&) = default;
+
+        StreamSink(UnitTestContext* ctx) : mpCtx(ctx) {}
+
+        ~StreamSink()
+        {
+            if (mpCtx) mpCtx->reportFailure(mSs.str());
+        }
+
+        template <typename T>
+        StreamSink& operator<<(T&&s)
+        {
+            if (mpCtx) mSs << s;
+            return *this;
+        }
+
+    private:
+        std::stringstream mSs;
+        UnitTestContext* mpCtx = nullptr;
+    };
+
+    template <typename T, typename U, typename Compare>
+    inline StreamSink expectCompareInternal(T x, const char* xString, U y, const char* yString, Compare compare, const char* op,
+                                            UnitTestContext& ctx, const char* file, int line) {
+        if (compare(x, y)) return StreamSink(nullptr);
+
+        if (++ctx.mNumFailures == kMaxTestFailures) throw TooManyFailedTestsException();
+
+        StreamSink ss(&ctx);
+        ss << file << ":" << line << " Test failed: " << xString << " " << op << " " <<
+            yString << " (" << x << " vs. " << y << ") ";
+        return ss;
+    }
+
+    template <typename T>
+    inline StreamSink expectInternal(T x, const char* xString, UnitTestContext& ctx,
+                                     const char* file, int line) {
+        if (x) return StreamSink(nullptr);
+
+        if (++ctx.mNumFailures == kMaxTestFailures) throw TooManyFailedTestsException();
+
+        StreamSink ss(&ctx);
+        ss << file << ":" << line << " Test failed: " << xString << " ";
+        return ss;
+    }
+
+#define CPU_TEST(Name, ...)                                                     \
+    static void CPUUnitTest##Name(CPUUnitTestContext& ctx);                     \
+    struct CPUUnitTestRegisterer##Name {                                        \
+        CPUUnitTestRegisterer##Name()                                           \
+        {                                                                       \
+            const char* skipMessage = "" __VA_ARGS__;                           \
+            registerCPUTest(__FILE__, #Name, skipMessage, CPUUnitTest##Name);   \
+        }                                                                       \
+    } RegisterCPUTest##Name;                                                    \
+    static void CPUUnitTest##Name(CPUUnitTestContext& ctx) /* over to the user for the braces */
+
+#define EXPECT_COMPARE_INTERNAL(x, y, op) expectCompareInternal((x), #x, (y), #y, [](const auto& a, const auto& b) { return a op b; }, #op, ctx, __FILE__, __LINE__)
+#define EXPECT_EQ(x, y) EXPECT_COMPARE_INTERNAL(x, y, ==)
+#define EXPECT_NE(x, y) EXPECT_COMPARE_INTERNAL(x, y, !=)
+#define EXPECT_GE(x, y) EXPECT_COMPARE_INTERNAL(x, y, >=)
+#define EXPECT_GT(x, y) EXPECT_COMPARE_INTERNAL(x, y, >)
+#define EXPECT_LE(x, y) EXPECT_COMPARE_INTERNAL(x, y, <=)
+#define EXPECT_LT(x, y) EXPECT_COMPARE_INTERNAL(x, y, <)
+#define EXPECT(x)       expectInternal((x), #x, ctx, __FILE__, __LINE__)
+
+} // namespace Falcor
@@ -0,0 +1,98 @@
+#include "TileResidency.h"
+#include <stdexcept>
+
+namespace CpuConemap
+{
+    LruCache::LruCache(uint32_t slotCount)
+        : mKeys(slotCount, kNone)
+    {
+        if (slotCount == 0) throw std::invalid_argument("LruCache: slotCount must be positive");
+        mFreeSlots.reserve(slotCount);
+        // free slots are popped from the back, so slot 0 is used first
+        for (uint32_t slot = slotCount; slot > 0; --slot) mFreeSlots.push_back(slot - 1);
+    }
+
+    uint32_t LruCache::find(uint32_t key) const
+    {
+        auto it = mMap.find(key);
+        return it == mMap.end() ? kNone : it->second.slot;
+    }
+
+    void LruCache::touch(uint32_t key)
+    {
+        auto it = mMap.find(key);
+        if (it == mMap.end()) throw std::invalid_argument("LruCache: key is not in the cache");
+        mOrder.splice(mOrder.begin(), mOrder, it->second.order);
+    }
+
+    uint32_t LruCache::insert(uint32_t key, uint32_t& evictedKey)
+    {
+        if (mMap.count(key)) throw std::invalid_argument("LruCache: key is already in the cache");
+        uint32_t slot;
+        if (!mFreeSlots.empty())
+        {
+            slot = mFreeSlots.back();
+            mFreeSlots.pop_back();
+            evictedKey = kNone;
+        }
+        else
+        {
+            evictedKey = mOrder.back();
+            mOrder.pop_back();
+            slot = mMap[evictedKey].slot;
+            mMap.erase(evictedKey);
+        }
+        mOrder.push_front(key);
+        mMap[key] = { slot, mOrder.begin() };
+        mKeys[slot] = key;
+        return slot;
+    }
+
+    ResidencyManager::ResidencyManager(uint32_t tilesX, uint32_t tilesY, uint32_t slotCount, uint32_t maxLoadsPerFrame)
+        : mTilesX(tilesX), mTilesY(tilesY), mMaxLoadsPerFrame(maxLoadsPerFrame), mCache(slotCount)
+        , mLastRequested(size_t(tilesX) * tilesY, 0), mPageTable(size_t(tilesX) * tilesY, kNotResident)
+    {
+        if (tilesX == 0 || tilesY == 0) throw std::invalid_argument("ResidencyManager: no tiles");
+    }
+
+    std::vector<ResidencyManager::TileLoad> ResidencyManager::update(const std::vector<uint32_t>& feedback)
+    {
+        if (feedback.size() != getFeedbackWordCount()) throw std::invalid_argument("ResidencyManager: feedback size mismatch");
+        ++mFrame;
+        const uint32_t tileCount = mTilesX * mTilesY;
+
+        // mark the requested tiles first, so none of them is evicted by a load of this frame
+        std::vector<uint32_t> missing;
+        mStats.requestedTiles = 0;
+        for (uint32_t tile = 0; tile < tileCount; ++tile)
+        {
+            if (!(feedback[tile / 32] & (1u << (tile % 32)))) continue;
+            ++mStats.requestedTiles;
+            mLastRequested[tile] = mFrame;
+            if (mPageTable[tile] != kNotResident) mCache.touch(tile);
+            else missing.push_back(tile);
+        }
+
+        std::vector<TileLoad> loads;
+        for (uint32_t tile : missing)
+        {
+            if (mMaxLoadsPerFrame != 0 && loads.size() >= mMaxLoadsPerFrame) break;
+            // every slot holds a tile of this frame
+            if (mCache.getSize() == mCache.getSlotCount() && mLastRequested[mCache.getLeastRecentlyUsed()] == mFrame) break;
+
+            TileLoad load;
+            load.tile = tile;
+            load.slot = mCache.insert(tile, load.evictedTile);
+            if (load.evictedTile != LruCache::kNone)
+            {
+                mPageTable[load.evictedTile] = kNotResident;
+                ++mStats.evictions;
+            }
+            mPageTable[tile] = load.slot + 1;
+            loads.push_back(load);
+        }
+        mStats.loads += loads.size();
+        mStats.missingTiles = uint32_t(missing.size() - loads.size());
+        return loads;
+    }
+}
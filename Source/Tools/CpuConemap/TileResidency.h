@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// CPU side of a virtual (sparse tiled) conemap: which tiles of a tiled conemap
+// file are in which slot of the physical tile cache. It does not touch the GPU,
+// the renderer (VirtualConemap in the Parallax sample) feeds it the tiles the
+// shader touched and uploads the tiles it decides to load.
+namespace CpuConemap
+{
+    /** Least recently used assignment of keys to a fixed number of slots.
+    */
+    class LruCache
+    {
+    public:
+        static const uint32_t kNone = ~0u;
+
+        explicit LruCache(uint32_t slotCount);
+
+        uint32_t getSlotCount() const { return uint32_t(mKeys.size()); }
+        uint32_t getSize() const { return uint32_t(mMap.size()); }
+
+        /** \return The slot of the key, kNone if it is not in the cache.
+        */
+        uint32_t find(uint32_t key) const;
+
+        /** Makes the key the most recently used one. It has to be in the cache.
+        */
+        void touch(uint32_t key);
+
+        /** \return The least recently used key, kNone if the cache is empty.
+        */
+        uint32_t getLeastRecentlyUsed() const { return mOrder.empty() ? kNone : mOrder.back(); }
+
+        /** Adds a key as the most recently used one. It must not be in the cache.
+            If every slot is used, the least recently used key is evicted and its slot is reused.
+            \param[out] evictedKey The evicted key, kNone if a free slot was used.
+            \return The slot of the key.
+        */
+        uint32_t insert(uint32_t key, uint32_t& evictedKey);
+
+        /** \return The key in the slot, kNone if the slot is free.
+        */
+        uint32_t getKey(uint32_t slot) const { return mKeys[slot]; }
+
+    private:
+        struct Entry
+        {
+            uint32_t slot;
+            std::list<uint32_t>::iterator order;
+        };
+        std::list<uint32_t> mOrder;                 // keys, most recently used first
+        std::unordered_map<uint32_t, Entry> mMap;
+        std::vector<uint32_t> mKeys;                // key of every slot
+        std::vector<uint32_t> mFreeSlots;
+    };
+
+    /** Decides which tiles of a virtual conemap are resident in the physical cache.
+        Every frame the shader sets a bit for every tile it sampled; update() marks
+        the resident ones as used and loads missing ones into free slots or the slots
+        of the least recently used tiles. Tiles requested in the same frame are never
+        evicted for each other, so a working set larger than the cache only loads
+        what fits instead of thrashing.
+    */
+    class ResidencyManager
+    {
+    public:
+        static const uint32_t kNotResident = 0;
+
+        struct TileLoad
+        {
+            uint32_t tile;        // virtual tile index, y * tilesX + x
+            uint32_t slot;        // physical cache slot
+            uint32_t evictedTile; // tile that was in the slot, LruCache::kNone if it was free
+        };
+
+        struct Stats
+        {
+            uint32_t requestedTiles = 0; // tiles in the last feedback
+            uint32_t missingTiles = 0;   // requested tiles that are still not resident after the last update
+            uint64_t loads = 0;          // total
+            uint64_t evictions = 0;      // total
+        };
+
+        /** \param[in] maxLoadsPerFrame Largest number of tiles loaded by an update, 0 means no limit.
+        */
+        ResidencyManager(uint32_t tilesX, uint32_t tilesY, uint32_t slotCount, uint32_t maxLoadsPerFrame);
+
+        uint32_t getTilesX() const { return mTilesX; }
+        uint32_t getTilesY() const { return mTilesY; }
+        uint32_t getSlotCount() const { return mCache.getSlotCount(); }
+        uint32_t getResidentCount() const { return mCache.getSize(); }
+
+        /** Number of 32 bit words of the feedback bit field: bit t of the field is tile t.
+        */
+        uint32_t getFeedbackWordCount() const { return (mTilesX * mTilesY + 31) / 32; }
+
+        /** Processes the feedback of a frame and updates the page table.
+            The caller has to upload the returned tiles before the page table is used.
+            \param[in] feedback getFeedbackWordCount() words.
+            \return The tiles to load, in the order of their tile index.
+        */
+        std::vector<TileLoad> update(const std::vector<uint32_t>& feedback);
+
+        /** Page table, one entry per virtual tile: slot + 1, or kNotResident.
+        */
+        const std::vector<uint32_t>& getPageTable() const { return mPageTable; }
+
+        const Stats& getStats() const { return mStats; }
+
+    private:
+        uint32_t mTilesX;
+        uint32_t mTilesY;
+        uint32_t mMaxLoadsPerFrame;
+        uint64_t mFrame = 0;
+        LruCache mCache;
+        std::vector<uint64_t> mLastRequested; // frame of the last request of every tile, 0: never
+        std::vector<uint32_t> mPageTable;
+        Stats mStats;
+    };
+}
@@ -0,0 +1,103 @@
+#include "TileScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CpuConemap
+{
+    namespace
+    {
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<uint32_t> tasks;
+
+            bool popBack(uint32_t& task)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (tasks.empty()) return false;
+                task = tasks.back();
+                tasks.pop_back();
+                return true;
+            }
+
+            bool stealFront(uint32_t& task)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (tasks.empty()) return false;
+                task = tasks.front();
+                tasks.pop_front();
+                return true;
+            }
+        };
+    }
+
+    TileScheduler::TileScheduler(uint32_t threadCount)
+        : mThreadCount(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    uint32_t TileScheduler::run(uint32_t taskCount, const std::function<void(uint32_t task, uint32_t worker)>& func)
+    {
+        if (taskCount == 0) return 0;
+        const uint32_t workerCount = std::min(mThreadCount, taskCount);
+
+        // Distribute contiguous ranges. The tasks are pushed in reverse order
+        // so popping from the back runs them front to back.
+        std::vector<std::unique_ptr<WorkerQueue>> queues(workerCount);
+        for (uint32_t w = 0; w < workerCount; ++w)
+        {
+            queues[w] = std::make_unique<WorkerQueue>();
+            uint32_t begin = uint32_t(uint64_t(taskCount) * w / workerCount);
+            uint32_t end = uint32_t(uint64_t(taskCount) * (w + 1) / workerCount);
+            for (uint32_t t = end; t > begin; --t) queues[w]->tasks.push_back(t - 1);
+        }
+
+        std::atomic<uint32_t> stolen = 0;
+        std::atomic<bool> failed = false;
+        std::exception_ptr pException;
+        std::mutex exceptionMutex;
+
+        auto work = [&](uint32_t worker)
+        {
+            uint32_t task;
+            while (!failed)
+            {
+                bool found = queues[worker]->popBack(task);
+                // Own queue is empty, try to steal from the others starting at the next worker.
+                for (uint32_t i = 1; !found && i < workerCount; ++i)
+                {
+                    found = queues[(worker + i) % workerCount]->stealFront(task);
+                    if (found) ++stolen;
+                }
+                // Tasks are never added during a run, so an unsuccessful round means we are done.
+                if (!found) break;
+
+                try
+                {
+                    func(task, worker);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(exceptionMutex);
+                    if (!pException) pException = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workerCount - 1);
+        for (uint32_t w = 1; w < workerCount; ++w) threads.emplace_back(work, w);
+        work(0);
+        for (auto& t : threads) t.join();
+
+        if (pException) std::rethrow_exception(pException);
+        return stolen;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+namespace CpuConemap
+{
+    /** Work-stealing scheduler for independent tasks (tiles of a texture).
+        Every worker owns a deque which is initially filled with a contiguous
+        range of the tasks, so neighbouring tiles tend to run on the same core.
+        A worker pops its own tasks from the back and steals from the front of
+        the other deques once its own is empty, which keeps all cores busy even
+        when the cost of the tiles varies a lot (e.g. flat vs. rugged regions).
+    */
+    class TileScheduler
+    {
+    public:
+        /** \param[in] threadCount Number of workers including the calling thread, 0 means hardware concurrency.
+        */
+        explicit TileScheduler(uint32_t threadCount = 0);
+
+        uint32_t getThreadCount() const { return mThreadCount; }
+
+        /** Runs func(task, worker) for every task in [0, taskCount) and waits for all of them.
+            The calling thread is worker 0. If a task throws, the remaining tasks
+            are skipped and the first exception is rethrown on the calling thread.
+            \return Number of tasks that were stolen by another worker.
+        */
+        uint32_t run(uint32_t taskCount, const std::function<void(uint32_t task, uint32_t worker)>& func);
+
+    private:
+        uint32_t mThreadCount;
+    };
+}
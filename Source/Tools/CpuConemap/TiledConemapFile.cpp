@@ -0,0 +1,167 @@
+#include "TiledConemapFile.h"
+#include "ConemapEncode.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace CpuConemap
+{
+    namespace
+    {
+        // Increment every time the file format changes.
+        const uint32_t kVersion = 3;
+        const char kMagic[8] = { 'C', 'O', 'N', 'E', 'T', 'I', 'L', 'E' };
+
+        float saturate(float x) { return std::max(0.f, std::min(1.f, x)); }
+
+        /** Converts the texels of a conemap to RG16 unorm, rows are pitch texels apart.
+            The heights are rounded to nearest. The renderers march the rounded heights, so the cones are narrowed
+            by the rounding of the base texel and the others (see narrowCone), then rounded down.
+            \param[in] texelSize 1 / max(width, height) of the whole conemap, not of the tile.
+        */
+        void packRG16(const Conemap& conemap, uint32_t pitch, float texelSize, uint16_t* dst)
+        {
+            const float heightError = 2.f * getUnormHeightError(16);
+            for (uint32_t y = 0; y < conemap.height; ++y)
+            {
+                for (uint32_t x = 0; x < conemap.width; ++x)
+                {
+                    size_t ind = 2 * (size_t(y) * pitch + x);
+                    dst[ind + 0] = uint16_t(std::lround(saturate(conemap.getHeight(x, y)) * 65535.f));
+                    const float cone = narrowCone(saturate(conemap.getCone(x, y)), texelSize, heightError);
+                    uint32_t c = uint32_t(std::floor(cone * 65535.f));
+                    // the float product can round up, make sure the decoded cone is not wider
+                    while (c > 0 && c / 65535.f > cone) --c;
+                    dst[ind + 1] = uint16_t(c);
+                }
+            }
+        }
+    }
+
+    TiledConemapWriter::TiledConemapWriter(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize, uint32_t albedoScale)
+    {
+        if (width == 0 || height == 0 || tileSize == 0) throw std::invalid_argument("TiledConemapWriter: empty conemap or tile");
+        std::memcpy(mHeader.magic, kMagic, sizeof(kMagic));
+        mHeader.version = kVersion;
+        mHeader.width = width;
+        mHeader.height = height;
+        mHeader.tileSize = tileSize;
+        mHeader.tilesX = (width + tileSize - 1) / tileSize;
+        mHeader.tilesY = (height + tileSize - 1) / tileSize;
+        mHeader.albedoScale = albedoScale;
+
+        mFile.open(filename, std::ios::binary | std::ios::trunc);
+        if (!mFile) throw std::runtime_error("Cannot create tiled conemap file '" + filename + "'");
+        mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+        if (!mFile) throw std::runtime_error("Cannot write tiled conemap file '" + filename + "'");
+    }
+
+    void TiledConemapWriter::writeTile(uint32_t tx, uint32_t ty, const Conemap& tile, const uint8_t* pAlbedo)
+    {
+        if (tx >= mHeader.tilesX || ty >= mHeader.tilesY) throw std::out_of_range("TiledConemapWriter: tile index out of range");
+        if (tile.width != mHeader.getTileWidth(tx) || tile.height != mHeader.getTileHeight(ty)) throw std::invalid_argument("TiledConemapWriter: tile size mismatch");
+        if ((mHeader.albedoScale != 0) != (pAlbedo != nullptr)) throw std::invalid_argument("TiledConemapWriter: albedo mismatch");
+
+        // convert outside of the lock, the workers only wait for each other's file writes
+        std::vector<uint8_t> data(mHeader.getTileBytes(), 0);
+        packRG16(tile, mHeader.tileSize, 1.f / float(std::max(mHeader.width, mHeader.height)), reinterpret_cast<uint16_t*>(data.data()));
+        if (pAlbedo)
+        {
+            const size_t rowBytes = size_t(tile.width) * mHeader.albedoScale * 4;
+            const size_t pitch = size_t(mHeader.getAlbedoTileSize()) * 4;
+            uint8_t* dst = data.data() + mHeader.getConemapTileBytes();
+            for (uint32_t y = 0; y < tile.height * mHeader.albedoScale; ++y) std::memcpy(dst + y * pitch, pAlbedo + y * rowBytes, rowBytes);
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFile.seekp(std::streamoff(mHeader.getTileOffset(tx, ty)));
+        mFile.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!mFile) throw std::runtime_error("Cannot write tiled conemap file");
+    }
+
+    void TiledConemapWriter::writeTail(const Conemap& tail, uint32_t blockSize)
+    {
+        if (tail.width == 0 || tail.height == 0) throw std::invalid_argument("TiledConemapWriter: empty tail");
+        if (blockSize == 0 || tail.width != (mHeader.width + blockSize - 1) / blockSize || tail.height != (mHeader.height + blockSize - 1) / blockSize)
+            throw std::invalid_argument("TiledConemapWriter: the tail size does not match the block size");
+        std::vector<uint16_t> texels(2 * size_t(tail.width) * tail.height);
+        packRG16(tail, tail.width, 1.f / float(std::max(tail.width, tail.height)), texels.data());
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mHeader.tailWidth = tail.width;
+        mHeader.tailHeight = tail.height;
+        mHeader.tailBlockSize = blockSize;
+        mFile.seekp(0);
+        mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+        mFile.seekp(std::streamoff(mHeader.getTailOffset()));
+        mFile.write(reinterpret_cast<const char*>(texels.data()), texels.size() * sizeof(uint16_t));
+        if (!mFile) throw std::runtime_error("Cannot write tiled conemap file");
+    }
+
+    TiledConemapReader::TiledConemapReader(const std::string& filename)
+    {
+        mFile.open(filename, std::ios::binary);
+        if (!mFile) throw std::runtime_error("Cannot open tiled conemap file '" + filename + "'");
+        mFile.read(reinterpret_cast<char*>(&mHeader), sizeof(mHeader));
+        if (!mFile || std::memcmp(mHeader.magic, kMagic, sizeof(kMagic)) != 0 || mHeader.version != kVersion)
+            throw std::runtime_error("Invalid header in tiled conemap file '" + filename + "'");
+        if (mHeader.width == 0 || mHeader.height == 0 || mHeader.tileSize == 0
+            || mHeader.tilesX != (mHeader.width + mHeader.tileSize - 1) / mHeader.tileSize
+            || mHeader.tilesY != (mHeader.height + mHeader.tileSize - 1) / mHeader.tileSize
+            || (mHeader.tailWidth == 0) != (mHeader.tailHeight == 0)
+            || (mHeader.tailWidth != 0 && (mHeader.tailBlockSize == 0
+                || mHeader.tailWidth != (mHeader.width + mHeader.tailBlockSize - 1) / mHeader.tailBlockSize
+                || mHeader.tailHeight != (mHeader.height + mHeader.tailBlockSize - 1) / mHeader.tailBlockSize)))
+            throw std::runtime_error("Invalid size in tiled conemap file '" + filename + "'");
+    }
+
+    void TiledConemapReader::readTileData(uint32_t tx, uint32_t ty, std::vector<uint16_t>& conemap, std::vector<uint8_t>& albedo)
+    {
+        if (tx >= mHeader.tilesX || ty >= mHeader.tilesY) throw std::out_of_range("TiledConemapReader: tile index out of range");
+        conemap.resize(mHeader.getConemapTileBytes() / sizeof(uint16_t));
+        albedo.resize(mHeader.getAlbedoTileBytes());
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFile.seekg(std::streamoff(mHeader.getTileOffset(tx, ty)));
+        mFile.read(reinterpret_cast<char*>(conemap.data()), conemap.size() * sizeof(uint16_t));
+        mFile.read(reinterpret_cast<char*>(albedo.data()), albedo.size());
+        if (!mFile) throw std::runtime_error("Unexpected end of tiled conemap file");
+    }
+
+    Conemap TiledConemapReader::readTile(uint32_t tx, uint32_t ty)
+    {
+        std::vector<uint16_t> texels;
+        std::vector<uint8_t> albedo;
+        readTileData(tx, ty, texels, albedo);
+
+        Conemap tile;
+        tile.width = mHeader.getTileWidth(tx);
+        tile.height = mHeader.getTileHeight(ty);
+        tile.texels.resize(2 * size_t(tile.width) * tile.height);
+        for (uint32_t y = 0; y < tile.height; ++y)
+        {
+            for (uint32_t x = 0; x < tile.width; ++x)
+            {
+                size_t src = 2 * (size_t(y) * mHeader.tileSize + x);
+                size_t dst = 2 * (size_t(y) * tile.width + x);
+                tile.texels[dst + 0] = texels[src + 0] / 65535.f;
+                tile.texels[dst + 1] = texels[src + 1] / 65535.f;
+            }
+        }
+        return tile;
+    }
+
+    std::vector<uint16_t> TiledConemapReader::readTailData()
+    {
+        std::vector<uint16_t> texels(2 * size_t(mHeader.tailWidth) * mHeader.tailHeight);
+        if (texels.empty()) return texels;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFile.seekg(std::streamoff(mHeader.getTailOffset()));
+        mFile.read(reinterpret_cast<char*>(texels.data()), texels.size() * sizeof(uint16_t));
+        if (!mFile) throw std::runtime_error("Unexpected end of tiled conemap file");
+        return texels;
+    }
+}
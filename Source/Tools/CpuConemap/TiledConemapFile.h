@@ -0,0 +1,108 @@
+#pragma once
+#include "CpuConemap.h"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace CpuConemap
+{
+    /** Header of a tiled conemap file.
+        The header is followed by tilesX * tilesY tiles in row major order. Every tile has
+        the same size: tileSize x tileSize texels of RG16 unorm [height, cone ratio] pairs
+        (height rounded to nearest, cone narrowed by the rounding of the heights and rounded down,
+        so it stays conservative for the stored heights), then, if albedoScale is not 0,
+        (tileSize * albedoScale)^2 RGBA8 albedo texels covering the same area. The tiles
+        on the right and bottom edges are padded with zeros. Fixed size tiles can be
+        written in any order and read without an index.
+        The tiles are followed by an optional low resolution conemap of the whole map
+        (tailWidth x tailHeight RG16 unorm texels, one per tailBlockSize x tailBlockSize block),
+        which renderers can use while the tiles are not loaded.
+    */
+    struct TiledConemapHeader
+    {
+        char magic[8] = {};
+        uint32_t version = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t tileSize = 0;
+        uint32_t tilesX = 0;
+        uint32_t tilesY = 0;
+        uint32_t albedoScale = 0; // albedo texels per conemap texel along each axis, 0: no albedo
+        uint32_t tailWidth = 0;   // 0: no low resolution conemap
+        uint32_t tailHeight = 0;
+        uint32_t tailBlockSize = 0; // conemap texels per side of a block covered by a texel of the low resolution conemap
+
+        uint32_t getTileCount() const { return tilesX * tilesY; }
+        uint32_t getAlbedoTileSize() const { return tileSize * albedoScale; }
+        uint64_t getConemapTileBytes() const { return uint64_t(tileSize) * tileSize * 2 * sizeof(uint16_t); }
+        uint64_t getAlbedoTileBytes() const { return uint64_t(getAlbedoTileSize()) * getAlbedoTileSize() * 4; }
+        uint64_t getTileBytes() const { return getConemapTileBytes() + getAlbedoTileBytes(); }
+        uint64_t getTileOffset(uint32_t tx, uint32_t ty) const { return sizeof(TiledConemapHeader) + (uint64_t(ty) * tilesX + tx) * getTileBytes(); }
+        uint64_t getTailOffset() const { return sizeof(TiledConemapHeader) + uint64_t(getTileCount()) * getTileBytes(); }
+        /** Size of the tile in texels, smaller than tileSize on the right and bottom edges. */
+        uint32_t getTileWidth(uint32_t tx) const { return std::min(tileSize, width - tx * tileSize); }
+        uint32_t getTileHeight(uint32_t ty) const { return std::min(tileSize, height - ty * tileSize); }
+    };
+
+    /** Writes a tiled conemap file tile by tile, the whole conemap is never in memory.
+    */
+    class TiledConemapWriter
+    {
+    public:
+        /** Creates the file, replacing an existing one. Throws if it cannot be created.
+            \param[in] albedoScale Albedo texels per conemap texel along each axis, 0 if the file has no albedo.
+        */
+        TiledConemapWriter(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize, uint32_t albedoScale = 0);
+
+        const TiledConemapHeader& getHeader() const { return mHeader; }
+
+        /** Writes a tile. Can be called from several threads.
+            \param[in] tile The texels of the tile, its size must be getTileWidth(tx) x getTileHeight(ty).
+            \param[in] pAlbedo RGBA8 texels of the tile, row major, albedoScale times the size of the tile. Required if the file has albedo.
+        */
+        void writeTile(uint32_t tx, uint32_t ty, const Conemap& tile, const uint8_t* pAlbedo = nullptr);
+
+        /** Writes the low resolution conemap after the tiles.
+            \param[in] blockSize Conemap texels per side of the block covered by a texel of the tail, the tail must have
+                       ceil(width / blockSize) x ceil(height / blockSize) texels.
+        */
+        void writeTail(const Conemap& tail, uint32_t blockSize);
+
+    private:
+        TiledConemapHeader mHeader;
+        std::ofstream mFile;
+        std::mutex mMutex;
+    };
+
+    /** Random access reader of a tiled conemap file.
+    */
+    class TiledConemapReader
+    {
+    public:
+        /** Opens the file and validates the header. Throws if it is not a tiled conemap file.
+        */
+        explicit TiledConemapReader(const std::string& filename);
+
+        const TiledConemapHeader& getHeader() const { return mHeader; }
+
+        /** Reads a tile, clipped to the size of the conemap. Can be called from several threads.
+        */
+        Conemap readTile(uint32_t tx, uint32_t ty);
+
+        /** Reads the stored texels of a tile, padded to the tile size. Can be called from several threads.
+            \param[out] conemap tileSize^2 RG16 unorm pairs.
+            \param[out] albedo getAlbedoTileSize()^2 RGBA8 texels, empty if the file has no albedo.
+        */
+        void readTileData(uint32_t tx, uint32_t ty, std::vector<uint16_t>& conemap, std::vector<uint8_t>& albedo);
+
+        /** Reads the RG16 unorm texels of the low resolution conemap, empty if the file has none.
+        */
+        std::vector<uint16_t> readTailData();
+
+    private:
+        TiledConemapHeader mHeader;
+        std::ifstream mFile;
+        std::mutex mMutex;
+    };
+}
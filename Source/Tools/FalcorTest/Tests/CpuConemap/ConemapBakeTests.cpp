@@ -0,0 +1,229 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "CpuConemap.h"
+#include "HeightfieldTrace.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        // the sizes are not multiples of the SIMD width, so the scalar tails run too
+        CpuConemap::Heightmap createNoiseHeightmap(uint32_t width, uint32_t height, uint32_t seed)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = width;
+            hmap.height = height;
+            hmap.texels.resize(size_t(width) * height);
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            for (float& h : hmap.texels) h = dist(rng);
+            return hmap;
+        }
+
+        /** Conservative cones from testing every pair of texels.
+        */
+        std::vector<float> bakeBruteForce(const CpuConemap::Heightmap& hmap)
+        {
+            std::vector<float> cones(hmap.texels.size());
+            for (uint32_t y = 0; y < hmap.height; ++y)
+            {
+                for (uint32_t x = 0; x < hmap.width; ++x)
+                {
+                    const float baseH = hmap.load(x, y);
+                    float minQ = 1.f;
+                    for (uint32_t j = 0; j < hmap.height; ++j)
+                    {
+                        for (uint32_t i = 0; i < hmap.width; ++i)
+                        {
+                            const float dh = hmap.load(i, j) - baseH;
+                            if (dh <= 0) continue;
+                            const float du = (float(x) - float(i)) / hmap.width;
+                            const float dv = (float(y) - float(j)) / hmap.height;
+                            minQ = std::min(minQ, (du * du + dv * dv) / (dh * dh));
+                        }
+                    }
+                    cones[size_t(y) * hmap.width + x] = std::sqrt(minQ);
+                }
+            }
+            return cones;
+        }
+
+        /** Smooth waves, the relaxed cones of white noise are too rough for the refinement to be of use.
+        */
+        CpuConemap::Heightmap createWaveHeightmap(uint32_t width, uint32_t height)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = width;
+            hmap.height = height;
+            hmap.texels.resize(size_t(width) * height);
+            const float twoPi = 6.2831853f;
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const float u = float(x) / width;
+                    const float v = float(y) / height;
+                    hmap.texels[size_t(y) * width + x] = 0.5f + 0.25f * std::sin(twoPi * (2 * u + v)) + 0.2f * std::sin(twoPi * (3 * v - 4 * u));
+                }
+            }
+            return hmap;
+        }
+    }
+
+    CPU_TEST(CpuConemapConservativeBake)
+    {
+        const auto hmap = createNoiseHeightmap(37, 29, 1);
+        const auto reference = bakeBruteForce(hmap);
+
+        CpuConemap::Settings settings;
+        settings.tileSize = 8;
+        const auto conemap = CpuConemap::bake(hmap, settings);
+        EXPECT_EQ(conemap.width, hmap.width);
+        EXPECT_EQ(conemap.height, hmap.height);
+
+        float maxError = 0.f;
+        for (uint32_t y = 0; y < hmap.height; ++y)
+        {
+            for (uint32_t x = 0; x < hmap.width; ++x)
+            {
+                EXPECT_EQ(conemap.getHeight(x, y), hmap.load(x, y));
+                maxError = std::max(maxError, std::abs(conemap.getCone(x, y) - reference[size_t(y) * hmap.width + x]));
+            }
+        }
+        EXPECT_LE(maxError, 1e-6f);
+    }
+
+    CPU_TEST(CpuConemapSimdMatchesScalar)
+    {
+        // the SIMD paths do the same operations as the scalar code, so the results are bit exact
+        const auto hmap = createNoiseHeightmap(45, 23, 2);
+        for (auto algorithm : { CpuConemap::Algorithm::Conservative, CpuConemap::Algorithm::Relaxed })
+        {
+            CpuConemap::Settings settings;
+            settings.algorithm = algorithm;
+            settings.relaxedConeSearchSteps = 16;
+
+            CpuConemap::setSimdEnabled(false);
+            const std::string scalarName = CpuConemap::getSimdName();
+            const auto scalar = CpuConemap::bake(hmap, settings);
+            CpuConemap::setSimdEnabled(true);
+            const auto simd = CpuConemap::bake(hmap, settings);
+
+            EXPECT_EQ(scalarName, std::string("scalar"));
+            EXPECT(simd.texels == scalar.texels) << CpuConemap::to_string(algorithm) << " with " << CpuConemap::getSimdName();
+        }
+    }
+
+    CPU_TEST(CpuConemapQuickConesNotWider)
+    {
+        // a power of two and an odd size, whose minmax levels have a texel that covers the extra row or column
+        const CpuConemap::Heightmap hmaps[] = { createNoiseHeightmap(64, 64, 3), createNoiseHeightmap(45, 23, 4), createWaveHeightmap(50, 37) };
+        for (const auto& hmap : hmaps)
+        {
+            const auto reference = bakeBruteForce(hmap);
+            // maxAtTexelCenter is left off: it assumes the maximum of a block at its center, which is not conservative
+            CpuConemap::Settings settings;
+            std::vector<float> ring7x7;
+            for (auto algorithm : { CpuConemap::Algorithm::QuickNaive, CpuConemap::Algorithm::QuickRegionGrowing, CpuConemap::Algorithm::QuickRing5x5,
+                CpuConemap::Algorithm::QuickRing7x7, CpuConemap::Algorithm::QuickRingAdaptive })
+            {
+                settings.algorithm = algorithm;
+                const auto conemap = CpuConemap::bake(hmap, settings);
+                uint32_t wideCones = 0;
+                for (size_t i = 0; i < reference.size(); ++i)
+                {
+                    // allow the rounding of the brute force search
+                    if (conemap.texels[2 * i + 1] > reference[i] * (1.f + 1e-6f)) wideCones++;
+                }
+                const std::string name = std::string(CpuConemap::to_string(algorithm)) + ", " + std::to_string(hmap.width) + "x" + std::to_string(hmap.height);
+                EXPECT_EQ(wideCones, 0u) << name;
+
+                std::vector<float> cones(reference.size());
+                for (size_t i = 0; i < cones.size(); ++i) cones[i] = conemap.texels[2 * i + 1];
+                if (algorithm == CpuConemap::Algorithm::QuickRing7x7) ring7x7 = cones;
+                // the adaptive ring only skips the rings that cannot lower the cone
+                if (algorithm == CpuConemap::Algorithm::QuickRingAdaptive) EXPECT(cones == ring7x7) << name;
+            }
+        }
+    }
+
+    CPU_TEST(CpuConemapMeasureOvershoot)
+    {
+        const auto hmap = createWaveHeightmap(64, 48);
+        const uint32_t searchSteps = 16;
+
+        // conservative cones contain no texel, so no ray toward a texel center leaves them above the surface
+        std::vector<float> perTexel;
+        const auto conservative = CpuConemap::bake(hmap, CpuConemap::Settings());
+        EXPECT_EQ(CpuConemap::measureOvershoot(hmap, conservative, searchSteps, 0.f, 0, &perTexel), 0.f);
+        EXPECT_EQ(size_t(std::count(perTexel.begin(), perTexel.end(), 0.f)), hmap.texels.size());
+
+        CpuConemap::Settings settings;
+        settings.algorithm = CpuConemap::Algorithm::Relaxed;
+        settings.relaxedConeSearchSteps = searchSteps;
+        const auto relaxed = CpuConemap::bake(hmap, settings);
+        const float overshoot = CpuConemap::measureOvershoot(hmap, relaxed, searchSteps, 0.f, 0, &perTexel);
+        EXPECT_EQ(overshoot, *std::max_element(perTexel.begin(), perTexel.end()));
+        EXPECT_GT(overshoot, 0.f);
+
+        // The refinement searches the overshoot plus a texel for the margin of the steps before t.
+        // The estimate only follows the rays toward the texel centers, so a few rays in between may end farther.
+        const uint32_t rayCount = 20000;
+        std::mt19937 rng(10);
+        std::uniform_real_distribution<float> uv(0.f, 1.f);
+        std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+        CpuConemap::TraceSettings traceSettings;
+        traceSettings.steps = 256;
+        uint32_t hits = 0;
+        uint32_t fartherRays = 0;
+        float maxLastStep = 0.f;
+        for (uint32_t i = 0; i < rayCount; ++i)
+        {
+            CpuConemap::TraceRay ray;
+            for (int a = 0; a < 2; ++a)
+            {
+                ray.u[a] = uv(rng);
+                ray.u2[a] = ray.u[a] + offset(rng);
+            }
+            const auto res = CpuConemap::traceConeStep(relaxed, ray, traceSettings);
+            if (!res.wasHit) continue;
+            hits++;
+            maxLastStep = std::max(maxLastStep, res.t - res.lastT);
+            const float dirZ = 1.f / std::sqrt(1.f + (ray.u2[0] - ray.u[0]) * (ray.u2[0] - ray.u[0]) + (ray.u2[1] - ray.u[1]) * (ray.u2[1] - ray.u[1]));
+            if (res.t > CpuConemap::traceReference(relaxed, ray) + overshoot + dirZ / hmap.width) fartherRays++;
+        }
+        EXPECT_GT(hits, rayCount * 99 / 100);
+        EXPECT_LE(fartherRays, hits / 1000);
+        // otherwise the refinement could just search the last step
+        EXPECT_LT(overshoot, maxLastStep);
+    }
+}
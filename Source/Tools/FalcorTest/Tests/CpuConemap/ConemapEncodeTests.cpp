@@ -0,0 +1,127 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "ConemapEncode.h"
+#include <cmath>
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        CpuConemap::Heightmap createNoiseHeightmap(uint32_t width, uint32_t height, uint32_t seed)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = width;
+            hmap.height = height;
+            hmap.texels.resize(size_t(width) * height);
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            for (float& h : hmap.texels) h = dist(rng);
+            return hmap;
+        }
+
+        /** Counts the decoded cones that are wider than the exact conservative cones of the decoded heights,
+            which are the heights the shaders march.
+        */
+        uint32_t countWideCones(const CpuConemap::Conemap& decoded, float& maxExcess)
+        {
+            CpuConemap::Heightmap heights;
+            heights.width = decoded.width;
+            heights.height = decoded.height;
+            heights.texels.resize(size_t(decoded.width) * decoded.height);
+            for (size_t i = 0; i < heights.texels.size(); ++i) heights.texels[i] = decoded.texels[2 * i];
+            const auto exact = CpuConemap::bake(heights, CpuConemap::Settings());
+
+            uint32_t wideCones = 0;
+            maxExcess = 0.f;
+            for (size_t i = 0; i < heights.texels.size(); ++i)
+            {
+                // allow the rounding of the float bake
+                const float excess = decoded.texels[2 * i + 1] - exact.texels[2 * i + 1];
+                if (excess > 1e-6f * exact.texels[2 * i + 1]) wideCones++;
+                maxExcess = std::max(maxExcess, excess);
+            }
+            return wideCones;
+        }
+    }
+
+    CPU_TEST(ConemapEncodeConservativeForDecodedHeights)
+    {
+        // white noise has the largest height errors and the narrowest cones
+        const auto hmap = createNoiseHeightmap(128, 128, 6);
+        const auto conemap = CpuConemap::bake(hmap, CpuConemap::Settings());
+
+        float maxExcess;
+        const auto packed = CpuConemap::decodePackedR16(CpuConemap::encodePackedR16(conemap), conemap.width, conemap.height);
+        EXPECT_EQ(countWideCones(packed, maxExcess), 0u) << "packed R16, max excess " << maxExcess;
+        EXPECT_EQ(CpuConemap::measureEncodeError(conemap, packed).wideCones, 0u);
+
+        const auto bc5 = CpuConemap::decodeBC5(CpuConemap::encodeBC5(conemap), conemap.width, conemap.height);
+        EXPECT_EQ(countWideCones(bc5, maxExcess), 0u) << "BC5, max excess " << maxExcess;
+        EXPECT_EQ(CpuConemap::measureEncodeError(conemap, bc5).wideCones, 0u);
+    }
+
+    CPU_TEST(ConemapEncodeUnormConservativeForDecodedHeights)
+    {
+        // 8 bit heights are off by more than a texel of cone at this size, the cones must be narrowed
+        const auto hmap = createNoiseHeightmap(128, 128, 7);
+        const auto conemap = CpuConemap::bake(hmap, CpuConemap::Settings());
+
+        for (uint32_t bits : { 8u, 16u })
+        {
+            float maxExcess;
+            const auto decoded = CpuConemap::decodeUnormRG(CpuConemap::encodeUnormRG(conemap, bits), conemap.width, conemap.height, bits);
+            EXPECT_EQ(countWideCones(decoded, maxExcess), 0u) << bits << " bit, max excess " << maxExcess;
+            const auto error = CpuConemap::measureEncodeError(conemap, decoded);
+            EXPECT_EQ(error.wideCones, 0u) << bits << " bit";
+            EXPECT_LE(error.maxHeightError, CpuConemap::getUnormHeightError(bits)) << bits << " bit";
+        }
+    }
+
+    CPU_TEST(ConemapEncodeNarrowCone)
+    {
+        // no error keeps the cone, the texel at the nearest distance just touches the narrowed cone
+        EXPECT_EQ(CpuConemap::narrowCone(0.5f, 1.f / 64, 0.f), 0.5f);
+        const float texelSize = 1.f / 64;
+        const float cone = 0.5f;
+        const float error = 0.01f;
+        const float narrowed = CpuConemap::narrowCone(cone, texelSize, error);
+        EXPECT_LT(narrowed, cone);
+        EXPECT_LE(std::abs(narrowed * (texelSize / cone + error) - texelSize), 1e-6f);
+
+        // the packed heights are rounded to 10 bits
+        for (float h : { 0.f, 0.1234f, 0.5f, 0.99951f, 1.f })
+        {
+            float height, decodedCone;
+            CpuConemap::unpackHeightCone(CpuConemap::packHeightCone(h, 1.f, texelSize), height, decodedCone);
+            EXPECT_LE(std::abs(height - h), CpuConemap::kPackedHeightError);
+            EXPECT_LE(decodedCone, CpuConemap::narrowCone(1.f, texelSize, 2.f * CpuConemap::kPackedHeightError));
+        }
+    }
+}
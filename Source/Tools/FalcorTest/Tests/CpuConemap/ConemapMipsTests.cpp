@@ -0,0 +1,72 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "ConemapMips.h"
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        CpuConemap::Conemap createNoiseConemap(uint32_t width, uint32_t height, uint32_t seed)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = width;
+            hmap.height = height;
+            hmap.texels.resize(size_t(width) * height);
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            for (float& h : hmap.texels) h = dist(rng);
+            return CpuConemap::bake(hmap, CpuConemap::Settings());
+        }
+    }
+
+    CPU_TEST(ConemapMipsConservative)
+    {
+        // odd sizes have texels that also cover the extra row or column of the finer level
+        const uint32_t sizes[][2] = { { 64, 64 }, { 37, 53 }, { 100, 7 }, { 129, 96 } };
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            const auto conemap = createNoiseConemap(sizes[i][0], sizes[i][1], 20 + i);
+            // as generated into a float texture and into an RG16Unorm texture, whose cones are rounded down
+            for (float coneQuantum : { 0.f, 1.f / 65535.f })
+            {
+                const auto levels = CpuConemap::buildConservativeMips(conemap, coneQuantum);
+                EXPECT_EQ(levels.back().width, 1u);
+                EXPECT_EQ(levels.back().height, 1u);
+                const auto res = CpuConemap::checkConservativeMips(levels, 4096);
+                const std::string name = std::to_string(sizes[i][0]) + "x" + std::to_string(sizes[i][1]) + ", quantum " + std::to_string(coneQuantum);
+                EXPECT_GT(res.checkedTexels, 0u) << name;
+                EXPECT_GT(res.checkedSamples, 0u) << name;
+                EXPECT_EQ(res.heightViolations, 0u) << name;
+                EXPECT_EQ(res.coneViolations, 0u) << name;
+                EXPECT_EQ(res.filterViolations, 0u) << name;
+            }
+        }
+    }
+}
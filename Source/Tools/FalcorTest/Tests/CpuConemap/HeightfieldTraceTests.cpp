@@ -0,0 +1,286 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "HeightfieldTrace.h"
+#include "ConemapMips.h"
+#include <cmath>
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        CpuConemap::Conemap createNoiseConemap(uint32_t width, uint32_t height, uint32_t seed)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = width;
+            hmap.height = height;
+            hmap.texels.resize(size_t(width) * height);
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            for (float& h : hmap.texels) h = dist(rng);
+            return CpuConemap::bake(hmap, CpuConemap::Settings());
+        }
+
+        /** Smooth waves, they have the wide cones that LOD-aware cone stepping is used with.
+        */
+        CpuConemap::Conemap createWaveConemap(uint32_t size)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = size;
+            hmap.height = size;
+            hmap.texels.resize(size_t(size) * size);
+            const float twoPi = 6.2831853f;
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    const float u = float(x) / size;
+                    const float v = float(y) / size;
+                    hmap.texels[size_t(y) * size + x] = 0.5f + 0.2f * std::sin(twoPi * (2 * u + v)) + 0.15f * std::sin(twoPi * (5 * v - 3 * u)) + 0.1f * std::sin(twoPi * (11 * u + 7 * v));
+                }
+            }
+            return CpuConemap::bake(hmap, CpuConemap::Settings());
+        }
+
+        CpuConemap::Conemap createCheckerboardConemap(uint32_t size, uint32_t squareSize)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = size;
+            hmap.height = size;
+            hmap.texels.resize(size_t(size) * size);
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t x = 0; x < size; ++x) hmap.texels[size_t(y) * size + x] = (x / squareSize + y / squareSize) % 2 ? 0.7f : 0.3f;
+            }
+            return CpuConemap::bake(hmap, CpuConemap::Settings());
+        }
+
+        std::vector<CpuConemap::TraceRay> createRays(size_t count, uint32_t seed)
+        {
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> uv(0.f, 1.f);
+            std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+            std::vector<CpuConemap::TraceRay> rays(count);
+            for (auto& ray : rays)
+            {
+                for (int a = 0; a < 2; ++a)
+                {
+                    ray.u[a] = uv(rng);
+                    ray.u2[a] = ray.u[a] + offset(rng);
+                }
+            }
+            return rays;
+        }
+    }
+
+    CPU_TEST(HeightfieldTracePacketsMatchScalar)
+    {
+        // not a multiple of the packet width, so the last packet is partially filled
+        const auto conemap = createNoiseConemap(64, 48, 3);
+        const auto rays = createRays(1003, 4);
+
+        CpuConemap::TraceSettings settings;
+        settings.steps = 32;
+        settings.relax = 1.2f;
+        settings.refineSteps = 6;
+        settings.refineOvershoot = 0.1f;
+
+        using IF = CpuConemap::IntersectionFunction;
+        using RF = CpuConemap::RefinementFunction;
+        for (IF function : { IF::BumpMapping, IF::ParallaxMapping, IF::LinearSearch, IF::ConeStepMapping })
+        {
+            for (RF refinement : { RF::None, RF::LinearApprox, RF::BinarySearch })
+            {
+                std::vector<CpuConemap::TraceResult> results(rays.size());
+                std::vector<float> refinedUvs(2 * rays.size());
+                CpuConemap::traceRays(conemap, function, refinement, rays.data(), rays.size(), settings, results.data(), refinedUvs.data());
+
+                size_t mismatches = 0;
+                for (size_t i = 0; i < rays.size(); ++i)
+                {
+                    const auto expected = CpuConemap::trace(conemap, function, rays[i], settings);
+                    float expectedUv[2];
+                    CpuConemap::refine(conemap, refinement, rays[i], expected, settings, expectedUv);
+                    const auto& res = results[i];
+                    const bool same = res.uv[0] == expected.uv[0] && res.uv[1] == expected.uv[1] && res.t == expected.t && res.lastT == expected.lastT &&
+                        res.wasHit == expected.wasHit && res.stepCount == expected.stepCount &&
+                        refinedUvs[2 * i] == expectedUv[0] && refinedUvs[2 * i + 1] == expectedUv[1];
+                    if (!same) mismatches++;
+                }
+                EXPECT_EQ(mismatches, size_t(0)) << "function " << int(function) << ", refinement " << int(refinement) << ", packet width " << CpuConemap::getTracePacketWidth();
+            }
+        }
+    }
+
+    CPU_TEST(HeightfieldTraceConeLodConverges)
+    {
+        // the cones of the coarser levels are narrower, so the steps are bounded by the margin of the level and not by the cones
+        const auto levels = CpuConemap::buildConservativeMips(createWaveConemap(256));
+        const auto rays = createRays(20000, 5);
+        std::vector<float> references(rays.size());
+        for (size_t i = 0; i < rays.size(); ++i) references[i] = CpuConemap::traceReference(levels[0], rays[i]);
+
+        CpuConemap::TraceSettings settings;
+        settings.steps = 64;
+        std::vector<CpuConemap::TraceResult> results(rays.size());
+        double level0Steps = 0.0;
+        for (size_t level = 0; level < levels.size(); ++level)
+        {
+            // the margin of selectConeLevel, a texel of the level
+            settings.texelSize = std::ldexp(1.f / levels[0].width, int(level));
+            CpuConemap::traceRays(levels[level], CpuConemap::IntersectionFunction::ConeStepMapping, CpuConemap::RefinementFunction::None, rays.data(), rays.size(), settings, results.data());
+            size_t nonConverged = 0;
+            size_t overBudget = 0;
+            size_t overshoots = 0;
+            double meanSteps = 0.0;
+            for (size_t i = 0; i < rays.size(); ++i)
+            {
+                const auto& res = results[i];
+                const auto& ray = rays[i];
+                const float dirZ = 1.f / std::sqrt(1.f + (ray.u2[0] - ray.u[0]) * (ray.u2[0] - ray.u[0]) + (ray.u2[1] - ray.u[1]) * (ray.u2[1] - ray.u[1]));
+                if (!res.wasHit) nonConverged++;
+                if (res.stepCount > CpuConemap::getConeStepBudget(dirZ, settings.texelSize, settings)) overBudget++;
+                // the search may end up to a margin past the surface of level 0, which is below the footprint of the pixel,
+                // plus a texel of level 0 where the bilinear filtering bends the surface between the texel centers
+                if (res.wasHit && res.t > references[i] + dirZ * (settings.texelSize + 1.f / levels[0].width)) overshoots++;
+                meanSteps += res.stepCount;
+            }
+            meanSteps /= rays.size();
+            if (level == 0) level0Steps = meanSteps;
+            EXPECT_LE(nonConverged, rays.size() / 1000) << "level " << level;
+            EXPECT_EQ(overBudget, size_t(0)) << "level " << level;
+            // level 0 itself ends farther for about 0.2% of these rays, the filtered cones between the texel centers can be wider
+            EXPECT_LE(overshoots, rays.size() / 200) << "level " << level;
+            if (level >= 2) EXPECT_LT(meanSteps, level0Steps) << "level " << level;
+        }
+    }
+
+    CPU_TEST(HeightfieldTraceShadowConeTracingLeaks)
+    {
+        std::mt19937 rng(8);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::vector<CpuConemap::ShadowRay> rays(20000);
+        for (auto& ray : rays)
+        {
+            const float angle = 6.2831853f * uniform(rng);
+            ray.u[0] = uniform(rng);
+            ray.u[1] = uniform(rng);
+            ray.light[0] = std::cos(angle);
+            ray.light[1] = std::sin(angle);
+            ray.light[2] = 0.05f + 1.5f * uniform(rng);
+        }
+
+        CpuConemap::ShadowSettings settings;
+        settings.steps = 64;
+        settings.penumbra = 0.f;
+        const CpuConemap::Conemap conemaps[] = { createNoiseConemap(128, 128, 7), createCheckerboardConemap(128, 8) };
+        for (const auto& conemap : conemaps)
+        {
+            // lit samples of shadowed rays, both marches miss the occluders that are thinner than their steps
+            size_t linearLeaks = 0;
+            size_t coneLeaks = 0;
+            for (const auto& ray : rays)
+            {
+                if (CpuConemap::traceShadowReference(conemap, ray, settings) > 0.5f) continue;
+                if (CpuConemap::traceShadow(conemap, CpuConemap::ShadowFunction::LinearMarch, ray, settings).visibility > 0.5f) linearLeaks++;
+                if (CpuConemap::traceShadow(conemap, CpuConemap::ShadowFunction::ConeTracing, ray, settings).visibility > 0.5f) coneLeaks++;
+            }
+            // the steps the cones prove skip no occluder, the others sample at least as densely as the linear march
+            EXPECT_LE(coneLeaks, linearLeaks + linearLeaks / 4) << "linear march leaks " << linearLeaks;
+        }
+    }
+
+    CPU_TEST(HeightfieldTraceMaxMipmapMatchesTexelWalk)
+    {
+        // the last texels of the levels of non-power-of-two sizes pool an extra row/column
+        const uint32_t kSizes[][2] = { { 64, 64 }, { 37, 53 }, { 100, 7 } };
+        const uint32_t maxSteps = 4096;
+        uint32_t seed = 20;
+        for (const auto& size : kSizes)
+        {
+            CpuConemap::Heightmap hmap;
+            hmap.width = size[0];
+            hmap.height = size[1];
+            hmap.texels.resize(size_t(size[0]) * size[1]);
+            std::mt19937 rng(seed++);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            for (float& h : hmap.texels) h = dist(rng);
+            const auto mipmap = CpuConemap::buildMinmaxMipmap(hmap);
+            EXPECT_EQ(mipmap.levels[1].width, size[0] / 2);
+            EXPECT_EQ(mipmap.levels.back().width * mipmap.levels.back().height, 1u);
+
+            // from steep rays to grazing ones that cross the whole texture, like the GPU verification of the sample
+            uint32_t mismatched = 0, unfinished = 0, aboveErrors = 0, hitErrors = 0;
+            for (uint32_t i = 0; i < 2000; ++i)
+            {
+                CpuConemap::TraceRay ray;
+                const float angle = 6.2831853f * dist(rng);
+                const float length = 2.f * dist(rng);
+                ray.u[0] = dist(rng);
+                ray.u[1] = dist(rng);
+                ray.u2[0] = ray.u[0] + length * std::cos(angle);
+                ray.u2[1] = ray.u[1] + length * std::sin(angle);
+
+                const auto res = CpuConemap::traceMaxMipmap(mipmap, ray, maxSteps);
+                if (res.stepCount >= maxSteps)
+                {
+                    unfinished++;
+                    continue;
+                }
+                const auto texels = CpuConemap::traceTexels(mipmap.levels[0], ray);
+                if (res.wasHit != texels.wasHit || res.t != texels.t) mismatched++;
+
+                // brute force: the ray is above the box of every texel it crosses before t, and reaches the box of the texel at t,
+                // samples close to a texel edge are skipped
+                auto findTexel = [&](float t, float& boxHeight)
+                {
+                    float p[2];
+                    for (int a = 0; a < 2; ++a)
+                    {
+                        p[a] = ((1 - t) * ray.u[a] + t * ray.u2[a]) * float(size[a]);
+                        if (p[a] < 0 || p[a] >= float(size[a]) || std::abs(p[a] - std::round(p[a])) < 1e-3f) return false;
+                    }
+                    boxHeight = hmap.load(uint32_t(p[0]), uint32_t(p[1]));
+                    return true;
+                };
+                float boxHeight;
+                for (uint32_t k = 0; k < 256; ++k)
+                {
+                    const float t = res.t * float(k) / 256.f;
+                    if (findTexel(t, boxHeight) && 1 - t < boxHeight - 1e-5f) aboveErrors++;
+                }
+                if (res.wasHit && findTexel(res.t + 1e-5f, boxHeight) && 1 - res.t > boxHeight + 1e-4f) hitErrors++;
+            }
+            EXPECT_EQ(unfinished, 0u) << size[0] << "x" << size[1];
+            EXPECT_EQ(mismatched, 0u) << size[0] << "x" << size[1];
+            EXPECT_EQ(aboveErrors, 0u) << size[0] << "x" << size[1];
+            EXPECT_EQ(hitErrors, 0u) << size[0] << "x" << size[1];
+        }
+    }
+}
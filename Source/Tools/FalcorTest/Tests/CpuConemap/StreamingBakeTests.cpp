@@ -0,0 +1,169 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "StreamingBake.h"
+#include "TiledConemapFile.h"
+#include "ConemapEncode.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Smooth hills with a little noise, quantized to 16 bit unorm. The low regions have wide cones,
+            so their tiles need a large halo.
+        */
+        std::vector<uint16_t> createHillsHeightmap(uint32_t width, uint32_t height, uint32_t seed)
+        {
+            std::vector<uint16_t> texels(size_t(width) * height);
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> noise(0.f, 0.02f);
+            const float pi = 3.14159265f;
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const float u = float(x) / width;
+                    const float v = float(y) / height;
+                    const float h = 0.45f + 0.4f * std::sin(3.f * pi * u) * std::cos(2.f * pi * v) + noise(rng);
+                    texels[size_t(y) * width + x] = uint16_t(std::lround(std::clamp(h, 0.f, 1.f) * 65535.f));
+                }
+            }
+            return texels;
+        }
+
+        /** Reads every tile of a tiled conemap file into a single conemap.
+        */
+        CpuConemap::Conemap readTiledConemap(const std::string& filename)
+        {
+            CpuConemap::TiledConemapReader reader(filename);
+            const auto& header = reader.getHeader();
+            CpuConemap::Conemap conemap;
+            conemap.width = header.width;
+            conemap.height = header.height;
+            conemap.texels.resize(2 * size_t(header.width) * header.height);
+            for (uint32_t ty = 0; ty < header.tilesY; ++ty)
+            {
+                for (uint32_t tx = 0; tx < header.tilesX; ++tx)
+                {
+                    const auto tile = reader.readTile(tx, ty);
+                    for (uint32_t y = 0; y < tile.height; ++y)
+                    {
+                        const float* row = tile.texels.data() + 2 * size_t(y) * tile.width;
+                        std::copy(row, row + 2 * tile.width, conemap.texels.begin() + 2 * (size_t(ty * header.tileSize + y) * header.width + tx * header.tileSize));
+                    }
+                }
+            }
+            return conemap;
+        }
+
+        struct StreamingResult
+        {
+            CpuConemap::StreamingStats stats;
+            CpuConemap::Conemap conemap;
+        };
+
+        StreamingResult bakeStreamingFile(const std::string& rawFilename, uint32_t width, uint32_t height, uint32_t maxHalo)
+        {
+            CpuConemap::StreamingSettings settings;
+            settings.tileSize = 64;
+            settings.blockSize = 32;
+            settings.maxHalo = maxHalo;
+            const std::string filename = (std::filesystem::temp_directory_path() / "CpuConemapStreaming.ctile").string();
+            StreamingResult result;
+            CpuConemap::bakeStreaming(CpuConemap::RawHeightmapFile(rawFilename, width, height, CpuConemap::RawFormat::UNorm16), filename, settings, &result.stats);
+            result.conemap = readTiledConemap(filename);
+            std::filesystem::remove(filename);
+            return result;
+        }
+    }
+
+    CPU_TEST(StreamingBakeMatchesBakeAndStaysConservative)
+    {
+        const uint32_t width = 256;
+        const uint32_t height = 192;
+        const auto texels = createHillsHeightmap(width, height, 3);
+        const std::string rawFilename = (std::filesystem::temp_directory_path() / "CpuConemapStreaming.raw").string();
+        {
+            // little endian, like the hosts the tests run on
+            std::ofstream file(rawFilename, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(texels.data()), std::streamsize(texels.size() * sizeof(uint16_t)));
+        }
+
+        // the stored heights are the input heights, so the cones must be conservative for the input
+        CpuConemap::Heightmap hmap;
+        hmap.width = width;
+        hmap.height = height;
+        for (uint16_t t : texels) hmap.texels.push_back(t / 65535.f);
+        const auto exact = CpuConemap::bake(hmap, CpuConemap::Settings());
+        const float heightError = 2.f * CpuConemap::getUnormHeightError(16);
+        const float texelSize = 1.f / float(std::max(width, height));
+        const float quantum = 1.f / 65535.f;
+
+        // a halo as large as the heightmap: every tile is exact and matches bake() after the narrowing and rounding
+        {
+            const auto result = bakeStreamingFile(rawFilename, width, height, 1024);
+            EXPECT_EQ(result.stats.tileCount, 12u);
+            EXPECT_EQ(result.stats.exactTiles, result.stats.tileCount);
+            uint32_t heightErrors = 0;
+            uint32_t coneErrors = 0;
+            for (size_t i = 0; i < hmap.texels.size(); ++i)
+            {
+                if (result.conemap.texels[2 * i] != hmap.texels[i]) heightErrors++;
+                const float expected = CpuConemap::narrowCone(exact.texels[2 * i + 1], texelSize, heightError);
+                if (std::abs(result.conemap.texels[2 * i + 1] - expected) > quantum + 1e-6f) coneErrors++;
+            }
+            EXPECT_EQ(heightErrors, 0u);
+            EXPECT_EQ(coneErrors, 0u);
+        }
+
+        // a small halo: the far texels of the low tiles are bounded by their blocks, the cones are narrower but conservative
+        {
+            const auto result = bakeStreamingFile(rawFilename, width, height, 32);
+            EXPECT_LT(result.stats.exactTiles, result.stats.tileCount);
+            EXPECT_GT(result.stats.largestHalo, 32u);
+            uint32_t wideCones = 0;
+            uint32_t narrowerCones = 0;
+            for (size_t i = 0; i < hmap.texels.size(); ++i)
+            {
+                const float cone = result.conemap.texels[2 * i + 1];
+                const float exactCone = exact.texels[2 * i + 1];
+                // allow the rounding of the float bake
+                if (cone > exactCone * (1.f + 1e-6f)) wideCones++;
+                if (cone < CpuConemap::narrowCone(exactCone, texelSize, heightError) - quantum - 1e-6f) narrowerCones++;
+            }
+            EXPECT_EQ(wideCones, 0u);
+            EXPECT_GT(narrowerCones, 0u) << "the far field fallback was not used";
+        }
+        std::filesystem::remove(rawFilename);
+    }
+}
@@ -0,0 +1,157 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "TileResidency.h"
+#include <initializer_list>
+#include <stdexcept>
+
+namespace Falcor
+{
+    namespace
+    {
+        using CpuConemap::LruCache;
+        using CpuConemap::ResidencyManager;
+
+        std::vector<uint32_t> createFeedback(const ResidencyManager& residency, std::initializer_list<uint32_t> tiles)
+        {
+            std::vector<uint32_t> feedback(residency.getFeedbackWordCount(), 0);
+            for (uint32_t tile : tiles) feedback[tile / 32] |= 1u << (tile % 32);
+            return feedback;
+        }
+
+        template<typename F>
+        bool throwsInvalidArgument(F f)
+        {
+            try
+            {
+                f();
+            }
+            catch (const std::invalid_argument&)
+            {
+                return true;
+            }
+            return false;
+        }
+    }
+
+    CPU_TEST(LruCacheEvictionOrder)
+    {
+        LruCache cache(3);
+        uint32_t evicted;
+        EXPECT_EQ(cache.getLeastRecentlyUsed(), LruCache::kNone);
+        EXPECT_EQ(cache.insert(10, evicted), 0u);
+        EXPECT_EQ(evicted, LruCache::kNone);
+        EXPECT_EQ(cache.insert(11, evicted), 1u);
+        EXPECT_EQ(cache.insert(12, evicted), 2u);
+        EXPECT_EQ(evicted, LruCache::kNone);
+        EXPECT_EQ(cache.getSize(), 3u);
+        EXPECT_EQ(cache.getLeastRecentlyUsed(), 10u);
+
+        // a touched key is the most recently used one, the next one is evicted
+        cache.touch(10);
+        EXPECT_EQ(cache.getLeastRecentlyUsed(), 11u);
+        EXPECT_EQ(cache.insert(13, evicted), 1u);
+        EXPECT_EQ(evicted, 11u);
+        EXPECT_EQ(cache.find(11), LruCache::kNone);
+        EXPECT_EQ(cache.find(13), 1u);
+        EXPECT_EQ(cache.getKey(1), 13u);
+        EXPECT_EQ(cache.getSize(), 3u);
+
+        // the order is now 13, 10, 12
+        EXPECT_EQ(cache.insert(14, evicted), 2u);
+        EXPECT_EQ(evicted, 12u);
+        EXPECT_EQ(cache.insert(15, evicted), 0u);
+        EXPECT_EQ(evicted, 10u);
+        EXPECT_EQ(cache.getLeastRecentlyUsed(), 13u);
+
+        EXPECT(throwsInvalidArgument([&]() { cache.insert(15, evicted); }));
+        EXPECT(throwsInvalidArgument([&]() { cache.touch(11); }));
+        EXPECT(throwsInvalidArgument([]() { LruCache empty(0); }));
+    }
+
+    CPU_TEST(ResidencyManagerUpdate)
+    {
+        // 4x2 tiles, 3 slots, at most 2 loads per update
+        ResidencyManager residency(4, 2, 3, 2);
+        EXPECT_EQ(residency.getFeedbackWordCount(), 1u);
+
+        auto loads = residency.update(createFeedback(residency, { 0, 1, 2, 3 }));
+        EXPECT_EQ(loads.size(), size_t(2));
+        if (loads.size() == 2)
+        {
+            EXPECT_EQ(loads[0].tile, 0u);
+            EXPECT_EQ(loads[0].slot, 0u);
+            EXPECT_EQ(loads[0].evictedTile, LruCache::kNone);
+            EXPECT_EQ(loads[1].tile, 1u);
+            EXPECT_EQ(loads[1].slot, 1u);
+        }
+        EXPECT_EQ(residency.getStats().requestedTiles, 4u);
+        EXPECT_EQ(residency.getStats().missingTiles, 2u);
+        EXPECT_EQ(residency.getPageTable()[0], 1u);
+        EXPECT_EQ(residency.getPageTable()[1], 2u);
+        EXPECT_EQ(residency.getPageTable()[2], ResidencyManager::kNotResident);
+
+        // the working set is larger than the cache: the free slot is filled, but no tile of the frame is evicted
+        loads = residency.update(createFeedback(residency, { 0, 1, 2, 3 }));
+        EXPECT_EQ(loads.size(), size_t(1));
+        if (loads.size() == 1)
+        {
+            EXPECT_EQ(loads[0].tile, 2u);
+            EXPECT_EQ(loads[0].slot, 2u);
+        }
+        EXPECT_EQ(residency.getStats().missingTiles, 1u);
+        EXPECT_EQ(residency.getStats().evictions, uint64_t(0));
+        EXPECT_EQ(residency.getResidentCount(), 3u);
+
+        // a new tile evicts the least recently used one of an earlier frame
+        loads = residency.update(createFeedback(residency, { 1, 5 }));
+        EXPECT_EQ(loads.size(), size_t(1));
+        if (loads.size() == 1)
+        {
+            EXPECT_EQ(loads[0].tile, 5u);
+            EXPECT_EQ(loads[0].slot, 0u);
+            EXPECT_EQ(loads[0].evictedTile, 0u);
+        }
+        EXPECT_EQ(residency.getPageTable()[0], ResidencyManager::kNotResident);
+        EXPECT_EQ(residency.getPageTable()[5], 1u);
+        EXPECT_EQ(residency.getStats().evictions, uint64_t(1));
+        EXPECT_EQ(residency.getStats().loads, uint64_t(4));
+
+        // resident tiles are not loaded again
+        loads = residency.update(createFeedback(residency, { 1, 5 }));
+        EXPECT_EQ(loads.size(), size_t(0));
+        EXPECT_EQ(residency.getStats().missingTiles, 0u);
+
+        EXPECT(throwsInvalidArgument([&]() { residency.update(std::vector<uint32_t>(2, 0)); }));
+
+        // 0 loads per frame means no limit
+        ResidencyManager unlimited(8, 8, 64, 0);
+        EXPECT_EQ(unlimited.getFeedbackWordCount(), 2u);
+        EXPECT_EQ(unlimited.update(std::vector<uint32_t>(2, ~0u)).size(), size_t(64));
+    }
+}
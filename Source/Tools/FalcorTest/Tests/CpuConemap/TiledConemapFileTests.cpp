@@ -0,0 +1,180 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "TiledConemapFile.h"
+#include "ConemapEncode.h"
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        CpuConemap::Conemap createRandomConemap(uint32_t width, uint32_t height, uint32_t seed)
+        {
+            CpuConemap::Conemap conemap;
+            conemap.width = width;
+            conemap.height = height;
+            conemap.texels.resize(2 * size_t(width) * height);
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            for (float& t : conemap.texels) t = dist(rng);
+            return conemap;
+        }
+
+        uint8_t getAlbedo(uint32_t x, uint32_t y, uint32_t channel)
+        {
+            return uint8_t((x * 7 + y * 13 + channel * 29) & 0xff);
+        }
+    }
+
+    CPU_TEST(TiledConemapRoundTrip)
+    {
+        // the tiles on the right and bottom edges are partial
+        const uint32_t tileSize = 16;
+        const uint32_t albedoScale = 2;
+        const auto conemap = createRandomConemap(37, 21, 11);
+        const auto tail = createRandomConemap(5, 3, 12);
+        const std::string filename = (std::filesystem::temp_directory_path() / "CpuConemapRoundTrip.ctile").string();
+
+        {
+            CpuConemap::TiledConemapWriter writer(filename, conemap.width, conemap.height, tileSize, albedoScale);
+            const auto& header = writer.getHeader();
+            EXPECT_EQ(header.tilesX, 3u);
+            EXPECT_EQ(header.tilesY, 2u);
+            for (uint32_t ty = 0; ty < header.tilesY; ++ty)
+            {
+                for (uint32_t tx = 0; tx < header.tilesX; ++tx)
+                {
+                    CpuConemap::Conemap tile;
+                    tile.width = header.getTileWidth(tx);
+                    tile.height = header.getTileHeight(ty);
+                    for (uint32_t y = 0; y < tile.height; ++y)
+                    {
+                        const float* row = conemap.texels.data() + 2 * (size_t(ty * tileSize + y) * conemap.width + tx * tileSize);
+                        tile.texels.insert(tile.texels.end(), row, row + 2 * tile.width);
+                    }
+                    std::vector<uint8_t> albedo;
+                    for (uint32_t y = 0; y < tile.height * albedoScale; ++y)
+                    {
+                        for (uint32_t x = 0; x < tile.width * albedoScale; ++x)
+                        {
+                            for (uint32_t c = 0; c < 4; ++c) albedo.push_back(getAlbedo(tx * tileSize * albedoScale + x, ty * tileSize * albedoScale + y, c));
+                        }
+                    }
+                    writer.writeTile(tx, ty, tile, albedo.data());
+                }
+            }
+            writer.writeTail(tail, 8);
+        }
+
+        {
+            CpuConemap::TiledConemapReader reader(filename);
+            const auto& header = reader.getHeader();
+            EXPECT_EQ(header.width, conemap.width);
+            EXPECT_EQ(header.height, conemap.height);
+            EXPECT_EQ(header.tileSize, tileSize);
+            EXPECT_EQ(header.albedoScale, albedoScale);
+            EXPECT_EQ(header.tailWidth, tail.width);
+            EXPECT_EQ(header.tailHeight, tail.height);
+            EXPECT_EQ(header.tailBlockSize, 8u);
+
+            // heights are rounded to the nearest 16 bit unorm, cones are narrowed by the rounding and rounded down
+            const float quantum = 1.f / 65535.f;
+            const float heightError = 2.f * CpuConemap::getUnormHeightError(16);
+            auto narrow = [&](float cone, uint32_t w, uint32_t h) { return CpuConemap::narrowCone(cone, 1.f / float(std::max(w, h)), heightError); };
+            uint32_t heightErrors = 0;
+            uint32_t coneErrors = 0;
+            uint32_t albedoErrors = 0;
+            uint32_t paddingErrors = 0;
+            std::vector<uint16_t> texels;
+            std::vector<uint8_t> albedo;
+            for (uint32_t ty = 0; ty < header.tilesY; ++ty)
+            {
+                for (uint32_t tx = 0; tx < header.tilesX; ++tx)
+                {
+                    const auto tile = reader.readTile(tx, ty);
+                    EXPECT_EQ(tile.width, header.getTileWidth(tx));
+                    EXPECT_EQ(tile.height, header.getTileHeight(ty));
+                    for (uint32_t y = 0; y < tile.height; ++y)
+                    {
+                        for (uint32_t x = 0; x < tile.width; ++x)
+                        {
+                            const uint32_t gx = tx * tileSize + x;
+                            const uint32_t gy = ty * tileSize + y;
+                            if (std::abs(tile.getHeight(x, y) - conemap.getHeight(gx, gy)) > 0.5f * quantum + 1e-7f) heightErrors++;
+                            const float coneError = narrow(conemap.getCone(gx, gy), conemap.width, conemap.height) - tile.getCone(x, y);
+                            if (coneError < 0.f || coneError > quantum + 1e-7f) coneErrors++;
+                        }
+                    }
+
+                    reader.readTileData(tx, ty, texels, albedo);
+                    EXPECT_EQ(texels.size(), size_t(2 * tileSize * tileSize));
+                    EXPECT_EQ(albedo.size(), size_t(4 * tileSize * tileSize * albedoScale * albedoScale));
+                    for (uint32_t y = 0; y < tileSize; ++y)
+                    {
+                        for (uint32_t x = 0; x < tileSize; ++x)
+                        {
+                            const bool inside = x < tile.width && y < tile.height;
+                            const size_t i = 2 * (size_t(y) * tileSize + x);
+                            if (!inside && (texels[i] != 0 || texels[i + 1] != 0)) paddingErrors++;
+                        }
+                    }
+                    const uint32_t albedoTileSize = tileSize * albedoScale;
+                    for (uint32_t y = 0; y < tile.height * albedoScale; ++y)
+                    {
+                        for (uint32_t x = 0; x < tile.width * albedoScale; ++x)
+                        {
+                            for (uint32_t c = 0; c < 4; ++c)
+                            {
+                                if (albedo[4 * (size_t(y) * albedoTileSize + x) + c] != getAlbedo(tx * albedoTileSize + x, ty * albedoTileSize + y, c)) albedoErrors++;
+                            }
+                        }
+                    }
+                }
+            }
+            EXPECT_EQ(heightErrors, 0u);
+            EXPECT_EQ(coneErrors, 0u);
+            EXPECT_EQ(albedoErrors, 0u);
+            EXPECT_EQ(paddingErrors, 0u);
+
+            const auto tailData = reader.readTailData();
+            EXPECT_EQ(tailData.size(), tail.texels.size());
+            uint32_t tailErrors = 0;
+            for (size_t i = 0; i < std::min(tailData.size(), tail.texels.size()); ++i)
+            {
+                if (i % 2 == 0 && std::abs(tailData[i] / 65535.f - tail.texels[i]) > 0.5f * quantum + 1e-7f) tailErrors++;
+                const float coneError = i % 2 ? narrow(tail.texels[i], tail.width, tail.height) - tailData[i] / 65535.f : 0.f;
+                if (coneError < 0.f || coneError > quantum + 1e-7f) tailErrors++;
+            }
+            EXPECT_EQ(tailErrors, 0u);
+        }
+        std::filesystem::remove(filename);
+    }
+}
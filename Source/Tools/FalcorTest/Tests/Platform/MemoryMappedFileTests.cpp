@@ -0,0 +1,70 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Core/Platform/MemoryMappedFile.h"
+#include <fstream>
+
+namespace Falcor
+{
+    CPU_TEST(MemoryMappedFile)
+    {
+        std::filesystem::path path = std::filesystem::current_path() / "memory_mapped_file.bin";
+
+        std::vector<uint8_t> data(100000);
+        for (size_t i = 0; i < data.size(); i++) data[i] = (uint8_t)(i * 7 + (i >> 8));
+        {
+            std::ofstream fs(path, std::ios_base::binary);
+            fs.write(reinterpret_cast<const char*>(data.data()), data.size());
+        }
+
+        {
+            MemoryMappedFile file;
+            EXPECT(file.open(path));
+            EXPECT(file.isOpen());
+            EXPECT_EQ(file.getSize(), data.size());
+            EXPECT(std::memcmp(file.getData(), data.data(), data.size()) == 0);
+
+            file.close();
+            EXPECT(!file.isOpen());
+            EXPECT(file.getData() == nullptr);
+            EXPECT_EQ(file.getSize(), 0);
+        }
+
+        // The file must not be locked by the closed mapping.
+        std::filesystem::remove(path);
+        EXPECT(!std::filesystem::exists(path));
+
+        // Missing and empty files cannot be mapped.
+        MemoryMappedFile file;
+        EXPECT(!file.open(path));
+        std::ofstream(path, std::ios_base::binary).close();
+        EXPECT(!file.open(path));
+        EXPECT(!file.isOpen());
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Utils/Timing/Profiler.h"
+
+namespace Falcor
+{
+    CPU_TEST(ProfilerCounters)
+    {
+        Profiler profiler;
+
+        // Counters are ignored while the profiler is disabled.
+        profiler.setCounter("ignored", 1.f);
+        profiler.endFrame();
+        EXPECT(profiler.getCounters().empty());
+
+        profiler.setEnabled(true);
+        profiler.startCapture(4);
+        profiler.setCounter("a", 1.f);
+        profiler.endFrame();
+        EXPECT_EQ(profiler.getCounters().size(), size_t(1));
+        EXPECT_EQ(profiler.getCounters().at("a"), 1.f);
+
+        // Counters keep their value until they are set again.
+        profiler.setCounter("b", 4.f);
+        profiler.endFrame();
+        EXPECT_EQ(profiler.getCounters().size(), size_t(2));
+        EXPECT_EQ(profiler.getCounters().at("a"), 1.f);
+
+        profiler.setCounter("a", 3.f);
+        profiler.setCounter("b", 6.f);
+        profiler.endFrame();
+
+        auto pCapture = profiler.endCapture();
+        EXPECT(pCapture != nullptr);
+        if (!pCapture) return;
+
+        const auto& lanes = pCapture->getLanes();
+        auto findLane = [&lanes](const std::string& name) -> const Profiler::Capture::Lane*
+        {
+            for (const auto& lane : lanes) if (lane.name == name) return &lane;
+            return nullptr;
+        };
+        const auto pLaneA = findLane("a/value");
+        const auto pLaneB = findLane("b/value");
+        EXPECT(pLaneA != nullptr && pLaneB != nullptr);
+        if (!pLaneA || !pLaneB) return;
+
+        EXPECT(pLaneA->records == std::vector<float>({ 1.f, 1.f, 3.f }));
+        // The frames before a counter is first set are padded with zeros, also when they had no events.
+        EXPECT(pLaneB->records == std::vector<float>({ 0.f, 4.f, 6.f }));
+        EXPECT_EQ(pLaneA->stats.min, 1.f);
+        EXPECT_EQ(pLaneA->stats.max, 3.f);
+        EXPECT_EQ(pLaneB->stats.min, 0.f);
+        EXPECT_EQ(pLaneB->stats.max, 6.f);
+    }
+}
@@ -0,0 +1,171 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include <atomic>
+
+namespace Falcor
+{
+    CPU_TEST(ThreadingParallelFor)
+    {
+        const size_t count = 100000;
+        for (size_t grainSize : { size_t(0), size_t(1), size_t(1000), count + 1 })
+        {
+            std::vector<uint32_t> visits(count, 0);
+            Threading::parallelFor(0, count, [&](size_t begin, size_t end)
+            {
+                EXPECT_LT(begin, end);
+                for (size_t i = begin; i < end; ++i) visits[i]++;
+            }, grainSize);
+            size_t visited = 0;
+            for (uint32_t v : visits) visited += v == 1 ? 1 : 0;
+            EXPECT_EQ(visited, count);
+        }
+
+        // empty range
+        bool called = false;
+        Threading::parallelFor(5, 5, [&](size_t, size_t) { called = true; });
+        EXPECT(!called);
+    }
+
+    CPU_TEST(ThreadingParallelForNested)
+    {
+        // the waits inside the tasks execute queued work, this must not deadlock with every worker waiting
+        std::atomic<uint32_t> sum = 0;
+        Threading::parallelFor(0, 64, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Threading::parallelFor(0, 64, [&](size_t b, size_t e) { sum += uint32_t(e - b); }, 4);
+            }
+        }, 1);
+        EXPECT_EQ(sum.load(), 64u * 64u);
+    }
+
+    CPU_TEST(ThreadingParallelReduce)
+    {
+        const size_t count = 1000000;
+        auto sum = [](size_t begin, size_t end)
+        {
+            uint64_t s = 0;
+            for (size_t i = begin; i < end; ++i) s += i;
+            return s;
+        };
+        auto add = [](uint64_t a, uint64_t b) { return a + b; };
+        EXPECT_EQ(Threading::parallelReduce(0, count, uint64_t(0), sum, add), uint64_t(count) * (count - 1) / 2);
+        EXPECT_EQ(Threading::parallelReduce(0, count, uint64_t(0), sum, add, 7), uint64_t(count) * (count - 1) / 2);
+        EXPECT_EQ(Threading::parallelReduce(3, 3, uint64_t(42), sum, add), uint64_t(42));
+
+        // the partial results are combined in order
+        auto concat = [](const std::string& a, const std::string& b) { return a + b; };
+        auto digits = [](size_t begin, size_t end)
+        {
+            std::string s;
+            for (size_t i = begin; i < end; ++i) s += char('0' + i);
+            return s;
+        };
+        EXPECT_EQ(Threading::parallelReduce(0, 10, std::string(), digits, concat, 1), std::string("0123456789"));
+    }
+
+    CPU_TEST(ThreadingDependencies)
+    {
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            std::atomic<uint32_t> order = 0;
+            uint32_t a = 0, b = 0, c = 0, d = 0;
+            auto taskA = Threading::dispatchTask([&]() { a = ++order; });
+            auto taskB = Threading::dispatchTask([&]() { b = ++order; });
+            auto taskC = Threading::dispatchTask([&]() { c = ++order; }, { taskA, taskB, Threading::Task() });
+            auto taskD = taskC.then([&]() { d = ++order; });
+            taskD.finish();
+            EXPECT(!taskA.isRunning());
+            EXPECT(!taskB.isRunning());
+            EXPECT(!taskC.isRunning());
+            EXPECT_EQ(c, 3u);
+            EXPECT_EQ(d, 4u);
+            EXPECT_EQ(a + b, 3u);
+        }
+
+        // a finished dependency does not delay the task
+        auto done = Threading::dispatchTask([]() {});
+        done.finish();
+        bool ran = false;
+        Threading::dispatchTask([&]() { ran = true; }, { done }).finish();
+        EXPECT(ran);
+
+        EXPECT(!Threading::Task().isRunning());
+    }
+
+    CPU_TEST(ThreadingTaskGroup)
+    {
+        Threading::TaskGroup group;
+        std::atomic<uint32_t> count = 0;
+        for (uint32_t i = 0; i < 1000; ++i) group.run([&]() { count++; });
+        group.wait();
+        EXPECT(!group.isRunning());
+        EXPECT_EQ(count.load(), 1000u);
+
+        // tasks dispatched by the tasks of the group
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            group.run([&]()
+            {
+                Threading::TaskGroup inner;
+                for (uint32_t j = 0; j < 10; ++j) inner.run([&]() { count++; });
+                inner.wait();
+            });
+        }
+        group.wait();
+        EXPECT_EQ(count.load(), 2000u);
+    }
+
+    CPU_TEST(ThreadingExceptions)
+    {
+        bool caught = false;
+        auto task = Threading::dispatchTask([]() { throw std::runtime_error("task"); });
+        try { task.finish(); }
+        catch (const std::runtime_error&) { caught = true; }
+        EXPECT(caught);
+
+        caught = false;
+        try { Threading::parallelFor(0, 100, [](size_t begin, size_t) { if (begin == 50) throw std::runtime_error("parallelFor"); }, 1); }
+        catch (const std::runtime_error&) { caught = true; }
+        EXPECT(caught);
+
+        // the group is usable after the exception was rethrown
+        Threading::TaskGroup group;
+        group.run([]() { throw std::runtime_error("group"); });
+        caught = false;
+        try { group.wait(); }
+        catch (const std::runtime_error&) { caught = true; }
+        EXPECT(caught);
+        bool ran = false;
+        group.run([&]() { ran = true; });
+        group.wait();
+        EXPECT(ran);
+    }
+}
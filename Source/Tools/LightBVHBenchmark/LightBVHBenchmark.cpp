@@ -0,0 +1,191 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "LightBVHBenchmark.h"
+#include "Experimental/Scene/Lights/LightBVHBuilder.h"
+
+#include <args.hxx>
+
+#include <iostream>
+#include <string>
+
+/** Global to hold return code.
+    The instance of LightBVHBenchmark is destroyed before leaving Sample::run().
+*/
+static int sReturnCode = 1;
+
+namespace
+{
+    struct BuilderConfig
+    {
+        std::string name;
+        LightBVHBuilder::Options options;
+    };
+
+    /** Returns the builders to measure: every split heuristic built serially and in parallel, and the LBVH sorted on the CPU and the GPU.
+    */
+    std::vector<BuilderConfig> getBuilderConfigs()
+    {
+        const std::pair<LightBVHBuilder::SplitHeuristic, const char*> heuristics[] =
+        {
+            { LightBVHBuilder::SplitHeuristic::Equal, "equal" },
+            { LightBVHBuilder::SplitHeuristic::BinnedSAH, "sah" },
+            { LightBVHBuilder::SplitHeuristic::BinnedSAOH, "saoh" },
+        };
+
+        std::vector<BuilderConfig> configs;
+        for (const auto& [heuristic, name] : heuristics)
+        {
+            for (bool parallel : { false, true })
+            {
+                BuilderConfig config;
+                config.name = std::string("topdown_") + name + (parallel ? "_parallel" : "_serial");
+                config.options.buildMethod = LightBVHBuilder::BuildMethod::TopDown;
+                config.options.splitHeuristicSelection = heuristic;
+                config.options.useParallelBuild = parallel;
+                configs.push_back(config);
+            }
+        }
+        for (bool gpu : { false, true })
+        {
+            BuilderConfig config;
+            config.name = gpu ? "lbvh_gpu" : "lbvh_cpu";
+            config.options.buildMethod = LightBVHBuilder::BuildMethod::LBVH;
+            config.options.sortOnGPU = gpu;
+            configs.push_back(config);
+        }
+        return configs;
+    }
+}
+
+void LightBVHBenchmark::onFrameRender(RenderContext* pRenderContext, const Fbo::SharedPtr& pTargetFbo)
+{
+    Scene::SharedPtr pScene;
+    try
+    {
+        pScene = Scene::create(mOptions.sceneFile);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to load scene '" << mOptions.sceneFile << "': " << e.what() << std::endl;
+    }
+
+    if (pScene)
+    {
+        const LightCollection::SharedConstPtr pLights = pScene->getLightCollection(pRenderContext);
+        LightBVH::SharedPtr pBVH = LightBVH::create(pLights);
+
+        std::cout << "scene,builder,lights,runs,build_min_ms,build_avg_ms,sah_cost,tree_height,min_depth,internal_nodes,leaf_nodes,bvh_triangles" << std::endl;
+        sReturnCode = 0;
+        for (const BuilderConfig& config : getBuilderConfigs())
+        {
+            try
+            {
+                LightBVHBuilder::SharedPtr pBuilder = LightBVHBuilder::create(config.options);
+
+                // The first build creates the GPU resources of the builder and is not measured.
+                pBuilder->build(*pBVH);
+                pRenderContext->flush(true);
+
+                double minTime = std::numeric_limits<double>::max();
+                double totalTime = 0.0;
+                for (uint32_t run = 0; run < mOptions.runCount; ++run)
+                {
+                    // The LBVH builders finish on the GPU, so every build is measured until the GPU is idle.
+                    const auto startTime = CpuTimer::getCurrentTimePoint();
+                    pBuilder->build(*pBVH);
+                    pRenderContext->flush(true);
+                    const double buildTime = CpuTimer::calcDuration(startTime, CpuTimer::getCurrentTimePoint());
+                    minTime = std::min(minTime, buildTime);
+                    totalTime += buildTime;
+                }
+
+                const LightBVH::BVHStats& stats = pBVH->getStats();
+                std::cout << mOptions.sceneFile << "," << config.name << "," << pLights->getTotalLightCount() << "," << mOptions.runCount << ","
+                    << minTime << "," << totalTime / mOptions.runCount << "," << pBVH->evalSAHCost() << ","
+                    << stats.treeHeight << "," << stats.minDepth << "," << stats.internalNodeCount << "," << stats.leafNodeCount << "," << stats.triangleCount << std::endl;
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Builder '" << config.name << "' failed: " << e.what() << std::endl;
+                sReturnCode = 1;
+            }
+        }
+    }
+
+    gpFramework->shutdown();
+}
+
+int main(int argc, char** argv)
+{
+    args::ArgumentParser parser("Measures the build time and the tree quality of the light BVH builders on the emissive triangles of a scene.");
+    parser.helpParams.programName = "LightBVHBenchmark";
+    args::HelpFlag helpFlag(parser, "help", "Display this help menu.", {'h', "help"});
+    args::Positional<std::string> sceneFlag(parser, "scene", "Scene file.", args::Options::Required);
+    args::ValueFlag<uint32_t> runsFlag(parser, "runs", "Number of builds measured per builder (default: 5).", {'r', "runs"}, 5);
+    args::CompletionFlag completionFlag(parser, {"complete"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (const args::Completion& e)
+    {
+        std::cout << e.what();
+        return 0;
+    }
+    catch (const args::Help&)
+    {
+        std::cout << parser;
+        return 0;
+    }
+    catch (const args::ParseError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const args::RequiredError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    LightBVHBenchmark::Options options;
+    options.sceneFile = args::get(sceneFlag);
+    options.runCount = std::max(args::get(runsFlag), 1u);
+
+    LightBVHBenchmark::UniquePtr pRenderer = std::make_unique<LightBVHBenchmark>(options);
+    SampleConfig config;
+    config.windowDesc.title = "LightBVHBenchmark";
+    config.windowDesc.mode = Window::WindowMode::Minimized;
+    config.windowDesc.resizableWindow = true;
+    config.windowDesc.width = config.windowDesc.height = 2;
+    Sample::run(config, pRenderer, argc, argv);
+    return sReturnCode;
+}
@@ -0,0 +1,147 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "SceneCacheBenchmark.h"
+
+#include <args.hxx>
+
+#include <iostream>
+#include <string>
+
+/** Global to hold return code.
+    The instance of SceneCacheBenchmark is destroyed before leaving Sample::run().
+*/
+static int sReturnCode = 1;
+
+namespace
+{
+    double toMB(uint64_t bytes)
+    {
+        return (double)bytes / (1024.0 * 1024.0);
+    }
+}
+
+void SceneCacheBenchmark::onFrameRender(RenderContext* pRenderContext, const Fbo::SharedPtr& pTargetFbo)
+{
+    SceneBuilder::Flags flags = mOptions.prepare ? SceneBuilder::Flags::RebuildCache : SceneBuilder::Flags::UseCache;
+    if (mOptions.mappedCache) flags |= SceneBuilder::Flags::UseMappedCache;
+    const char* format = mOptions.mappedCache ? "mapped" : "stream";
+
+    // Without a valid cache the scene builder silently imports the source, which would be reported as a cached load.
+    if (!mOptions.prepare && !SceneBuilder::hasValidSceneCache(mOptions.sceneFile, flags))
+    {
+        SceneBuilder::Flags otherFormatFlags = flags;
+        flip_bit(otherFormatFlags, SceneBuilder::Flags::UseMappedCache);
+        const bool hasOtherFormat = SceneBuilder::hasValidSceneCache(mOptions.sceneFile, otherFormatFlags);
+        std::cerr << "No valid " << format << " scene cache of '" << mOptions.sceneFile << "'. "
+            << (hasOtherFormat ? (mOptions.mappedCache ? "Run without --mapped to use the stream cache." : "Run with --mapped to use the mapped cache.") : "Run with --prepare first.") << std::endl;
+        gpFramework->shutdown();
+        return;
+    }
+
+    // The peak working set covers the whole process, so every run measures a single load.
+    const uint64_t workingSetBefore = getProcessWorkingSet();
+    const auto startTime = CpuTimer::getCurrentTimePoint();
+
+    Scene::SharedPtr pScene;
+    try
+    {
+        SceneBuilder::SharedPtr pBuilder = SceneBuilder::create(mOptions.sceneFile, flags);
+        if (pBuilder) pScene = pBuilder->getScene();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to load scene '" << mOptions.sceneFile << "': " << e.what() << std::endl;
+    }
+
+    const double loadTime = CpuTimer::calcDuration(startTime, CpuTimer::getCurrentTimePoint()) * 1.0e-3;
+    const uint64_t peakWorkingSet = getProcessPeakWorkingSet();
+
+    if (pScene)
+    {
+        std::cout << "scene,format,mode,load_s,working_set_before_mb,peak_working_set_mb,peak_delta_mb,vertices,triangles" << std::endl;
+        std::cout << mOptions.sceneFile << "," << format << "," << (mOptions.prepare ? "prepare" : "cached") << ","
+            << loadTime << "," << toMB(workingSetBefore) << "," << toMB(peakWorkingSet) << "," << toMB(peakWorkingSet - workingSetBefore) << ","
+            << pScene->getSceneStats().uniqueVertexCount << "," << pScene->getSceneStats().uniqueTriangleCount << std::endl;
+        sReturnCode = 0;
+    }
+
+    gpFramework->shutdown();
+}
+
+int main(int argc, char** argv)
+{
+    args::ArgumentParser parser("Measures the load time and peak working set of a scene loaded from the scene cache.\n"
+        "Run once with --prepare to write the cache, then once per measurement, as the peak working set covers the whole process.");
+    parser.helpParams.programName = "SceneCacheBenchmark";
+    args::HelpFlag helpFlag(parser, "help", "Display this help menu.", {'h', "help"});
+    args::Positional<std::string> sceneFlag(parser, "scene", "Scene file.", args::Options::Required);
+    args::Flag mappedFlag(parser, "mapped", "Use the memory mapped scene cache format instead of the stream compressed one.", {'m', "mapped"});
+    args::Flag prepareFlag(parser, "prepare", "Build the scene from its source and write the scene cache.", {'p', "prepare"});
+    args::CompletionFlag completionFlag(parser, {"complete"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (const args::Completion& e)
+    {
+        std::cout << e.what();
+        return 0;
+    }
+    catch (const args::Help&)
+    {
+        std::cout << parser;
+        return 0;
+    }
+    catch (const args::ParseError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const args::RequiredError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    SceneCacheBenchmark::Options options;
+    options.sceneFile = args::get(sceneFlag);
+    if (mappedFlag) options.mappedCache = true;
+    if (prepareFlag) options.prepare = true;
+
+    SceneCacheBenchmark::UniquePtr pRenderer = std::make_unique<SceneCacheBenchmark>(options);
+    SampleConfig config;
+    config.windowDesc.title = "SceneCacheBenchmark";
+    config.windowDesc.mode = Window::WindowMode::Minimized;
+    config.windowDesc.resizableWindow = true;
+    config.windowDesc.width = config.windowDesc.height = 2;
+    Sample::run(config, pRenderer, argc, argv);
+    return sReturnCode;
+}
@@ -13,12 +13,20 @@ m.loadScene('Arcade/Arcade.pyscene', SceneBuilderFlags.RebuildCache)
 render_frames(m, 'arcade', frames=[64])
 m.loadScene('Arcade/Arcade.pyscene', SceneBuilderFlags.UseCache)
 render_frames(m, 'arcade.cached', frames=[64])
+m.loadScene('Arcade/Arcade.pyscene', SceneBuilderFlags.RebuildCache | SceneBuilderFlags.UseMappedCache)
+render_frames(m, 'arcade.mapped', frames=[64])
+m.loadScene('Arcade/Arcade.pyscene', SceneBuilderFlags.UseCache | SceneBuilderFlags.UseMappedCache)
+render_frames(m, 'arcade.mapped.cached', frames=[64])
 
 # grey_and_white_room
 m.loadScene('grey_and_white_room/grey_and_white_room.fbx', SceneBuilderFlags.RebuildCache)
 render_frames(m, 'grey_and_white_room', frames=[64])
 m.loadScene('grey_and_white_room/grey_and_white_room.fbx', SceneBuilderFlags.UseCache)
 render_frames(m, 'grey_and_white_room.cached', frames=[64])
+m.loadScene('grey_and_white_room/grey_and_white_room.fbx', SceneBuilderFlags.RebuildCache | SceneBuilderFlags.UseMappedCache)
+render_frames(m, 'grey_and_white_room.mapped', frames=[64])
+m.loadScene('grey_and_white_room/grey_and_white_room.fbx', SceneBuilderFlags.UseCache | SceneBuilderFlags.UseMappedCache)
+render_frames(m, 'grey_and_white_room.mapped.cached', frames=[64])
 
 m.removeGraph(MegakernelPathTracerVBuffer)
 m.addGraph(SceneDebuggerGraph)
@@ -28,5 +36,9 @@ m.loadScene(os.path.abspath('scenes/Volumes.pyscene'), SceneBuilderFlags.Rebuild
 render_frames(m, 'volumes', frames=[1])
 m.loadScene(os.path.abspath('scenes/Volumes.pyscene'), SceneBuilderFlags.UseCache)
 render_frames(m, 'volumes.cached', frames=[1])
+m.loadScene(os.path.abspath('scenes/Volumes.pyscene'), SceneBuilderFlags.RebuildCache | SceneBuilderFlags.UseMappedCache)
+render_frames(m, 'volumes.mapped', frames=[1])
+m.loadScene(os.path.abspath('scenes/Volumes.pyscene'), SceneBuilderFlags.UseCache | SceneBuilderFlags.UseMappedCache)
+render_frames(m, 'volumes.mapped.cached', frames=[1])
 
 exit()